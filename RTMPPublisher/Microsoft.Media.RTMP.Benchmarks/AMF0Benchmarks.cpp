@@ -0,0 +1,131 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "BenchmarkHarness.h"
+#include "CommandTemplates.h"
+#include "StreamMetadata.h"
+#include "AMF0Document.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+using namespace Microsoft::Media::RTMP::Benchmarks;
+
+namespace
+{
+  shared_ptr<RTMPMessage> MakeConnect()
+  {
+    return CommandTemplates::Connect().Stamp(0, {
+      1U,
+      std::string("live"),
+      std::string("rtmp://ingest.example.net:1935/live"),
+      RTMPAudioCodecFlag::SUPPORT_SND_AAC,
+      RTMPVideoCodecFlag::SUPPORT_VID_H264 });
+  }
+
+  shared_ptr<RTMPMessage> MakePublish()
+  {
+    return CommandTemplates::Publish().Stamp(1, { 0U, std::string("channel1_720p"), "live" });
+  }
+
+  StreamMetadata MakeMetadata()
+  {
+    StreamMetadata metadata;
+    metadata.HasVideo = true;
+    metadata.FrameRate = 29.97;
+    metadata.Width = 1280U;
+    metadata.Height = 720U;
+    metadata.VideoCodec = "avc1";
+    metadata.VideoBitrate = 2500U;
+    metadata.VideoKeyFrameFrequency = 2U;
+    metadata.HasAudio = true;
+    metadata.AudioCodec = "mp4a";
+    metadata.AudioSampleRate = 48000U;
+    metadata.AudioChannels = 2U;
+    metadata.AudioBitrate = 128U;
+    return metadata;
+  }
+
+  void RunParse(BenchmarkRunner& runner, const std::string& name, shared_ptr<RTMPMessage> msg)
+  {
+    auto payload = msg->GetPayload();
+
+    //arena backed document, reused across messages the way the command dispatcher reuses it
+    auto document = make_shared<AMF0Document>();
+    runner.Run("amf0.parse.document/" + name, payload->size(), [payload, document]()
+    {
+      auto ok = document->Load(AMF0Reader(payload->data(), (unsigned int) payload->size()));
+      DoNotOptimize(ok);
+    });
+
+    //one entity per value
+    runner.Run("amf0.parse.entity/" + name, payload->size(), [payload]()
+    {
+      auto entities = AMF0Entity::TryParse(payload->data(), (unsigned int) payload->size());
+      DoNotOptimize(entities);
+    });
+
+    //pull parser skipping over every value
+    runner.Run("amf0.parse.reader/" + name, payload->size(), [payload]()
+    {
+      AMF0Reader reader(payload->data(), (unsigned int) payload->size());
+      AMF0Token tok;
+      unsigned int count = 0;
+      while (reader.Next(tok))
+        count++;
+      DoNotOptimize(count);
+    });
+  }
+}
+
+void Microsoft::Media::RTMP::Benchmarks::RunAMF0Benchmarks(BenchmarkRunner& runner)
+{
+  auto connect = MakeConnect();
+  auto publish = MakePublish();
+  auto metadata = MakeMetadata();
+  auto setDataFrame = metadata.CreateSetDataFrameMessage(1);
+
+  runner.Run("amf0.encode/connect", connect->GetMessageLength(), []()
+  {
+    DoNotOptimize(MakeConnect());
+  });
+
+  runner.Run("amf0.encode/publish", publish->GetMessageLength(), []()
+  {
+    DoNotOptimize(MakePublish());
+  });
+
+  runner.Run("amf0.encode/setdataframe", setDataFrame->GetMessageLength(), [metadata]()
+  {
+    DoNotOptimize(metadata.CreateSetDataFrameMessage(1));
+  });
+
+  RunParse(runner, "connect", connect);
+  RunParse(runner, "publish", publish);
+  RunParse(runner, "setdataframe", setDataFrame);
+}
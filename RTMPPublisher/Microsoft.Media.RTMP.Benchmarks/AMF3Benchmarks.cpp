@@ -0,0 +1,118 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "BenchmarkHarness.h"
+#include "AMF3.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+using namespace Microsoft::Media::RTMP::Benchmarks;
+
+namespace
+{
+  //values spread over the 1, 2, 3 and 4 byte U29 forms
+  const unsigned int U29Values[] = { 0x05U, 0x7FU, 0x80U, 0x3FFFU, 0x4000U, 0x1FFFFFU, 0x200000U, 0x1FFFFFFFU };
+  const unsigned int U29sPerOp = 1000U;
+
+  //stream metadata the way an AMF3 speaking server sends it - a dynamic object, a nested sealed object and an array of them
+  shared_ptr<AMF3Entity> MakeMetadata()
+  {
+    auto props = make_shared<AMF3Entity::PropertyList>();
+    props->push_back(make_tuple(string("width"), make_shared<AMF3Entity>(1280)));
+    props->push_back(make_tuple(string("height"), make_shared<AMF3Entity>(720)));
+    props->push_back(make_tuple(string("framerate"), make_shared<AMF3Entity>(29.97)));
+    props->push_back(make_tuple(string("videodatarate"), make_shared<AMF3Entity>(2500)));
+    props->push_back(make_tuple(string("audiodatarate"), make_shared<AMF3Entity>(128)));
+    props->push_back(make_tuple(string("encoder"), make_shared<AMF3Entity>(string("Microsoft.Media.RTMP"))));
+    props->push_back(make_tuple(string("stereo"), make_shared<AMF3Entity>(true)));
+
+    auto renditions = make_shared<std::vector<shared_ptr<AMF3Entity>>>();
+    for (int ctr = 0; ctr < 4; ctr++)
+    {
+      auto sealed = make_shared<AMF3Entity::PropertyList>();
+      sealed->push_back(make_tuple(string("name"), make_shared<AMF3Entity>(string("channel1_") + std::to_string(360 + 120 * ctr) + "p")));
+      sealed->push_back(make_tuple(string("bitrate"), make_shared<AMF3Entity>(800000 + 600000 * ctr)));
+      renditions->push_back(AMF3Entity::CreateObject("Rendition", sealed, 2U, false));
+    }
+    props->push_back(make_tuple(string("renditions"), AMF3Entity::CreateArray(renditions)));
+
+    return AMF3Entity::CreateObject("", props);
+  }
+}
+
+void Microsoft::Media::RTMP::Benchmarks::RunAMF3Benchmarks(BenchmarkRunner& runner)
+{
+  auto u29s = make_shared<vector<BYTE>>();
+  for (unsigned int ctr = 0; ctr < U29sPerOp; ctr++)
+    AMF3Writer::EncodeU29(U29Values[ctr % 8], *u29s);
+
+  runner.Run("amf3.u29.encode", u29s->size(), [u29s]()
+  {
+    vector<BYTE> bs;
+    bs.reserve(u29s->size());
+    for (unsigned int ctr = 0; ctr < U29sPerOp; ctr++)
+      AMF3Writer::EncodeU29(U29Values[ctr % 8], bs);
+    DoNotOptimize(bs);
+  });
+
+  runner.Run("amf3.u29.decode", u29s->size(), [u29s]()
+  {
+    ByteReader br(u29s->data(), (unsigned int) u29s->size());
+    unsigned int sum = 0;
+    for (unsigned int ctr = 0; ctr < U29sPerOp; ctr++)
+      sum += AMF3Reader::DecodeU29(br);
+    DoNotOptimize(sum);
+  });
+
+  auto metadata = MakeMetadata();
+  auto encoded = make_shared<vector<BYTE>>();
+  AMF3Writer(encoded).Write(metadata);
+
+  runner.Run("amf3.encode/metadata", encoded->size(), [metadata]()
+  {
+    auto bs = make_shared<vector<BYTE>>();
+    AMF3Writer(bs).Write(metadata);
+    DoNotOptimize(bs);
+  });
+
+  runner.Run("amf3.decode/metadata", encoded->size(), [encoded]()
+  {
+    auto value = AMF3Reader(encoded->data(), (unsigned int) encoded->size()).Read();
+    DoNotOptimize(value);
+  });
+
+  //what the AMF0 reader does with an AvmPlus value it is not asked to decode
+  runner.Run("amf3.skip/metadata", encoded->size(), [encoded]()
+  {
+    AMF3Reader reader(encoded->data(), (unsigned int) encoded->size());
+    auto ok = reader.Skip();
+    DoNotOptimize(ok);
+  });
+}
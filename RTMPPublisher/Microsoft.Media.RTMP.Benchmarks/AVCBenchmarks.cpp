@@ -0,0 +1,99 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "BenchmarkHarness.h"
+#include "AVCParser.h"
+#include "ByteWriter.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+using namespace Microsoft::Media::RTMP::Benchmarks;
+
+namespace
+{
+  void AppendNALU(std::vector<BYTE>& au, BYTE header, unsigned int len, unsigned int& seed)
+  {
+    static const BYTE startCode[] = { 0x00, 0x00, 0x00, 0x01 };
+    au.insert(au.end(), startCode, startCode + sizeof(startCode));
+    au.push_back(header);
+    for (unsigned int ctr = 1; ctr < len; ctr++)
+    {
+      seed = seed * 1103515245U + 12345U;
+      //never zero, so the body can not contain a start code
+      au.push_back((BYTE) ((seed >> 16) % 255U + 1U));
+    }
+  }
+
+  //an Annex-B access unit the way an encoder hands it over - AUD, and SPS/PPS ahead of an IDR
+  std::vector<BYTE> MakeAccessUnit(bool idr, unsigned int sliceLength)
+  {
+    std::vector<BYTE> au;
+    unsigned int seed = 42U;
+    AppendNALU(au, 0x09, 2U, seed);
+    if (idr)
+    {
+      AppendNALU(au, 0x67, 24U, seed);
+      AppendNALU(au, 0x68, 4U, seed);
+    }
+    AppendNALU(au, idr ? 0x65 : 0x41, sliceLength, seed);
+    return au;
+  }
+}
+
+void Microsoft::Media::RTMP::Benchmarks::RunAVCBenchmarks(BenchmarkRunner& runner)
+{
+  struct
+  {
+    const char* Name;
+    bool IDR;
+    unsigned int SliceLength;
+  } profiles[] = { { "pframe", false, 10U * 1024U }, { "idr", true, 300U * 1024U } };
+
+  for (auto& profile : profiles)
+  {
+    auto au = make_shared<std::vector<BYTE>>(MakeAccessUnit(profile.IDR, profile.SliceLength));
+
+    //start code scan splitting the access unit into NALU's
+    runner.Run(std::string("annexb.scan/") + profile.Name, au->size(), [au]()
+    {
+      auto nalus = AVCParser::Parse(*au);
+      DoNotOptimize(nalus);
+    });
+
+    //scan plus rewrite into the length prefixed form carried in an RTMP video message
+    runner.Run(std::string("avcc.convert/") + profile.Name, au->size(), [au]()
+    {
+      auto nalus = AVCParser::Parse(*au);
+      std::vector<BYTE> avcc;
+      ByteWriter bw(avcc, AVCParser::GetAVCCLength(nalus));
+      AVCParser::WriteAVCC(nalus, bw);
+      DoNotOptimize(avcc);
+    });
+  }
+}
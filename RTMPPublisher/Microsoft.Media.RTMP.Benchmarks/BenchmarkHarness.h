@@ -0,0 +1,196 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      namespace Benchmarks
+      {
+        ///<summary>Number of heap allocations made by the process so far - counted by the operator new replacements in BenchmarkMain.cpp</summary>
+        unsigned long long GetAllocationCount();
+
+        ///<summary>Keeps the compiler from discarding a result the benchmark does not otherwise use</summary>
+        template<typename T>
+        inline void DoNotOptimize(const T& val)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+          asm volatile("" : : "g"(&val) : "memory");
+#else
+          static volatile const void* sink;
+          sink = &val;
+#endif
+        }
+
+        struct BenchmarkResult
+        {
+          std::string Name;
+          unsigned long long Iterations = 0ULL;
+          double NanosecondsPerOp = 0;
+          //0 for benchmarks that do not move a payload
+          double BytesPerSecond = 0;
+          double AllocationsPerOp = 0;
+        };
+
+        ///<summary>Runs each benchmark in growing batches until a batch takes at least the minimum time, then reports the last batch</summary>
+        class BenchmarkRunner
+        {
+        public:
+
+          BenchmarkRunner(const std::string& filter = "", unsigned int minTimeMilliseconds = 250U) :
+            _filter(filter), _minTime(std::chrono::milliseconds(minTimeMilliseconds))
+          {
+
+          }
+
+          ///<param name='name'>Slash separated name - area/case/parameters</param>
+          ///<param name='bytesPerOp'>Payload bytes one operation processes - used for the throughput column</param>
+          ///<param name='op'>One operation - called repeatedly, any setup belongs outside of it</param>
+          void Run(const std::string& name, unsigned long long bytesPerOp, std::function<void()> op)
+          {
+            if (!_filter.empty() && name.find(_filter) == std::string::npos)
+              return;
+
+            //warm up caches and any lazily built state
+            op();
+
+            unsigned long long iterations = 1ULL;
+            while (true)
+            {
+              auto allocations = GetAllocationCount();
+              auto start = std::chrono::steady_clock::now();
+              for (unsigned long long ctr = 0; ctr < iterations; ctr++)
+                op();
+              auto elapsed = std::chrono::steady_clock::now() - start;
+              allocations = GetAllocationCount() - allocations;
+
+              if (elapsed >= _minTime || iterations >= (1ULL << 40))
+              {
+                BenchmarkResult result;
+                result.Name = name;
+                result.Iterations = iterations;
+                auto ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+                result.NanosecondsPerOp = ns / (double) iterations;
+                result.BytesPerSecond = bytesPerOp > 0 ? (double) bytesPerOp * (double) iterations * 1e9 / ns : 0;
+                result.AllocationsPerOp = (double) allocations / (double) iterations;
+                _results.push_back(result);
+                printf("%-48s %14.1f ns/op %12.1f MB/s %8.2f allocs/op\n", name.c_str(),
+                  result.NanosecondsPerOp, result.BytesPerSecond / 1e6, result.AllocationsPerOp);
+                fflush(stdout);
+                return;
+              }
+
+              //aim a little past the minimum time so that the next batch is usually the last
+              auto ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+              auto target = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(_minTime).count() * 1.2;
+              auto next = ns > 0 ? (unsigned long long) ((double) iterations * target / ns) : iterations * 10;
+              iterations = std::max(iterations * 2, std::min(next, iterations * 100));
+            }
+          }
+
+          const std::vector<BenchmarkResult>& GetResults() const
+          {
+            return _results;
+          }
+
+          ///<summary>Writes the results as JSON - one object per benchmark under "benchmarks"</summary>
+          bool WriteJson(const std::string& path, const std::string& label) const
+          {
+            auto file = fopen(path.c_str(), "w");
+            if (file == nullptr)
+              return false;
+            fprintf(file, "{\n  \"label\": \"%s\",\n  \"benchmarks\": [\n", Escape(label).c_str());
+            for (size_t ctr = 0; ctr < _results.size(); ctr++)
+            {
+              auto& result = _results[ctr];
+              fprintf(file, "    { \"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"bytes_per_second\": %.1f, \"allocations_per_op\": %.4f }%s\n",
+                Escape(result.Name).c_str(), result.Iterations, result.NanosecondsPerOp, result.BytesPerSecond, result.AllocationsPerOp,
+                ctr + 1 < _results.size() ? "," : "");
+            }
+            fprintf(file, "  ]\n}\n");
+            return fclose(file) == 0;
+          }
+
+          ///<summary>Writes the results as CSV with a header row</summary>
+          bool WriteCsv(const std::string& path) const
+          {
+            auto file = fopen(path.c_str(), "w");
+            if (file == nullptr)
+              return false;
+            fprintf(file, "name,iterations,ns_per_op,bytes_per_second,allocations_per_op\n");
+            for (auto& result : _results)
+              fprintf(file, "%s,%llu,%.3f,%.1f,%.4f\n", result.Name.c_str(), result.Iterations, result.NanosecondsPerOp, result.BytesPerSecond, result.AllocationsPerOp);
+            return fclose(file) == 0;
+          }
+
+        private:
+
+          static std::string Escape(const std::string& val)
+          {
+            std::string retval;
+            for (auto c : val)
+            {
+              if (c == '"' || c == '\\')
+                retval.push_back('\\');
+              retval.push_back(c);
+            }
+            return retval;
+          }
+
+          std::string _filter;
+          std::chrono::nanoseconds _minTime;
+          std::vector<BenchmarkResult> _results;
+        };
+
+        //one per benchmark source file
+        void RunChunkingBenchmarks(BenchmarkRunner& runner);
+
+        void RunAMF0Benchmarks(BenchmarkRunner& runner);
+
+        void RunAMF3Benchmarks(BenchmarkRunner& runner);
+
+        void RunAVCBenchmarks(BenchmarkRunner& runner);
+
+        void RunByteWriterBenchmarks(BenchmarkRunner& runner);
+
+        void RunLoopbackBenchmarks(BenchmarkRunner& runner);
+      }
+    }
+  }
+}
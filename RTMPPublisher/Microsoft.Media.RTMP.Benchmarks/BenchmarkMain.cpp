@@ -0,0 +1,135 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "BenchmarkHarness.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP::Benchmarks;
+
+namespace
+{
+  std::atomic<unsigned long long> allocationCount(0ULL);
+}
+
+//every allocation in the process goes through these - allocations/op is the difference across a batch divided by its size
+void* operator new(size_t size)
+{
+  allocationCount.fetch_add(1ULL, std::memory_order_relaxed);
+  if (auto ptr = malloc(size > 0 ? size : 1))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+unsigned long long Microsoft::Media::RTMP::Benchmarks::GetAllocationCount()
+{
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+static void PrintUsage(const char* name)
+{
+  printf("usage: %s [--filter <substring>] [--min-time <ms>] [--json <file>] [--csv <file>] [--label <text>]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+  std::string filter;
+  std::string jsonPath;
+  std::string csvPath;
+  std::string label;
+  unsigned int minTime = 250U;
+
+  for (int ctr = 1; ctr < argc; ctr++)
+  {
+    std::string arg = argv[ctr];
+    bool hasValue = ctr + 1 < argc;
+    if (arg == "--filter" && hasValue)
+      filter = argv[++ctr];
+    else if (arg == "--min-time" && hasValue)
+      minTime = (unsigned int) strtoul(argv[++ctr], nullptr, 10);
+    else if (arg == "--json" && hasValue)
+      jsonPath = argv[++ctr];
+    else if (arg == "--csv" && hasValue)
+      csvPath = argv[++ctr];
+    else if (arg == "--label" && hasValue)
+      label = argv[++ctr];
+    else
+    {
+      PrintUsage(argv[0]);
+      return arg == "--help" ? 0 : 2;
+    }
+  }
+
+  BenchmarkRunner runner(filter, minTime);
+  RunChunkingBenchmarks(runner);
+  RunAMF0Benchmarks(runner);
+  RunAMF3Benchmarks(runner);
+  RunAVCBenchmarks(runner);
+  RunByteWriterBenchmarks(runner);
+  RunLoopbackBenchmarks(runner);
+
+  if (!jsonPath.empty() && !runner.WriteJson(jsonPath, label))
+  {
+    fprintf(stderr, "Could not write %s\n", jsonPath.c_str());
+    return 1;
+  }
+  if (!csvPath.empty() && !runner.WriteCsv(csvPath))
+  {
+    fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <memory>
+#include <vector>
+#include "BenchmarkHarness.h"
+#include "ByteWriter.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+using namespace Microsoft::Media::RTMP::Benchmarks;
+
+namespace
+{
+  //a Type0 chunk header, an AMF0 number and an FLV video tag header - the field mix the send path writes
+  const unsigned int RecordSize = 12U + 9U + 5U;
+  const unsigned int RecordsPerOp = 1000U;
+
+  template<typename Writer>
+  void WriteRecord(Writer& bw, unsigned int ctr)
+  {
+    bw.put_u8(0x06);
+    bw.put_u24be(ctr & 0xFFFFFF);
+    bw.put_u24be(10240U);
+    bw.put_u8(0x09);
+    bw.put_u32le(1U);
+    bw.put_u8(0x00);
+    bw.put_f64be((double) ctr);
+    bw.put_u8(0x27);
+    bw.put_u8(0x01);
+    bw.put_u24be(33U);
+  }
+
+  //pushes one byte at a time in network byte order - how fields were appended before ByteWriter, kept as the baseline
+  struct PushBackWriter
+  {
+    vector<BYTE>& Bitstream;
+
+    template<typename T>
+    void Push(T val, unsigned int numbytes)
+    {
+      vector<BYTE> temp;
+      for (unsigned int i = 0; i < numbytes; i++)
+      {
+        temp.push_back((BYTE) (val & 0xFF));
+        val >>= 8;
+      }
+      for (auto itr = temp.rbegin(); itr != temp.rend(); itr++)
+        Bitstream.push_back(*itr);
+    }
+
+    void put_u8(BYTE val) { Bitstream.push_back(val); }
+    void put_u24be(unsigned int val) { Push(val, 3); }
+    void put_u32le(unsigned int val) { for (unsigned int i = 0; i < 4; i++, val >>= 8) Bitstream.push_back((BYTE) (val & 0xFF)); }
+    void put_f64be(double val) { Push(BitOp::FromDoubleToFPRep(val), 8); }
+  };
+}
+
+void Microsoft::Media::RTMP::Benchmarks::RunByteWriterBenchmarks(BenchmarkRunner& runner)
+{
+  //into a caller supplied buffer - every write bounds checked against it
+  auto buffer = make_shared<vector<BYTE>>(RecordSize * RecordsPerOp);
+  runner.Run("bytewriter.buffer", RecordSize * RecordsPerOp, [buffer]()
+  {
+    ByteWriter bw(buffer->data(), (unsigned int) buffer->size());
+    for (unsigned int ctr = 0; ctr < RecordsPerOp; ctr++)
+      WriteRecord(bw, ctr);
+    DoNotOptimize(buffer->data()[0]);
+  });
+
+  //appending to a byte array sized once for the whole batch
+  runner.Run("bytewriter.append", RecordSize * RecordsPerOp, []()
+  {
+    vector<BYTE> bitstream;
+    ByteWriter bw(bitstream, RecordSize * RecordsPerOp);
+    for (unsigned int ctr = 0; ctr < RecordsPerOp; ctr++)
+      WriteRecord(bw, ctr);
+    DoNotOptimize(bitstream);
+  });
+
+  //no size up front - the writer grows the array on every write
+  runner.Run("bytewriter.grow", RecordSize * RecordsPerOp, []()
+  {
+    vector<BYTE> bitstream;
+    ByteWriter bw(bitstream, 0);
+    for (unsigned int ctr = 0; ctr < RecordsPerOp; ctr++)
+      WriteRecord(bw, ctr);
+    DoNotOptimize(bitstream);
+  });
+
+  runner.Run("bytewriter.pushback", RecordSize * RecordsPerOp, []()
+  {
+    vector<BYTE> bitstream;
+    PushBackWriter bw = { bitstream };
+    for (unsigned int ctr = 0; ctr < RecordsPerOp; ctr++)
+      WriteRecord(bw, ctr);
+    DoNotOptimize(bitstream);
+  });
+}
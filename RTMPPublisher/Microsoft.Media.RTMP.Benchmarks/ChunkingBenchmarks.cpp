@@ -0,0 +1,149 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BenchmarkHarness.h"
+#include "RTMPChunking.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+using namespace Microsoft::Media::RTMP::Benchmarks;
+
+namespace
+{
+  struct MessageProfile
+  {
+    const char* Name;
+    BYTE MessageTypeID;
+    unsigned int Size;
+  };
+
+  //typical publisher traffic - an AAC frame, a P-frame and an IDR of a 720p rendition
+  const MessageProfile Profiles[] = {
+    { "audio", RTMPMessageType::AUDIO, 400U },
+    { "pframe", RTMPMessageType::VIDEO, 10U * 1024U },
+    { "idr", RTMPMessageType::VIDEO, 300U * 1024U }
+  };
+
+  const unsigned int ChunkSizes[] = { 128U, 4096U, 65536U };
+
+  shared_ptr<RTMPMessage> MakeMessage(const MessageProfile& profile)
+  {
+    auto payload = make_shared<vector<BYTE>>(profile.Size);
+    for (unsigned int ctr = 0; ctr < profile.Size; ctr++)
+      (*payload)[ctr] = (BYTE) (ctr * 7 + 3);
+    return make_shared<RTMPMessage>(1000U, profile.MessageTypeID, 1U, payload);
+  }
+
+  //one ChunkMessage per chunk, copied into the output - the chunking the segment list replaced, kept as the bytes/s baseline
+  shared_ptr<vector<BYTE>> ChunkPerCopy(unsigned int chunkStreamID, unsigned int chunkSize, shared_ptr<RTMPMessage> msg)
+  {
+    auto retval = make_shared<vector<BYTE>>();
+    unsigned int messagelen = msg->GetMessageLength();
+    BYTE* payload = msg->GetPayload()->data();
+    for (unsigned int offset = 0; offset < messagelen; offset += chunkSize)
+    {
+      unsigned int len = min(messagelen - offset, chunkSize);
+      auto bs = offset == 0 ?
+        ChunkMessage(chunkStreamID, msg->GetTimestamp(), messagelen, msg->GetMessageTypeID(), msg->GetMessageStreamID(), payload, len).ToBitstream() :
+        ChunkMessage(RTMPChunkType::Type3, chunkStreamID, msg->GetTimestamp(), payload + offset, len).ToBitstream();
+      auto oldsize = retval->size();
+      retval->resize(oldsize + bs->size());
+      memcpy(retval->data() + oldsize, bs->data(), bs->size());
+    }
+    return retval;
+  }
+
+  std::string Name(const char* area, const MessageProfile& profile, unsigned int chunkSize)
+  {
+    return std::string(area) + "/" + profile.Name + "/chunk" + std::to_string(chunkSize);
+  }
+}
+
+void Microsoft::Media::RTMP::Benchmarks::RunChunkingBenchmarks(BenchmarkRunner& runner)
+{
+  //header writing alone - a batch of headers per op so the call overhead of the runner does not dominate
+  const unsigned int HeadersPerOp = 1000U;
+  const char* typeNames[4] = { "type0", "type1", "type2", "type3" };
+  for (BYTE chunkType = 0; chunkType < 4; chunkType++)
+  {
+    for (auto timestamp : { 1000U, 0x01000000U })
+    {
+      std::string name = std::string("chunk.header/") + typeNames[chunkType] + (timestamp >= 0xFFFFFF ? "/extts" : "");
+      auto buffer = make_shared<vector<BYTE>>(ChunkMessage::MAXHEADERSIZE * HeadersPerOp);
+      unsigned int headerSize = SelectChunkHeaderWriter(chunkType, 6U, timestamp)(buffer->data(), 6U, timestamp, 400U, RTMPMessageType::AUDIO, 1U);
+      runner.Run(name, headerSize * HeadersPerOp, [buffer, chunkType, timestamp, HeadersPerOp]()
+      {
+        auto writer = SelectChunkHeaderWriter(chunkType, 6U, timestamp);
+        BYTE* dst = buffer->data();
+        for (unsigned int ctr = 0; ctr < HeadersPerOp; ctr++)
+          dst += writer(dst, 6U, timestamp + ctr, 400U, RTMPMessageType::AUDIO, 1U);
+        DoNotOptimize(dst);
+      });
+    }
+  }
+
+  for (auto& profile : Profiles)
+  {
+    auto msg = MakeMessage(profile);
+
+    for (auto chunkSize : ChunkSizes)
+    {
+      //segments pointing into the payload - what the send path hands to a vectored write
+      runner.Run(Name("chunk.segments", profile, chunkSize), profile.Size, [msg, chunkSize]()
+      {
+        auto segments = ChunkProcessor::ToChunkSegments(6U, chunkSize, msg);
+        DoNotOptimize(segments);
+      });
+
+      runner.Run(Name("chunk.percopy", profile, chunkSize), profile.Size, [msg, chunkSize]()
+      {
+        auto bitstream = ChunkPerCopy(6U, chunkSize, msg);
+        DoNotOptimize(bitstream);
+      });
+
+      //segments flattened into one contiguous bitstream
+      runner.Run(Name("chunk.bitstream", profile, chunkSize), profile.Size, [msg, chunkSize]()
+      {
+        auto bitstream = ChunkProcessor::ToChunkedBitstream(6U, chunkSize, msg);
+        DoNotOptimize(bitstream);
+      });
+
+      //reassembly through the streaming decoder, fed the way a socket read would
+      auto bitstream = ChunkProcessor::ToChunkedBitstream(6U, chunkSize, msg);
+      auto decoder = make_shared<ChunkDecoder>(chunkSize);
+      runner.Run(Name("dechunk", profile, chunkSize), profile.Size, [bitstream, decoder]()
+      {
+        auto messages = decoder->Decode(bitstream->data(), (unsigned int) bitstream->size());
+        DoNotOptimize(messages);
+      });
+    }
+  }
+}
@@ -0,0 +1,140 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BenchmarkHarness.h"
+#include "LoopbackTransport.h"
+#include "FakeIngestPeer.h"
+#include "RTMPMessageFormats.h"
+#include "RTMPChunking.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+using namespace Microsoft::Media::RTMP::Benchmarks;
+
+namespace
+{
+  const unsigned int HandshakeBytes = 2U * (1U + 1536U + 1536U);
+  //a second of 720p video at 30 fps, 10 KB a frame
+  const unsigned int FramesPerOp = 30U;
+  const unsigned int FrameSize = 10U * 1024U;
+
+  void Send(RTMPTransport& transport, shared_ptr<vector<BYTE>> bitstream)
+  {
+    //loopback sends complete before they return
+    TransportBuffer buffer = { bitstream->data(), (unsigned int) bitstream->size() };
+    transport.Send(&buffer, 1, [](unsigned int, std::exception_ptr) {});
+  }
+
+  void ReceiveExactly(RTMPTransport& transport, std::vector<BYTE>& buffer)
+  {
+    unsigned int received = 0;
+    while (received < buffer.size())
+    {
+      std::promise<unsigned int> done;
+      transport.Receive(buffer.data() + received, (unsigned int) buffer.size() - received, [&done](unsigned int len, std::exception_ptr)
+      {
+        done.set_value(len);
+      });
+      auto len = done.get_future().get();
+      if (len == 0)
+        return;
+      received += len;
+    }
+  }
+
+  void Handshake(RTMPTransport& transport, FakeIngestPeer& peer)
+  {
+    auto c0c1 = make_shared<vector<BYTE>>();
+    HandshakeMessageC0S0(HandshakeMessageC0S0::RTMP_VERSION).ToBitstream(c0c1);
+    HandshakeMessageC1C2S1S2(0, make_shared<vector<BYTE>>(1528, (BYTE) 0x5A)).ToBitstream(c0c1);
+    Send(transport, c0c1);
+
+    std::vector<BYTE> s0s1s2(1 + 1536 + 1536);
+    ReceiveExactly(transport, s0s1s2);
+    auto s1 = HandshakeMessageC1C2S1S2::TryParse(s0s1s2.data() + 1, 1536);
+    auto c2 = make_shared<vector<BYTE>>();
+    HandshakeMessageC1C2S1S2(s1->GetBaseEpoch(), s1->GetParseTimestamp(), s1->GetRandomBytes()).ToBitstream(c2);
+    Send(transport, c2);
+
+    while (!peer.GetStats().HandshakeValid)
+      std::this_thread::yield();
+  }
+
+  ///<summary>Publishes frames to a fake ingest peer and waits until it has decoded all of them</summary>
+  void RunThroughput(BenchmarkRunner& runner, const std::string& name, unsigned int chunkSize, unsigned int maxReadSize)
+  {
+    auto transports = LoopbackTransport::CreatePair();
+    LoopbackFaults faults;
+    faults.MaxReadSize = maxReadSize;
+    transports.second->SetReceiveFaults(faults);
+    auto peer = make_shared<FakeIngestPeer>(transports.second);
+    peer->Start();
+    Handshake(*transports.first, *peer);
+
+    Send(*transports.first, ChunkProcessor::ToChunkedBitstream(2, 128, make_shared<ProtoSetChunkSizeMessage>(chunkSize)));
+
+    //chunked once up front - the benchmark measures the transport and the peer's decoder, not the chunker
+    auto frames = make_shared<vector<BYTE>>();
+    for (unsigned int ctr = 0; ctr < FramesPerOp; ctr++)
+    {
+      auto frame = ChunkProcessor::ToChunkedBitstream(6, chunkSize,
+        make_shared<RTMPMessage>(ctr * 33, (BYTE) RTMPMessageType::VIDEO, 1U, make_shared<vector<BYTE>>(FrameSize, (BYTE) ctr)));
+      frames->insert(frames->end(), frame->begin(), frame->end());
+    }
+    auto transport = transports.first;
+    auto expected = make_shared<unsigned int>(0U);
+
+    runner.Run(name, (unsigned long long) FramesPerOp * FrameSize, [transport, peer, frames, expected]()
+    {
+      Send(*transport, frames);
+      *expected += FramesPerOp;
+      while (peer->GetStats().VideoMessages < *expected)
+        std::this_thread::yield();
+    });
+  }
+}
+
+void Microsoft::Media::RTMP::Benchmarks::RunLoopbackBenchmarks(BenchmarkRunner& runner)
+{
+  //a fresh pair and peer every time - includes starting the pair's delivery thread
+  runner.Run("loopback.handshake", HandshakeBytes, []()
+  {
+    auto transports = LoopbackTransport::CreatePair();
+    FakeIngestPeer peer(transports.second);
+    peer.Start();
+    Handshake(*transports.first, peer);
+  });
+
+  RunThroughput(runner, "loopback.throughput/4096", 4096U, 0U);
+  RunThroughput(runner, "loopback.throughput/128", 128U, 0U);
+  //reads no larger than a TCP segment
+  RunThroughput(runner, "loopback.throughput/4096/mss", 4096U, 1460U);
+}
@@ -0,0 +1,145 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <signal.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include "IngestServer.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  volatile sig_atomic_t stopRequested = 0;
+
+  void OnSignal(int)
+  {
+    stopRequested = 1;
+  }
+
+  void PrintReport(IngestServer& server)
+  {
+    unsigned int open = 0U;
+    for (auto& report : server.GetReport())
+    {
+      if (report.Open)
+        open++;
+      printf("%4u %-22s %-6s %-24s %10.1f kbps %8.1f msg/s %7.2f ms jitter  a/v/d %u/%u/%u\n",
+        report.ConnectionID,
+        report.RemoteAddress.c_str(),
+        report.Open ? "open" : "closed",
+        report.Stats.StreamName.empty() ? "-" : report.Stats.StreamName.c_str(),
+        report.BytesPerSecond * 8.0 / 1000.0,
+        report.MessagesPerSecond,
+        report.Stats.JitterMilliseconds,
+        report.Stats.AudioMessages,
+        report.Stats.VideoMessages,
+        report.Stats.DataMessages);
+    }
+    printf("-- %u open\n", open);
+    fflush(stdout);
+  }
+
+  void PrintUsage(const char* name)
+  {
+    printf("usage: %s [--address <ipv4>] [--port <port>] [--duration <s>] [--report-interval <s>] [--stream-id <id>] [--chunk-size <bytes>] [--checksum]\n", name);
+  }
+}
+
+//runs an IngestServer until interrupted (or for --duration seconds) and prints the per connection report periodically
+int main(int argc, char** argv)
+{
+  std::string address = "127.0.0.1";
+  unsigned short port = 1935;
+  unsigned int duration = 0U;
+  unsigned int reportInterval = 5U;
+  FakeIngestScript script;
+
+  for (int ctr = 1; ctr < argc; ctr++)
+  {
+    std::string arg = argv[ctr];
+    bool hasValue = ctr + 1 < argc;
+    if (arg == "--address" && hasValue)
+      address = argv[++ctr];
+    else if (arg == "--port" && hasValue)
+      port = (unsigned short) strtoul(argv[++ctr], nullptr, 10);
+    else if (arg == "--duration" && hasValue)
+      duration = (unsigned int) strtoul(argv[++ctr], nullptr, 10);
+    else if (arg == "--report-interval" && hasValue)
+      reportInterval = (unsigned int) strtoul(argv[++ctr], nullptr, 10);
+    else if (arg == "--stream-id" && hasValue)
+      script.StreamID = (unsigned int) strtoul(argv[++ctr], nullptr, 10);
+    else if (arg == "--chunk-size" && hasValue)
+      script.SetChunkSize = (unsigned int) strtoul(argv[++ctr], nullptr, 10);
+    else if (arg == "--checksum")
+      script.ChecksumMedia = true;
+    else
+    {
+      PrintUsage(argv[0]);
+      return arg == "--help" ? 0 : 2;
+    }
+  }
+
+  signal(SIGINT, OnSignal);
+  signal(SIGTERM, OnSignal);
+
+  IngestServer server(script);
+  try
+  {
+    port = server.Listen(address, port);
+  }
+  catch (const std::exception& ex)
+  {
+    fprintf(stderr, "%s\n", ex.what());
+    return 1;
+  }
+  printf("listening on %s:%u\n", address.c_str(), (unsigned int) port);
+  fflush(stdout);
+
+  auto started = std::chrono::steady_clock::now();
+  auto lastReport = started;
+  while (stopRequested == 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto now = std::chrono::steady_clock::now();
+    if (duration > 0 && now - started >= std::chrono::seconds(duration))
+      break;
+    if (reportInterval > 0 && now - lastReport >= std::chrono::seconds(reportInterval))
+    {
+      PrintReport(server);
+      lastReport = now;
+    }
+  }
+
+  server.Stop();
+  PrintReport(server);
+  return 0;
+}
@@ -0,0 +1,371 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "TestHarness.h"
+#include "ByteReader.h"
+#include "RTMPMessageFormats.h"
+#include "AMF0Document.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  unsigned long long Bits(double val)
+  {
+    unsigned long long bits = 0;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits;
+  }
+
+  double FromBits(unsigned long long bits)
+  {
+    double val = 0;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+  }
+
+  //values the old bit by bit conversion got wrong, as raw binary64 patterns so that NaN payloads and signed zeros are kept
+  const unsigned long long EdgeNumbers[] = {
+    0x0000000000000000ULL, //+0
+    0x8000000000000000ULL, //-0
+    0x7FF0000000000000ULL, //+Inf
+    0xFFF0000000000000ULL, //-Inf
+    0x7FF8000000000000ULL, //quiet NaN
+    0xFFF8000000000000ULL, //negative quiet NaN
+    0x7FF8DEADBEEF0001ULL, //quiet NaN with a payload
+    0x0000000000000001ULL, //smallest subnormal
+    0x800FFFFFFFFFFFFFULL, //largest negative subnormal
+    0x0010000000000000ULL, //smallest normal
+    0x7FEFFFFFFFFFFFFFULL, //largest finite
+    0xFFEFFFFFFFFFFFFFULL, //lowest finite
+    0x3FF0000000000000ULL, //1
+    0x3FB999999999999AULL, //0.1
+    0x4341C37937E08000ULL  //10^16 - past the range every integer is exact in
+  };
+
+  //encodes one number with EncodeNumber and parses it back with TryParse
+  double RoundTripNumber(double val, vector<BYTE>& encoded)
+  {
+    auto bs = make_shared<vector<BYTE>>();
+    AMF0Entity::EncodeNumber(val, bs);
+    encoded = *bs;
+    auto entities = AMF0Entity::TryParse(bs);
+    if (entities.size() != 1 || entities[0]->GetType() != AMF0TypeMarker::Number)
+      throw std::logic_error("Number did not parse back");
+    return entities[0]->GetNumberValue();
+  }
+
+  typedef std::vector<tuple<string, shared_ptr<AMF0Entity>>> PropertyMap;
+
+  shared_ptr<PropertyMap> Properties(std::initializer_list<tuple<string, shared_ptr<AMF0Entity>>> props)
+  {
+    return make_shared<PropertyMap>(props);
+  }
+
+  shared_ptr<vector<BYTE>> EncodeEntity(shared_ptr<AMF0Entity> entity)
+  {
+    auto bs = make_shared<vector<BYTE>>();
+    AMF0Entity::Encode(entity, bs);
+    return bs;
+  }
+
+  shared_ptr<AMF0Entity> String(const string& val)
+  {
+    return make_shared<AMF0Entity>(val);
+  }
+
+  //onStatus with an info object - a second "code" after the first, the way a sloppy server might send it
+  shared_ptr<vector<BYTE>> StatusPayload()
+  {
+    auto bs = make_shared<vector<BYTE>>();
+    AMF0Entity::EncodeString("onStatus", bs);
+    AMF0Entity::EncodeNumber(0, bs);
+    AMF0Entity::EncodeNull(bs);
+    AMF0Entity::EncodeObject(Properties({
+      make_tuple(string("level"), String("status")),
+      make_tuple(string("code"), String("NetStream.Publish.Start")),
+      make_tuple(string("description"), String("Publishing")),
+      make_tuple(string("code"), String("NetStream.Publish.Duplicate")) }), bs);
+    return bs;
+  }
+
+  bool Throws(const vector<BYTE>& payload)
+  {
+    try
+    {
+      AMF0Entity::TryParse(payload.data(), (unsigned int) payload.size());
+    }
+    catch (const std::logic_error&)
+    {
+      return true;
+    }
+    return false;
+  }
+}
+
+TEST_CASE(AMF0Number_EncodesBigEndianBinary64)
+{
+  struct Golden
+  {
+    double Value;
+    vector<BYTE> Expected;
+  };
+  const Golden goldens[] = {
+    { 1.0, { 0x00, 0x3F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+    { -0.0, { 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+    { -2.5, { 0x00, 0xC0, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+    { numeric_limits<double>::infinity(), { 0x00, 0x7F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+    { numeric_limits<double>::denorm_min(), { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 } },
+    { numeric_limits<double>::max(), { 0x00, 0x7F, 0xEF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF } }
+  };
+
+  for (auto& golden : goldens)
+  {
+    auto bs = make_shared<vector<BYTE>>();
+    AMF0Entity::EncodeNumber(golden.Value, bs);
+    CHECK(*bs == golden.Expected);
+  }
+}
+
+TEST_CASE(AMF0Number_EdgeValuesRoundTripBitExact)
+{
+  for (auto bits : EdgeNumbers)
+  {
+    double val = FromBits(bits);
+    CHECK_EQUAL(bits, BitOp::FromDoubleToFPRep(val));
+    CHECK_EQUAL(bits, Bits(BitOp::FromFPRepToDouble(bits)));
+
+    vector<BYTE> encoded;
+    CHECK_EQUAL(bits, Bits(RoundTripNumber(val, encoded)));
+    REQUIRE(encoded.size() == 9U);
+    ByteReader br(encoded.data() + 1, 8);
+    CHECK_EQUAL(bits, br.get_u64be());
+  }
+
+  vector<BYTE> encoded;
+  CHECK(std::isnan(RoundTripNumber(numeric_limits<double>::quiet_NaN(), encoded)));
+  CHECK(std::signbit(RoundTripNumber(-0.0, encoded)));
+  CHECK(std::isinf(RoundTripNumber(-numeric_limits<double>::infinity(), encoded)));
+}
+
+TEST_CASE(AMF0Number_RandomBitPatternsRoundTripBitExact)
+{
+  //fixed seed - a failure names the exact pattern and reproduces
+  std::mt19937_64 rng(0x414D4630ULL);
+  vector<BYTE> buffer(8);
+  for (unsigned int ctr = 0; ctr < 100000U; ctr++)
+  {
+    unsigned long long bits = rng();
+    //keep NaNs quiet - a signaling NaN may be quieted by the FPU when it passes through a double, which is not the codec's doing
+    if ((bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL && (bits & 0x000FFFFFFFFFFFFFULL) != 0)
+      bits |= 0x0008000000000000ULL;
+
+    ByteWriter bw(buffer.data(), 8);
+    bw.put_f64be(FromBits(bits));
+    ByteReader br(buffer.data(), 8);
+    auto val = br.get_f64be();
+    if (Bits(val) != bits)
+    {
+      CHECK_EQUAL(bits, Bits(val));
+      break;
+    }
+
+    if (ctr % 100 == 0)
+    {
+      vector<BYTE> encoded;
+      CHECK_EQUAL(bits, Bits(RoundTripNumber(FromBits(bits), encoded)));
+    }
+  }
+}
+
+TEST_CASE(AMF0Number_RandomFiniteValuesRoundTrip)
+{
+  std::mt19937_64 rng(20261017ULL);
+  std::uniform_real_distribution<double> dist(-1e12, 1e12);
+  for (unsigned int ctr = 0; ctr < 1000U; ctr++)
+  {
+    double val = dist(rng);
+    vector<BYTE> encoded;
+    auto parsed = RoundTripNumber(val, encoded);
+    if (parsed != val)
+    {
+      CHECK_EQUAL(val, parsed);
+      break;
+    }
+  }
+}
+
+TEST_CASE(AMF0Entity_EveryMarkerRoundTrips)
+{
+  struct Golden
+  {
+    BYTE Marker;
+    shared_ptr<AMF0Entity> Entity;
+    vector<BYTE> Expected;
+  };
+
+  auto elements = make_shared<std::vector<shared_ptr<AMF0Entity>>>();
+  elements->push_back(make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::Null));
+  elements->push_back(make_shared<AMF0Entity>(string("x")));
+
+  const Golden goldens[] = {
+    { AMF0TypeMarker::Number, make_shared<AMF0Entity>(2.0), { 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+    { AMF0TypeMarker::Boolean, make_shared<AMF0Entity>(true), { 0x01, 0x01 } },
+    { AMF0TypeMarker::String, make_shared<AMF0Entity>(string("ab")), { 0x02, 0x00, 0x02, 0x61, 0x62 } },
+    { AMF0TypeMarker::Object, make_shared<AMF0Entity>(Properties({ make_tuple(string("a"), make_shared<AMF0Entity>(1.0)) })),
+      { 0x03, 0x00, 0x01, 0x61, 0x00, 0x3F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09 } },
+    { AMF0TypeMarker::Null, make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::Null), { 0x05 } },
+    { AMF0TypeMarker::Undefined, make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::Undefined), { 0x06 } },
+    { AMF0TypeMarker::Reference, AMF0Entity::CreateReference(3), { 0x07, 0x00, 0x03 } },
+    { AMF0TypeMarker::EcmaArray, make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::EcmaArray, Properties({ make_tuple(string("k"), make_shared<AMF0Entity>(true)) })),
+      { 0x08, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x6B, 0x01, 0x01, 0x00, 0x00, 0x09 } },
+    { AMF0TypeMarker::StrictArray, make_shared<AMF0Entity>(elements), { 0x0A, 0x00, 0x00, 0x00, 0x02, 0x05, 0x02, 0x00, 0x01, 0x78 } },
+    { AMF0TypeMarker::Date, AMF0Entity::CreateDate(1.0), { 0x0B, 0x3F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+    { AMF0TypeMarker::Unsupported, make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::Unsupported), { 0x0D } },
+    { AMF0TypeMarker::XmlDocument, AMF0Entity::CreateXmlDocument("<a/>"), { 0x0F, 0x00, 0x00, 0x00, 0x04, 0x3C, 0x61, 0x2F, 0x3E } },
+    { AMF0TypeMarker::TypedObject, AMF0Entity::CreateTypedObject("C", Properties({ make_tuple(string("n"), make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::Null)) })),
+      { 0x10, 0x00, 0x01, 0x43, 0x00, 0x01, 0x6E, 0x05, 0x00, 0x00, 0x09 } },
+    { AMF0TypeMarker::AvmPlus, make_shared<AMF0Entity>(make_shared<AMF3Entity>(5)), { 0x11, 0x04, 0x05 } }
+  };
+
+  for (auto& golden : goldens)
+  {
+    auto bs = EncodeEntity(golden.Entity);
+    CHECK(*bs == golden.Expected);
+
+    //parsed back, the entity must encode to the same bytes
+    auto entities = AMF0Entity::TryParse(bs);
+    REQUIRE(entities.size() == 1U);
+    CHECK_EQUAL(golden.Marker, entities[0]->GetType());
+    CHECK(*EncodeEntity(entities[0]) == golden.Expected);
+
+    AMF0Document document;
+    REQUIRE(document.Parse(bs->data(), (unsigned int) bs->size()));
+    REQUIRE(document.GetRootCount() == 1U);
+    CHECK_EQUAL(golden.Marker, document.GetFirstRoot().GetType());
+  }
+}
+
+TEST_CASE(AMF0Entity_LongStringRoundTrips)
+{
+  //one byte past what a string's 16 bit length can hold
+  string str(65536, 'z');
+  auto bs = EncodeEntity(make_shared<AMF0Entity>(str));
+  const vector<BYTE> prefix = { 0x0C, 0x00, 0x01, 0x00, 0x00 };
+  REQUIRE(bs->size() == prefix.size() + str.size());
+  CHECK(std::equal(prefix.begin(), prefix.end(), bs->begin()));
+
+  auto entities = AMF0Entity::TryParse(bs);
+  REQUIRE(entities.size() == 1U);
+  CHECK_EQUAL((BYTE) AMF0TypeMarker::LongString, entities[0]->GetType());
+  CHECK(entities[0]->GetStringValue() == str);
+  CHECK(*EncodeEntity(entities[0]) == *bs);
+
+  //65535 bytes still fit a string
+  auto shortbs = EncodeEntity(make_shared<AMF0Entity>(string(65535, 'z')));
+  CHECK_EQUAL((BYTE) AMF0TypeMarker::String, (*shortbs)[0]);
+}
+
+TEST_CASE(AMF0Entity_ReservedMarkersAreRejected)
+{
+  CHECK(Throws({ AMF0TypeMarker::MovieClip }));
+  CHECK(Throws({ AMF0TypeMarker::Recordset }));
+  CHECK(Throws({ AMF0TypeMarker::ObjectEnd }));
+  CHECK(Throws({ 0x12 }));
+  CHECK(Throws({ 0xFF }));
+  //truncated values
+  CHECK(Throws({ AMF0TypeMarker::Number, 0x3F, 0xF0 }));
+  CHECK(Throws({ AMF0TypeMarker::String, 0x00, 0x05, 0x61 }));
+  CHECK(Throws({ AMF0TypeMarker::Object, 0x00, 0x01, 0x61, 0x05 }));
+}
+
+TEST_CASE(AMF0EncodedCommandOrData_GetObjectPropertyValueFindsStatusInfo)
+{
+  auto payload = StatusPayload();
+  Command_Status status(AMF0Entity::TryParse(payload), (unsigned int) payload->size(), 1U);
+
+  auto level = status.GetObjectPropertyValue("level");
+  REQUIRE(level != nullptr);
+  CHECK(level->GetStringValue() == "status");
+  //duplicate names resolve to the first
+  auto code = status.GetObjectPropertyValue("code");
+  REQUIRE(code != nullptr);
+  CHECK(code->GetStringValue() == "NetStream.Publish.Start");
+  CHECK(status.GetObjectPropertyValue("clientid") == nullptr);
+  CHECK(status.GetObjectPropertyValue("") == nullptr);
+}
+
+TEST_CASE(AMF0Entity_PropertyLookupSeesChangesMadeThroughThePropertyMap)
+{
+  auto obj = make_shared<AMF0Entity>(Properties({ make_tuple(string("a"), String("1")), make_tuple(string("b"), String("2")) }));
+  REQUIRE(obj->GetPropertyValue("a") != nullptr);
+
+  //same number of properties - the index must still be rebuilt
+  std::get<0>(obj->GetPropertyMap()->at(0)) = "c";
+  CHECK(obj->GetPropertyValue("a") == nullptr);
+  auto c = obj->GetPropertyValue("c");
+  REQUIRE(c != nullptr);
+  CHECK(c->GetStringValue() == "1");
+
+  obj->GetPropertyMap()->push_back(make_tuple(string("d"), String("4")));
+  auto d = obj->GetPropertyValue("d");
+  REQUIRE(d != nullptr);
+  CHECK(d->GetStringValue() == "4");
+}
+
+TEST_CASE(AMF0Document_FindPropertyFindsStatusInfo)
+{
+  auto payload = StatusPayload();
+  AMF0Document doc;
+  REQUIRE(doc.Parse(payload->data(), (unsigned int) payload->size()));
+  REQUIRE(doc.GetRootCount() == 4U);
+
+  auto info = doc.GetRoot(3);
+  CHECK(info["level"].GetStringValue() == "status");
+  CHECK(info["code"].GetStringValue() == "NetStream.Publish.Start");
+  CHECK(info["description"].GetStringValue() == "Publishing");
+  CHECK(!info["clientid"].IsValid());
+  CHECK(!info[""].IsValid());
+
+  //a reparsed document does not look names up in the previous payload's index
+  auto other = make_shared<vector<BYTE>>();
+  AMF0Entity::EncodeObject(Properties({ make_tuple(string("code"), String("NetStream.Unpublish.Success")) }), other);
+  REQUIRE(doc.Parse(other->data(), (unsigned int) other->size()));
+  CHECK(doc.GetFirstRoot()["code"].GetStringValue() == "NetStream.Unpublish.Success");
+  CHECK(!doc.GetFirstRoot()["level"].IsValid());
+}
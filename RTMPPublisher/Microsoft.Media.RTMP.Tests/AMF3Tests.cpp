@@ -0,0 +1,303 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "TestHarness.h"
+#include "AMF3.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  typedef std::vector<shared_ptr<AMF3Entity>> Elements;
+
+  vector<BYTE> Encode(shared_ptr<AMF3Entity> entity)
+  {
+    auto bs = make_shared<vector<BYTE>>();
+    AMF3Writer(bs).Write(entity);
+    return *bs;
+  }
+
+  shared_ptr<AMF3Entity> Decode(const vector<BYTE>& bytes)
+  {
+    AMF3Reader reader(bytes.data(), (unsigned int) bytes.size());
+    auto retval = reader.Read();
+    if (reader.HasMore())
+      throw std::logic_error("Bytes left over after the value");
+    return retval;
+  }
+
+  bool Throws(const vector<BYTE>& bytes)
+  {
+    try
+    {
+      Decode(bytes);
+    }
+    catch (const std::logic_error&)
+    {
+      return true;
+    }
+    return false;
+  }
+
+  shared_ptr<AMF3Entity> Integer(int val)
+  {
+    return make_shared<AMF3Entity>(val);
+  }
+
+  //encodes, checks the bytes, decodes and checks the value encodes to the same bytes again
+  bool RoundTrips(shared_ptr<AMF3Entity> entity, const vector<BYTE>& expected)
+  {
+    auto bytes = Encode(entity);
+    if (bytes != expected)
+      return false;
+    auto decoded = Decode(bytes);
+    return decoded->GetType() == entity->GetType() && Encode(decoded) == expected;
+  }
+
+  //Skip validates AMF3 inside AMF0 - it has to accept exactly what Read accepts and stop at the same place
+  bool SkipMatchesRead(const vector<BYTE>& bytes)
+  {
+    AMF3Reader skipper(bytes.data(), (unsigned int) bytes.size());
+    bool skipped = skipper.Skip();
+    AMF3Reader reader(bytes.data(), (unsigned int) bytes.size());
+    bool read = reader.TryRead() != nullptr;
+    return skipped == read && (!read || skipper.GetPosition() == reader.GetPosition());
+  }
+}
+
+TEST_CASE(AMF3U29_EncodesAtTheLengthBoundaries)
+{
+  struct Golden
+  {
+    unsigned int Value;
+    vector<BYTE> Expected;
+  };
+  const Golden goldens[] = {
+    { 0x00U, { 0x00 } },
+    { 0x7FU, { 0x7F } },
+    { 0x80U, { 0x81, 0x00 } },
+    { 0x3FFFU, { 0xFF, 0x7F } },
+    { 0x4000U, { 0x81, 0x80, 0x00 } },
+    { 0x1FFFFFU, { 0xFF, 0xFF, 0x7F } },
+    { 0x200000U, { 0x80, 0xC0, 0x80, 0x00 } },
+    { 0x0FFFFFFFU, { 0xBF, 0xFF, 0xFF, 0xFF } },
+    { 0x1FFFFFFFU, { 0xFF, 0xFF, 0xFF, 0xFF } }
+  };
+
+  for (auto& golden : goldens)
+  {
+    vector<BYTE> bytes;
+    AMF3Writer::EncodeU29(golden.Value, bytes);
+    CHECK(bytes == golden.Expected);
+
+    ByteReader br(bytes.data(), (unsigned int) bytes.size());
+    CHECK_EQUAL(golden.Value, AMF3Reader::DecodeU29(br));
+    CHECK(!br.IsTruncated());
+    CHECK_EQUAL(0U, br.GetRemaining());
+  }
+}
+
+TEST_CASE(AMF3U29_TruncatedIsDetected)
+{
+  const BYTE bytes[] = { 0x81, 0x80, 0x80 };
+  for (unsigned int len = 0; len <= 3; len++)
+  {
+    ByteReader br(bytes, len);
+    AMF3Reader::DecodeU29(br);
+    CHECK(br.IsTruncated());
+  }
+}
+
+TEST_CASE(AMF3Integer_SignExtendsFrom29Bits)
+{
+  struct Golden
+  {
+    int Value;
+    vector<BYTE> Expected;
+  };
+  const Golden goldens[] = {
+    { 0, { 0x04, 0x00 } },
+    { 127, { 0x04, 0x7F } },
+    { 128, { 0x04, 0x81, 0x00 } },
+    { 16383, { 0x04, 0xFF, 0x7F } },
+    { 16384, { 0x04, 0x81, 0x80, 0x00 } },
+    { 2097151, { 0x04, 0xFF, 0xFF, 0x7F } },
+    { 2097152, { 0x04, 0x80, 0xC0, 0x80, 0x00 } },
+    { AMF3Entity::MAXINTEGER, { 0x04, 0xBF, 0xFF, 0xFF, 0xFF } },
+    { -1, { 0x04, 0xFF, 0xFF, 0xFF, 0xFF } },
+    { -128, { 0x04, 0xFF, 0xFF, 0xFF, 0x80 } },
+    { AMF3Entity::MININTEGER, { 0x04, 0xC0, 0x80, 0x80, 0x00 } }
+  };
+
+  for (auto& golden : goldens)
+  {
+    CHECK(RoundTrips(Integer(golden.Value), golden.Expected));
+    CHECK_EQUAL(golden.Value, Decode(golden.Expected)->GetIntegerValue());
+  }
+}
+
+TEST_CASE(AMF3Integer_OutOfRangeIsSentAsDouble)
+{
+  auto above = Integer(AMF3Entity::MAXINTEGER + 1);
+  CHECK_EQUAL((BYTE) AMF3TypeMarker::Double, above->GetType());
+  CHECK(RoundTrips(above, { 0x05, 0x41, 0xB0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }));
+  CHECK_EQUAL((double) (AMF3Entity::MAXINTEGER + 1), Decode(Encode(above))->GetNumberValue());
+
+  auto below = Integer(AMF3Entity::MININTEGER - 1);
+  CHECK_EQUAL((BYTE) AMF3TypeMarker::Double, below->GetType());
+  CHECK_EQUAL((double) (AMF3Entity::MININTEGER - 1), Decode(Encode(below))->GetNumberValue());
+}
+
+TEST_CASE(AMF3Entity_EveryTypeRoundTrips)
+{
+  CHECK(RoundTrips(make_shared<AMF3Entity>((BYTE) AMF3TypeMarker::Undefined), { 0x00 }));
+  CHECK(RoundTrips(make_shared<AMF3Entity>((BYTE) AMF3TypeMarker::Null), { 0x01 }));
+  CHECK(RoundTrips(make_shared<AMF3Entity>(false), { 0x02 }));
+  CHECK(RoundTrips(make_shared<AMF3Entity>(true), { 0x03 }));
+  CHECK(RoundTrips(make_shared<AMF3Entity>(1.5), { 0x05, 0x3F, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }));
+  CHECK(RoundTrips(make_shared<AMF3Entity>(string("hi")), { 0x06, 0x05, 0x68, 0x69 }));
+  CHECK(RoundTrips(make_shared<AMF3Entity>(string()), { 0x06, 0x01 }));
+  CHECK(RoundTrips(AMF3Entity::CreateXml(AMF3TypeMarker::XmlDocument, "<a/>"), { 0x07, 0x09, 0x3C, 0x61, 0x2F, 0x3E }));
+  CHECK(RoundTrips(AMF3Entity::CreateDate(1.0), { 0x08, 0x01, 0x3F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }));
+  CHECK(RoundTrips(AMF3Entity::CreateXml(AMF3TypeMarker::Xml, "<b/>"), { 0x0B, 0x09, 0x3C, 0x62, 0x2F, 0x3E }));
+  CHECK(RoundTrips(AMF3Entity::CreateByteArray({ 0x01, 0x02 }), { 0x0C, 0x05, 0x01, 0x02 }));
+
+  //dense [1] and associative { k: null }
+  auto assoc = make_shared<AMF3Entity::PropertyList>();
+  assoc->push_back(make_tuple(string("k"), make_shared<AMF3Entity>((BYTE) AMF3TypeMarker::Null)));
+  auto arr = AMF3Entity::CreateArray(make_shared<Elements>(Elements({ Integer(1) })), assoc);
+  CHECK(RoundTrips(arr, { 0x09, 0x03, 0x03, 0x6B, 0x01, 0x01, 0x04, 0x01 }));
+
+  //anonymous dynamic object { a: 1 }
+  auto props = make_shared<AMF3Entity::PropertyList>();
+  props->push_back(make_tuple(string("a"), Integer(1)));
+  CHECK(RoundTrips(AMF3Entity::CreateObject("", props), { 0x0A, 0x0B, 0x01, 0x03, 0x61, 0x04, 0x01, 0x01 }));
+}
+
+TEST_CASE(AMF3Entity_ReferencesRoundTrip)
+{
+  //the second "ab" is a string reference, the second P reuses its traits and the repeated byte array is an object reference
+  auto sealed = make_shared<AMF3Entity::PropertyList>();
+  sealed->push_back(make_tuple(string("x"), Integer(1)));
+  auto first = AMF3Entity::CreateObject("P", sealed, 1U, false);
+  auto sealed2 = make_shared<AMF3Entity::PropertyList>();
+  sealed2->push_back(make_tuple(string("x"), Integer(2)));
+  auto second = AMF3Entity::CreateObject("P", sealed2, 1U, false);
+  auto bytes = AMF3Entity::CreateByteArray({ 0x07 });
+
+  auto arr = AMF3Entity::CreateArray(make_shared<Elements>(Elements({
+    make_shared<AMF3Entity>(string("ab")), make_shared<AMF3Entity>(string("ab")), first, second, bytes, bytes })));
+
+  const vector<BYTE> expected = {
+    0x09, 0x0D, 0x01,
+    0x06, 0x05, 0x61, 0x62,
+    0x06, 0x00,
+    0x0A, 0x13, 0x03, 0x50, 0x03, 0x78, 0x04, 0x01,
+    0x0A, 0x01, 0x04, 0x02,
+    0x0C, 0x03, 0x07,
+    0x0C, 0x06
+  };
+  CHECK(Encode(arr) == expected);
+
+  auto decoded = Decode(expected);
+  auto elements = decoded->GetElements();
+  REQUIRE(elements->size() == 6U);
+  CHECK(elements->at(1)->GetStringValue() == "ab");
+  CHECK(elements->at(3)->GetClassName() == "P");
+  CHECK_EQUAL(1U, elements->at(3)->GetSealedMemberCount());
+  CHECK_EQUAL(2, std::get<1>(elements->at(3)->GetProperties()->at(0))->GetIntegerValue());
+  CHECK(elements->at(4) == elements->at(5));
+  CHECK(Encode(decoded) == expected);
+}
+
+TEST_CASE(AMF3Reader_RejectsMalformedInput)
+{
+  //references to entries that were never read
+  CHECK(Throws({ 0x06, 0x00 }));
+  CHECK(Throws({ 0x0C, 0x00 }));
+  CHECK(Throws({ 0x0A, 0x01 }));
+  //truncated values
+  CHECK(Throws({ 0x04, 0x81 }));
+  CHECK(Throws({ 0x05, 0x3F, 0xF0 }));
+  CHECK(Throws({ 0x06, 0x05, 0x61 }));
+  //vectors, dictionaries and externalizable objects are not supported
+  CHECK(Throws({ 0x0D, 0x01, 0x00 }));
+  CHECK(Throws({ 0x0A, 0x07, 0x01 }));
+}
+
+TEST_CASE(AMF3Reader_SkipRejectsWhatReadRejects)
+{
+  const vector<vector<BYTE>> inputs = {
+    //string, object and traits references to entries that were never read
+    { 0x06, 0x00 }, { 0x06, 0x0A }, { 0x0C, 0x00 }, { 0x0A, 0x01 },
+    //empty strings do not enter the string table
+    { 0x09, 0x05, 0x01, 0x06, 0x01, 0x06, 0x00 },
+    //an array referencing itself from inside
+    { 0x09, 0x03, 0x01, 0x09, 0x00 },
+    //a second object referencing the traits of the first
+    { 0x09, 0x05, 0x01, 0x0A, 0x13, 0x03, 0x50, 0x03, 0x78, 0x04, 0x01, 0x0A, 0x01, 0x04, 0x02 },
+    //unsupported markers, inline and as references
+    { 0x0D, 0x01, 0x00 }, { 0x11, 0x00 }, { 0x09, 0x03, 0x01, 0x0C, 0x01, 0x0D, 0x02 },
+    { 0x0A, 0x07, 0x01 }
+  };
+  for (auto& input : inputs)
+    CHECK(SkipMatchesRead(input));
+
+  //every truncation and every single byte change of a value that uses each kind of reference
+  const vector<BYTE> references = {
+    0x09, 0x0D, 0x01,
+    0x06, 0x05, 0x61, 0x62,
+    0x06, 0x00,
+    0x0A, 0x13, 0x03, 0x50, 0x03, 0x78, 0x04, 0x01,
+    0x0A, 0x01, 0x04, 0x02,
+    0x0C, 0x03, 0x07,
+    0x0C, 0x06
+  };
+  unsigned int mismatches = 0;
+  for (size_t len = 0; len <= references.size(); len++)
+  {
+    if (!SkipMatchesRead(vector<BYTE>(references.begin(), references.begin() + len)))
+      mismatches++;
+  }
+  for (size_t i = 0; i < references.size(); i++)
+  {
+    for (unsigned int b = 0; b < 256; b++)
+    {
+      auto mutated = references;
+      mutated[i] = (BYTE) b;
+      if (!SkipMatchesRead(mutated))
+        mismatches++;
+    }
+  }
+  CHECK_EQUAL(0U, mismatches);
+}
@@ -0,0 +1,127 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include "TestHarness.h"
+#include "ByteWriter.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+TEST_CASE(ByteWriter_WritesNetworkByteOrder)
+{
+  vector<BYTE> bytes;
+  ByteWriter bw(bytes, 1 + 2 + 3 + 4 + 4 + 8 + 8 + 3);
+  bw.put_u8(0x01);
+  bw.put_u16be(0x0203);
+  bw.put_u24be(0x040506);
+  bw.put_u32be(0x0708090A);
+  bw.put_u32le(0x0E0D0C0B);
+  bw.put_u64be(0x0F10111213141516ULL);
+  bw.put_f64be(1.0);
+  const BYTE tail[] = { 0xAA, 0xBB, 0xCC };
+  bw.put_bytes(tail, 3);
+
+  const vector<BYTE> expected = {
+    0x01,
+    0x02, 0x03,
+    0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0A,
+    0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x3F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xAA, 0xBB, 0xCC
+  };
+  CHECK(bytes == expected);
+  CHECK_EQUAL((unsigned int) expected.size(), bw.GetPosition());
+  CHECK_EQUAL(0U, bw.GetRemaining());
+}
+
+TEST_CASE(ByteWriter_AppendsAfterExistingBytes)
+{
+  vector<BYTE> bytes = { 0x10, 0x20 };
+  ByteWriter bw(bytes, 2);
+  bw.put_u16be(0x3040);
+  const vector<BYTE> expected = { 0x10, 0x20, 0x30, 0x40 };
+  CHECK(bytes == expected);
+  CHECK_EQUAL(2U, bw.GetPosition());
+}
+
+TEST_CASE(ByteWriter_BufferOverflowThrows)
+{
+  BYTE buffer[8];
+  std::fill(std::begin(buffer), std::end(buffer), (BYTE) 0xEE);
+  ByteWriter bw(buffer, 3);
+  bw.put_u16be(0x0102);
+
+  //none of these fit in the one byte left - each must throw without touching the buffer
+  bool threw[4] = { false, false, false, false };
+  try { bw.put_u16be(0x0304); } catch (const std::out_of_range&) { threw[0] = true; }
+  try { bw.put_u24be(0x030405); } catch (const std::out_of_range&) { threw[1] = true; }
+  try { bw.put_u64be(0ULL); } catch (const std::out_of_range&) { threw[2] = true; }
+  const BYTE two[] = { 0x03, 0x04 };
+  try { bw.put_bytes(two, 2); } catch (const std::out_of_range&) { threw[3] = true; }
+  CHECK(threw[0] && threw[1] && threw[2] && threw[3]);
+  CHECK_EQUAL((BYTE) 0xEE, buffer[2]);
+  CHECK_EQUAL(2U, bw.GetPosition());
+
+  //the last byte still fits, the one after it does not
+  bw.put_u8(0x03);
+  CHECK_EQUAL((BYTE) 0x03, buffer[2]);
+  bool threwAtEnd = false;
+  try { bw.put_u8(0x04); } catch (const std::out_of_range&) { threwAtEnd = true; }
+  CHECK(threwAtEnd);
+  CHECK_EQUAL((BYTE) 0xEE, buffer[3]);
+}
+
+TEST_CASE(ByteWriter_ByteArrayGrowsPastItsSize)
+{
+  vector<BYTE> bytes = { 0x55 };
+  ByteWriter bw(bytes, 1);
+  bw.put_u8(0x01);
+  //past the size the writer was given - the array grows instead of being overrun
+  bw.put_u32be(0x02030405);
+  vector<BYTE> payload(1000);
+  for (unsigned int ctr = 0; ctr < payload.size(); ctr++)
+    payload[ctr] = (BYTE) ctr;
+  bw.put_bytes(payload.data(), (unsigned int) payload.size());
+
+  REQUIRE(bytes.size() == 1U + 1U + 4U + payload.size());
+  const vector<BYTE> head = { 0x55, 0x01, 0x02, 0x03, 0x04, 0x05 };
+  CHECK(std::equal(head.begin(), head.end(), bytes.begin()));
+  CHECK(std::equal(payload.begin(), payload.end(), bytes.begin() + head.size()));
+  CHECK_EQUAL((unsigned int) (bytes.size() - 1U), bw.GetPosition());
+  CHECK_EQUAL(0U, bw.GetRemaining());
+}
+
+TEST_CASE(ByteWriter_EmptyWritesNeedNoRoom)
+{
+  ByteWriter bw(nullptr, 0);
+  bw.put_bytes(nullptr, 0);
+  CHECK_EQUAL(0U, bw.GetPosition());
+}
@@ -0,0 +1,219 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include "PlatformTypes.h"
+#include <memory>
+#include <vector>
+#include "TestHarness.h"
+#include "ChunkInterleaver.h"
+#include "SendRingBuffer.h"
+#include "RTMPChunking.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  const unsigned int AudioChunkStreamID = 4U;
+  const unsigned int VideoChunkStreamID = 6U;
+
+  shared_ptr<RTMPMessage> MakeMessage(BYTE messageTypeID, unsigned int len, unsigned int timestamp)
+  {
+    auto payload = make_shared<vector<BYTE>>(len);
+    for (unsigned int ctr = 0; ctr < len; ctr++)
+      (*payload)[ctr] = (BYTE) (ctr * 7 + timestamp + messageTypeID);
+    return make_shared<RTMPMessage>(timestamp, messageTypeID, 1U, payload);
+  }
+
+  ///<summary>Dequeues one chunk at a time until the interleaver is empty or maxChunks have gone out</summary>
+  ///<returns>Chunk stream ID of each chunk in wire order - the bytes are appended to wire</returns>
+  vector<unsigned int> DrainChunks(ChunkInterleaver& interleaver, vector<BYTE>& wire, unsigned int maxChunks = 0xFFFFFFFF)
+  {
+    SendRingBuffer sendBuffer(65536);
+    vector<unsigned int> retval;
+    while (retval.size() < maxChunks && interleaver.Dequeue(sendBuffer, 1))
+    {
+      BYTE* data = nullptr;
+      unsigned int len = 0;
+      REQUIRE(sendBuffer.GetReadRegion(data, len));
+      //single byte basic headers - chunk stream IDs below 64
+      retval.push_back(data[0] & 0x3F);
+      wire.insert(wire.end(), data, data + len);
+      sendBuffer.Consume(len);
+    }
+    return retval;
+  }
+
+  vector<shared_ptr<RTMPMessage>> DecodeMedia(const vector<BYTE>& wire, unsigned int chunkSize = 128U)
+  {
+    ChunkDecoder decoder(chunkSize);
+    vector<shared_ptr<RTMPMessage>> retval;
+    for (auto& msg : decoder.Decode(wire.data(), (unsigned int) wire.size()))
+    {
+      if (msg->GetMessageTypeID() == RTMPMessageType::AUDIO || msg->GetMessageTypeID() == RTMPMessageType::VIDEO)
+        retval.push_back(msg);
+    }
+    return retval;
+  }
+
+  bool SameMessage(shared_ptr<RTMPMessage> expected, shared_ptr<RTMPMessage> actual)
+  {
+    return expected->GetMessageTypeID() == actual->GetMessageTypeID() &&
+      expected->GetTimestamp() == actual->GetTimestamp() &&
+      *(expected->GetPayload()) == *(actual->GetPayload());
+  }
+
+  unsigned int Count(const vector<unsigned int>& chunks, unsigned int chunkStreamID)
+  {
+    unsigned int retval = 0;
+    for (auto csid : chunks)
+    {
+      if (csid == chunkStreamID)
+        retval++;
+    }
+    return retval;
+  }
+}
+
+TEST_CASE(ChunkInterleaver_AudioPreemptsALongVideoMessage)
+{
+  ChunkInterleaver interleaver(128U);
+  interleaver.SetChunkStreamPriority(AudioChunkStreamID, 1U);
+  interleaver.SetChunkStreamPriority(VideoChunkStreamID, 2U);
+
+  auto video = MakeMessage(RTMPMessageType::VIDEO, 10U * 128U, 0U);
+  interleaver.Enqueue(VideoChunkStreamID, video);
+  vector<BYTE> wire;
+  auto chunks = DrainChunks(interleaver, wire, 3U);
+  CHECK(interleaver.IsMessageInProgress());
+
+  //audio arriving part way through the video message goes out at the next chunk boundary
+  auto audio = MakeMessage(RTMPMessageType::AUDIO, 100U, 21U);
+  interleaver.Enqueue(AudioChunkStreamID, audio);
+  auto rest = DrainChunks(interleaver, wire);
+  chunks.insert(chunks.end(), rest.begin(), rest.end());
+
+  const vector<unsigned int> expected = { 6, 6, 6, 4, 6, 6, 6, 6, 6, 6, 6 };
+  CHECK(chunks == expected);
+  CHECK(interleaver.IsEmpty());
+
+  auto messages = DecodeMedia(wire);
+  REQUIRE(messages.size() == 2U);
+  CHECK(SameMessage(audio, messages[0]));
+  CHECK(SameMessage(video, messages[1]));
+}
+
+TEST_CASE(ChunkInterleaver_SamePriorityIsWeightedRoundRobin)
+{
+  ChunkInterleaver interleaver(128U);
+  interleaver.SetChunkStreamPriority(AudioChunkStreamID, 1U, 1U);
+  interleaver.SetChunkStreamPriority(VideoChunkStreamID, 1U, 3U);
+
+  auto audio = MakeMessage(RTMPMessageType::AUDIO, 6U * 128U, 0U);
+  auto video = MakeMessage(RTMPMessageType::VIDEO, 10U * 128U, 0U);
+  interleaver.Enqueue(AudioChunkStreamID, audio);
+  interleaver.Enqueue(VideoChunkStreamID, video);
+
+  vector<BYTE> wire;
+  auto chunks = DrainChunks(interleaver, wire);
+
+  //one audio chunk per three video chunks until video runs out, then audio alone
+  const vector<unsigned int> expected = { 4, 6, 6, 6, 4, 6, 6, 6, 4, 6, 6, 6, 4, 6, 4, 4 };
+  CHECK(chunks == expected);
+  CHECK_EQUAL(6U, Count(chunks, AudioChunkStreamID));
+  CHECK_EQUAL(10U, Count(chunks, VideoChunkStreamID));
+
+  auto messages = DecodeMedia(wire);
+  REQUIRE(messages.size() == 2U);
+  CHECK(SameMessage(video, messages[0]));
+  CHECK(SameMessage(audio, messages[1]));
+}
+
+TEST_CASE(ChunkInterleaver_WholeMessagesInOrderWhenInterleavingIsOff)
+{
+  ChunkInterleaver interleaver(128U, false);
+  //priorities do not matter with interleaving off
+  interleaver.SetChunkStreamPriority(AudioChunkStreamID, 1U);
+  interleaver.SetChunkStreamPriority(VideoChunkStreamID, 2U);
+
+  auto first = MakeMessage(RTMPMessageType::VIDEO, 3U * 128U, 0U);
+  auto audio = MakeMessage(RTMPMessageType::AUDIO, 2U * 128U, 10U);
+  auto second = MakeMessage(RTMPMessageType::VIDEO, 2U * 128U, 33U);
+  interleaver.Enqueue(VideoChunkStreamID, first);
+  vector<BYTE> wire;
+  auto chunks = DrainChunks(interleaver, wire, 1U);
+  interleaver.Enqueue(AudioChunkStreamID, audio);
+  interleaver.Enqueue(VideoChunkStreamID, second);
+  auto rest = DrainChunks(interleaver, wire);
+  chunks.insert(chunks.end(), rest.begin(), rest.end());
+
+  const vector<unsigned int> expected = { 6, 6, 6, 4, 4, 6, 6 };
+  CHECK(chunks == expected);
+
+  auto messages = DecodeMedia(wire);
+  REQUIRE(messages.size() == 3U);
+  CHECK(SameMessage(first, messages[0]));
+  CHECK(SameMessage(audio, messages[1]));
+  CHECK(SameMessage(second, messages[2]));
+}
+
+TEST_CASE(ChunkInterleaver_ChunkSizeChangeWaitsForMessagesInFlight)
+{
+  ChunkInterleaver interleaver(128U);
+  interleaver.SetChunkStreamPriority(AudioChunkStreamID, 1U);
+  interleaver.SetChunkStreamPriority(VideoChunkStreamID, 2U);
+
+  auto video = MakeMessage(RTMPMessageType::VIDEO, 1000U, 0U);
+  interleaver.Enqueue(VideoChunkStreamID, video);
+  vector<BYTE> wire;
+  auto chunks = DrainChunks(interleaver, wire, 2U);
+
+  interleaver.RequestChunkSize(4096U);
+  CHECK(interleaver.IsChunkSizeChangePending());
+  //higher priority audio still waits - it would start at the new size
+  auto audio = MakeMessage(RTMPMessageType::AUDIO, 300U, 21U);
+  interleaver.Enqueue(AudioChunkStreamID, audio);
+  auto rest = DrainChunks(interleaver, wire);
+  chunks.insert(chunks.end(), rest.begin(), rest.end());
+
+  //the video message finishes at 128, Set Chunk Size goes out on the control chunk stream, audio fits one 4096 chunk
+  const vector<unsigned int> expected = { 6, 6, 6, 6, 6, 6, 6, 6, 2, 4 };
+  CHECK(chunks == expected);
+  CHECK_EQUAL(4096U, interleaver.GetChunkSize());
+  CHECK(!interleaver.IsChunkSizeChangePending());
+
+  ChunkDecoder decoder(128U);
+  vector<shared_ptr<RTMPMessage>> messages;
+  for (auto& msg : decoder.Decode(wire.data(), (unsigned int) wire.size()))
+  {
+    if (msg->GetMessageTypeID() == RTMPMessageType::AUDIO || msg->GetMessageTypeID() == RTMPMessageType::VIDEO)
+      messages.push_back(msg);
+  }
+  CHECK_EQUAL(4096U, decoder.GetChunkSize());
+  REQUIRE(messages.size() == 2U);
+  CHECK(SameMessage(video, messages[0]));
+  CHECK(SameMessage(audio, messages[1]));
+}
@@ -0,0 +1,146 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include "PlatformTypes.h"
+#include <vector>
+#include "TestHarness.h"
+#include "ChunkSizeController.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  const unsigned int PathMSS = 1460U;
+
+  ///<summary>Chunk size that, with its 1 byte continuation header, fills the given number of segments</summary>
+  unsigned int Segments(unsigned int count, unsigned int mss = PathMSS)
+  {
+    return count * mss - 1;
+  }
+
+  ///<summary>Observes one evaluation window - the listed video sizes first, the rest of the window audio messages of audioSize</summary>
+  unsigned int EvaluateWindow(ChunkSizeController& controller, unsigned int audioSize, const vector<unsigned int>& videoSizes)
+  {
+    for (auto size : videoSizes)
+      controller.Observe(RTMPMessageType::VIDEO, size);
+    for (size_t ctr = videoSizes.size(); ctr < ChunkSizeController::EVALUATIONWINDOW; ctr++)
+      controller.Observe(RTMPMessageType::AUDIO, audioSize);
+    return controller.Evaluate();
+  }
+
+  vector<unsigned int> VideoSizes(unsigned int count, unsigned int size)
+  {
+    return vector<unsigned int>(count, size);
+  }
+}
+
+TEST_CASE(ChunkSizeController_WaitsForAFullWindow)
+{
+  ChunkSizeController controller(128U, 65536U, PathMSS);
+  for (unsigned int ctr = 0; ctr < ChunkSizeController::EVALUATIONWINDOW - 1; ctr++)
+    controller.Observe(RTMPMessageType::AUDIO, 400U);
+  CHECK_EQUAL(0U, controller.Evaluate());
+  controller.Observe(RTMPMessageType::AUDIO, 400U);
+  CHECK_EQUAL(Segments(1), controller.Evaluate());
+
+  //the window starts over after every evaluation
+  CHECK_EQUAL(0U, controller.Evaluate());
+}
+
+TEST_CASE(ChunkSizeController_AudioFitsOneChunk)
+{
+  ChunkSizeController controller(128U, 65536U, PathMSS);
+  CHECK_EQUAL(Segments(1), EvaluateWindow(controller, 400U, {}));
+  CHECK_EQUAL(Segments(1), controller.GetChunkSize());
+
+  //one byte more than a segment holds takes two
+  CHECK_EQUAL(Segments(2), EvaluateWindow(controller, Segments(1) + 1, {}));
+  CHECK_EQUAL(Segments(2), controller.GetChunkSize());
+}
+
+TEST_CASE(ChunkSizeController_TargetsTheVideoPercentile)
+{
+  //128 video messages - the 90th percentile is the 115th smallest
+  ChunkSizeController controller(Segments(1), 65536U, PathMSS);
+  auto sizes = VideoSizes(115, 4000U);
+  auto large = VideoSizes(13, 50000U);
+  sizes.insert(sizes.end(), large.begin(), large.end());
+  CHECK_EQUAL(Segments(3), EvaluateWindow(controller, 0U, sizes));
+
+  sizes = VideoSizes(114, 4000U);
+  large = VideoSizes(14, 50000U);
+  sizes.insert(sizes.end(), large.begin(), large.end());
+  CHECK_EQUAL(Segments(35), EvaluateWindow(controller, 0U, sizes));
+}
+
+TEST_CASE(ChunkSizeController_AlignsToThePathMSS)
+{
+  ChunkSizeController controller(128U, 65536U, 536U);
+  CHECK_EQUAL(Segments(2, 536U), EvaluateWindow(controller, 0U, VideoSizes(128, 1000U)));
+  CHECK_EQUAL(0U, (controller.GetChunkSize() + 1) % 536U);
+
+  //never below the protocol minimum, even for tiny messages on a tiny MSS
+  ChunkSizeController small(4096U, 65536U, 64U);
+  CHECK_EQUAL((unsigned int) ChunkSizeController::MINCHUNKSIZE, EvaluateWindow(small, 10U, VideoSizes(10, 10U)));
+}
+
+TEST_CASE(ChunkSizeController_CapsAtTheMaxChunkSize)
+{
+  //aligned down to whole segments below the cap
+  ChunkSizeController controller(Segments(1), 8192U, PathMSS);
+  CHECK_EQUAL(Segments(5), EvaluateWindow(controller, 0U, VideoSizes(128, 60000U)));
+
+  //audio that does not fit the cap is split rather than exceeding it
+  CHECK_EQUAL(0U, EvaluateWindow(controller, 10000U, {}));
+  CHECK_EQUAL(Segments(5), controller.GetChunkSize());
+
+  //a cap below one segment is used as is
+  ChunkSizeController belowMSS(128U, 1000U, PathMSS);
+  CHECK_EQUAL(1000U, EvaluateWindow(belowMSS, 0U, VideoSizes(128, 60000U)));
+}
+
+TEST_CASE(ChunkSizeController_IgnoresChangesBelowAQuarter)
+{
+  ChunkSizeController controller(Segments(6), 65536U, PathMSS);
+
+  //one segment less is 17% - not worth a change
+  CHECK_EQUAL(0U, EvaluateWindow(controller, 0U, VideoSizes(128, 7000U)));
+  CHECK_EQUAL(Segments(6), controller.GetChunkSize());
+
+  //two segments less is 33%
+  CHECK_EQUAL(Segments(4), EvaluateWindow(controller, 0U, VideoSizes(128, 5000U)));
+
+  //growing by one segment is 25% of the current size - just enough
+  CHECK_EQUAL(Segments(5), EvaluateWindow(controller, 0U, VideoSizes(128, Segments(5))));
+}
+
+TEST_CASE(ChunkSizeController_SplitAudioOverridesHysteresis)
+{
+  ChunkSizeController controller(Segments(6), 65536U, PathMSS);
+  //audio one byte larger than a chunk grows it by a single segment
+  CHECK_EQUAL(Segments(7), EvaluateWindow(controller, Segments(6) + 1, {}));
+}
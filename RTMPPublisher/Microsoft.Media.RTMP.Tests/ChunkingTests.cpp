@@ -0,0 +1,431 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <algorithm>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "TestHarness.h"
+#include "RTMPChunking.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  shared_ptr<vector<BYTE>> MakePayload(unsigned int len)
+  {
+    auto payload = make_shared<vector<BYTE>>(len);
+    for (unsigned int ctr = 0; ctr < len; ctr++)
+      (*payload)[ctr] = (BYTE) (ctr * 13 + 5);
+    return payload;
+  }
+
+  //one ChunkMessage per chunk, copied into the output - how messages were chunked before segments pointed into the payload
+  shared_ptr<vector<BYTE>> ChunkPerCopy(unsigned int chunkStreamID, unsigned int chunkSize, shared_ptr<RTMPMessage> msg)
+  {
+    auto retval = make_shared<vector<BYTE>>();
+    unsigned int messagelen = msg->GetMessageLength();
+    BYTE* payload = msg->GetPayload()->data();
+    for (unsigned int offset = 0; offset < messagelen; offset += chunkSize)
+    {
+      unsigned int len = min(messagelen - offset, chunkSize);
+      auto bs = offset == 0 ?
+        ChunkMessage(chunkStreamID, msg->GetTimestamp(), messagelen, msg->GetMessageTypeID(), msg->GetMessageStreamID(), payload, len).ToBitstream() :
+        ChunkMessage(RTMPChunkType::Type3, chunkStreamID, msg->GetTimestamp(), payload + offset, len).ToBitstream();
+      retval->insert(retval->end(), bs->begin(), bs->end());
+    }
+    return retval;
+  }
+
+  //Set Chunk Size with a raw 4 byte value, chunked on the control chunk stream
+  shared_ptr<vector<BYTE>> SetChunkSizeBitstream(unsigned int rawValue)
+  {
+    auto payload = make_shared<vector<BYTE>>(4);
+    ByteWriter(payload->data(), 4).put_u32be(rawValue);
+    return ChunkProcessor::ToChunkedBitstream(2, 128, make_shared<RTMPMessage>(0, (BYTE) RTMPMessageType::PROTOSETCHUNKSIZE, 0, payload));
+  }
+  //golden header fields - length 0x000304, type 0x09, stream 1, timestamp 0x0A0B0C or the extended 0x01020304
+  const unsigned int GoldenLength = 0x000304U;
+  const BYTE GoldenTypeID = 0x09;
+  const unsigned int GoldenStreamID = 1U;
+  const unsigned int GoldenTimestamp = 0x0A0B0CU;
+  const unsigned int GoldenExtendedTimestamp = 0x01020304U;
+
+  //chunk stream IDs 5, 106 and 4724 in their 1, 2 and 3 byte basic header forms, per chunk type
+  const unsigned int GoldenChunkStreamIDs[3] = { 5U, 106U, 4724U };
+  const vector<BYTE> GoldenBasicHeaders[4][3] = {
+    { { 0x05 }, { 0x00, 0x2A }, { 0x01, 0x34, 0x12 } },
+    { { 0x45 }, { 0x40, 0x2A }, { 0x41, 0x34, 0x12 } },
+    { { 0x85 }, { 0x80, 0x2A }, { 0x81, 0x34, 0x12 } },
+    { { 0xC5 }, { 0xC0, 0x2A }, { 0xC1, 0x34, 0x12 } }
+  };
+
+  //message header followed by the extended timestamp if any, per chunk type
+  const vector<BYTE> GoldenMessageHeaders[4][2] = {
+    {
+      { 0x0A, 0x0B, 0x0C, 0x00, 0x03, 0x04, 0x09, 0x01, 0x00, 0x00, 0x00 },
+      { 0xFF, 0xFF, 0xFF, 0x00, 0x03, 0x04, 0x09, 0x01, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04 }
+    },
+    {
+      { 0x0A, 0x0B, 0x0C, 0x00, 0x03, 0x04, 0x09 },
+      { 0xFF, 0xFF, 0xFF, 0x00, 0x03, 0x04, 0x09, 0x01, 0x02, 0x03, 0x04 }
+    },
+    {
+      { 0x0A, 0x0B, 0x0C },
+      { 0xFF, 0xFF, 0xFF, 0x01, 0x02, 0x03, 0x04 }
+    },
+    {
+      { },
+      { 0x01, 0x02, 0x03, 0x04 }
+    }
+  };
+
+  //writes one header into a buffer filled with a marker byte - the bytes past the header must be left alone
+  vector<BYTE> WriteHeader(BYTE chunkType, unsigned int chunkStreamID, unsigned int timestamp, unsigned int& written)
+  {
+    vector<BYTE> buffer(ChunkMessage::MAXHEADERSIZE + 4, 0xEE);
+    written = SelectChunkHeaderWriter(chunkType, chunkStreamID, timestamp)(buffer.data(), chunkStreamID, timestamp, GoldenLength, GoldenTypeID, GoldenStreamID);
+    return buffer;
+  }
+
+  struct HeaderCase
+  {
+    unsigned int Timestamp;
+    BYTE MessageTypeID;
+    unsigned int Length;
+    unsigned int MessageStreamID;
+    //expected type of the first chunk
+    BYTE ChunkType;
+  };
+
+  //sends the messages back to back on one chunk stream sharing a header state - checks the first chunk type of each
+  //and that the decoder gets every message back with its timestamp, type, stream and payload
+  void CheckChunkTypes(const vector<HeaderCase>& cases)
+  {
+    auto headerState = make_shared<ChunkStreamHeaderState>();
+    vector<shared_ptr<RTMPMessage>> sent;
+    vector<BYTE> wire;
+    for (auto& c : cases)
+    {
+      auto msg = make_shared<RTMPMessage>(c.Timestamp, c.MessageTypeID, c.MessageStreamID, MakePayload(c.Length));
+      sent.push_back(msg);
+      auto bitstream = ChunkProcessor::ToChunkSegments(4U, 4096U, msg, headerState)->ToBitstream();
+      CHECK_EQUAL((unsigned int) c.ChunkType, (unsigned int) ((*bitstream)[0] >> 6));
+      wire.insert(wire.end(), bitstream->begin(), bitstream->end());
+    }
+
+    ChunkDecoder decoder(4096U);
+    auto received = decoder.Decode(wire.data(), (unsigned int) wire.size());
+    REQUIRE(received.size() == sent.size());
+    for (size_t ctr = 0; ctr < sent.size(); ctr++)
+    {
+      CHECK_EQUAL(sent[ctr]->GetTimestamp(), received[ctr]->GetTimestamp());
+      CHECK_EQUAL((unsigned int) sent[ctr]->GetMessageTypeID(), (unsigned int) received[ctr]->GetMessageTypeID());
+      CHECK_EQUAL(sent[ctr]->GetMessageStreamID(), received[ctr]->GetMessageStreamID());
+      CHECK(*(sent[ctr]->GetPayload()) == *(received[ctr]->GetPayload()));
+    }
+  }
+
+  const BYTE Audio = RTMPMessageType::AUDIO;
+  const BYTE Video = RTMPMessageType::VIDEO;
+}
+
+TEST_CASE(ChunkDecoder_AppliesSetChunkSize)
+{
+  ChunkDecoder decoder;
+  auto control = SetChunkSizeBitstream(4096U);
+  decoder.Decode(control->data(), (unsigned int) control->size());
+  CHECK_EQUAL(4096U, decoder.GetChunkSize());
+
+  auto msg = make_shared<RTMPMessage>(40, (BYTE) RTMPMessageType::VIDEO, 1, MakePayload(3000));
+  auto bitstream = ChunkProcessor::ToChunkedBitstream(6, 4096, msg);
+  auto messages = decoder.Decode(bitstream->data(), (unsigned int) bitstream->size());
+  REQUIRE(messages.size() == 1);
+  CHECK(*(messages[0]->GetPayload()) == *(msg->GetPayload()));
+}
+
+TEST_CASE(ChunkDecoder_ZeroChunkSizeIsAProtocolError)
+{
+  ChunkDecoder decoder;
+  auto control = SetChunkSizeBitstream(0U);
+  bool threw = false;
+  try
+  {
+    decoder.Decode(control->data(), (unsigned int) control->size());
+  }
+  catch (const std::logic_error&)
+  {
+    threw = true;
+  }
+  CHECK(threw);
+  //the previous chunk size stays in force
+  CHECK_EQUAL(128U, decoder.GetChunkSize());
+}
+
+TEST_CASE(ChunkSegments_MatchPerChunkCopy)
+{
+  const unsigned int messageLengths[] = { 1U, 127U, 128U, 129U, 400U, 4096U, 10240U, 307200U };
+  const unsigned int chunkSizes[] = { 1U, 128U, 4096U, 65536U };
+  const unsigned int chunkStreamIDs[] = { 6U, 64U, 320U };
+  for (auto messageLength : messageLengths)
+  {
+    for (auto chunkSize : chunkSizes)
+    {
+      //one byte chunks of a large message only slow the test down
+      if (chunkSize == 1U && messageLength > 4096U)
+        continue;
+      for (auto chunkStreamID : chunkStreamIDs)
+      {
+        auto msg = make_shared<RTMPMessage>(0x1000000 + messageLength, (BYTE) RTMPMessageType::VIDEO, 1, MakePayload(messageLength));
+        auto expected = ChunkPerCopy(chunkStreamID, chunkSize, msg);
+        auto segments = ChunkProcessor::ToChunkSegments(chunkStreamID, chunkSize, msg);
+        CHECK_EQUAL((unsigned int) expected->size(), segments->GetSize());
+        CHECK(*(segments->ToBitstream()) == *expected);
+        CHECK(*(ChunkProcessor::ToChunkedBitstream(chunkStreamID, chunkSize, msg)) == *expected);
+      }
+    }
+  }
+}
+
+TEST_CASE(ChunkSegments_PointIntoThePayload)
+{
+  auto msg = make_shared<RTMPMessage>(1000, (BYTE) RTMPMessageType::VIDEO, 1, MakePayload(1000));
+  auto payload = msg->GetPayload();
+  auto segments = ChunkProcessor::ToChunkSegments(6, 128, msg);
+  REQUIRE(segments->GetSegments().size() == 8U);
+
+  unsigned int offset = 0;
+  for (auto& segment : segments->GetSegments())
+  {
+    //no copy - every slice is the payload memory itself
+    CHECK(segment.Payload == payload->data() + offset);
+    offset += segment.PayloadLength;
+  }
+  CHECK_EQUAL(1000U, offset);
+  CHECK_EQUAL(12U, segments->GetSegments()[0].HeaderLength);
+  CHECK_EQUAL(1U, segments->GetSegments()[1].HeaderLength);
+
+  //the list keeps the payload alive on its own
+  msg.reset();
+  CHECK(payload.use_count() > 1);
+}
+
+TEST_CASE(ChunkSegments_EmptyMessageIsOneHeader)
+{
+  auto msg = make_shared<RTMPMessage>(0, (BYTE) RTMPMessageType::DATAAMF0, 1, make_shared<vector<BYTE>>());
+  auto segments = ChunkProcessor::ToChunkSegments(4, 128, msg);
+  REQUIRE(segments->GetSegments().size() == 1U);
+  CHECK_EQUAL(12U, segments->GetSize());
+  CHECK_EQUAL(0U, segments->GetSegments()[0].PayloadLength);
+
+  ChunkDecoder decoder;
+  auto bitstream = segments->ToBitstream();
+  auto messages = decoder.Decode(bitstream->data(), (unsigned int) bitstream->size());
+  REQUIRE(messages.size() == 1U);
+  CHECK_EQUAL(0U, messages[0]->GetMessageLength());
+}
+
+TEST_CASE(ChunkSegments_RoundTripThroughDecoder)
+{
+  const unsigned int chunkSizes[] = { 128U, 4096U };
+  for (auto chunkSize : chunkSizes)
+  {
+    ChunkDecoder decoder(chunkSize);
+    std::vector<shared_ptr<RTMPMessage>> sent;
+    std::vector<BYTE> wire;
+    for (unsigned int ctr = 0; ctr < 20; ctr++)
+    {
+      bool video = ctr % 3 == 0;
+      auto msg = make_shared<RTMPMessage>(ctr * 40, video ? (BYTE) RTMPMessageType::VIDEO : (BYTE) RTMPMessageType::AUDIO, 1, MakePayload(video ? 9000 + ctr : 300 + ctr));
+      sent.push_back(msg);
+      auto bitstream = ChunkProcessor::ToChunkedBitstream(video ? 6 : 4, chunkSize, msg);
+      wire.insert(wire.end(), bitstream->begin(), bitstream->end());
+    }
+
+    //fed in odd sized reads, the way a socket hands them over
+    std::vector<shared_ptr<RTMPMessage>> received;
+    for (size_t offset = 0; offset < wire.size(); offset += 1000)
+    {
+      auto len = (unsigned int) min(wire.size() - offset, (size_t) 1000);
+      auto messages = decoder.Decode(wire.data() + offset, len);
+      received.insert(received.end(), messages.begin(), messages.end());
+    }
+
+    REQUIRE(received.size() == sent.size());
+    for (size_t ctr = 0; ctr < sent.size(); ctr++)
+    {
+      CHECK_EQUAL(sent[ctr]->GetTimestamp(), received[ctr]->GetTimestamp());
+      CHECK_EQUAL((unsigned int) sent[ctr]->GetMessageTypeID(), (unsigned int) received[ctr]->GetMessageTypeID());
+      CHECK(*(sent[ctr]->GetPayload()) == *(received[ctr]->GetPayload()));
+    }
+  }
+}
+
+TEST_CASE(ChunkHeaderWriter_MatchesGoldenBytes)
+{
+  for (BYTE chunkType = 0; chunkType < 4; chunkType++)
+  {
+    for (unsigned int form = 0; form < 3; form++)
+    {
+      for (unsigned int extended = 0; extended < 2; extended++)
+      {
+        vector<BYTE> expected(GoldenBasicHeaders[chunkType][form]);
+        expected.insert(expected.end(), GoldenMessageHeaders[chunkType][extended].begin(), GoldenMessageHeaders[chunkType][extended].end());
+
+        unsigned int written = 0;
+        auto buffer = WriteHeader(chunkType, GoldenChunkStreamIDs[form], extended ? GoldenExtendedTimestamp : GoldenTimestamp, written);
+        REQUIRE(written == expected.size());
+        CHECK(std::equal(expected.begin(), expected.end(), buffer.begin()));
+        CHECK(std::all_of(buffer.begin() + written, buffer.end(), [](BYTE b) { return b == 0xEE; }));
+      }
+    }
+  }
+}
+
+TEST_CASE(ChunkHeaderWriter_BasicHeaderBoundaries)
+{
+  struct Boundary
+  {
+    unsigned int ChunkStreamID;
+    vector<BYTE> Expected;
+  };
+  const Boundary boundaries[] = {
+    { 2U, { 0xC2 } },
+    { 63U, { 0xFF } },
+    { 64U, { 0xC0, 0x00 } },
+    { 319U, { 0xC0, 0xFF } },
+    { 320U, { 0xC1, 0x00, 0x01 } },
+    { 65599U, { 0xC1, 0xFF, 0xFF } }
+  };
+
+  for (auto& boundary : boundaries)
+  {
+    unsigned int written = 0;
+    auto buffer = WriteHeader(RTMPChunkType::Type3, boundary.ChunkStreamID, GoldenTimestamp, written);
+    REQUIRE(written == boundary.Expected.size());
+    CHECK(std::equal(boundary.Expected.begin(), boundary.Expected.end(), buffer.begin()));
+  }
+}
+
+TEST_CASE(ChunkHeaderWriter_ExtendedTimestampBoundary)
+{
+  unsigned int written = 0;
+  auto below = WriteHeader(RTMPChunkType::Type2, 5U, 0xFFFFFEU, written);
+  const vector<BYTE> expectedBelow = { 0x85, 0xFF, 0xFF, 0xFE };
+  REQUIRE(written == expectedBelow.size());
+  CHECK(std::equal(expectedBelow.begin(), expectedBelow.end(), below.begin()));
+
+  //0xFFFFFF itself no longer fits the 3 byte field - it is the marker
+  auto at = WriteHeader(RTMPChunkType::Type2, 5U, 0xFFFFFFU, written);
+  const vector<BYTE> expectedAt = { 0x85, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF };
+  REQUIRE(written == expectedAt.size());
+  CHECK(std::equal(expectedAt.begin(), expectedAt.end(), at.begin()));
+}
+
+TEST_CASE(ChunkHeaderWriter_ExtendedTimestampRoundTripsThroughDecoder)
+{
+  auto msg = make_shared<RTMPMessage>(GoldenExtendedTimestamp, (BYTE) RTMPMessageType::VIDEO, 1U, MakePayload(300U));
+  auto bitstream = ChunkProcessor::ToChunkedBitstream(6U, 128U, msg);
+  //Type0 with the marker, then two Type3 continuations that each repeat the extended timestamp
+  CHECK_EQUAL((size_t) (300U + 1U + 11U + 4U + 2U * (1U + 4U)), bitstream->size());
+
+  ChunkDecoder decoder(128U);
+  auto messages = decoder.Decode(bitstream->data(), (unsigned int) bitstream->size());
+  REQUIRE(messages.size() == 1U);
+  CHECK_EQUAL(GoldenExtendedTimestamp, messages[0]->GetTimestamp());
+  CHECK(*messages[0]->GetPayload() == *msg->GetPayload());
+}
+
+TEST_CASE(ChunkDecoder_CreateMessageRejectsTruncatedControlMessages)
+{
+  auto make = [](std::initializer_list<BYTE> bytes) { return make_shared<vector<BYTE>>(bytes); };
+
+  CHECK(ChunkDecoder::CreateMessage((BYTE) RTMPMessageType::PROTOACKNOWLEDGEMENT, 0, make({ 0x00, 0x00, 0x01 })) == nullptr);
+  CHECK(ChunkDecoder::CreateMessage((BYTE) RTMPMessageType::PROTOSETPEERBANDWIDTH, 0, make({ 0x00, 0x00, 0x01, 0x00 })) == nullptr);
+  //Set Buffer Length carries a stream ID and a buffer length - 6 bytes are not enough
+  CHECK(ChunkDecoder::CreateMessage((BYTE) RTMPMessageType::USERCONTROL, 0, make({ 0x00, 0x03, 0x00, 0x00, 0x00, 0x01 })) == nullptr);
+
+  auto ack = ChunkDecoder::CreateMessage((BYTE) RTMPMessageType::PROTOACKNOWLEDGEMENT, 0, make({ 0x00, 0x00, 0x01, 0x00 }));
+  REQUIRE(ack != nullptr);
+  CHECK_EQUAL(256U, static_pointer_cast<ProtoAcknowledgementMessage>(ack)->GetSequenceNumber());
+
+  //Stream Begin - 2 byte event type and a 4 byte stream ID
+  auto streamBegin = ChunkDecoder::CreateMessage((BYTE) RTMPMessageType::USERCONTROL, 0, make({ 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xEE }));
+  REQUIRE(streamBegin != nullptr);
+  CHECK_EQUAL(6U, streamBegin->GetMessageLength());
+  CHECK_EQUAL((unsigned short) UserControlMessageType::StreamBegin, static_pointer_cast<UserControlMessage>(streamBegin)->GetType());
+}
+
+TEST_CASE(ChunkStreamHeaderState_ConstantSizeAudioCompressesToType3)
+{
+  //AAC frames of one size every 21 ms - the first delta has to be sent once before Type3 can repeat it
+  CheckChunkTypes({
+    { 0U, Audio, 371U, 1U, RTMPChunkType::Type0 },
+    { 21U, Audio, 371U, 1U, RTMPChunkType::Type2 },
+    { 42U, Audio, 371U, 1U, RTMPChunkType::Type3 },
+    { 63U, Audio, 371U, 1U, RTMPChunkType::Type3 },
+    //a different delta is sent again, then repeated
+    { 86U, Audio, 371U, 1U, RTMPChunkType::Type2 },
+    { 109U, Audio, 371U, 1U, RTMPChunkType::Type3 }
+  });
+}
+
+TEST_CASE(ChunkStreamHeaderState_SizeOrTypeChangeIsType1)
+{
+  CheckChunkTypes({
+    { 0U, Audio, 371U, 1U, RTMPChunkType::Type0 },
+    { 21U, Audio, 380U, 1U, RTMPChunkType::Type1 },
+    { 42U, Video, 380U, 1U, RTMPChunkType::Type1 },
+    //same delta, size and type as the Type1 before it
+    { 63U, Video, 380U, 1U, RTMPChunkType::Type3 }
+  });
+}
+
+TEST_CASE(ChunkStreamHeaderState_BackwardsOrLargeTimestampIsType0)
+{
+  CheckChunkTypes({
+    { 1000U, Audio, 371U, 1U, RTMPChunkType::Type0 },
+    { 999U, Audio, 371U, 1U, RTMPChunkType::Type0 },
+    //the largest delta a 3 byte field carries without an extended timestamp
+    { 999U + 0xFFFFFEU, Audio, 371U, 1U, RTMPChunkType::Type2 },
+    { 999U + 0xFFFFFEU + 0xFFFFFFU, Audio, 371U, 1U, RTMPChunkType::Type0 },
+    { 999U + 0xFFFFFEU + 0xFFFFFFU + 21U, Audio, 371U, 1U, RTMPChunkType::Type2 }
+  });
+}
+
+TEST_CASE(ChunkStreamHeaderState_MessageStreamChangeIsType0)
+{
+  CheckChunkTypes({
+    { 0U, Video, 500U, 1U, RTMPChunkType::Type0 },
+    { 33U, Video, 500U, 1U, RTMPChunkType::Type2 },
+    { 66U, Video, 500U, 2U, RTMPChunkType::Type0 },
+    { 99U, Video, 500U, 2U, RTMPChunkType::Type2 },
+    { 132U, Video, 500U, 2U, RTMPChunkType::Type3 }
+  });
+}
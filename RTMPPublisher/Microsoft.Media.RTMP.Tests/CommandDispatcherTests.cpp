@@ -0,0 +1,237 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include "PlatformTypes.h"
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "TestHarness.h"
+#include "RTMPChunking.h"
+#include "CommandDispatcher.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  typedef std::vector<tuple<string, shared_ptr<AMF0Entity>>> PropertyMap;
+
+  //_result or _error - transaction ID, a null command object and a number such as a createStream stream ID
+  vector<BYTE> Result(const string& name, unsigned int transactionID, double number)
+  {
+    auto bs = make_shared<vector<BYTE>>();
+    AMF0Entity::EncodeString(name, bs);
+    AMF0Entity::EncodeNumber(transactionID, bs);
+    AMF0Entity::EncodeNull(bs);
+    AMF0Entity::EncodeNumber(number, bs);
+    return *bs;
+  }
+
+  vector<BYTE> Status(const string& level, const string& code)
+  {
+    auto bs = make_shared<vector<BYTE>>();
+    AMF0Entity::EncodeString("onStatus", bs);
+    AMF0Entity::EncodeNumber(0, bs);
+    AMF0Entity::EncodeNull(bs);
+    auto info = make_shared<PropertyMap>();
+    info->push_back(make_tuple(string("level"), make_shared<AMF0Entity>(level)));
+    info->push_back(make_tuple(string("code"), make_shared<AMF0Entity>(code)));
+    AMF0Entity::EncodeObject(info, bs);
+    return *bs;
+  }
+
+  //chunks a command payload the way a server sends it
+  shared_ptr<vector<BYTE>> CommandBitstream(const vector<BYTE>& payload, unsigned int messageStreamID = 0U)
+  {
+    return ChunkProcessor::ToChunkedBitstream(3, 128, make_shared<RTMPMessage>(0, (BYTE) RTMPMessageType::COMMANDAMF0, messageStreamID, make_shared<vector<BYTE>>(payload)));
+  }
+
+  //feeds a bitstream through a decoder that hands commands to the dispatcher, like the messenger's receive loop
+  bool DecodeInto(CommandDispatcher& dispatcher, shared_ptr<vector<BYTE>> bitstream)
+  {
+    ChunkDecoder decoder;
+    decoder.SetMessageHandler<AMF0CommandView>([&dispatcher](const AMF0CommandView& view)
+    {
+      dispatcher.Dispatch(view);
+    });
+    try
+    {
+      decoder.Decode(bitstream->data(), (unsigned int) bitstream->size());
+    }
+    catch (const std::logic_error&)
+    {
+      return false;
+    }
+    return true;
+  }
+}
+
+TEST_CASE(CommandDispatcher_MalformedAMF3ReplyHasNoValue)
+{
+  //_result for transaction 1 whose last argument is an AMF3 string referencing entry 5 of an empty string table
+  const vector<BYTE> payload = {
+    0x02, 0x00, 0x07, '_', 'r', 'e', 's', 'u', 'l', 't',
+    0x00, 0x3F, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x05,
+    0x11, 0x06, 0x0A
+  };
+  REQUIRE(payload.size() == 23U);
+
+  CommandDispatcher dispatcher;
+  bool answered = false;
+  CommandReply received;
+  dispatcher.ExpectResult(1U, 10000U, [&](const CommandReply& reply)
+  {
+    answered = true;
+    received = reply;
+  });
+
+  CHECK(DecodeInto(dispatcher, CommandBitstream(payload)));
+  REQUIRE(answered);
+  CHECK_EQUAL(1U, received.TransactionID);
+  CHECK(!received.HasNumber);
+  CHECK(!received.Error);
+  CHECK(received.Failure == nullptr);
+}
+
+TEST_CASE(CommandDispatcher_ResultsAreMatchedByTransactionID)
+{
+  CommandDispatcher dispatcher;
+  vector<CommandReply> first;
+  vector<CommandReply> second;
+  dispatcher.ExpectResult(1U, 10000U, [&](const CommandReply& reply) { first.push_back(reply); });
+  dispatcher.ExpectResult(2U, 10000U, [&](const CommandReply& reply) { second.push_back(reply); });
+
+  //answered in the opposite order they were sent
+  CHECK(DecodeInto(dispatcher, CommandBitstream(Result("_error", 2U, 0))));
+  CHECK(DecodeInto(dispatcher, CommandBitstream(Result("_result", 1U, 5))));
+
+  REQUIRE(first.size() == 1U);
+  REQUIRE(second.size() == 1U);
+  CHECK(first[0].CommandName == "_result");
+  CHECK_EQUAL(1U, first[0].TransactionID);
+  CHECK(!first[0].Error);
+  CHECK(first[0].HasNumber);
+  CHECK_EQUAL(5.0, first[0].Number);
+  CHECK(second[0].CommandName == "_error");
+  CHECK_EQUAL(2U, second[0].TransactionID);
+  CHECK(second[0].Error);
+  CHECK(second[0].Failure == nullptr);
+  CHECK_EQUAL((size_t) 0U, dispatcher.GetPendingCount());
+
+  //a reply nobody waits for is dropped
+  CHECK(DecodeInto(dispatcher, CommandBitstream(Result("_result", 1U, 5))));
+  CHECK_EQUAL((size_t) 1U, first.size());
+}
+
+TEST_CASE(CommandDispatcher_StatusOnStreamZeroGoesToTheOldestWaiter)
+{
+  CommandDispatcher dispatcher;
+  vector<CommandReply> first;
+  vector<CommandReply> second;
+  dispatcher.ExpectStatus(1U, 10000U, [&](const CommandReply& reply) { first.push_back(reply); });
+  dispatcher.ExpectStatus(2U, 10000U, [&](const CommandReply& reply) { second.push_back(reply); });
+  dispatcher.ExpectStatus(3U, 10000U, [&](const CommandReply& reply) { second.push_back(reply); });
+
+  //a status on a stream somebody waits on goes to them even if others waited longer
+  CHECK(DecodeInto(dispatcher, CommandBitstream(Status("status", "NetStream.Publish.Start"), 2U)));
+  REQUIRE(second.size() == 1U);
+  CHECK_EQUAL(2U, second[0].MessageStreamID);
+  CHECK(first.empty());
+
+  //nobody waits on stream 0 - the longest waiting status takes it
+  CHECK(DecodeInto(dispatcher, CommandBitstream(Status("status", "NetStream.Publish.Start"), 0U)));
+  REQUIRE(first.size() == 1U);
+  CHECK_EQUAL(0U, first[0].MessageStreamID);
+  CHECK(first[0].Level == "status");
+  CHECK(first[0].Code == "NetStream.Publish.Start");
+  CHECK(!first[0].Error);
+  CHECK_EQUAL((size_t) 1U, second.size());
+  CHECK_EQUAL((size_t) 1U, dispatcher.GetPendingCount());
+}
+
+TEST_CASE(CommandDispatcher_ErrorLevelStatusIsAnError)
+{
+  CommandDispatcher dispatcher;
+  vector<CommandReply> replies;
+  dispatcher.ExpectStatus(1U, 10000U, [&](const CommandReply& reply) { replies.push_back(reply); });
+
+  CHECK(DecodeInto(dispatcher, CommandBitstream(Status("error", "NetStream.Publish.BadName"), 1U)));
+  REQUIRE(replies.size() == 1U);
+  CHECK(replies[0].Error);
+  CHECK(replies[0].Code == "NetStream.Publish.BadName");
+  CHECK(replies[0].Failure == nullptr);
+}
+
+TEST_CASE(CommandDispatcher_DeadlineExpiryTimesOut)
+{
+  CommandDispatcher dispatcher;
+  std::promise<CommandReply> expired;
+  auto start = std::chrono::steady_clock::now();
+  dispatcher.ExpectResult(7U, 20U, [&](const CommandReply& reply) { expired.set_value(reply); });
+  //a later deadline is not failed along with it
+  dispatcher.ExpectResult(8U, 10000U, [](const CommandReply&) {});
+
+  auto future = expired.get_future();
+  REQUIRE(future.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+  auto reply = future.get();
+  CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+  CHECK(reply.TimedOut);
+  CHECK(reply.Failure != nullptr);
+  CHECK_EQUAL(7U, reply.TransactionID);
+  CHECK_EQUAL((size_t) 1U, dispatcher.GetPendingCount());
+}
+
+TEST_CASE(CommandDispatcher_FailAllAndShutdownFailEveryWaiter)
+{
+  vector<CommandReply> failed;
+  {
+    CommandDispatcher dispatcher;
+    dispatcher.ExpectResult(1U, 10000U, [&](const CommandReply& reply) { failed.push_back(reply); });
+    dispatcher.ExpectStatus(1U, 10000U, [&](const CommandReply& reply) { failed.push_back(reply); });
+    dispatcher.FailAll(std::make_exception_ptr(std::runtime_error("connection closed")));
+    REQUIRE(failed.size() == 2U);
+    CHECK_EQUAL((size_t) 0U, dispatcher.GetPendingCount());
+
+    dispatcher.ExpectResult(2U, 10000U, [&](const CommandReply& reply) { failed.push_back(reply); });
+    dispatcher.ExpectStatus(2U, 10000U, [&](const CommandReply& reply) { failed.push_back(reply); });
+  }
+
+  REQUIRE(failed.size() == 4U);
+  for (auto& reply : failed)
+  {
+    CHECK(reply.Failure != nullptr);
+    CHECK(!reply.TimedOut);
+  }
+  CHECK_EQUAL(1U, failed[0].TransactionID);
+  CHECK_EQUAL(1U, failed[1].MessageStreamID);
+  CHECK_EQUAL(2U, failed[2].TransactionID);
+  CHECK_EQUAL(2U, failed[3].MessageStreamID);
+}
@@ -0,0 +1,125 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "TestHarness.h"
+#include "RTMPMessageFormats.h"
+#include "ControlMessageViews.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  bool TryCreateSetChunkSize(unsigned int rawValue, unsigned int payloadLength, unsigned int& chunkSize)
+  {
+    BYTE bytes[4];
+    ByteWriter(bytes, 4).put_u32be(rawValue);
+    MessagePayloadView payload = { bytes, payloadLength, 0, 0, RTMPMessageType::PROTOSETCHUNKSIZE };
+    SetChunkSizeView view;
+    auto ok = SetChunkSizeView::TryCreate(payload, view);
+    chunkSize = view.GetChunkSize();
+    return ok;
+  }
+}
+
+TEST_CASE(SetChunkSizeView_AcceptsTheSpecRange)
+{
+  unsigned int chunkSize = 0;
+  CHECK(TryCreateSetChunkSize(1U, 4, chunkSize));
+  CHECK_EQUAL(1U, chunkSize);
+  CHECK(TryCreateSetChunkSize(4096U, 4, chunkSize));
+  CHECK_EQUAL(4096U, chunkSize);
+  CHECK(TryCreateSetChunkSize(0x7FFFFFFFU, 4, chunkSize));
+  CHECK_EQUAL(0x7FFFFFFFU, chunkSize);
+}
+
+TEST_CASE(SetChunkSizeView_RejectsZeroReservedBitAndTruncation)
+{
+  unsigned int chunkSize = 0;
+  CHECK(!TryCreateSetChunkSize(0U, 4, chunkSize));
+  CHECK(!TryCreateSetChunkSize(0x80000000U, 4, chunkSize));
+  CHECK(!TryCreateSetChunkSize(0xFFFFFFFFU, 4, chunkSize));
+  CHECK(!TryCreateSetChunkSize(4096U, 3, chunkSize));
+}
+
+TEST_CASE(ProtoSetChunkSizeMessage_RejectsOutOfRange)
+{
+  bool threw = false;
+  try
+  {
+    ProtoSetChunkSizeMessage msg(0);
+  }
+  catch (const std::invalid_argument&)
+  {
+    threw = true;
+  }
+  CHECK(threw);
+  CHECK_EQUAL(1U, ProtoSetChunkSizeMessage(1).GetChunkSize());
+}
+
+TEST_CASE(ProtoMessages_TruncatedPayloadIsDetected)
+{
+  const BYTE bytes[] = { 0x00, 0x00, 0x10, 0x00, 0x02 };
+  unsigned int val = 0U;
+  CHECK(ProtoSetChunkSizeMessage::TryGetChunkSize(bytes, 4, val));
+  CHECK_EQUAL(4096U, val);
+  CHECK(!ProtoSetChunkSizeMessage::TryGetChunkSize(bytes, 3, val));
+  CHECK(!ProtoAbortMessage::TryGetChunkStreamID(bytes, 0, val));
+  CHECK(!ProtoAcknowledgementMessage::TryGetSequenceNumber(bytes, 2, val));
+  CHECK(!ProtoAckWindowSizeMessage::TryGetWindowSize(bytes, 1, val));
+
+  BYTE limitType = 0;
+  CHECK(ProtoSetPeerBandwidthMessage::TryGetBandwidth(bytes, 5, val, limitType));
+  CHECK_EQUAL(4096U, val);
+  CHECK_EQUAL((BYTE) BandwidthLimitType::Dynamic, limitType);
+  //the limit type byte is missing
+  CHECK(!ProtoSetPeerBandwidthMessage::TryGetBandwidth(bytes, 4, val, limitType));
+
+  CHECK_EQUAL(2500000U, ProtoAckWindowSizeMessage(2500000U).GetWindowSize());
+  CHECK_EQUAL((BYTE) BandwidthLimitType::Soft, ProtoSetPeerBandwidthMessage(2500000U, BandwidthLimitType::Soft).GetBandwidthLimitType());
+}
+
+TEST_CASE(HandshakeMessage_RoundTripsBigEndianEpoch)
+{
+  auto random = make_shared<vector<BYTE>>(1528);
+  for (unsigned int ctr = 0; ctr < random->size(); ctr++)
+    (*random)[ctr] = (BYTE) (ctr * 31 + 7);
+
+  auto bitstream = HandshakeMessageC1C2S1S2(0x01020304U, random).ToBitstream();
+  REQUIRE(bitstream->size() == 1536U);
+  CHECK_EQUAL((BYTE) 0x01, (*bitstream)[0]);
+
+  auto parsed = HandshakeMessageC1C2S1S2::TryParse(bitstream->data(), 1536);
+  REQUIRE(parsed != nullptr);
+  CHECK_EQUAL(0x01020304U, parsed->GetBaseEpoch());
+  CHECK(parsed->AreRandomBytesEqual(random));
+
+  CHECK(HandshakeMessageC1C2S1S2::TryParse(bitstream->data(), 1535) == nullptr);
+}
@@ -0,0 +1,277 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include "PlatformTypes.h"
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TestHarness.h"
+#include "LoopbackTransport.h"
+#include "FakeIngestPeer.h"
+#include "RTMPMessageFormats.h"
+#include "RTMPChunking.h"
+#include "ControlMessageViews.h"
+#include "CommandTemplates.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  const std::chrono::seconds Timeout(5);
+
+  shared_ptr<vector<BYTE>> MakeBytes(unsigned int len)
+  {
+    auto retval = make_shared<vector<BYTE>>(len);
+    for (unsigned int ctr = 0; ctr < len; ctr++)
+      (*retval)[ctr] = (BYTE) (ctr * 13 + 5);
+    return retval;
+  }
+
+  void SendAll(RTMPTransport& transport, shared_ptr<vector<BYTE>> bitstream)
+  {
+    auto done = make_shared<std::promise<unsigned int>>();
+    TransportBuffer buffer = { bitstream->data(), (unsigned int) bitstream->size() };
+    transport.Send(&buffer, 1, [done](unsigned int sent, std::exception_ptr error)
+    {
+      if (error != nullptr)
+        done->set_exception(error);
+      else
+        done->set_value(sent);
+    });
+    auto result = done->get_future();
+    REQUIRE(result.wait_for(Timeout) == std::future_status::ready);
+    CHECK_EQUAL((unsigned int) bitstream->size(), result.get());
+  }
+
+  ///<returns>Bytes read into the buffer - 0 once the peer has closed</returns>
+  unsigned int ReceiveSome(RTMPTransport& transport, std::vector<BYTE>& buffer)
+  {
+    auto done = make_shared<std::promise<unsigned int>>();
+    transport.Receive(buffer.data(), (unsigned int) buffer.size(), [done](unsigned int received, std::exception_ptr error)
+    {
+      if (error != nullptr)
+        done->set_exception(error);
+      else
+        done->set_value(received);
+    });
+    auto result = done->get_future();
+    REQUIRE(result.wait_for(Timeout) == std::future_status::ready);
+    return result.get();
+  }
+
+  std::vector<BYTE> ReceiveExactly(RTMPTransport& transport, unsigned int len)
+  {
+    std::vector<BYTE> retval;
+    std::vector<BYTE> buffer(len);
+    while (retval.size() < len)
+    {
+      buffer.resize(len - retval.size());
+      auto received = ReceiveSome(transport, buffer);
+      REQUIRE(received > 0);
+      retval.insert(retval.end(), buffer.begin(), buffer.begin() + received);
+    }
+    return retval;
+  }
+
+  ///<summary>Reads and decodes until a command arrives</summary>
+  std::string ReceiveCommand(RTMPTransport& transport, ChunkDecoder& decoder)
+  {
+    std::string name;
+    decoder.SetMessageHandler<AMF0CommandView>([&](const AMF0CommandView& view)
+    {
+      if (name.empty())
+        name = view.GetCommandName();
+    });
+
+    std::vector<BYTE> buffer(4096);
+    while (name.empty())
+    {
+      auto received = ReceiveSome(transport, buffer);
+      REQUIRE(received > 0);
+      decoder.Decode(buffer.data(), received);
+    }
+    return name;
+  }
+
+  void SendMessage(RTMPTransport& transport, unsigned int chunkStreamID, shared_ptr<RTMPMessage> msg)
+  {
+    SendAll(transport, ChunkProcessor::ToChunkedBitstream(chunkStreamID, 128, msg));
+  }
+
+  ///<summary>C0 and C1 together, S0 S1 and S2 back, C2 echoes S1</summary>
+  void Handshake(RTMPTransport& transport)
+  {
+    auto c0c1 = make_shared<vector<BYTE>>();
+    HandshakeMessageC0S0(HandshakeMessageC0S0::RTMP_VERSION).ToBitstream(c0c1);
+    auto random = MakeBytes(1528);
+    HandshakeMessageC1C2S1S2(0, random).ToBitstream(c0c1);
+    SendAll(transport, c0c1);
+
+    auto s0s1s2 = ReceiveExactly(transport, 1 + 1536 + 1536);
+    CHECK_EQUAL((BYTE) HandshakeMessageC0S0::RTMP_VERSION, s0s1s2[0]);
+    auto s1 = HandshakeMessageC1C2S1S2::TryParse(s0s1s2.data() + 1, 1536);
+    auto s2 = HandshakeMessageC1C2S1S2::TryParse(s0s1s2.data() + 1537, 1536);
+    REQUIRE(s1 != nullptr && s2 != nullptr);
+    CHECK(s2->AreRandomBytesEqual(random));
+    auto c2 = make_shared<vector<BYTE>>();
+    HandshakeMessageC1C2S1S2(s1->GetBaseEpoch(), s1->GetParseTimestamp(), s1->GetRandomBytes()).ToBitstream(c2);
+    SendAll(transport, c2);
+  }
+
+  template<typename TCondition>
+  FakeIngestStats WaitForStats(FakeIngestPeer& peer, TCondition condition)
+  {
+    auto deadline = std::chrono::steady_clock::now() + Timeout;
+    auto stats = peer.GetStats();
+    while (!condition(stats) && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      stats = peer.GetStats();
+    }
+    return stats;
+  }
+}
+
+TEST_CASE(LoopbackTransport_SplitReadsDeliverEveryByteInOrder)
+{
+  auto transports = LoopbackTransport::CreatePair();
+  LoopbackFaults faults;
+  faults.MaxReadSize = 3U;
+  transports.second->SetReceiveFaults(faults);
+
+  auto first = MakeBytes(500);
+  auto second = MakeBytes(301);
+  SendAll(*transports.first, first);
+  SendAll(*transports.first, second);
+
+  std::vector<BYTE> received;
+  std::vector<BYTE> buffer(64);
+  unsigned int largest = 0;
+  while (received.size() < first->size() + second->size())
+  {
+    auto len = ReceiveSome(*transports.second, buffer);
+    REQUIRE(len > 0);
+    if (len > largest)
+      largest = len;
+    received.insert(received.end(), buffer.begin(), buffer.begin() + len);
+  }
+
+  CHECK_EQUAL(3U, largest);
+  CHECK(std::equal(first->begin(), first->end(), received.begin()));
+  CHECK(std::equal(second->begin(), second->end(), received.begin() + first->size()));
+  CHECK_EQUAL(801ULL, transports.second->GetBytesReceived());
+  CHECK_EQUAL(801ULL, transports.first->GetBytesSent());
+}
+
+TEST_CASE(LoopbackTransport_StallHoldsDeliveryAtItsOffset)
+{
+  auto transports = LoopbackTransport::CreatePair();
+  LoopbackFaults faults;
+  faults.Stalls.push_back(LoopbackStall{ 100ULL, 50U });
+  transports.second->SetReceiveFaults(faults);
+
+  SendAll(*transports.first, MakeBytes(200));
+
+  //the first read stops short of the stall even though more is buffered
+  std::vector<BYTE> buffer(4096);
+  CHECK_EQUAL(100U, ReceiveSome(*transports.second, buffer));
+  auto stalled = std::chrono::steady_clock::now();
+  CHECK_EQUAL(100U, ReceiveSome(*transports.second, buffer));
+  CHECK(std::chrono::steady_clock::now() - stalled >= std::chrono::milliseconds(50));
+}
+
+TEST_CASE(LoopbackTransport_CloseWhileReceivingFailsTheReceive)
+{
+  auto transports = LoopbackTransport::CreatePair();
+
+  //closing the receiving side fails its pending receive
+  auto done = make_shared<std::promise<std::exception_ptr>>();
+  std::vector<BYTE> buffer(16);
+  transports.second->Receive(buffer.data(), (unsigned int) buffer.size(), [done](unsigned int, std::exception_ptr error)
+  {
+    done->set_value(error);
+  });
+  transports.second->Close();
+  auto result = done->get_future();
+  REQUIRE(result.wait_for(Timeout) == std::future_status::ready);
+  CHECK(result.get() != nullptr);
+  CHECK_EQUAL(0U, ReceiveSome(*transports.first, buffer));
+
+  //a closed peer still hands over what was in flight, then EOF
+  auto other = LoopbackTransport::CreatePair();
+  SendAll(*other.first, MakeBytes(10));
+  other.first->Close();
+  CHECK_EQUAL(10U, ReceiveSome(*other.second, buffer));
+  CHECK_EQUAL(0U, ReceiveSome(*other.second, buffer));
+}
+
+//the whole publish sequence with every read on both sides split to single bytes and a stall in the middle of C1
+TEST_CASE(FakeIngestPeer_PublishesOverSingleByteReadsAndAStall)
+{
+  auto transports = LoopbackTransport::CreatePair();
+  LoopbackFaults serverFaults;
+  serverFaults.MaxReadSize = 1U;
+  serverFaults.Stalls.push_back(LoopbackStall{ 700ULL, 30U });
+  transports.second->SetReceiveFaults(serverFaults);
+  LoopbackFaults clientFaults;
+  clientFaults.MaxReadSize = 1U;
+  transports.first->SetReceiveFaults(clientFaults);
+
+  FakeIngestPeer peer(transports.second);
+  peer.Start();
+  auto& client = *transports.first;
+
+  Handshake(client);
+  auto handshake = WaitForStats(peer, [](const FakeIngestStats& stats) { return stats.HandshakeValid; });
+  CHECK(handshake.HandshakeValid);
+  CHECK(handshake.C0C1Received - handshake.Started >= std::chrono::milliseconds(30));
+
+  ChunkDecoder decoder;
+  SendMessage(client, 3, CommandTemplates::Connect().Stamp(0, { 1U, std::string("live"), std::string("rtmp://localhost/live"),
+    (unsigned int) RTMPAudioCodecFlag::SUPPORT_SND_AAC, (unsigned int) RTMPVideoCodecFlag::SUPPORT_VID_H264 }));
+  CHECK_EQUAL(std::string("_result"), ReceiveCommand(client, decoder));
+  SendMessage(client, 3, CommandTemplates::CreateStream().Stamp(0, { 2U }));
+  CHECK_EQUAL(std::string("_result"), ReceiveCommand(client, decoder));
+  SendMessage(client, 4, CommandTemplates::Publish().Stamp(1U, { 0U, "split", "live" }));
+  CHECK_EQUAL(std::string("onStatus"), ReceiveCommand(client, decoder));
+
+  for (unsigned int ctr = 0; ctr < 5; ctr++)
+    SendMessage(client, 6, make_shared<RTMPMessage>(ctr * 33, (BYTE) RTMPMessageType::VIDEO, 1U, MakeBytes(300)));
+
+  auto stats = WaitForStats(peer, [](const FakeIngestStats& s) { return s.VideoMessages == 5U; });
+  CHECK(stats.Publishing);
+  CHECK_EQUAL(std::string("split"), stats.StreamName);
+  CHECK_EQUAL(5U, stats.VideoMessages);
+  CHECK_EQUAL(1500ULL, stats.MediaBytes);
+
+  client.Close();
+  CHECK(WaitForStats(peer, [](const FakeIngestStats& s) { return s.Closed; }).Closed);
+}
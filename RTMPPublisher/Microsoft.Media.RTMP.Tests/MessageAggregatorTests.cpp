@@ -0,0 +1,243 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "TestHarness.h"
+#include "MessageAggregator.h"
+#include "RTMPChunking.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  shared_ptr<RTMPMessage> MakeAudio(unsigned int timestamp, unsigned int len = 100U, bool delta = false)
+  {
+    return make_shared<RTMPMessage>(timestamp, (BYTE) RTMPMessageType::AUDIO, 1U, make_shared<vector<BYTE>>(len), delta);
+  }
+
+  shared_ptr<RTMPMessage> MakeFilled(BYTE messageTypeID, unsigned int timestamp, unsigned int len)
+  {
+    auto payload = make_shared<vector<BYTE>>(len);
+    for (unsigned int ctr = 0; ctr < len; ctr++)
+      (*payload)[ctr] = (BYTE) (ctr * 13 + timestamp + messageTypeID);
+    return make_shared<RTMPMessage>(timestamp, messageTypeID, 1U, payload);
+  }
+
+  vector<BYTE> AggregatePayload(const vector<shared_ptr<RTMPMessage>>& messages)
+  {
+    AggregateMessage aggregate(1U, messages);
+    return vector<BYTE>(aggregate.GetPayload()->begin(), aggregate.GetPayload()->end());
+  }
+
+  bool SplitThrows(const vector<BYTE>& payload, unsigned int len)
+  {
+    try
+    {
+      AggregateMessage::Split(0U, 1U, payload.data(), len);
+    }
+    catch (const std::logic_error&)
+    {
+      return true;
+    }
+    return false;
+  }
+}
+
+TEST_CASE(MessageAggregator_NoDeadlineWithoutABatch)
+{
+  MessageAggregator aggregator(100U, 4096U);
+  CHECK(aggregator.GetFlushDeadline() == Clock::time_point::max());
+
+  //messages that pass through unbatched do not open a batch
+  auto t0 = Clock::now();
+  CHECK_EQUAL((size_t) 1, aggregator.Add(MakeAudio(0U, 8192U), t0).size());
+  CHECK_EQUAL((size_t) 1, aggregator.Add(MakeAudio(10U, 100U, true), t0).size());
+  CHECK(aggregator.GetFlushDeadline() == Clock::time_point::max());
+}
+
+TEST_CASE(MessageAggregator_DeadlineIsAWindowAfterTheBatchOpened)
+{
+  MessageAggregator aggregator(100U, 4096U);
+  auto t0 = Clock::now();
+  CHECK(aggregator.Add(MakeAudio(0U), t0).empty());
+  CHECK(aggregator.GetFlushDeadline() == t0 + std::chrono::milliseconds(100));
+
+  //later messages of the same batch do not push the deadline out
+  CHECK(aggregator.Add(MakeAudio(20U), t0 + std::chrono::milliseconds(60)).empty());
+  CHECK(aggregator.GetFlushDeadline() == t0 + std::chrono::milliseconds(100));
+
+  auto batch = aggregator.Flush();
+  REQUIRE(batch.size() == 1U);
+  CHECK_EQUAL((BYTE) RTMPMessageType::AGGREGATE, batch[0]->GetMessageTypeID());
+  CHECK(aggregator.GetFlushDeadline() == Clock::time_point::max());
+}
+
+TEST_CASE(MessageAggregator_ClosedBatchRestartsTheDeadline)
+{
+  MessageAggregator aggregator(100U, 4096U);
+  auto t0 = Clock::now();
+  aggregator.Add(MakeAudio(0U), t0);
+  aggregator.Add(MakeAudio(50U), t0);
+
+  //spans the time window - the batch goes out and the message opens the next one
+  auto t1 = t0 + std::chrono::milliseconds(30);
+  auto ready = aggregator.Add(MakeAudio(150U), t1);
+  REQUIRE(ready.size() == 1U);
+  CHECK_EQUAL((BYTE) RTMPMessageType::AGGREGATE, ready[0]->GetMessageTypeID());
+  CHECK(aggregator.GetFlushDeadline() == t1 + std::chrono::milliseconds(100));
+
+  //a lone message is flushed as is
+  auto single = aggregator.Flush();
+  REQUIRE(single.size() == 1U);
+  CHECK_EQUAL((BYTE) RTMPMessageType::AUDIO, single[0]->GetMessageTypeID());
+  CHECK_EQUAL(150U, single[0]->GetTimestamp());
+}
+
+TEST_CASE(MessageAggregator_RoundTripsThroughTheDecoder)
+{
+  //two 100 byte messages per 300 byte window, a 40ms time window and one message too large to batch
+  vector<shared_ptr<RTMPMessage>> sent = {
+    MakeFilled(RTMPMessageType::AUDIO, 1000U, 100U),
+    MakeFilled(RTMPMessageType::AUDIO, 1021U, 100U),
+    MakeFilled(RTMPMessageType::AUDIO, 1042U, 100U),
+    MakeFilled(RTMPMessageType::AUDIO, 1063U, 20U),
+    MakeFilled(RTMPMessageType::AUDIO, 1084U, 20U),
+    MakeFilled(RTMPMessageType::AUDIO, 1105U, 400U),
+    MakeFilled(RTMPMessageType::AUDIO, 1126U, 20U),
+    MakeFilled(RTMPMessageType::AUDIO, 1147U, 20U)
+  };
+
+  MessageAggregator aggregator(40U, 300U);
+  vector<shared_ptr<RTMPMessage>> wireMessages;
+  for (auto& msg : sent)
+  {
+    auto ready = aggregator.Add(msg);
+    wireMessages.insert(wireMessages.end(), ready.begin(), ready.end());
+  }
+  auto rest = aggregator.Flush();
+  wireMessages.insert(wireMessages.end(), rest.begin(), rest.end());
+
+  unsigned int aggregates = 0;
+  auto headerState = make_shared<ChunkStreamHeaderState>();
+  vector<BYTE> wire;
+  for (auto& msg : wireMessages)
+  {
+    if (msg->GetMessageTypeID() == RTMPMessageType::AGGREGATE)
+      aggregates++;
+    auto bits = ChunkProcessor::ToChunkSegments(4U, 128U, msg, headerState)->ToBitstream();
+    wire.insert(wire.end(), bits->begin(), bits->end());
+  }
+  //[1000,1021] [1042,1063] [1084] [1105] [1126,1147]
+  CHECK_EQUAL((size_t) 5, wireMessages.size());
+  CHECK_EQUAL(3U, aggregates);
+
+  ChunkDecoder decoder(128U);
+  auto received = decoder.Decode(wire.data(), (unsigned int) wire.size());
+  REQUIRE(received.size() == sent.size());
+  for (size_t ctr = 0; ctr < sent.size(); ctr++)
+  {
+    CHECK_EQUAL(sent[ctr]->GetTimestamp(), received[ctr]->GetTimestamp());
+    CHECK_EQUAL(sent[ctr]->GetMessageTypeID(), received[ctr]->GetMessageTypeID());
+    CHECK_EQUAL(sent[ctr]->GetMessageStreamID(), received[ctr]->GetMessageStreamID());
+    REQUIRE(received[ctr]->GetMessageLength() == sent[ctr]->GetMessageLength());
+    CHECK(std::equal(sent[ctr]->GetPayload()->begin(), sent[ctr]->GetPayload()->end(), received[ctr]->GetPayload()->begin()));
+  }
+}
+
+TEST_CASE(AggregateMessage_SplitRejectsMalformedTags)
+{
+  auto payload = AggregatePayload({ MakeFilled(RTMPMessageType::AUDIO, 0U, 10U), MakeFilled(RTMPMessageType::VIDEO, 5U, 30U) });
+  REQUIRE(payload.size() == AggregateMessage::GetTagSize(10U) + AggregateMessage::GetTagSize(30U));
+  CHECK_EQUAL((size_t) 2, AggregateMessage::Split(0U, 1U, payload.data(), (unsigned int) payload.size()).size());
+
+  //every truncation falls inside a tag header, payload or back pointer
+  for (unsigned int len = 1; len < payload.size(); len++)
+  {
+    if (len == AggregateMessage::GetTagSize(10U))
+      continue;
+    CHECK(SplitThrows(payload, len));
+  }
+
+  //back pointer of the first tag off by one
+  auto badBackPointer = payload;
+  badBackPointer[AggregateMessage::GetTagSize(10U) - 1]++;
+  CHECK(SplitThrows(badBackPointer, (unsigned int) badBackPointer.size()));
+
+  //tag length that runs past the aggregate
+  auto badLength = payload;
+  badLength[AggregateMessage::GetTagSize(10U) + 3]++;
+  CHECK(SplitThrows(badLength, (unsigned int) badLength.size()));
+}
+
+TEST_CASE(MessageAggregator_ByteWindowBoundary)
+{
+  //three 100 byte messages fill the window exactly
+  MessageAggregator aggregator(1000U, 3 * AggregateMessage::GetTagSize(100U));
+  CHECK(aggregator.Add(MakeAudio(0U)).empty());
+  CHECK(aggregator.Add(MakeAudio(1U)).empty());
+  CHECK(aggregator.Add(MakeAudio(2U)).empty());
+
+  auto ready = aggregator.Add(MakeAudio(3U));
+  REQUIRE(ready.size() == 1U);
+  CHECK_EQUAL((BYTE) RTMPMessageType::AGGREGATE, ready[0]->GetMessageTypeID());
+  CHECK_EQUAL(3 * AggregateMessage::GetTagSize(100U), ready[0]->GetMessageLength());
+
+  //a message that fills the window on its own is still batched, one byte more passes through
+  MessageAggregator single(1000U, AggregateMessage::GetTagSize(100U));
+  CHECK(single.Add(MakeAudio(0U, 100U)).empty());
+  ready = single.Add(MakeAudio(1U, 101U));
+  REQUIRE(ready.size() == 2U);
+  CHECK_EQUAL(100U, ready[0]->GetMessageLength());
+  CHECK_EQUAL(101U, ready[1]->GetMessageLength());
+}
+
+TEST_CASE(MessageAggregator_TimeWindowBoundary)
+{
+  MessageAggregator aggregator(100U, 4096U);
+  CHECK(aggregator.Add(MakeAudio(500U)).empty());
+  //one millisecond short of the window still joins the batch
+  CHECK(aggregator.Add(MakeAudio(599U)).empty());
+
+  //a full window after the first message closes it
+  auto ready = aggregator.Add(MakeAudio(600U));
+  REQUIRE(ready.size() == 1U);
+  CHECK_EQUAL((BYTE) RTMPMessageType::AGGREGATE, ready[0]->GetMessageTypeID());
+  CHECK_EQUAL(2 * AggregateMessage::GetTagSize(100U), ready[0]->GetMessageLength());
+  CHECK_EQUAL(500U, ready[0]->GetTimestamp());
+
+  //a timestamp going backwards closes it as well
+  ready = aggregator.Add(MakeAudio(599U));
+  REQUIRE(ready.size() == 1U);
+  CHECK_EQUAL((BYTE) RTMPMessageType::AUDIO, ready[0]->GetMessageTypeID());
+  CHECK_EQUAL(600U, ready[0]->GetTimestamp());
+}
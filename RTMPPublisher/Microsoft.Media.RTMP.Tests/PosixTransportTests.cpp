@@ -0,0 +1,323 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TestHarness.h"
+#include "PosixTransport.h"
+#include "IngestServer.h"
+#include "RTMPMessageFormats.h"
+#include "RTMPChunking.h"
+#include "ControlMessageViews.h"
+#include "CommandTemplates.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  const std::chrono::seconds Timeout(5);
+
+  void SendAll(RTMPTransport& transport, shared_ptr<vector<BYTE>> bitstream)
+  {
+    auto done = make_shared<std::promise<unsigned int>>();
+    TransportBuffer buffer = { bitstream->data(), (unsigned int) bitstream->size() };
+    transport.Send(&buffer, 1, [done](unsigned int sent, std::exception_ptr error)
+    {
+      if (error != nullptr)
+        done->set_exception(error);
+      else
+        done->set_value(sent);
+    });
+    auto result = done->get_future();
+    REQUIRE(result.wait_for(Timeout) == std::future_status::ready);
+    CHECK_EQUAL((unsigned int) bitstream->size(), result.get());
+  }
+
+  ///<returns>Bytes read into the buffer - 0 once the peer has closed</returns>
+  unsigned int ReceiveSome(RTMPTransport& transport, std::vector<BYTE>& buffer)
+  {
+    auto done = make_shared<std::promise<unsigned int>>();
+    transport.Receive(buffer.data(), (unsigned int) buffer.size(), [done](unsigned int received, std::exception_ptr error)
+    {
+      if (error != nullptr)
+        done->set_exception(error);
+      else
+        done->set_value(received);
+    });
+    auto result = done->get_future();
+    REQUIRE(result.wait_for(Timeout) == std::future_status::ready);
+    return result.get();
+  }
+
+  std::vector<BYTE> ReceiveExactly(RTMPTransport& transport, unsigned int len)
+  {
+    std::vector<BYTE> retval;
+    std::vector<BYTE> buffer(len);
+    while (retval.size() < len)
+    {
+      buffer.resize(len - retval.size());
+      auto received = ReceiveSome(transport, buffer);
+      REQUIRE(received > 0);
+      retval.insert(retval.end(), buffer.begin(), buffer.begin() + received);
+    }
+    return retval;
+  }
+
+  struct CommandResult
+  {
+    std::string Name;
+    unsigned int TransactionID = 0U;
+    double LastNumber = 0;
+  };
+
+  ///<summary>Reads and decodes until a command arrives</summary>
+  CommandResult ReceiveCommand(RTMPTransport& transport, ChunkDecoder& decoder)
+  {
+    CommandResult result;
+    bool found = false;
+    decoder.SetMessageHandler<AMF0CommandView>([&](const AMF0CommandView& view)
+    {
+      if (found)
+        return;
+      found = true;
+      result.Name = view.GetCommandName();
+      result.TransactionID = view.GetTransactionID();
+      view.TryGetLastNumber(result.LastNumber);
+    });
+
+    std::vector<BYTE> buffer(4096);
+    while (!found)
+    {
+      auto received = ReceiveSome(transport, buffer);
+      REQUIRE(received > 0);
+      decoder.Decode(buffer.data(), received);
+    }
+    return result;
+  }
+
+  void SendMessage(RTMPTransport& transport, unsigned int chunkStreamID, shared_ptr<RTMPMessage> msg)
+  {
+    SendAll(transport, ChunkProcessor::ToChunkedBitstream(chunkStreamID, 128, msg));
+  }
+
+  IngestConnectionReport WaitForClosed(IngestServer& server)
+  {
+    auto deadline = std::chrono::steady_clock::now() + Timeout;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+      auto reports = server.GetReport();
+      if (reports.size() == 1 && !reports[0].Open)
+        return reports[0];
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto reports = server.GetReport();
+    REQUIRE(reports.size() == 1);
+    return reports[0];
+  }
+
+  shared_ptr<PosixTransport> ConnectTo(unsigned short port)
+  {
+    auto transport = make_shared<PosixTransport>();
+    auto connected = make_shared<std::promise<void>>();
+    transport->Connect("127.0.0.1", std::to_string(port), [connected](std::exception_ptr error)
+    {
+      if (error != nullptr)
+        connected->set_exception(error);
+      else
+        connected->set_value();
+    });
+    auto connectResult = connected->get_future();
+    REQUIRE(connectResult.wait_for(Timeout) == std::future_status::ready);
+    connectResult.get();
+    return transport;
+  }
+
+  ///<summary>C0 and C1 together, S0 S1 and S2 back, C2 echoes S1</summary>
+  void Handshake(RTMPTransport& transport)
+  {
+    auto c0c1 = make_shared<vector<BYTE>>();
+    HandshakeMessageC0S0(HandshakeMessageC0S0::RTMP_VERSION).ToBitstream(c0c1);
+    auto random = make_shared<vector<BYTE>>(1528);
+    for (unsigned int ctr = 0; ctr < random->size(); ctr++)
+      (*random)[ctr] = (BYTE) (ctr * 31 + 7);
+    HandshakeMessageC1C2S1S2(0, random).ToBitstream(c0c1);
+    SendAll(transport, c0c1);
+
+    auto s0s1s2 = ReceiveExactly(transport, 1 + 1536 + 1536);
+    CHECK_EQUAL((BYTE) HandshakeMessageC0S0::RTMP_VERSION, s0s1s2[0]);
+    auto s1 = HandshakeMessageC1C2S1S2::TryParse(s0s1s2.data() + 1, 1536);
+    auto s2 = HandshakeMessageC1C2S1S2::TryParse(s0s1s2.data() + 1537, 1536);
+    REQUIRE(s1 != nullptr && s2 != nullptr);
+    CHECK(s2->AreRandomBytesEqual(random));
+    auto c2 = make_shared<vector<BYTE>>();
+    HandshakeMessageC1C2S1S2(s1->GetBaseEpoch(), s1->GetParseTimestamp(), s1->GetRandomBytes()).ToBitstream(c2);
+    SendAll(transport, c2);
+  }
+}
+
+//connects over loopback TCP to an in-process ingest server and publishes a few messages
+TEST_CASE(PosixTransport_PublishesToIngestServer)
+{
+  FakeIngestScript script;
+  script.StreamID = 3U;
+  IngestServer server(script);
+  auto port = server.Listen("127.0.0.1", 0);
+
+  auto transport = ConnectTo(port);
+  CHECK(transport->GetPathMSS() > 0);
+  Handshake(*transport);
+
+  ChunkDecoder decoder;
+  std::string app = "live";
+  std::string tcUrl = "rtmp://127.0.0.1:" + std::to_string(port) + "/live";
+  SendMessage(*transport, 3, CommandTemplates::Connect().Stamp(0, { 1U, app, tcUrl,
+    (unsigned int) RTMPAudioCodecFlag::SUPPORT_SND_AAC, (unsigned int) RTMPVideoCodecFlag::SUPPORT_VID_H264 }));
+  auto connect = ReceiveCommand(*transport, decoder);
+  CHECK_EQUAL(std::string("_result"), connect.Name);
+  CHECK_EQUAL(1U, connect.TransactionID);
+
+  SendMessage(*transport, 3, CommandTemplates::CreateStream().Stamp(0, { 2U }));
+  auto createStream = ReceiveCommand(*transport, decoder);
+  CHECK_EQUAL(std::string("_result"), createStream.Name);
+  CHECK_EQUAL(2U, createStream.TransactionID);
+  CHECK_EQUAL(3.0, createStream.LastNumber);
+
+  auto streamID = (unsigned int) createStream.LastNumber;
+  SendMessage(*transport, 4, CommandTemplates::Publish().Stamp(streamID, { 0U, "smoke", "live" }));
+  auto publish = ReceiveCommand(*transport, decoder);
+  CHECK_EQUAL(std::string("onStatus"), publish.Name);
+
+  for (unsigned int ctr = 0; ctr < 10; ctr++)
+  {
+    SendMessage(*transport, 4, make_shared<RTMPMessage>(ctr * 21, (BYTE) RTMPMessageType::AUDIO, streamID, make_shared<vector<BYTE>>(200, (BYTE) 0xAF)));
+    SendMessage(*transport, 6, make_shared<RTMPMessage>(ctr * 33, (BYTE) RTMPMessageType::VIDEO, streamID, make_shared<vector<BYTE>>(5000, (BYTE) 0x27)));
+  }
+
+  transport->Close();
+  auto report = WaitForClosed(server);
+  CHECK(report.Stats.HandshakeValid);
+  CHECK(report.Stats.Publishing);
+  CHECK_EQUAL(std::string("smoke"), report.Stats.StreamName);
+  CHECK_EQUAL(10U, report.Stats.AudioMessages);
+  CHECK_EQUAL(10U, report.Stats.VideoMessages);
+  CHECK_EQUAL(10ULL * (200ULL + 5000ULL), report.Stats.MediaBytes);
+}
+
+TEST_CASE(PosixTransport_ConnectFailsWithoutListener)
+{
+  //grab a free port and release it so nothing listens there
+  unsigned short port;
+  {
+    IngestServer server;
+    port = server.Listen("127.0.0.1", 0);
+  }
+
+  PosixTransport transport;
+  auto connected = make_shared<std::promise<void>>();
+  transport.Connect("127.0.0.1", std::to_string(port), [connected](std::exception_ptr error)
+  {
+    if (error != nullptr)
+      connected->set_exception(error);
+    else
+      connected->set_value();
+  });
+  auto result = connected->get_future();
+  REQUIRE(result.wait_for(Timeout) == std::future_status::ready);
+  bool failed = false;
+  try
+  {
+    result.get();
+  }
+  catch (const std::exception&)
+  {
+    failed = true;
+  }
+  CHECK(failed);
+}
+
+TEST_CASE(PosixTransport_SendBeforeConnectFails)
+{
+  PosixTransport transport;
+  std::vector<BYTE> bytes(16);
+  TransportBuffer buffer = { bytes.data(), (unsigned int) bytes.size() };
+  bool failed = false;
+  transport.Send(&buffer, 1, [&failed](unsigned int, std::exception_ptr error) { failed = error != nullptr; });
+  CHECK(failed);
+}
+
+//a zero chunk size can not be framed - the server hangs up instead of spinning
+TEST_CASE(PosixTransport_IngestServerClosesOnZeroChunkSize)
+{
+  IngestServer server;
+  auto port = server.Listen("127.0.0.1", 0);
+  auto transport = ConnectTo(port);
+  Handshake(*transport);
+
+  auto payload = make_shared<vector<BYTE>>(4, (BYTE) 0);
+  SendMessage(*transport, 2, make_shared<RTMPMessage>(0, (BYTE) RTMPMessageType::PROTOSETCHUNKSIZE, 0, payload));
+
+  //a reset is as good as an orderly close
+  std::vector<BYTE> buffer(4096);
+  unsigned int received = 0U;
+  try
+  {
+    received = ReceiveSome(*transport, buffer);
+  }
+  catch (const std::system_error&)
+  {
+  }
+  CHECK_EQUAL(0U, received);
+  auto report = WaitForClosed(server);
+  CHECK(report.Stats.HandshakeValid);
+  CHECK(report.Stats.Closed);
+}
+
+//the owner may let go of the transport from one of its callbacks - the messenger's receive loop does when it holds the last reference
+TEST_CASE(PosixTransport_DestroyedFromItsOwnCallback)
+{
+  IngestServer server;
+  auto port = server.Listen("127.0.0.1", 0);
+  auto holder = make_shared<shared_ptr<PosixTransport>>(ConnectTo(port));
+
+  std::vector<BYTE> buffer(64);
+  auto done = make_shared<std::promise<void>>();
+  (*holder)->Receive(buffer.data(), (unsigned int) buffer.size(), [holder, done](unsigned int, std::exception_ptr)
+  {
+    holder->reset();
+    done->set_value();
+  });
+
+  //the server hanging up completes the receive
+  server.Stop();
+  auto result = done->get_future();
+  REQUIRE(result.wait_for(Timeout) == std::future_status::ready);
+  CHECK(*holder == nullptr);
+}
@@ -0,0 +1,162 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include "PlatformTypes.h"
+#include <vector>
+#include "TestHarness.h"
+#include "SendRingBuffer.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  ///<summary>Reserves len bytes, fills them with consecutive values starting at first and commits them</summary>
+  BYTE* Write(SendRingBuffer& buffer, unsigned int len, BYTE first)
+  {
+    BYTE* data = buffer.Reserve(len);
+    if (data == nullptr)
+      return nullptr;
+    for (unsigned int ctr = 0; ctr < len; ctr++)
+      data[ctr] = (BYTE) (first + ctr);
+    buffer.Commit(len);
+    return data;
+  }
+
+  ///<summary>Reads the next region and consumes all of it</summary>
+  vector<BYTE> Read(SendRingBuffer& buffer)
+  {
+    BYTE* data = nullptr;
+    unsigned int len = 0;
+    if (!buffer.GetReadRegion(data, len))
+      return vector<BYTE>();
+    vector<BYTE> retval(data, data + len);
+    buffer.Consume(len);
+    return retval;
+  }
+}
+
+TEST_CASE(SendRingBuffer_ReserveWrapsOnceTheReaderHasMovedOn)
+{
+  SendRingBuffer buffer(100U);
+  BYTE* start = Write(buffer, 60U, 0);
+  REQUIRE(start != nullptr);
+
+  //40 bytes left at the end and the reader still at the start
+  CHECK(buffer.Reserve(50U) == nullptr);
+  CHECK(buffer.Reserve(40U) == start + 60);
+
+  BYTE* data = nullptr;
+  unsigned int len = 0;
+  REQUIRE(buffer.GetReadRegion(data, len));
+  buffer.Consume(30U);
+  CHECK(buffer.Reserve(50U) == nullptr);
+  buffer.Consume(20U);
+
+  //50 bytes ahead of the reader
+  CHECK(Write(buffer, 50U, 60) == start);
+  CHECK_EQUAL(60U, buffer.GetSize());
+
+  //while wrapped the writer may only fill up to the reader
+  CHECK(buffer.Reserve(1U) == nullptr);
+}
+
+TEST_CASE(SendRingBuffer_ReadRegionsFollowWriteOrderAcrossTheWrap)
+{
+  SendRingBuffer buffer(100U);
+  BYTE* start = Write(buffer, 80U, 0);
+  REQUIRE(start != nullptr);
+
+  BYTE* data = nullptr;
+  unsigned int len = 0;
+  REQUIRE(buffer.GetReadRegion(data, len));
+  CHECK_EQUAL(80U, len);
+  buffer.Consume(50U);
+
+  //20 bytes left at the end - the next write goes to the start
+  CHECK(Write(buffer, 30U, 80) == start);
+  CHECK_EQUAL(60U, buffer.GetSize());
+
+  //the tail comes first, a partial consume leaves the rest of it in place
+  REQUIRE(buffer.GetReadRegion(data, len));
+  CHECK(data == start + 50);
+  CHECK_EQUAL(30U, len);
+  CHECK_EQUAL((BYTE) 50, data[0]);
+  buffer.Consume(10U);
+  CHECK_EQUAL(50U, buffer.GetSize());
+
+  auto tail = Read(buffer);
+  REQUIRE(tail.size() == 20U);
+  CHECK_EQUAL((BYTE) 60, tail.front());
+  CHECK_EQUAL((BYTE) 79, tail.back());
+  CHECK_EQUAL(30U, buffer.GetSize());
+
+  //then the wrapped bytes from the start of the buffer
+  REQUIRE(buffer.GetReadRegion(data, len));
+  CHECK(data == start);
+  CHECK_EQUAL(30U, len);
+  auto head = Read(buffer);
+  REQUIRE(head.size() == 30U);
+  CHECK_EQUAL((BYTE) 80, head.front());
+  CHECK_EQUAL((BYTE) 109, head.back());
+
+  CHECK(buffer.IsEmpty());
+  CHECK_EQUAL(0U, buffer.GetSize());
+  CHECK(!buffer.GetReadRegion(data, len));
+  //an empty buffer starts over at the beginning
+  CHECK(buffer.Reserve(100U) == start);
+}
+
+TEST_CASE(SendRingBuffer_CommitLessThanReserved)
+{
+  SendRingBuffer buffer(100U);
+  BYTE* start = buffer.Reserve(50U);
+  REQUIRE(start != nullptr);
+  buffer.Commit(20U);
+  CHECK_EQUAL(20U, buffer.GetSize());
+
+  //the uncommitted part of the reservation is handed out again
+  CHECK(buffer.Reserve(80U) == start + 20);
+
+  //committing more than was reserved is clamped to the reservation
+  buffer.Commit(90U);
+  CHECK_EQUAL(100U, buffer.GetSize());
+  buffer.Commit(10U);
+  CHECK_EQUAL(100U, buffer.GetSize());
+}
+
+TEST_CASE(SendRingBuffer_ResizeOnlyWhileEmpty)
+{
+  SendRingBuffer buffer(100U);
+  REQUIRE(Write(buffer, 10U, 0) != nullptr);
+  CHECK(!buffer.Resize(200U));
+  CHECK_EQUAL(100U, buffer.GetCapacity());
+
+  CHECK_EQUAL((size_t) 10, Read(buffer).size());
+  CHECK(buffer.Resize(200U));
+  CHECK_EQUAL(200U, buffer.GetCapacity());
+  CHECK(buffer.Reserve(200U) != nullptr);
+}
@@ -0,0 +1,163 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#include "PlatformTypes.h"
+#include <string>
+#include <vector>
+#include "TestHarness.h"
+#include "StreamMetadata.h"
+#include "AMF0Document.h"
+
+using namespace std;
+using namespace Microsoft::Media::RTMP;
+
+namespace
+{
+  const vector<string> VideoKeys = { "framerate", "width", "height", "videocodecid", "videodatarate", "videokeyframe_frequency" };
+  const vector<string> AudioKeys = { "audiocodecid", "audiosamplerate", "audiochannels", "audiodatarate" };
+
+  StreamMetadata Video()
+  {
+    StreamMetadata retval;
+    retval.HasVideo = true;
+    retval.FrameRate = 29.97;
+    retval.Width = 1280U;
+    retval.Height = 720U;
+    retval.VideoCodec = "avc1";
+    retval.VideoBitrate = 2500U;
+    retval.VideoKeyFrameFrequency = 2U;
+    return retval;
+  }
+
+  StreamMetadata Audio()
+  {
+    StreamMetadata retval;
+    retval.HasAudio = true;
+    retval.AudioCodec = "mp4a";
+    retval.AudioSampleRate = 48000U;
+    retval.AudioChannels = 2U;
+    retval.AudioBitrate = 128U;
+    return retval;
+  }
+
+  StreamMetadata AudioVideo()
+  {
+    auto retval = Video();
+    auto audio = Audio();
+    retval.HasAudio = true;
+    retval.AudioCodec = audio.AudioCodec;
+    retval.AudioSampleRate = audio.AudioSampleRate;
+    retval.AudioChannels = audio.AudioChannels;
+    retval.AudioBitrate = audio.AudioBitrate;
+    return retval;
+  }
+
+  ///<summary>Parses the @setDataFrame message and checks the two leading strings</summary>
+  ///<returns>The onMetaData object</returns>
+  AMF0Value ParseMetadata(const StreamMetadata& metadata, AMF0Document& doc)
+  {
+    auto msg = metadata.CreateSetDataFrameMessage(1U);
+    CHECK_EQUAL((BYTE) RTMPMessageType::DATAAMF0, msg->GetMessageTypeID());
+    CHECK_EQUAL(1U, msg->GetMessageStreamID());
+    CHECK_EQUAL((unsigned int) msg->GetPayload()->size(), msg->GetMessageLength());
+
+    REQUIRE(doc.Parse(msg->GetPayload()->data(), msg->GetMessageLength()));
+    REQUIRE(doc.GetRootCount() == 3U);
+    CHECK(doc.GetRoot(0).GetStringValue() == "@setDataFrame");
+    CHECK(doc.GetRoot(1).GetStringValue() == "onMetaData");
+    CHECK_EQUAL((BYTE) AMF0TypeMarker::Object, doc.GetRoot(2).GetType());
+    return doc.GetRoot(2);
+  }
+
+  vector<string> GetKeys(AMF0Value obj)
+  {
+    vector<string> retval;
+    for (auto child = obj.GetFirstChild(); child.IsValid(); child = child.GetNextSibling())
+      retval.push_back(child.GetName());
+    return retval;
+  }
+
+  void CheckVideo(AMF0Value obj)
+  {
+    CHECK_EQUAL(29.97, obj["framerate"].GetNumberValue());
+    CHECK_EQUAL(1280.0, obj["width"].GetNumberValue());
+    CHECK_EQUAL(720.0, obj["height"].GetNumberValue());
+    CHECK(obj["videocodecid"].GetStringValue() == "avc1");
+    CHECK_EQUAL(2500.0, obj["videodatarate"].GetNumberValue());
+    CHECK_EQUAL(2.0, obj["videokeyframe_frequency"].GetNumberValue());
+  }
+
+  void CheckAudio(AMF0Value obj)
+  {
+    CHECK(obj["audiocodecid"].GetStringValue() == "mp4a");
+    CHECK_EQUAL(48000.0, obj["audiosamplerate"].GetNumberValue());
+    CHECK_EQUAL(2.0, obj["audiochannels"].GetNumberValue());
+    CHECK_EQUAL(128.0, obj["audiodatarate"].GetNumberValue());
+  }
+
+  void CheckAbsent(AMF0Value obj, const vector<string>& keys)
+  {
+    for (auto& key : keys)
+      CHECK(!obj[key.c_str()].IsValid());
+  }
+}
+
+TEST_CASE(StreamMetadata_VideoOnlyLeavesOutAudioKeys)
+{
+  AMF0Document doc;
+  auto obj = ParseMetadata(Video(), doc);
+  CHECK(GetKeys(obj) == VideoKeys);
+  CheckVideo(obj);
+  CheckAbsent(obj, AudioKeys);
+}
+
+TEST_CASE(StreamMetadata_AudioOnlyLeavesOutVideoKeys)
+{
+  AMF0Document doc;
+  auto obj = ParseMetadata(Audio(), doc);
+  CHECK(GetKeys(obj) == AudioKeys);
+  CheckAudio(obj);
+  CheckAbsent(obj, VideoKeys);
+}
+
+TEST_CASE(StreamMetadata_AudioAndVideoSendsEveryKey)
+{
+  AMF0Document doc;
+  auto obj = ParseMetadata(AudioVideo(), doc);
+  auto keys = VideoKeys;
+  keys.insert(keys.end(), AudioKeys.begin(), AudioKeys.end());
+  CHECK(GetKeys(obj) == keys);
+  CHECK_EQUAL((unsigned int) keys.size(), obj.GetCount());
+  CheckVideo(obj);
+  CheckAudio(obj);
+}
+
+TEST_CASE(StreamMetadata_NoTracksSendsAnEmptyObject)
+{
+  AMF0Document doc;
+  auto obj = ParseMetadata(StreamMetadata(), doc);
+  CHECK_EQUAL(0U, obj.GetCount());
+}
@@ -0,0 +1,158 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      namespace Tests
+      {
+        ///<summary>Thrown by REQUIRE to abandon the rest of a test</summary>
+        struct TestAbort : public std::runtime_error
+        {
+          TestAbort(const std::string& what) : std::runtime_error(what)
+          {
+          }
+        };
+
+        ///<summary>Every test case linked into the executable, in registration order</summary>
+        class TestRegistry
+        {
+        public:
+          struct TestCase
+          {
+            const char* Name;
+            std::function<void()> Body;
+          };
+
+          static std::vector<TestCase>& GetTests()
+          {
+            static std::vector<TestCase> tests;
+            return tests;
+          }
+
+          static unsigned int& GetFailureCount()
+          {
+            static unsigned int failures = 0U;
+            return failures;
+          }
+
+          static void Fail(const char* file, int line, const std::string& message)
+          {
+            GetFailureCount()++;
+            fprintf(stderr, "%s(%d): check failed : %s\n", file, line, message.c_str());
+          }
+
+          ///<summary>Runs the tests whose name contains the filter</summary>
+          ///<returns>Process exit code - 0 when every test passed</returns>
+          static int RunAll(const std::string& filter)
+          {
+            unsigned int failedTests = 0U;
+            unsigned int ran = 0U;
+            for (auto& test : GetTests())
+            {
+              if (!filter.empty() && std::string(test.Name).find(filter) == std::string::npos)
+                continue;
+              ran++;
+              auto before = GetFailureCount();
+              try
+              {
+                test.Body();
+              }
+              catch (const TestAbort&)
+              {
+              }
+              catch (const std::exception& ex)
+              {
+                Fail(test.Name, 0, std::string("unexpected exception - ") + ex.what());
+              }
+              bool passed = GetFailureCount() == before;
+              if (!passed)
+                failedTests++;
+              printf("[%s] %s\n", passed ? "  OK  " : " FAIL ", test.Name);
+            }
+            printf("%u of %u tests passed\n", ran - failedTests, ran);
+            return failedTests == 0 ? 0 : 1;
+          }
+        };
+
+        struct TestRegistrar
+        {
+          TestRegistrar(const char* name, std::function<void()> body)
+          {
+            TestRegistry::GetTests().push_back({ name, body });
+          }
+        };
+
+        template<typename T>
+        std::string Describe(const T& val)
+        {
+          std::ostringstream stm;
+          stm << val;
+          return stm.str();
+        }
+
+        inline std::string Describe(unsigned char val)
+        {
+          return Describe((unsigned int) val);
+        }
+      }
+    }
+  }
+}
+
+#define TEST_CASE(name) \
+  static void name(); \
+  static ::Microsoft::Media::RTMP::Tests::TestRegistrar name##_registrar(#name, name); \
+  static void name()
+
+//records the failure and carries on with the test
+#define CHECK(cond) \
+  do { if (!(cond)) ::Microsoft::Media::RTMP::Tests::TestRegistry::Fail(__FILE__, __LINE__, #cond); } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+  do { \
+    auto&& _expected = (expected); \
+    auto&& _actual = (actual); \
+    if (!(_expected == _actual)) \
+      ::Microsoft::Media::RTMP::Tests::TestRegistry::Fail(__FILE__, __LINE__, std::string(#actual) + " is " + \
+        ::Microsoft::Media::RTMP::Tests::Describe(_actual) + ", expected " + ::Microsoft::Media::RTMP::Tests::Describe(_expected)); \
+  } while (0)
+
+//records the failure and ends the test
+#define REQUIRE(cond) \
+  do { if (!(cond)) { ::Microsoft::Media::RTMP::Tests::TestRegistry::Fail(__FILE__, __LINE__, #cond); throw ::Microsoft::Media::RTMP::Tests::TestAbort(#cond); } } while (0)
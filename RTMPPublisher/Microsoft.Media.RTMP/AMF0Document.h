@@ -0,0 +1,473 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string.h>
+#include <string>
+#include <vector>
+#include "ProtocolConstants.h"
+#include "AMF0Reader.h"
+#include "AMF0PropertyIndex.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      class AMF0Document;
+
+      ///<summary>A value in an AMF0Document</summary>
+      struct AMF0Node
+      {
+        static const unsigned int NONE = 0xFFFFFFFF;
+
+        BYTE Marker = AMF0TypeMarker::Undefined;
+        //numbers and dates
+        double NumberValue = 0;
+        short TimeZone = 0;
+        bool BooleanValue = false;
+        //string, long string and XML document values, class name of a typed object - UTF-8, not null terminated. Undecoded AMF3 value of an AvmPlus node
+        const char* StringData = nullptr;
+        unsigned int StringLength = 0U;
+        //property name, if the node is a property of an object, typed object or ECMA array
+        const char* NameData = nullptr;
+        unsigned int NameLength = 0U;
+        unsigned short ReferenceIndex = 0;
+        //children of objects and arrays, in payload order
+        unsigned int ChildCount = 0U;
+        unsigned int FirstChild = NONE;
+        unsigned int NextSibling = NONE;
+        //where the object's entries start in the document's property index - built on the first lookup by name
+        mutable unsigned int PropertyIndexOffset = NONE;
+      };
+
+      ///<summary>Handle to a node of an AMF0Document - cheap to copy, valid until the document is cleared or reparsed.
+      ///Lookups that find nothing return an invalid value, so lookups can be chained (info["data"]["version"]) and checked once</summary>
+      class AMF0Value
+      {
+      public:
+
+        AMF0Value() : _document(nullptr), _index(AMF0Node::NONE)
+        {
+
+        }
+
+        AMF0Value(const AMF0Document* document, unsigned int index) : _document(document), _index(index)
+        {
+
+        }
+
+        bool IsValid() const
+        {
+          return _document != nullptr && _index != AMF0Node::NONE;
+        }
+
+        ///<returns>The AMF0 type marker, AMF0TypeMarker::Undefined for an invalid value</returns>
+        BYTE GetType() const;
+
+        bool IsNull() const
+        {
+          return GetType() == AMF0TypeMarker::Null;
+        }
+
+        double GetNumberValue() const;
+
+        bool GetBooleanValue() const;
+
+        ///<returns>The UTF-8 string value (string, long string or XML document)</returns>
+        std::string GetStringValue() const;
+
+        ///<returns>true if the value is a string equal to str - compares in place</returns>
+        bool StringEquals(const char* str) const;
+
+        ///<returns>Milliseconds since the epoch (UTC)</returns>
+        double GetDateValue() const;
+
+        std::string GetClassName() const;
+
+        ///<summary>Decodes the AMF3 value an AvmPlus marker switched to</summary>
+        ///<returns>nullptr if the AMF3 value is malformed</returns>
+        shared_ptr<AMF3Entity> GetAMF3Value() const;
+
+        ///<returns>The property name this value is stored under, empty if it is not a property</returns>
+        std::string GetName() const;
+
+        bool NameEquals(const char* name) const;
+
+        ///<returns>Number of properties of an object or elements of an array</returns>
+        unsigned int GetCount() const;
+
+        ///<summary>Looks up a property of an object, typed object or ECMA array - references are followed</summary>
+        AMF0Value operator[](const char* name) const;
+
+        ///<summary>Element of a strict array or property of an object by position - references are followed</summary>
+        AMF0Value At(unsigned int position) const;
+
+        AMF0Value GetFirstChild() const;
+
+        AMF0Value GetNextSibling() const;
+
+        ///<returns>The object or array a reference points to, the value itself if it is not a reference</returns>
+        AMF0Value Resolve() const;
+
+      private:
+        const AMF0Node* GetNode() const;
+
+        const AMF0Document* _document;
+        unsigned int _index;
+      };
+
+      ///<summary>Tree of the values in an AMF0 payload. Nodes are allocated out of a single arena that is released in one shot - clearing or reparsing
+      ///the document keeps the arena's capacity, so a document that is reused across messages stops allocating once it has seen the largest one</summary>
+      class AMF0Document
+      {
+      public:
+
+        ///<param name='maxDepth'>Deepest nesting of objects and arrays accepted</param>
+        AMF0Document(unsigned int maxDepth = AMF0Reader::MAXDEPTH) : _maxDepth(maxDepth)
+        {
+
+        }
+
+        ///<summary>Parses a copy of the payload - the document does not depend on the caller's buffer</summary>
+        ///<returns>false if the payload is truncated or malformed - GetError says why</returns>
+        bool Parse(const BYTE* data, unsigned int len)
+        {
+          _bytes.assign(data, data + len);
+          return Load(AMF0Reader(_bytes.empty() ? nullptr : &(*(_bytes.begin())), len, _maxDepth));
+        }
+
+        ///<summary>Builds the tree from the rest of what a reader has not consumed yet. Strings point into the reader's payload, which has to outlive the document contents</summary>
+        ///<returns>false if the payload is truncated or malformed - GetError says why</returns>
+        bool Load(AMF0Reader reader)
+        {
+          Clear();
+
+          AMF0Token tok;
+          unsigned int last = AMF0Node::NONE;
+          while (reader.Next(tok))
+          {
+            auto index = ReadNode(reader, tok);
+            if (index == AMF0Node::NONE)
+              break;
+            Append(_firstRoot, last, index);
+            _rootCount++;
+          }
+
+          if (reader.HasError())
+          {
+            Clear();
+            _error = reader.GetError();
+            return false;
+          }
+          return true;
+        }
+
+        ///<summary>Drops every node - the arena keeps its capacity</summary>
+        void Clear()
+        {
+          _nodes.clear();
+          _complexNodes.clear();
+          _propertyIndex.clear();
+          _firstRoot = AMF0Node::NONE;
+          _rootCount = 0U;
+          _error = nullptr;
+        }
+
+        const char* GetError() const
+        {
+          return _error;
+        }
+
+        ///<returns>Number of top level values</returns>
+        unsigned int GetRootCount() const
+        {
+          return _rootCount;
+        }
+
+        AMF0Value GetRoot(unsigned int position) const
+        {
+          auto index = _firstRoot;
+          while (index != AMF0Node::NONE && position-- > 0)
+            index = _nodes[index].NextSibling;
+          return AMF0Value(this, index);
+        }
+
+        AMF0Value GetFirstRoot() const
+        {
+          return AMF0Value(this, _firstRoot);
+        }
+
+        const AMF0Node* GetNode(unsigned int index) const
+        {
+          return index < _nodes.size() ? &_nodes[index] : nullptr;
+        }
+
+        ///<returns>Node index of the index'th object, typed object or array in the payload, AMF0Node::NONE if there is no such value</returns>
+        unsigned int GetReferencedNode(unsigned short index) const
+        {
+          if (index >= _complexNodes.size())
+            return AMF0Node::NONE;
+          return _complexNodes[index];
+        }
+
+        ///<summary>Looks up a property of an object, typed object or ECMA array node by name. The first lookup on an object indexes all of its property names,
+        ///the ones that follow are a binary search</summary>
+        ///<returns>Node index of the property, AMF0Node::NONE if there is no such property</returns>
+        unsigned int FindProperty(unsigned int index, const char* name, unsigned int len) const
+        {
+          if (index >= _nodes.size())
+            return AMF0Node::NONE;
+
+          auto& node = _nodes[index];
+          if (node.PropertyIndexOffset == AMF0Node::NONE)
+          {
+            node.PropertyIndexOffset = (unsigned int) _propertyIndex.size();
+            for (auto child = node.FirstChild; child != AMF0Node::NONE; child = _nodes[child].NextSibling)
+              _propertyIndex.push_back(AMF0PropertyIndex::Entry{ AMF0PropertyIndex::Hash(_nodes[child].NameData, _nodes[child].NameLength), child });
+            AMF0PropertyIndex::Sort(_propertyIndex.data() + node.PropertyIndexOffset, _propertyIndex.data() + _propertyIndex.size());
+          }
+
+          auto first = _propertyIndex.data() + node.PropertyIndexOffset;
+          return AMF0PropertyIndex::Find(first, first + node.ChildCount, AMF0PropertyIndex::Hash(name, len), [this, name, len](unsigned int child)
+          {
+            auto& prop = _nodes[child];
+            return prop.NameLength == len && (len == 0 || memcmp(prop.NameData, name, len) == 0);
+          });
+        }
+
+      private:
+
+        void Append(unsigned int& first, unsigned int& last, unsigned int index)
+        {
+          if (first == AMF0Node::NONE)
+            first = index;
+          else
+            _nodes[last].NextSibling = index;
+          last = index;
+        }
+
+        ///<summary>Adds the node for the value that starts with tok - objects and arrays are read up to their end token</summary>
+        ///<returns>The node index, AMF0Node::NONE if the reader failed part way through</returns>
+        unsigned int ReadNode(AMF0Reader& reader, const AMF0Token& tok)
+        {
+          auto index = (unsigned int) _nodes.size();
+          _nodes.push_back(AMF0Node());
+
+          //_nodes may reallocate while children are added - always go through the index
+          _nodes[index].Marker = tok.Marker;
+          _nodes[index].NumberValue = tok.NumberValue;
+          _nodes[index].TimeZone = tok.TimeZone;
+          _nodes[index].BooleanValue = tok.BooleanValue;
+          _nodes[index].StringData = tok.StringData;
+          _nodes[index].StringLength = tok.StringLength;
+          _nodes[index].ReferenceIndex = tok.ReferenceIndex;
+
+          if (tok.Type != AMF0TokenType::ObjectBegin && tok.Type != AMF0TokenType::ArrayBegin)
+            return index;
+
+          //references count objects and arrays in the order they start
+          _complexNodes.push_back(index);
+
+          unsigned int first = AMF0Node::NONE;
+          unsigned int last = AMF0Node::NONE;
+          unsigned int count = 0U;
+          AMF0Token name;
+          AMF0Token val;
+
+          while (true)
+          {
+            if (tok.Type == AMF0TokenType::ObjectBegin)
+            {
+              if (!reader.Next(name))
+                return AMF0Node::NONE;
+              if (name.Type == AMF0TokenType::ObjectEnd)
+                break;
+              if (!reader.Next(val))
+                return AMF0Node::NONE;
+            }
+            else
+            {
+              if (!reader.Next(val))
+                return AMF0Node::NONE;
+              if (val.Type == AMF0TokenType::ArrayEnd)
+                break;
+            }
+
+            auto child = ReadNode(reader, val);
+            if (child == AMF0Node::NONE)
+              return AMF0Node::NONE;
+            if (tok.Type == AMF0TokenType::ObjectBegin)
+            {
+              _nodes[child].NameData = name.StringData;
+              _nodes[child].NameLength = name.StringLength;
+            }
+            Append(first, last, child);
+            count++;
+          }
+
+          _nodes[index].FirstChild = first;
+          _nodes[index].ChildCount = count;
+          return index;
+        }
+
+        std::vector<BYTE> _bytes;
+        std::vector<AMF0Node> _nodes;
+        std::vector<unsigned int> _complexNodes;
+        //name indexes of the objects looked up so far, one run of entries per object
+        mutable std::vector<AMF0PropertyIndex::Entry> _propertyIndex;
+        unsigned int _firstRoot = AMF0Node::NONE;
+        unsigned int _rootCount = 0U;
+        unsigned int _maxDepth = AMF0Reader::MAXDEPTH;
+        const char* _error = nullptr;
+      };
+
+
+
+      inline const AMF0Node* AMF0Value::GetNode() const
+      {
+        return _document != nullptr ? _document->GetNode(_index) : nullptr;
+      }
+
+      inline BYTE AMF0Value::GetType() const
+      {
+        auto node = GetNode();
+        return node != nullptr ? node->Marker : AMF0TypeMarker::Undefined;
+      }
+
+      inline double AMF0Value::GetNumberValue() const
+      {
+        if (GetType() != AMF0TypeMarker::Number) throw std::logic_error("Not a number");
+        return GetNode()->NumberValue;
+      }
+
+      inline bool AMF0Value::GetBooleanValue() const
+      {
+        if (GetType() != AMF0TypeMarker::Boolean) throw std::logic_error("Not a boolean");
+        return GetNode()->BooleanValue;
+      }
+
+      inline std::string AMF0Value::GetStringValue() const
+      {
+        auto type = GetType();
+        if (type != AMF0TypeMarker::String && type != AMF0TypeMarker::LongString && type != AMF0TypeMarker::XmlDocument) throw std::logic_error("Not a string");
+        return std::string(GetNode()->StringData, GetNode()->StringLength);
+      }
+
+      inline bool AMF0Value::StringEquals(const char* str) const
+      {
+        auto type = GetType();
+        if (type != AMF0TypeMarker::String && type != AMF0TypeMarker::LongString)
+          return false;
+        auto len = strlen(str);
+        return len == GetNode()->StringLength && (len == 0 || memcmp(GetNode()->StringData, str, len) == 0);
+      }
+
+      inline double AMF0Value::GetDateValue() const
+      {
+        if (GetType() != AMF0TypeMarker::Date) throw std::logic_error("Not a date");
+        return GetNode()->NumberValue;
+      }
+
+      inline std::string AMF0Value::GetClassName() const
+      {
+        if (GetType() != AMF0TypeMarker::TypedObject) throw std::logic_error("Not a typed object");
+        return std::string(GetNode()->StringData, GetNode()->StringLength);
+      }
+
+      inline shared_ptr<AMF3Entity> AMF0Value::GetAMF3Value() const
+      {
+        if (GetType() != AMF0TypeMarker::AvmPlus) throw std::logic_error("Not an AMF3 value");
+        return AMF3Reader((const BYTE*) GetNode()->StringData, GetNode()->StringLength).TryRead();
+      }
+
+      inline std::string AMF0Value::GetName() const
+      {
+        auto node = GetNode();
+        return node != nullptr && node->NameData != nullptr ? std::string(node->NameData, node->NameLength) : std::string();
+      }
+
+      inline bool AMF0Value::NameEquals(const char* name) const
+      {
+        auto node = GetNode();
+        if (node == nullptr || node->NameData == nullptr)
+          return false;
+        auto len = strlen(name);
+        return len == node->NameLength && (len == 0 || memcmp(node->NameData, name, len) == 0);
+      }
+
+      inline unsigned int AMF0Value::GetCount() const
+      {
+        auto node = Resolve().GetNode();
+        return node != nullptr ? node->ChildCount : 0U;
+      }
+
+      inline AMF0Value AMF0Value::operator[](const char* name) const
+      {
+        auto type = Resolve().GetType();
+        if (type != AMF0TypeMarker::Object && type != AMF0TypeMarker::TypedObject && type != AMF0TypeMarker::EcmaArray)
+          return AMF0Value();
+
+        auto obj = Resolve();
+        auto child = _document->FindProperty(obj._index, name, (unsigned int) strlen(name));
+        return child != AMF0Node::NONE ? AMF0Value(_document, child).Resolve() : AMF0Value();
+      }
+
+      inline AMF0Value AMF0Value::At(unsigned int position) const
+      {
+        auto child = Resolve().GetFirstChild();
+        while (child.IsValid() && position-- > 0)
+          child = child.GetNextSibling();
+        return child.Resolve();
+      }
+
+      inline AMF0Value AMF0Value::GetFirstChild() const
+      {
+        auto node = GetNode();
+        return node != nullptr ? AMF0Value(_document, node->FirstChild) : AMF0Value();
+      }
+
+      inline AMF0Value AMF0Value::GetNextSibling() const
+      {
+        auto node = GetNode();
+        return node != nullptr ? AMF0Value(_document, node->NextSibling) : AMF0Value();
+      }
+
+      inline AMF0Value AMF0Value::Resolve() const
+      {
+        auto node = GetNode();
+        if (node == nullptr || node->Marker != AMF0TypeMarker::Reference)
+          return *this;
+        //references point at objects and arrays, never at other references
+        return AMF0Value(_document, _document->GetReferencedNode(node->ReferenceIndex));
+      }
+    }
+  }
+}
@@ -0,0 +1,96 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>Property name index for AMF0 objects - a flat array of (name hash, position) pairs sorted by hash.
+      ///Lookups binary search on the hash and confirm the name at the position, so hash collisions and duplicate names are handled - the first property with a name wins</summary>
+      class AMF0PropertyIndex
+      {
+      public:
+        static const unsigned int NONE = 0xFFFFFFFF;
+
+        struct Entry
+        {
+          unsigned int Hash;
+          unsigned int Position;
+        };
+
+        ///<summary>32 bit FNV-1a over the UTF-8 name</summary>
+        static unsigned int Hash(const char* name, unsigned int len)
+        {
+          unsigned int hash = 2166136261U;
+          for (unsigned int i = 0; i < len; i++)
+          {
+            hash ^= (BYTE) name[i];
+            hash *= 16777619U;
+          }
+          return hash;
+        }
+
+        ///<summary>Orders entries by hash - ties keep the order of the properties so duplicate names resolve to the first one</summary>
+        static void Sort(Entry* first, Entry* last)
+        {
+          std::sort(first, last, [](const Entry& a, const Entry& b)
+          {
+            return a.Hash < b.Hash || (a.Hash == b.Hash && a.Position < b.Position);
+          });
+        }
+
+        ///<param name='nameEquals'>Called with a candidate position, returns true if the property there has the name looked up</param>
+        ///<returns>Position of the property, NONE if there is none</returns>
+        template<typename TNameEquals>
+        static unsigned int Find(const Entry* first, const Entry* last, unsigned int hash, TNameEquals nameEquals)
+        {
+          auto it = std::lower_bound(first, last, hash, [](const Entry& e, unsigned int h)
+          {
+            return e.Hash < h;
+          });
+
+          for (; it != last && it->Hash == hash; ++it)
+          {
+            if (nameEquals(it->Position))
+              return it->Position;
+          }
+          return NONE;
+        }
+      };
+    }
+  }
+}
@@ -0,0 +1,365 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string.h>
+#include <string>
+#include "ProtocolConstants.h"
+#include "ByteReader.h"
+#include "AMF3.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      class AMF0TokenType
+      {
+      public:
+        static const BYTE None = 0;
+        static const BYTE Number = 1;
+        static const BYTE Boolean = 2;
+        static const BYTE String = 3;
+        static const BYTE Null = 4;
+        static const BYTE Undefined = 5;
+        static const BYTE ObjectBegin = 6;
+        static const BYTE PropertyName = 7;
+        static const BYTE ObjectEnd = 8;
+        static const BYTE ArrayBegin = 9;
+        static const BYTE ArrayEnd = 10;
+        static const BYTE Date = 11;
+        static const BYTE Reference = 12;
+        static const BYTE XmlDocument = 13;
+        static const BYTE Unsupported = 14;
+        static const BYTE AvmPlus = 15;
+      };
+
+      ///<summary>A single token pulled out of an AMF0 payload. Strings and property names point into the payload and are only valid for as long as it is</summary>
+      struct AMF0Token
+      {
+        BYTE Type = AMF0TokenType::None;
+        //type marker the token was read from - tells an anonymous object from an ECMA array
+        BYTE Marker = AMF0TypeMarker::Unsupported;
+        double NumberValue = 0;
+        bool BooleanValue = false;
+        //UTF-8, not null terminated - string and XML document values, property names and the class name of a typed object.
+        //For AvmPlus tokens, the undecoded AMF3 value
+        const char* StringData = nullptr;
+        unsigned int StringLength = 0U;
+        //element count declared by an ECMA or strict array
+        unsigned int Count = 0U;
+        //dates - milliseconds since the epoch are in NumberValue
+        short TimeZone = 0;
+        //references - index into the complex values (objects and arrays) read so far
+        unsigned short ReferenceIndex = 0;
+
+        bool StringEquals(const char* str) const
+        {
+          auto len = strlen(str);
+          return len == StringLength && (len == 0 || memcmp(StringData, str, len) == 0);
+        }
+
+        std::string ToString() const
+        {
+          return std::string(StringData != nullptr ? StringData : "", StringLength);
+        }
+      };
+
+      ///<summary>Pull parser over an AMF0 payload. Each call to Next yields one token without allocating - objects, typed objects and ECMA arrays come out as
+      ///ObjectBegin, PropertyName/value pairs and ObjectEnd, strict arrays as ArrayBegin, the elements and ArrayEnd.
+      ///Truncated or malformed input, and nesting deeper than the depth limit, stop the reader and mark it as failed</summary>
+      class AMF0Reader
+      {
+      public:
+        static const unsigned int MAXDEPTH = 32;
+
+        AMF0Reader() : _br(nullptr, 0)
+        {
+
+        }
+
+        AMF0Reader(const BYTE* data, unsigned int len, unsigned int maxDepth = MAXDEPTH) : _br(data, len), _maxDepth(maxDepth < MAXDEPTH ? maxDepth : MAXDEPTH)
+        {
+
+        }
+
+        ///<summary>Reads the next token</summary>
+        ///<returns>false at the end of the payload or if the payload is truncated or malformed - check HasError to tell them apart</returns>
+        bool Next(AMF0Token& tok)
+        {
+          tok = AMF0Token();
+
+          if (_error != nullptr)
+            return false;
+
+          if (_depth == 0)
+          {
+            if (_br.GetRemaining() == 0)
+              return false;
+            return ReadValue(tok);
+          }
+
+          auto& top = _containers[_depth - 1];
+
+          if (top.Type == AMF0TokenType::ArrayBegin)
+          {
+            if (top.Remaining == 0)
+            {
+              _depth--;
+              tok.Type = AMF0TokenType::ArrayEnd;
+              tok.Marker = AMF0TypeMarker::StrictArray;
+              CompleteValue();
+              return true;
+            }
+            return ReadValue(tok);
+          }
+
+          if (top.HasName)
+            return ReadValue(tok);
+
+          //property name, or the empty name that precedes the object end marker
+          auto len = _br.get_u16be();
+          auto name = _br.get_bytes(len);
+          if (_br.IsTruncated())
+            return Fail("Parse Error : Truncated AMF0 payload");
+
+          if (len == 0)
+          {
+            auto marker = _br.get_u8();
+            if (_br.IsTruncated())
+              return Fail("Parse Error : Truncated AMF0 payload");
+            if (marker != AMF0TypeMarker::ObjectEnd)
+              return Fail("Parse Error : Missing object property name");
+
+            tok.Type = AMF0TokenType::ObjectEnd;
+            tok.Marker = top.Marker;
+            _depth--;
+            CompleteValue();
+            return true;
+          }
+
+          tok.Type = AMF0TokenType::PropertyName;
+          tok.StringData = (const char*) name;
+          tok.StringLength = len;
+          top.HasName = true;
+          return true;
+        }
+
+        ///<summary>Skips the rest of a value - call after Next returned tok. Scalars are already complete, containers are read up to their end token</summary>
+        bool Skip(const AMF0Token& tok)
+        {
+          if (tok.Type != AMF0TokenType::ObjectBegin && tok.Type != AMF0TokenType::ArrayBegin)
+            return _error == nullptr;
+
+          auto depth = _depth;
+          AMF0Token cur;
+          while (_depth >= depth)
+          {
+            if (!Next(cur))
+              return Fail("Parse Error : Truncated AMF0 payload");
+          }
+          return true;
+        }
+
+        bool HasError() const
+        {
+          return _error != nullptr;
+        }
+
+        ///<returns>Why the reader stopped, nullptr if it has not failed</returns>
+        const char* GetError() const
+        {
+          return _error;
+        }
+
+        ///<returns>Number of containers the last token is nested in</returns>
+        unsigned int GetDepth() const
+        {
+          return _depth;
+        }
+
+        unsigned int GetPosition() const
+        {
+          return _br.GetPosition();
+        }
+
+      private:
+
+        struct Container
+        {
+          BYTE Type;
+          BYTE Marker;
+          //object: a property name has been read and its value is next
+          bool HasName;
+          //strict array: elements left
+          unsigned int Remaining;
+        };
+
+        bool ReadValue(AMF0Token& tok)
+        {
+          if (_br.GetRemaining() == 0)
+            return Fail("Parse Error : Truncated AMF0 payload");
+
+          tok.Marker = _br.get_u8();
+
+          switch (tok.Marker)
+          {
+          case AMF0TypeMarker::Number:
+            tok.Type = AMF0TokenType::Number;
+            tok.NumberValue = _br.get_f64be();
+            break;
+          case AMF0TypeMarker::Boolean:
+            tok.Type = AMF0TokenType::Boolean;
+            tok.BooleanValue = _br.get_u8() != 0;
+            break;
+          case AMF0TypeMarker::String:
+          case AMF0TypeMarker::LongString:
+          {
+            auto len = tok.Marker == AMF0TypeMarker::String ? _br.get_u16be() : _br.get_u32be();
+            tok.Type = AMF0TokenType::String;
+            tok.StringData = (const char*) _br.get_bytes(len);
+            tok.StringLength = len;
+            break;
+          }
+          case AMF0TypeMarker::Null:
+            tok.Type = AMF0TokenType::Null;
+            break;
+          case AMF0TypeMarker::Undefined:
+            tok.Type = AMF0TokenType::Undefined;
+            break;
+          case AMF0TypeMarker::Object:
+            tok.Type = AMF0TokenType::ObjectBegin;
+            break;
+          case AMF0TypeMarker::TypedObject:
+          {
+            auto len = _br.get_u16be();
+            tok.Type = AMF0TokenType::ObjectBegin;
+            tok.StringData = (const char*) _br.get_bytes(len);
+            tok.StringLength = len;
+            break;
+          }
+          case AMF0TypeMarker::EcmaArray:
+            //the count is advisory - the entries run up to the object end marker like an object's
+            tok.Type = AMF0TokenType::ObjectBegin;
+            tok.Count = _br.get_u32be();
+            break;
+          case AMF0TypeMarker::StrictArray:
+            tok.Type = AMF0TokenType::ArrayBegin;
+            tok.Count = _br.get_u32be();
+            break;
+          case AMF0TypeMarker::Date:
+            tok.Type = AMF0TokenType::Date;
+            tok.NumberValue = _br.get_f64be();
+            tok.TimeZone = (short) _br.get_u16be();
+            break;
+          case AMF0TypeMarker::Reference:
+            tok.Type = AMF0TokenType::Reference;
+            tok.ReferenceIndex = _br.get_u16be();
+            break;
+          case AMF0TypeMarker::XmlDocument:
+          {
+            auto len = _br.get_u32be();
+            tok.Type = AMF0TokenType::XmlDocument;
+            tok.StringData = (const char*) _br.get_bytes(len);
+            tok.StringLength = len;
+            break;
+          }
+          case AMF0TypeMarker::Unsupported:
+            tok.Type = AMF0TokenType::Unsupported;
+            break;
+          case AMF0TypeMarker::AvmPlus:
+          {
+            //handed out undecoded - AMF3Reader builds the value if anyone needs it
+            auto amf3 = _br.get_bytes(0);
+            AMF3Reader reader(amf3, _br.GetRemaining());
+            if (!reader.Skip())
+              return Fail("Parse Error : Malformed AMF3 value");
+            tok.Type = AMF0TokenType::AvmPlus;
+            tok.StringData = (const char*) amf3;
+            tok.StringLength = reader.GetPosition();
+            _br.skip(tok.StringLength);
+            break;
+          }
+          default:
+            //MovieClip and Recordset are reserved, anything past TypedObject is not AMF0
+            return Fail("Parse Error : Unsupported AMF0 type marker");
+          }
+
+          if (_br.IsTruncated())
+            return Fail("Parse Error : Truncated AMF0 payload");
+
+          if (tok.Type == AMF0TokenType::ObjectBegin || tok.Type == AMF0TokenType::ArrayBegin)
+          {
+            if (_depth == _maxDepth)
+              return Fail("Parse Error : AMF0 payload nested too deeply");
+
+            _containers[_depth].Type = tok.Type;
+            _containers[_depth].Marker = tok.Marker;
+            _containers[_depth].HasName = false;
+            _containers[_depth].Remaining = tok.Count;
+            _depth++;
+          }
+          else
+          {
+            CompleteValue();
+          }
+
+          return true;
+        }
+
+        //a value (scalar or whole container) finished - advance the enclosing container
+        void CompleteValue()
+        {
+          if (_depth == 0)
+            return;
+
+          auto& top = _containers[_depth - 1];
+          if (top.Type == AMF0TokenType::ArrayBegin)
+            top.Remaining--;
+          else
+            top.HasName = false;
+        }
+
+        bool Fail(const char* error)
+        {
+          if (_error == nullptr)
+            _error = error;
+          return false;
+        }
+
+        ByteReader _br;
+        Container _containers[MAXDEPTH];
+        unsigned int _depth = 0U;
+        unsigned int _maxDepth = MAXDEPTH;
+        const char* _error = nullptr;
+      };
+    }
+  }
+}
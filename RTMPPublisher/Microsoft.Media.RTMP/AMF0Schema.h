@@ -0,0 +1,217 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+#include <tuple>
+#include <utility>
+#include "ProtocolConstants.h"
+#include "ByteWriter.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>A run of AMF0 bytes built at compile time</summary>
+      template<size_t N>
+      struct AMF0Literal
+      {
+        BYTE Bytes[N];
+      };
+
+      ///<summary>Maps an AMF0 property to a struct member - only written when the groups it belongs to are asked for</summary>
+      template<typename TStruct, typename TMember, size_t N>
+      struct AMF0SchemaField
+      {
+        //length prefixed property name
+        AMF0Literal<N + 1> Key;
+        TMember TStruct::* Member;
+        unsigned int Groups;
+      };
+
+      ///<summary>Compile time AMF0 serialization of plain structs. A struct describes itself with a static GetSchema() that returns a tuple of fields :
+      ///  static auto GetSchema() { return std::make_tuple(AMF0Schema::Field("width", &Metadata::Width), ...); }
+      ///Property names are length prefixed at compile time, so encoding a struct is a copy per name plus the value encodes</summary>
+      class AMF0Schema
+      {
+      public:
+        static const unsigned int ALLGROUPS = 0xFFFFFFFF;
+
+        ///<param name='name'>Property name</param>
+        ///<param name='member'>Member that holds the value - double, int, unsigned int, bool or a UTF-8 std::string</param>
+        ///<param name='groups'>Groups the field belongs to</param>
+        template<typename TStruct, typename TMember, size_t N>
+        static constexpr AMF0SchemaField<TStruct, TMember, N> Field(const char(&name)[N], TMember TStruct::* member, unsigned int groups = ALLGROUPS)
+        {
+          static_assert(N - 1 <= 65535, "AMF0 property names cannot be longer than 65535 bytes");
+          return AMF0SchemaField<TStruct, TMember, N>{ MakeKey(name, std::make_index_sequence<N - 1>()), member, groups };
+        }
+
+        ///<returns>An AMF0 string value - the marker, the length and the UTF-8 bytes</returns>
+        template<size_t N>
+        static constexpr AMF0Literal<N + 2> StringValue(const char(&str)[N])
+        {
+          static_assert(N - 1 <= 65535, "Use a long string for values longer than 65535 bytes");
+          return MakeStringValue(str, std::make_index_sequence<N - 1>());
+        }
+
+        ///<returns>Number of bytes the struct takes as an AMF0 object</returns>
+        ///<param name='groups'>Only fields in one of these groups are counted</param>
+        template<typename TStruct>
+        static unsigned int GetEncodedLength(const TStruct& val, unsigned int groups = ALLGROUPS)
+        {
+          unsigned int len = 4; //object marker, empty name and object end marker
+          ForEachField(GetFields<TStruct>(), [&val, groups, &len](const auto& field)
+          {
+            if ((field.Groups & groups) != 0)
+              len += (unsigned int) sizeof(field.Key.Bytes) + GetValueLength(val.*(field.Member));
+          });
+          return len;
+        }
+
+        ///<summary>Writes the struct as an AMF0 object - the writer needs GetEncodedLength() bytes of room</summary>
+        ///<param name='groups'>Only fields in one of these groups are written</param>
+        template<typename TStruct>
+        static void Encode(const TStruct& val, ByteWriter& bw, unsigned int groups = ALLGROUPS)
+        {
+          bw.put_u8(AMF0TypeMarker::Object);
+          ForEachField(GetFields<TStruct>(), [&val, groups, &bw](const auto& field)
+          {
+            if ((field.Groups & groups) != 0)
+            {
+              bw.put_bytes(field.Key.Bytes, (unsigned int) sizeof(field.Key.Bytes));
+              EncodeValue(val.*(field.Member), bw);
+            }
+          });
+          bw.put_u16be(0);
+          bw.put_u8(AMF0TypeMarker::ObjectEnd);
+        }
+
+      private:
+        template<typename TStruct>
+        static const decltype(TStruct::GetSchema())& GetFields()
+        {
+          static const auto fields = TStruct::GetSchema();
+          return fields;
+        }
+
+        template<typename TTuple, typename TFunc, size_t... I>
+        static void ForEachField(const TTuple& fields, TFunc&& func, std::index_sequence<I...>)
+        {
+          int expand[] = { 0, (func(std::get<I>(fields)), 0)... };
+          (void) expand;
+        }
+
+        template<typename TTuple, typename TFunc>
+        static void ForEachField(const TTuple& fields, TFunc&& func)
+        {
+          ForEachField(fields, func, std::make_index_sequence<std::tuple_size<TTuple>::value>());
+        }
+
+        template<size_t N, size_t... I>
+        static constexpr AMF0Literal<N + 1> MakeKey(const char(&name)[N], std::index_sequence<I...>)
+        {
+          return AMF0Literal<N + 1>{ { (BYTE) ((N - 1) >> 8), (BYTE) ((N - 1) & 0xFF), (BYTE) name[I]... } };
+        }
+
+        template<size_t N, size_t... I>
+        static constexpr AMF0Literal<N + 2> MakeStringValue(const char(&str)[N], std::index_sequence<I...>)
+        {
+          return AMF0Literal<N + 2>{ { (BYTE) AMF0TypeMarker::String, (BYTE) ((N - 1) >> 8), (BYTE) ((N - 1) & 0xFF), (BYTE) str[I]... } };
+        }
+
+        static unsigned int GetValueLength(double)
+        {
+          return 9;
+        }
+
+        static unsigned int GetValueLength(int)
+        {
+          return 9;
+        }
+
+        static unsigned int GetValueLength(unsigned int)
+        {
+          return 9;
+        }
+
+        static unsigned int GetValueLength(bool)
+        {
+          return 2;
+        }
+
+        static unsigned int GetValueLength(const std::string& val)
+        {
+          return (val.size() <= 65535 ? 3 : 5) + (unsigned int) val.size();
+        }
+
+        static void EncodeValue(double val, ByteWriter& bw)
+        {
+          bw.put_u8(AMF0TypeMarker::Number);
+          bw.put_f64be(val);
+        }
+
+        static void EncodeValue(int val, ByteWriter& bw)
+        {
+          EncodeValue((double) val, bw);
+        }
+
+        static void EncodeValue(unsigned int val, ByteWriter& bw)
+        {
+          EncodeValue((double) val, bw);
+        }
+
+        static void EncodeValue(bool val, ByteWriter& bw)
+        {
+          bw.put_u8(AMF0TypeMarker::Boolean);
+          bw.put_u8(val ? 1 : 0);
+        }
+
+        static void EncodeValue(const std::string& val, ByteWriter& bw)
+        {
+          if (val.size() <= 65535)
+          {
+            bw.put_u8(AMF0TypeMarker::String);
+            bw.put_u16be((unsigned short) val.size());
+          }
+          else
+          {
+            bw.put_u8(AMF0TypeMarker::LongString);
+            bw.put_u32be((unsigned int) val.size());
+          }
+          bw.put_bytes((const BYTE*) val.data(), (unsigned int) val.size());
+        }
+      };
+    }
+  }
+}
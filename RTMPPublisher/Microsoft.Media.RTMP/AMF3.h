@@ -0,0 +1,842 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <unordered_map>
+#include <stdexcept>
+#include "ProtocolConstants.h"
+#include "ByteReader.h"
+#include "ByteWriter.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      class AMF3Entity
+      {
+      public:
+
+        typedef std::vector<tuple<string, shared_ptr<AMF3Entity>>> PropertyList;
+
+        static const int MININTEGER = -(1 << 28);
+        static const int MAXINTEGER = (1 << 28) - 1;
+
+        ///<param name='type'>AMF3TypeMarker::Undefined or AMF3TypeMarker::Null</param>
+        AMF3Entity(BYTE type) : _type(type)
+        {
+
+        }
+
+        AMF3Entity(bool booleanValue) : _type(booleanValue ? AMF3TypeMarker::True : AMF3TypeMarker::False)
+        {
+
+        }
+
+        ///<summary>Integers outside the 29 bit range AMF3 can carry are stored as doubles</summary>
+        AMF3Entity(int integerValue) : _type(AMF3TypeMarker::Integer), _integerValue(integerValue), _numberValue(integerValue)
+        {
+          if (integerValue < MININTEGER || integerValue > MAXINTEGER)
+            _type = AMF3TypeMarker::Double;
+        }
+
+        AMF3Entity(double numberValue) : _type(AMF3TypeMarker::Double), _numberValue(numberValue)
+        {
+
+        }
+
+        ///<param name='stringValue'>UTF-8 string</param>
+        AMF3Entity(string stringValue) : _type(AMF3TypeMarker::String), _stringValue(stringValue)
+        {
+
+        }
+
+        ///<param name='dateValue'>Milliseconds since the epoch (UTC)</param>
+        static shared_ptr<AMF3Entity> CreateDate(double dateValue)
+        {
+          auto retval = make_shared<AMF3Entity>((BYTE) AMF3TypeMarker::Date);
+          retval->_numberValue = dateValue;
+          return retval;
+        }
+
+        ///<param name='type'>AMF3TypeMarker::Xml (E4X) or AMF3TypeMarker::XmlDocument (legacy XMLDocument)</param>
+        ///<param name='xml'>UTF-8 XML text</param>
+        static shared_ptr<AMF3Entity> CreateXml(BYTE type, string xml)
+        {
+          auto retval = make_shared<AMF3Entity>(type);
+          retval->_stringValue = xml;
+          return retval;
+        }
+
+        static shared_ptr<AMF3Entity> CreateByteArray(std::vector<BYTE> bytes)
+        {
+          auto retval = make_shared<AMF3Entity>((BYTE) AMF3TypeMarker::ByteArray);
+          retval->_bytes = std::move(bytes);
+          return retval;
+        }
+
+        ///<param name='dense'>Elements at index 0 to n-1</param>
+        ///<param name='associative'>Named elements, may be nullptr</param>
+        static shared_ptr<AMF3Entity> CreateArray(shared_ptr<std::vector<shared_ptr<AMF3Entity>>> dense, shared_ptr<PropertyList> associative = nullptr)
+        {
+          auto retval = make_shared<AMF3Entity>((BYTE) AMF3TypeMarker::Array);
+          retval->_elements = dense;
+          retval->_properties = associative;
+          return retval;
+        }
+
+        ///<param name='className'>UTF-8 class name, empty for an anonymous object</param>
+        ///<param name='properties'>Sealed members first, in trait order, then the dynamic members</param>
+        ///<param name='sealedMemberCount'>Number of leading properties that are sealed members of the class</param>
+        ///<param name='dynamic'>Whether members beyond the sealed ones are allowed</param>
+        static shared_ptr<AMF3Entity> CreateObject(string className, shared_ptr<PropertyList> properties, unsigned int sealedMemberCount = 0U, bool dynamic = true)
+        {
+          if (properties != nullptr && sealedMemberCount > properties->size())
+            throw invalid_argument("More sealed members than properties");
+          if (!dynamic && properties != nullptr && sealedMemberCount != properties->size())
+            throw invalid_argument("Sealed objects cannot have dynamic members");
+
+          auto retval = make_shared<AMF3Entity>((BYTE) AMF3TypeMarker::Object);
+          retval->_stringValue = className;
+          retval->_properties = properties;
+          retval->_sealedMemberCount = sealedMemberCount;
+          retval->_dynamic = dynamic;
+          return retval;
+        }
+
+        BYTE GetType()
+        {
+          return _type;
+        }
+
+        bool GetBooleanValue()
+        {
+          if (_type != AMF3TypeMarker::True && _type != AMF3TypeMarker::False) throw std::logic_error("Not a boolean");
+          return _type == AMF3TypeMarker::True;
+        }
+
+        int GetIntegerValue()
+        {
+          if (_type != AMF3TypeMarker::Integer) throw std::logic_error("Not an integer");
+          return _integerValue;
+        }
+
+        ///<returns>The value of an integer or a double</returns>
+        double GetNumberValue()
+        {
+          if (_type != AMF3TypeMarker::Integer && _type != AMF3TypeMarker::Double) throw std::logic_error("Not a number");
+          return _numberValue;
+        }
+
+        ///<returns>The UTF-8 string value</returns>
+        string GetStringValue()
+        {
+          if (_type != AMF3TypeMarker::String) throw std::logic_error("Not a string");
+          return _stringValue;
+        }
+
+        ///<returns>The UTF-8 XML text</returns>
+        string GetXmlValue()
+        {
+          if (_type != AMF3TypeMarker::Xml && _type != AMF3TypeMarker::XmlDocument) throw std::logic_error("Not XML");
+          return _stringValue;
+        }
+
+        double GetDateValue()
+        {
+          if (_type != AMF3TypeMarker::Date) throw std::logic_error("Not a date");
+          return _numberValue;
+        }
+
+        const std::vector<BYTE>& GetByteArray()
+        {
+          if (_type != AMF3TypeMarker::ByteArray) throw std::logic_error("Not a byte array");
+          return _bytes;
+        }
+
+        ///<summary>Dense part of an array</summary>
+        shared_ptr<std::vector<shared_ptr<AMF3Entity>>> GetElements()
+        {
+          if (_type != AMF3TypeMarker::Array) throw std::logic_error("Not an array");
+          if (_elements == nullptr)
+            _elements = make_shared<std::vector<shared_ptr<AMF3Entity>>>();
+          return _elements;
+        }
+
+        ///<summary>Members of an object, or the associative part of an array</summary>
+        shared_ptr<PropertyList> GetProperties()
+        {
+          if (_type != AMF3TypeMarker::Object && _type != AMF3TypeMarker::Array) throw std::logic_error("Not an object");
+          if (_properties == nullptr)
+            _properties = make_shared<PropertyList>();
+          return _properties;
+        }
+
+        string GetClassName()
+        {
+          if (_type != AMF3TypeMarker::Object) throw std::logic_error("Not an object");
+          return _stringValue;
+        }
+
+        unsigned int GetSealedMemberCount()
+        {
+          return _sealedMemberCount;
+        }
+
+        bool IsDynamic()
+        {
+          return _dynamic;
+        }
+
+      private:
+        friend class AMF3Reader;
+
+        BYTE _type = AMF3TypeMarker::Undefined;
+        int _integerValue = 0;
+        //doubles, integers and dates
+        double _numberValue = 0;
+        //string and XML values, class name of an object
+        string _stringValue;
+        std::vector<BYTE> _bytes;
+        shared_ptr<std::vector<shared_ptr<AMF3Entity>>> _elements = nullptr;
+        shared_ptr<PropertyList> _properties = nullptr;
+        unsigned int _sealedMemberCount = 0U;
+        bool _dynamic = true;
+      };
+
+      ///<summary>Encodes AMF3 values. Strings, objects and traits that repeat are written as references to their first occurrence -
+      ///the tables live as long as the writer, so use one writer per AMF3 context (one AMF0 AvmPlus value or one AMF3 message body)</summary>
+      class AMF3Writer
+      {
+      public:
+
+        AMF3Writer(shared_ptr<vector<BYTE>> bs) : _bs(bs)
+        {
+
+        }
+
+        ///<summary>Encodes a 29 bit unsigned integer in 1 to 4 bytes</summary>
+        static void EncodeU29(unsigned int val, vector<BYTE>& bs)
+        {
+          val &= 0x1FFFFFFF;
+          if (val < 0x80)
+          {
+            ByteWriter(bs, 1).put_u8((BYTE) val);
+          }
+          else if (val < 0x4000)
+          {
+            ByteWriter bw(bs, 2);
+            bw.put_u8((BYTE) ((val >> 7) | 0x80));
+            bw.put_u8((BYTE) (val & 0x7F));
+          }
+          else if (val < 0x200000)
+          {
+            ByteWriter bw(bs, 3);
+            bw.put_u8((BYTE) ((val >> 14) | 0x80));
+            bw.put_u8((BYTE) (((val >> 7) & 0x7F) | 0x80));
+            bw.put_u8((BYTE) (val & 0x7F));
+          }
+          else
+          {
+            ByteWriter bw(bs, 4);
+            bw.put_u8((BYTE) ((val >> 22) | 0x80));
+            bw.put_u8((BYTE) (((val >> 15) & 0x7F) | 0x80));
+            bw.put_u8((BYTE) (((val >> 8) & 0x7F) | 0x80));
+            bw.put_u8((BYTE) (val & 0xFF));
+          }
+        }
+
+        void Write(shared_ptr<AMF3Entity> entity)
+        {
+          auto type = entity->GetType();
+
+          switch (type)
+          {
+          case AMF3TypeMarker::Undefined:
+          case AMF3TypeMarker::Null:
+          case AMF3TypeMarker::False:
+          case AMF3TypeMarker::True:
+            ByteWriter(*_bs, 1).put_u8(type);
+            return;
+          case AMF3TypeMarker::Integer:
+            ByteWriter(*_bs, 1).put_u8(type);
+            EncodeU29((unsigned int) entity->GetIntegerValue(), *_bs);
+            return;
+          case AMF3TypeMarker::Double:
+          {
+            ByteWriter bw(*_bs, 9);
+            bw.put_u8(type);
+            bw.put_f64be(entity->GetNumberValue());
+            return;
+          }
+          case AMF3TypeMarker::String:
+            ByteWriter(*_bs, 1).put_u8(type);
+            WriteString(entity->GetStringValue());
+            return;
+          default:
+            break;
+          }
+
+          //everything else goes into the object table and can be sent by reference
+          ByteWriter(*_bs, 1).put_u8(type);
+          auto ref = _objects.find(entity.get());
+          if (ref != _objects.end())
+          {
+            EncodeU29(ref->second << 1, *_bs);
+            return;
+          }
+          _objects[entity.get()] = (unsigned int) _objects.size();
+
+          switch (type)
+          {
+          case AMF3TypeMarker::Date:
+          {
+            EncodeU29(1, *_bs);
+            ByteWriter(*_bs, 8).put_f64be(entity->GetDateValue());
+            break;
+          }
+          case AMF3TypeMarker::Xml:
+          case AMF3TypeMarker::XmlDocument:
+          {
+            auto xml = entity->GetXmlValue();
+            EncodeU29(((unsigned int) xml.size() << 1) | 1, *_bs);
+            ByteWriter(*_bs, (unsigned int) xml.size()).put_bytes((const BYTE*) xml.data(), (unsigned int) xml.size());
+            break;
+          }
+          case AMF3TypeMarker::ByteArray:
+          {
+            auto& bytes = entity->GetByteArray();
+            EncodeU29(((unsigned int) bytes.size() << 1) | 1, *_bs);
+            if (!bytes.empty())
+              ByteWriter(*_bs, (unsigned int) bytes.size()).put_bytes(&(*(bytes.begin())), (unsigned int) bytes.size());
+            break;
+          }
+          case AMF3TypeMarker::Array:
+          {
+            auto dense = entity->GetElements();
+            EncodeU29(((unsigned int) dense->size() << 1) | 1, *_bs);
+            for (auto& t : *(entity->GetProperties()))
+            {
+              WriteString(std::get<0>(t));
+              Write(std::get<1>(t));
+            }
+            WriteString("");
+            for (auto& element : *dense)
+              Write(element);
+            break;
+          }
+          case AMF3TypeMarker::Object:
+            WriteObject(entity);
+            break;
+          default:
+            //vectors and dictionaries are not supported
+            throw invalid_argument("Unsupported AMF3 type");
+          }
+        }
+
+      private:
+
+        ///<summary>UTF-8-vr - the empty string is never sent by reference</summary>
+        void WriteString(const string& str)
+        {
+          if (str.empty())
+          {
+            EncodeU29(1, *_bs);
+            return;
+          }
+
+          auto ref = _strings.find(str);
+          if (ref != _strings.end())
+          {
+            EncodeU29(ref->second << 1, *_bs);
+            return;
+          }
+          _strings[str] = (unsigned int) _strings.size();
+
+          EncodeU29(((unsigned int) str.size() << 1) | 1, *_bs);
+          ByteWriter(*_bs, (unsigned int) str.size()).put_bytes((const BYTE*) str.data(), (unsigned int) str.size());
+        }
+
+        void WriteObject(shared_ptr<AMF3Entity> entity)
+        {
+          auto properties = entity->GetProperties();
+          auto sealedCount = entity->GetSealedMemberCount();
+
+          //traits are identified by class name, dynamic flag and sealed member names
+          string key = entity->GetClassName();
+          key.push_back(entity->IsDynamic() ? '\x01' : '\x00');
+          for (unsigned int i = 0; i < sealedCount; i++)
+          {
+            key.push_back('\x00');
+            key.append(std::get<0>((*properties)[i]));
+          }
+
+          auto ref = _traits.find(key);
+          if (ref != _traits.end())
+          {
+            EncodeU29((ref->second << 2) | 1, *_bs);
+          }
+          else
+          {
+            _traits[key] = (unsigned int) _traits.size();
+            EncodeU29((sealedCount << 4) | (entity->IsDynamic() ? 0x08 : 0x00) | 0x03, *_bs);
+            WriteString(entity->GetClassName());
+            for (unsigned int i = 0; i < sealedCount; i++)
+              WriteString(std::get<0>((*properties)[i]));
+          }
+
+          for (unsigned int i = 0; i < sealedCount; i++)
+            Write(std::get<1>((*properties)[i]));
+
+          if (entity->IsDynamic())
+          {
+            for (auto i = sealedCount; i < properties->size(); i++)
+            {
+              WriteString(std::get<0>((*properties)[i]));
+              Write(std::get<1>((*properties)[i]));
+            }
+            WriteString("");
+          }
+        }
+
+        shared_ptr<vector<BYTE>> _bs;
+        std::unordered_map<string, unsigned int> _strings;
+        std::unordered_map<const AMF3Entity*, unsigned int> _objects;
+        std::unordered_map<string, unsigned int> _traits;
+      };
+
+      ///<summary>Decodes AMF3 values - string, object and trait references resolve against the values read earlier by the same reader.
+      ///Truncated or malformed input throws</summary>
+      class AMF3Reader
+      {
+      public:
+        static const unsigned int MAXDEPTH = 32;
+
+        AMF3Reader(const BYTE* data, unsigned int len, unsigned int maxDepth = MAXDEPTH) : _br(data, len), _maxDepth(maxDepth)
+        {
+
+        }
+
+        ///<summary>Decodes a 29 bit unsigned integer</summary>
+        static unsigned int DecodeU29(ByteReader& br)
+        {
+          unsigned int retval = 0;
+          for (int i = 0; i < 3; i++)
+          {
+            auto b = br.get_u8();
+            if ((b & 0x80) == 0)
+              return (retval << 7) | b;
+            retval = (retval << 7) | (b & 0x7F);
+          }
+          return (retval << 8) | br.get_u8();
+        }
+
+        shared_ptr<AMF3Entity> Read()
+        {
+          return ReadValue(0);
+        }
+
+        ///<summary>Read for values that came off the wire</summary>
+        ///<returns>nullptr if the value is truncated or malformed</returns>
+        shared_ptr<AMF3Entity> TryRead()
+        {
+          try
+          {
+            return Read();
+          }
+          catch (const std::logic_error&)
+          {
+            return nullptr;
+          }
+        }
+
+        bool HasMore() const
+        {
+          return _br.GetRemaining() > 0;
+        }
+
+        unsigned int GetPosition() const
+        {
+          return _br.GetPosition();
+        }
+
+        ///<summary>Steps over one value without building it - the reference tables are only counted, except for traits,
+        ///as the member count of a referenced trait is needed to find the end of an object</summary>
+        ///<returns>false for exactly the input Read throws on</returns>
+        bool Skip()
+        {
+          return SkipValue(0) && !_br.IsTruncated();
+        }
+
+      private:
+
+        struct Traits
+        {
+          string ClassName;
+          std::vector<string> SealedMemberNames;
+          bool Dynamic;
+        };
+
+        struct SkippedTraits
+        {
+          unsigned int SealedMemberCount;
+          bool Dynamic;
+        };
+
+        //U29 with the low bit set carries an inline value, otherwise a reference index
+        unsigned int ReadHeader(bool& isInline)
+        {
+          auto header = DecodeU29(_br);
+          CheckTruncated();
+          isInline = (header & 1) != 0;
+          return header >> 1;
+        }
+
+        string ReadString()
+        {
+          bool isInline = false;
+          auto val = ReadHeader(isInline);
+          if (!isInline)
+          {
+            if (val >= _strings.size())
+              throw std::logic_error("Parse Error : Invalid AMF3 string reference");
+            return _strings[val];
+          }
+
+          auto str = _br.get_bytes(val);
+          CheckTruncated();
+          string retval((const char*) str, val);
+          if (!retval.empty())
+            _strings.push_back(retval);
+          return retval;
+        }
+
+        shared_ptr<AMF3Entity> ReadValue(unsigned int depth)
+        {
+          if (depth > _maxDepth)
+            throw std::logic_error("Parse Error : AMF3 payload nested too deeply");
+
+          auto type = _br.get_u8();
+          CheckTruncated();
+
+          switch (type)
+          {
+          case AMF3TypeMarker::Undefined:
+          case AMF3TypeMarker::Null:
+          case AMF3TypeMarker::False:
+          case AMF3TypeMarker::True:
+            return make_shared<AMF3Entity>(type);
+          case AMF3TypeMarker::Integer:
+          {
+            auto val = DecodeU29(_br);
+            CheckTruncated();
+            //sign extend from 29 bits
+            return make_shared<AMF3Entity>((int) (val << 3) >> 3);
+          }
+          case AMF3TypeMarker::Double:
+          {
+            auto val = _br.get_f64be();
+            CheckTruncated();
+            return make_shared<AMF3Entity>(val);
+          }
+          case AMF3TypeMarker::String:
+            return make_shared<AMF3Entity>(ReadString());
+          default:
+            break;
+          }
+
+          bool isInline = false;
+          auto val = ReadHeader(isInline);
+          if (!isInline)
+          {
+            if (val >= _objects.size())
+              throw std::logic_error("Parse Error : Invalid AMF3 object reference");
+            if (_objects[val] == nullptr)
+              throw std::logic_error("Parse Error : Cyclic AMF3 object reference");
+            return _objects[val];
+          }
+
+          //claim the table slot before reading members so that references inside keep their numbering -
+          //the slot is filled in once the value is complete, a reference to it before then would be a cycle
+          auto slot = _objects.size();
+          _objects.push_back(nullptr);
+          shared_ptr<AMF3Entity> retval = nullptr;
+
+          switch (type)
+          {
+          case AMF3TypeMarker::Date:
+          {
+            auto date = _br.get_f64be();
+            CheckTruncated();
+            retval = AMF3Entity::CreateDate(date);
+            break;
+          }
+          case AMF3TypeMarker::Xml:
+          case AMF3TypeMarker::XmlDocument:
+          {
+            auto str = _br.get_bytes(val);
+            CheckTruncated();
+            retval = AMF3Entity::CreateXml(type, string((const char*) str, val));
+            break;
+          }
+          case AMF3TypeMarker::ByteArray:
+          {
+            auto bytes = _br.get_bytes(val);
+            CheckTruncated();
+            retval = AMF3Entity::CreateByteArray(std::vector<BYTE>(bytes, bytes + val));
+            break;
+          }
+          case AMF3TypeMarker::Array:
+          {
+            retval = AMF3Entity::CreateArray(make_shared<std::vector<shared_ptr<AMF3Entity>>>(), make_shared<AMF3Entity::PropertyList>());
+            while (true)
+            {
+              auto name = ReadString();
+              if (name.empty())
+                break;
+              retval->_properties->push_back(tuple<string, shared_ptr<AMF3Entity>>(name, ReadValue(depth + 1)));
+            }
+            //the count comes off the wire - do not trust it for a reservation
+            for (unsigned int i = 0; i < val; i++)
+              retval->_elements->push_back(ReadValue(depth + 1));
+            break;
+          }
+          case AMF3TypeMarker::Object:
+            retval = ReadObject(val, depth);
+            break;
+          default:
+            throw std::logic_error("Parse Error : Unsupported AMF3 type marker");
+          }
+
+          _objects[slot] = retval;
+          return retval;
+        }
+
+        ///<param name='header'>U29O with the inline object bit already removed</param>
+        shared_ptr<AMF3Entity> ReadObject(unsigned int header, unsigned int depth)
+        {
+          unsigned int traitsIndex = 0;
+          if ((header & 1) == 0)
+          {
+            traitsIndex = header >> 1;
+            if (traitsIndex >= _traits.size())
+              throw std::logic_error("Parse Error : Invalid AMF3 traits reference");
+          }
+          else
+          {
+            if ((header & 2) != 0)
+              throw std::logic_error("Parse Error : Externalizable AMF3 objects are not supported");
+
+            Traits traits;
+            traits.Dynamic = (header & 4) != 0;
+            auto sealedCount = header >> 3;
+            traits.ClassName = ReadString();
+            for (unsigned int i = 0; i < sealedCount; i++)
+              traits.SealedMemberNames.push_back(ReadString());
+            traitsIndex = (unsigned int) _traits.size();
+            _traits.push_back(traits);
+          }
+
+          auto properties = make_shared<AMF3Entity::PropertyList>();
+          //_traits may grow while members are read - copy what we need out of it first
+          auto className = _traits[traitsIndex].ClassName;
+          auto sealedNames = _traits[traitsIndex].SealedMemberNames;
+          auto dynamic = _traits[traitsIndex].Dynamic;
+
+          for (auto& name : sealedNames)
+            properties->push_back(tuple<string, shared_ptr<AMF3Entity>>(name, ReadValue(depth + 1)));
+
+          if (dynamic)
+          {
+            while (true)
+            {
+              auto name = ReadString();
+              if (name.empty())
+                break;
+              properties->push_back(tuple<string, shared_ptr<AMF3Entity>>(name, ReadValue(depth + 1)));
+            }
+          }
+
+          return AMF3Entity::CreateObject(className, properties, (unsigned int) sealedNames.size(), dynamic);
+        }
+
+        bool SkipString()
+        {
+          auto header = DecodeU29(_br);
+          if (_br.IsTruncated())
+            return false;
+          if ((header & 1) == 0)
+            return (header >> 1) < _skipStringCount;
+          if (!_br.skip(header >> 1))
+            return false;
+          if ((header >> 1) > 0)
+            _skipStringCount++;
+          return true;
+        }
+
+        bool SkipValue(unsigned int depth)
+        {
+          if (depth > _maxDepth)
+            return false;
+
+          auto type = _br.get_u8();
+          switch (type)
+          {
+          case AMF3TypeMarker::Undefined:
+          case AMF3TypeMarker::Null:
+          case AMF3TypeMarker::False:
+          case AMF3TypeMarker::True:
+            return !_br.IsTruncated();
+          case AMF3TypeMarker::Integer:
+            DecodeU29(_br);
+            return !_br.IsTruncated();
+          case AMF3TypeMarker::Double:
+            return _br.skip(8);
+          case AMF3TypeMarker::String:
+            return SkipString();
+          default:
+            break;
+          }
+
+          auto header = DecodeU29(_br);
+          if (_br.IsTruncated())
+            return false;
+          if ((header & 1) == 0)
+            return (header >> 1) < _skipObjects.size() && _skipObjects[header >> 1];
+
+          //same slot numbering as ReadValue - a reference to a slot that is not complete yet is a cycle
+          auto slot = _skipObjects.size();
+          _skipObjects.push_back(false);
+          if (!SkipInlineValue(type, header >> 1, depth))
+            return false;
+          _skipObjects[slot] = true;
+          return true;
+        }
+
+        bool SkipInlineValue(BYTE type, unsigned int val, unsigned int depth)
+        {
+          switch (type)
+          {
+          case AMF3TypeMarker::Date:
+            return _br.skip(8);
+          case AMF3TypeMarker::Xml:
+          case AMF3TypeMarker::XmlDocument:
+          case AMF3TypeMarker::ByteArray:
+            return _br.skip(val);
+          case AMF3TypeMarker::Array:
+          {
+            while (!_br.IsTruncated() && _br.peek_u8() != 0x01)
+            {
+              if (!SkipString() || !SkipValue(depth + 1))
+                return false;
+            }
+            if (!_br.skip(1))
+              return false;
+            for (unsigned int i = 0; i < val; i++)
+            {
+              if (!SkipValue(depth + 1))
+                return false;
+            }
+            return true;
+          }
+          case AMF3TypeMarker::Object:
+          {
+            unsigned int sealedCount = 0;
+            bool dynamic = false;
+            if ((val & 1) == 0)
+            {
+              if ((val >> 1) >= _skipTraits.size())
+                return false;
+              sealedCount = _skipTraits[val >> 1].SealedMemberCount;
+              dynamic = _skipTraits[val >> 1].Dynamic;
+            }
+            else
+            {
+              if ((val & 2) != 0)
+                return false;
+              dynamic = (val & 4) != 0;
+              sealedCount = val >> 3;
+              if (!SkipString())
+                return false;
+              //names are not needed, only how many there are
+              for (unsigned int i = 0; i < sealedCount; i++)
+              {
+                if (!SkipString())
+                  return false;
+              }
+              SkippedTraits traits = { sealedCount, dynamic };
+              _skipTraits.push_back(traits);
+            }
+
+            for (unsigned int i = 0; i < sealedCount; i++)
+            {
+              if (!SkipValue(depth + 1))
+                return false;
+            }
+            if (dynamic)
+            {
+              while (!_br.IsTruncated() && _br.peek_u8() != 0x01)
+              {
+                if (!SkipString() || !SkipValue(depth + 1))
+                  return false;
+              }
+              return _br.skip(1);
+            }
+            return true;
+          }
+          default:
+            return false;
+          }
+        }
+
+        void CheckTruncated()
+        {
+          if (_br.IsTruncated())
+            throw std::logic_error("Parse Error : Truncated AMF3 payload");
+        }
+
+        ByteReader _br;
+        unsigned int _maxDepth = MAXDEPTH;
+        std::vector<string> _strings;
+        //null while the value in the slot is still being read
+        std::vector<shared_ptr<AMF3Entity>> _objects;
+        std::vector<Traits> _traits;
+        std::vector<SkippedTraits> _skipTraits;
+        unsigned int _skipStringCount = 0;
+        //false while the value in the slot is still being skipped
+        std::vector<bool> _skipObjects;
+      };
+    }
+  }
+}
@@ -25,11 +25,11 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
 
-#include "pch.h"
 #include <memory>
 #include <vector>
-#include <wtypes.h>
+#include "PlatformTypes.h"
 #include "BitOp.h"
+#include "ByteWriter.h"
 
 
 using namespace std;
@@ -186,6 +186,25 @@ namespace Microsoft
 
 
 
+        ///<returns>Number of bytes the NALU's take up in AVCC form - each one prefixed with a 4 byte length instead of a start code</returns>
+        static unsigned int GetAVCCLength(const std::vector<shared_ptr<NALUnit>>& nalus)
+        {
+          unsigned int size = 0;
+          for (auto& nalu : nalus)
+            size += 4 + nalu->GetLength();
+          return size;
+        }
+
+        ///<summary>Writes the NALU's in AVCC form - the writer needs GetAVCCLength bytes of room</summary>
+        static void WriteAVCC(const std::vector<shared_ptr<NALUnit>>& nalus, ByteWriter& bw)
+        {
+          for (auto& nalu : nalus)
+          {
+            bw.put_u32be(nalu->GetLength()); //add the length field as 4 bytes
+            bw.put_bytes(nalu->GetData(), nalu->GetLength());
+          }
+        }
+
         static bool FindNextMatchingBitSequence(unsigned int sequencevalue, unsigned short numbits, unsigned int startat, const BYTE *data, unsigned int size, unsigned int& MatchPos)
         {
           MatchPos = size;
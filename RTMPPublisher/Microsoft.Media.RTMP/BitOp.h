@@ -26,17 +26,18 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
 
-#include <wtypes.h>
+#include "PlatformTypes.h"
 #include <memory>
 #include <vector>
 #include <assert.h>
-#include <wrl.h>
-#include <robuffer.h>
-#include <Windows.Foundation.h>
-#include <windows.storage.streams.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <stdexcept>
+#include <cmath>
+#include <algorithm>
 
-using namespace Windows::Storage::Streams;
-using namespace Microsoft::WRL;
+using namespace std;
 
 namespace Microsoft
 {
@@ -50,170 +51,34 @@ namespace Microsoft
       {
       public:
 
-
-        ///<summary>Converts an integral type to a byte array and appends the result to the supplied byte array</summary>    
-        ///<param name='in'>value to convert</param>
-        ///<param name='bitstream'>byte array to append to</param>
-        ///<param name='networkByteOrder'>change to big-endian if set to true</param>
-        ///<param name='bitstream'>number of bytes to take from the converted value starting from least significant byte</param>
-
-        ///<returns>void</returns>
-        template<class T>
-        static void AddToBitstream(T in,
-          std::shared_ptr<std::vector<BYTE>> bitstream,
-          bool networkByteOrder = true,
-          unsigned int numbytes = 0)
-        {
-          if (bitstream == nullptr)
-            throw invalid_argument("Null pointer");
-
-          if (numbytes == 0 || numbytes > sizeof(T)) //clamp
-            numbytes = sizeof(T);
-
-
-
-          if (!networkByteOrder)
-          {
-            for (unsigned int i = 0; i < numbytes; i++)
-            {
-              bitstream->push_back(in & 0xFF);
-              in >>= 8;
-            }
-
-          }
-          else
-          {
-            vector<BYTE> temp;
-            for (unsigned int i = 0; i < numbytes; i++)
-            {
-              temp.push_back(in & 0xFF);
-              in >>= 8;
-            }
-
-            for (auto itr = rbegin(temp); itr != rend(temp); itr++)
-              bitstream->push_back(*itr);
-          }
-
-        }
-
-        template<class T>
-        static void AddToBitstream(T in,
-          std::vector<BYTE>& bitstream,
-          bool networkByteOrder = true,
-          unsigned int numbytes = 0)
-        {
-
-          if (numbytes == 0 || numbytes > sizeof(T)) //clamp
-            numbytes = sizeof(T);
-
-
-
-          if (!networkByteOrder)
-          {
-            for (unsigned int i = 0; i < numbytes; i++)
-            {
-              bitstream.push_back(in & 0xFF);
-              in >>= 8;
-            }
-
-          }
-          else
-          {
-            vector<BYTE> temp;
-            for (unsigned int i = 0; i < numbytes; i++)
-            {
-              temp.push_back(in & 0xFF);
-              in >>= 8;
-            }
-
-            for (auto itr = rbegin(temp); itr != rend(temp); itr++)
-              bitstream.push_back(*itr);
-          }
-
-        }
-
-
-        static void AddToBitstream(std::wstring in,
-          std::vector<BYTE>& bitstream)
+        ///<summary>Reverses the byte order of a value - compiles to a single bswap instruction</summary>
+        static unsigned short ByteSwap(unsigned short in)
         {
-          auto oldsize = bitstream.size();
-
-          auto buffsize = ::WideCharToMultiByte(CP_UTF8, 0, in.c_str(), -1, nullptr, 0, nullptr, nullptr);
-          std::vector<CHAR> buffer;
-          buffer.resize(buffsize);
-          ::WideCharToMultiByte(CP_UTF8, 0, in.c_str(), -1, &(*(buffer.begin())), buffsize, nullptr, nullptr);
-
-          bitstream.resize(oldsize + buffsize);
-
-
-          if (buffer[buffer.size() - 1] == '\0')
-          {
-            bitstream.resize(oldsize + buffsize - 1);
-            memcpy_s(&(*(bitstream.begin() + oldsize)), buffsize - 1, &(*(buffer.begin())), buffsize - 1); //we do not want the terminating null
-          }
-          else
-          {
-            bitstream.resize(oldsize + buffsize);
-            memcpy_s(&(*(bitstream.begin() + oldsize)), buffsize, &(*(buffer.begin())), buffsize);
-          }
-          return;
+#if defined(_MSC_VER)
+          return _byteswap_ushort(in);
+#else
+          return __builtin_bswap16(in);
+#endif
         }
 
-        static void AddToBitstream(std::wstring in,
-          std::shared_ptr<std::vector<BYTE>> bitstream)
+        static unsigned int ByteSwap(unsigned int in)
         {
-          if (bitstream == nullptr)
-            throw invalid_argument("Null pointer");
-          auto oldsize = bitstream->size();
-
-          auto buffsize = ::WideCharToMultiByte(CP_UTF8, 0, in.c_str(), -1, nullptr, 0, nullptr, nullptr);
-          std::vector<CHAR> buffer;
-          buffer.resize(buffsize);
-          ::WideCharToMultiByte(CP_UTF8, 0, in.c_str(), -1, &(*(buffer.begin())), buffsize, nullptr, nullptr);
-
-
-
-          if (buffer[buffer.size() - 1] == '\0')
-          {
-            bitstream->resize(oldsize + buffsize - 1);
-            memcpy_s(&(*(bitstream->begin() + oldsize)), buffsize - 1, &(*(buffer.begin())), buffsize - 1); //we do not want the terminating null
-          }
-          else
-          {
-            bitstream->resize(oldsize + buffsize);
-            memcpy_s(&(*(bitstream->begin() + oldsize)), buffsize, &(*(buffer.begin())), buffsize);
-          }
-          return;
+#if defined(_MSC_VER)
+          return _byteswap_ulong(in);
+#else
+          return __builtin_bswap32(in);
+#endif
         }
 
-        static wstring ToWideString(char* mbstr, unsigned int len)
+        static unsigned long long ByteSwap(unsigned long long in)
         {
-
-          /*  if (mbstr[len - 1] == '\0')
-            {*/
-          auto buffsize = ::MultiByteToWideChar(CP_UTF8, 0, mbstr, len, nullptr, 0);
-          std::vector<wchar_t> buffer;
-          buffer.resize(buffsize);
-          ::MultiByteToWideChar(CP_UTF8, 0, mbstr, len, &(*(buffer.begin())), buffsize);
-
-          return wstring(&(*(buffer.begin())), buffsize);
-          /*}
-          else
-          {
-            std::vector<char> terminated;
-            terminated.resize(len + 1,'\0');
-            memcpy_s(&(*(terminated.begin())), len, mbstr, len);
-
-            auto buffsize = ::MultiByteToWideChar(CP_UTF8, 0, &(*(terminated.begin())), terminated.size(), nullptr, 0);
-            std::vector<wchar_t> buffer;
-            buffer.resize(buffsize);
-            ::MultiByteToWideChar(CP_UTF8, 0, &(*(terminated.begin())), terminated.size(), &(*(buffer.begin())), buffsize);
-
-            return wstring(&(*(buffer.begin())), buffsize);
-          }*/
+#if defined(_MSC_VER)
+          return _byteswap_uint64(in);
+#else
+          return __builtin_bswap64(in);
+#endif
         }
 
-
         ///<summary>Converts a byte array to a specific integral type T</summary>    
         ///<param name='data'>Byte array</param>
         ///<param name='size'>array length</param>
@@ -294,192 +159,21 @@ namespace Microsoft
           }
         }
 
-        static std::vector<BYTE> BufferToVector(IBuffer^ buffer)
-        {
-          ComPtr<IBufferByteAccess> cpbufferbytes;
-          std::vector<BYTE> retvec;
-
-          if (buffer->Length == 0)
-            return retvec;
-          if (SUCCEEDED(reinterpret_cast<IInspectable*>(buffer)->QueryInterface(IID_PPV_ARGS(&cpbufferbytes))))
-          {
-
-            retvec.resize(buffer->Length);
-            BYTE* tmpbuff = nullptr;
-            cpbufferbytes->Buffer(&tmpbuff);
-            memcpy_s(&(*(retvec.begin())), buffer->Length, tmpbuff, buffer->Length);
-
-            cpbufferbytes.Reset();
-          }
-
-          return retvec;
-        }
-
-        static IBuffer^ VectorToBuffer(const std::vector<BYTE>& vec)
-        {
-
-          Buffer^ retbuff = ref new Buffer((unsigned int) vec.size());
-          ComPtr<IBufferByteAccess> cpbufferbytes;
-
-          if (SUCCEEDED(reinterpret_cast<IInspectable*>(retbuff)->QueryInterface(IID_PPV_ARGS(&cpbufferbytes))))
-          {
-            BYTE* tmpbuff = nullptr;
-            cpbufferbytes->Buffer(&tmpbuff);
-            memcpy_s(tmpbuff, vec.size(), &(*(vec.begin())), vec.size());
-
-            cpbufferbytes.Reset();
-          }
-
-          return retbuff;
-        }
-
-
+        ///<summary>Returns the IEEE-754 binary64 representation of a double (the AMF0 number encoding) - exact for every value including NaN, infinities and subnormals</summary>
         static unsigned long long FromDoubleToFPRep(double a)
         {
-
-          if (a == 0)
-            return 0;
-
-          int whole = (int) trunc(abs(a));
-          double fraction = abs(a) - whole;
-          std::vector<BYTE> bin;
-
-          while (whole != 0 && whole != 1)
-          {
-            bin.push_back(whole % 2);
-            whole >>= 1;
-          }
-          bin.push_back(whole);
-          std::reverse(bin.begin(), bin.end());
-          while (bin.size() > 0 && bin.front() != 1)
-            bin.erase(bin.begin()); //move to 1
-
-          int wholedigits = (int) bin.size();
-
-          double tmp = fraction * 2;
-
-          while (trunc(tmp) != tmp)
-          {
-            bin.push_back((BYTE) trunc(tmp));
-            if (bin.size() == 53) break;
-            tmp -= trunc(tmp);
-            tmp *= 2;
-          }
-
-          if (bin.size() < 53) bin.push_back((BYTE) trunc(tmp));
-
-          unsigned long long exponent = 0;
-          if (wholedigits > 0)
-          {
-            exponent = 1023 + wholedigits - 1;
-            bin.erase(bin.begin()); //erase 1
-          }
-          else
-          {
-            int ctr = 0;
-            while (bin.front() == 0)
-            {
-              bin.erase(bin.begin());
-              ctr++;
-            }
-            bin.erase(bin.begin()); //erase 1
-            exponent = 1023 - (ctr + 1);
-          }
-
-
-
-
-          //add zeros to make mantissa 52 bits
-          while (bin.size() < 52)
-            bin.push_back(0);
-
-          unsigned long long mantissa = 0;
-          int pos = 0;
-          for (auto itr = bin.rbegin(); itr != bin.rend(); itr++, pos++)
-            mantissa += (*itr) * (unsigned long long)pow(2, pos);
-
+          static_assert(sizeof(double) == sizeof(unsigned long long), "double must be IEEE-754 binary64");
           unsigned long long rep = 0;
-          rep |= mantissa;
-          exponent <<= 52;
-          rep |= exponent;
-
-
-          if (a < 0)
-          {
-            unsigned long long sign = 1;
-            sign <<= 63;
-            rep |= sign;
-          }
-
+          memcpy(&rep, &a, sizeof(rep));
           return rep;
         }
 
-
-
-
+        ///<summary>Returns the double for an IEEE-754 binary64 representation</summary>
         static double FromFPRepToDouble(unsigned long long b)
         {
-
-          if (b == 0)
-            return 0;
-
-          double wholepart = 0;
-          double fracpart = 0;
-
-          BYTE sign = (BYTE) BitOp::ExtractBits<unsigned long long>(b, 0, 1);
-          int exponent = (int) BitOp::ExtractBits<unsigned long long>(b, 1, 11) - 1023;
-
-          unsigned long long mantissa = BitOp::ExtractBits<unsigned long long>(b, 12, 52);
-
-          std::vector<BYTE> bin;
-          //mantissa to binary
-          while (bin.size() < 52)
-          {
-            bin.push_back(mantissa % 2);
-            mantissa >>= 1;
-          }
-
-
-
-          if (exponent >= 0)
-          {
-
-            bin.push_back(1);
-            std::reverse(bin.begin(), bin.end());
-
-
-            for (int i = exponent; i >= 0; i--)
-              wholepart += bin[i] * pow(2, exponent - i);
-
-            auto size = (int) bin.size();
-
-            for (int j = size - 1; j != exponent; j--)
-            {
-              fracpart += bin[j];
-              fracpart /= 2;
-            }
-          }
-          else if (exponent < 0)
-          {
-            bin.push_back(1);
-
-            for (int i = 0; i < abs(exponent) - 1; i++)
-              bin.push_back(0);
-
-            std::reverse(bin.begin(), bin.end());
-
-            auto size = (int) bin.size();
-
-            for (int j = size - 1; j >= 0; j--)
-            {
-              fracpart += bin[j];
-              fracpart /= 2;
-            }
-
-
-          }
-
-          return sign == 1 ? -1 * (wholepart + fracpart) : wholepart + fracpart;
+          double val = 0;
+          memcpy(&val, &b, sizeof(val));
+          return val;
         }
 
       };
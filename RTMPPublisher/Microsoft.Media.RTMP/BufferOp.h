@@ -0,0 +1,147 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+#pragma once
+
+#include <wtypes.h>
+#include <vector>
+#include <wrl.h>
+#include <robuffer.h>
+#include <Windows.Foundation.h>
+#include <windows.storage.streams.h>
+
+using namespace Windows::Storage::Streams;
+using namespace Microsoft::WRL;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+
+      ///<summary>Conversions between WinRT buffers and byte vectors - kept apart from BitOp so that the protocol headers do not depend on WinRT</summary>
+      class BufferOp
+      {
+      public:
+
+        static std::vector<BYTE> BufferToVector(IBuffer^ buffer)
+        {
+          ComPtr<IBufferByteAccess> cpbufferbytes;
+          std::vector<BYTE> retvec;
+
+          if (buffer->Length == 0)
+            return retvec;
+          if (SUCCEEDED(reinterpret_cast<IInspectable*>(buffer)->QueryInterface(IID_PPV_ARGS(&cpbufferbytes))))
+          {
+
+            retvec.resize(buffer->Length);
+            BYTE* tmpbuff = nullptr;
+            cpbufferbytes->Buffer(&tmpbuff);
+            memcpy_s(&(*(retvec.begin())), buffer->Length, tmpbuff, buffer->Length);
+
+            cpbufferbytes.Reset();
+          }
+
+          return retvec;
+        }
+
+        static IBuffer^ VectorToBuffer(const std::vector<BYTE>& vec)
+        {
+
+          Buffer^ retbuff = ref new Buffer((unsigned int) vec.size());
+          ComPtr<IBufferByteAccess> cpbufferbytes;
+
+          if (SUCCEEDED(reinterpret_cast<IInspectable*>(retbuff)->QueryInterface(IID_PPV_ARGS(&cpbufferbytes))))
+          {
+            BYTE* tmpbuff = nullptr;
+            cpbufferbytes->Buffer(&tmpbuff);
+            memcpy_s(tmpbuff, vec.size(), &(*(vec.begin())), vec.size());
+
+            cpbufferbytes.Reset();
+          }
+
+          return retbuff;
+        }
+      };
+
+      ///<summary>IBuffer over memory owned by someone else - lets a stream write straight out of the send buffer without an intermediate copy.
+      ///The memory has to stay valid until the operation the buffer is passed to completes</summary>
+      class BufferView :
+        public RuntimeClass<RuntimeClassFlags<RuntimeClassType::WinRtClassicComMix>,
+        ABI::Windows::Storage::Streams::IBuffer,
+        IBufferByteAccess>
+      {
+        InspectableClass(L"Microsoft.Media.RTMP.BufferView", BaseTrust);
+
+      public:
+
+        void SetView(BYTE* data, UINT32 length)
+        {
+          _data = data;
+          _capacity = length;
+          _length = length;
+        }
+
+        IBuffer^ AsBuffer()
+        {
+          return reinterpret_cast<IBuffer^>(static_cast<ABI::Windows::Storage::Streams::IBuffer*>(this));
+        }
+
+        STDMETHODIMP get_Capacity(UINT32* value)
+        {
+          *value = _capacity;
+          return S_OK;
+        }
+
+        STDMETHODIMP get_Length(UINT32* value)
+        {
+          *value = _length;
+          return S_OK;
+        }
+
+        STDMETHODIMP put_Length(UINT32 value)
+        {
+          if (value > _capacity)
+            return E_INVALIDARG;
+          _length = value;
+          return S_OK;
+        }
+
+        STDMETHODIMP Buffer(BYTE** value)
+        {
+          *value = _data;
+          return S_OK;
+        }
+
+      private:
+        BYTE* _data = nullptr;
+        UINT32 _capacity = 0;
+        UINT32 _length = 0;
+      };
+
+    }
+  }
+}
@@ -0,0 +1,176 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string.h>
+#include "BitOp.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>Bounds checked cursor that reads fixed width fields from a byte span.
+      ///Integers are read with a single load (byte swapped for network byte order). Reading past the end of the span returns 0
+      ///and marks the reader as truncated - every read after that fails as well, so a run of reads can be checked once at the end</summary>
+      class ByteReader
+      {
+      public:
+
+        ByteReader(const BYTE* data, unsigned int len) : _begin(data), _cur(data), _end(data + len)
+        {
+
+        }
+
+        BYTE get_u8()
+        {
+          if (!Ensure(1))
+            return 0;
+          return *_cur++;
+        }
+
+        BYTE peek_u8()
+        {
+          if (_truncated || _cur >= _end)
+            return 0;
+          return *_cur;
+        }
+
+        unsigned short get_u16be()
+        {
+          return BitOp::ByteSwap(Load<unsigned short>());
+        }
+
+        unsigned short get_u16le()
+        {
+          return Load<unsigned short>();
+        }
+
+        unsigned int get_u24be()
+        {
+          if (!Ensure(3))
+            return 0;
+          unsigned short low = 0;
+          memcpy(&low, _cur + 1, sizeof(low));
+          unsigned int retval = ((unsigned int) _cur[0] << 16) | BitOp::ByteSwap(low);
+          _cur += 3;
+          return retval;
+        }
+
+        unsigned int get_u32be()
+        {
+          return BitOp::ByteSwap(Load<unsigned int>());
+        }
+
+        unsigned int get_u32le()
+        {
+          return Load<unsigned int>();
+        }
+
+        unsigned long long get_u64be()
+        {
+          return BitOp::ByteSwap(Load<unsigned long long>());
+        }
+
+        double get_f64be()
+        {
+          return BitOp::FromFPRepToDouble(get_u64be());
+        }
+
+        ///<summary>Consumes a run of bytes without copying them</summary>
+        ///<returns>Pointer to the bytes within the span, nullptr if fewer than len bytes are left</returns>
+        const BYTE* get_bytes(unsigned int len)
+        {
+          if (!Ensure(len))
+            return nullptr;
+          auto retval = _cur;
+          _cur += len;
+          return retval;
+        }
+
+        bool skip(unsigned int len)
+        {
+          if (!Ensure(len))
+            return false;
+          _cur += len;
+          return true;
+        }
+
+        ///<returns>true if a read ran past the end of the span</returns>
+        bool IsTruncated() const
+        {
+          return _truncated;
+        }
+
+        ///<returns>Number of bytes consumed so far</returns>
+        unsigned int GetPosition() const
+        {
+          return (unsigned int) (_cur - _begin);
+        }
+
+        unsigned int GetRemaining() const
+        {
+          return (unsigned int) (_end - _cur);
+        }
+
+      private:
+
+        bool Ensure(unsigned int len)
+        {
+          if (_truncated || (unsigned int) (_end - _cur) < len)
+          {
+            _truncated = true;
+            return false;
+          }
+          return true;
+        }
+
+        //host byte order is little endian on every platform we target
+        template<typename T>
+        T Load()
+        {
+          T val = 0;
+          if (!Ensure(sizeof(T)))
+            return val;
+          memcpy(&val, _cur, sizeof(T));
+          _cur += sizeof(T);
+          return val;
+        }
+
+        const BYTE* _begin = nullptr;
+        const BYTE* _cur = nullptr;
+        const BYTE* _end = nullptr;
+        bool _truncated = false;
+      };
+    }
+  }
+}
@@ -0,0 +1,167 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include <stdexcept>
+#include <string.h>
+#include "BitOp.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>Cursor that writes fixed width fields into a buffer sized up front.
+      ///Integers are written with a single store (byte swapped for network byte order). Every write is bounds checked - a writer over a byte array
+      ///grows the array when the size it was given runs out, a writer over a caller supplied buffer throws out_of_range</summary>
+      class ByteWriter
+      {
+      public:
+
+        ///<summary>Writes into a caller supplied buffer</summary>
+        ///<param name='data'>Buffer to write to</param>
+        ///<param name='len'>Size of the buffer - writing past it throws</param>
+        ByteWriter(BYTE* data, unsigned int len) : _begin(data), _cur(data), _end(data + len)
+        {
+
+        }
+
+        ///<summary>Appends to a byte array - the array grows by the supplied length once and the writes that follow fill in the new bytes</summary>
+        ///<param name='bitstream'>Byte array to append to</param>
+        ///<param name='len'>Number of bytes that will be written - writing more grows the array again</param>
+        ByteWriter(std::vector<BYTE>& bitstream, unsigned int len) : _bitstream(&bitstream)
+        {
+          auto oldsize = bitstream.size();
+          bitstream.resize(oldsize + len);
+          _begin = _cur = bitstream.data() + oldsize;
+          _end = _begin + len;
+        }
+
+        void put_u8(BYTE val)
+        {
+          Ensure(1);
+          *_cur++ = val;
+        }
+
+        void put_u16be(unsigned short val)
+        {
+          Store(BitOp::ByteSwap(val));
+        }
+
+        void put_u24be(unsigned int val)
+        {
+          Ensure(3);
+          _cur[0] = (BYTE) (val >> 16);
+          unsigned short low = BitOp::ByteSwap((unsigned short) val);
+          memcpy(_cur + 1, &low, sizeof(low));
+          _cur += 3;
+        }
+
+        void put_u32be(unsigned int val)
+        {
+          Store(BitOp::ByteSwap(val));
+        }
+
+        void put_u32le(unsigned int val)
+        {
+          Store(val);
+        }
+
+        void put_u64be(unsigned long long val)
+        {
+          Store(BitOp::ByteSwap(val));
+        }
+
+        void put_f64be(double val)
+        {
+          Store(BitOp::ByteSwap(BitOp::FromDoubleToFPRep(val)));
+        }
+
+        void put_bytes(const BYTE* data, unsigned int len)
+        {
+          Ensure(len);
+          if (len > 0)
+            memcpy(_cur, data, len);
+          _cur += len;
+        }
+
+        ///<returns>Number of bytes written so far</returns>
+        unsigned int GetPosition() const
+        {
+          return (unsigned int) (_cur - _begin);
+        }
+
+        unsigned int GetRemaining() const
+        {
+          return (unsigned int) (_end - _cur);
+        }
+
+      private:
+
+        //host byte order is little endian on every platform we target
+        template<typename T>
+        void Store(T val)
+        {
+          Ensure(sizeof(T));
+          memcpy(_cur, &val, sizeof(T));
+          _cur += sizeof(T);
+        }
+
+        void Ensure(size_t len)
+        {
+          if ((size_t) (_end - _cur) < len)
+            Overflow(len);
+        }
+
+        void Overflow(size_t len)
+        {
+          if (_bitstream == nullptr)
+            throw out_of_range("ByteWriter : write past the end of the buffer");
+
+          //resizing may move the array - keep the offsets and re-point the cursor
+          auto begin = _begin - _bitstream->data();
+          auto cur = _cur - _bitstream->data();
+          _bitstream->resize(cur + len);
+          _begin = _bitstream->data() + begin;
+          _cur = _bitstream->data() + cur;
+          _end = _bitstream->data() + _bitstream->size();
+        }
+
+        std::vector<BYTE>* _bitstream = nullptr;
+        BYTE* _begin = nullptr;
+        BYTE* _cur = nullptr;
+        BYTE* _end = nullptr;
+      };
+    }
+  }
+}
@@ -0,0 +1,368 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <climits>
+#include <algorithm>
+#include "RTMPMessageFormats.h"
+#include "RTMPChunking.h"
+#include "ByteWriter.h"
+#include "SendRingBuffer.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+
+      ///<summary>Queueing statistics for a single chunk stream. Delays are measured from Enqueue() until the last chunk of the message is handed to the writer</summary>
+      struct ChunkStreamQueueStatistics
+      {
+        unsigned int MessageCount = 0U;
+        unsigned long long TotalQueueingDelayMicroseconds = 0ULL;
+        unsigned long long MaxQueueingDelayMicroseconds = 0ULL;
+      };
+
+      ///<summary>Chunk level multiplexer for outbound chunk streams. Messages are queued per chunk stream and emitted one chunk at a time - the chunk stream
+      ///with the lowest priority value that has data pending always goes next, chunk streams sharing a priority are served weighted round robin (weight = number of
+      ///consecutive chunks per turn). This lets audio and control chunks preempt a long video message at chunk boundaries. With interleaving disabled
+      ///messages leave whole and in enqueue order, which is the behavior to compare against</summary>
+      class ChunkInterleaver
+      {
+      public:
+
+        static const unsigned int DEFAULTPRIORITY = 0U;
+        static const unsigned int DEFAULTWEIGHT = 1U;
+
+        ChunkInterleaver(unsigned int chunkSize, bool enableInterleaving = true) : _chunkSize(chunkSize), _enableInterleaving(enableInterleaving)
+        {
+
+        }
+
+        unsigned int GetChunkSize()
+        {
+          return _chunkSize;
+        }
+
+        ///<summary>Takes effect from the next message that has not started transmission - a message always goes out with the chunk size it started with</summary>
+        void SetChunkSize(unsigned int val)
+        {
+          _chunkSize = val;
+        }
+
+        ///<summary>Schedules a chunk size change that is sequenced against the chunks already on the wire : messages that have started transmission finish
+        ///at the current size, no new message starts until they have, then a Set Chunk Size message goes out on the protocol control chunk stream and every
+        ///later message uses the new size</summary>
+        void RequestChunkSize(unsigned int val)
+        {
+          _requestedChunkSize = val;
+        }
+
+        bool IsChunkSizeChangePending()
+        {
+          return _requestedChunkSize != 0 && _requestedChunkSize != _chunkSize;
+        }
+
+        bool IsInterleavingEnabled()
+        {
+          return _enableInterleaving;
+        }
+
+        ///<summary>Lower priority values are served first. Weight is the number of consecutive chunks a chunk stream may send before yielding to another chunk stream of the same priority
+        ///- the chunk stream starts over with a full turn at the new weight</summary>
+        void SetChunkStreamPriority(unsigned int chunkStreamID, unsigned int priority, unsigned int weight = DEFAULTWEIGHT)
+        {
+          auto& stream = GetChunkStream(chunkStreamID);
+          stream.Priority = priority;
+          stream.Weight = max(weight, 1U);
+          stream.Credits = stream.Weight;
+        }
+
+        void Enqueue(unsigned int chunkStreamID, shared_ptr<RTMPMessage> msg, shared_ptr<ChunkStreamHeaderState> headerState = nullptr)
+        {
+          PendingMessage pending;
+          pending.Message = msg;
+          pending.HeaderState = headerState;
+          pending.Sequence = _nextSequence++;
+          pending.EnqueuedAt = std::chrono::steady_clock::now();
+
+          GetChunkStream(chunkStreamID).Messages.push_back(pending);
+          _pendingMessageCount++;
+        }
+
+        ///<summary>True if there is nothing left to write</summary>
+        bool IsEmpty()
+        {
+          return _pendingMessageCount == 0 && !IsChunkSizeChangePending();
+        }
+
+        ///<summary>True if a message has been partially emitted (some but not all of its chunks have been dequeued)</summary>
+        bool IsMessageInProgress()
+        {
+          for (auto& itm : _chunkStreams)
+          {
+            if (!itm.second.Messages.empty() && itm.second.Messages.front().Offset > 0)
+              return true;
+          }
+          return false;
+        }
+
+        ///<summary>Serializes chunks in scheduling order into the send buffer until at least maxBytes have been written, the queues are empty or the send buffer is full</summary>
+        ///<returns>false if nothing was written</returns>
+        bool Dequeue(SendRingBuffer& sendBuffer, unsigned int maxBytes)
+        {
+          unsigned int added = 0;
+          while (added < maxBytes && !IsEmpty())
+          {
+            unsigned int written = 0;
+            if (IsChunkSizeChangePending() && !IsMessageInProgress())
+              written = EmitSetChunkSize(sendBuffer);
+            else
+            {
+              auto stream = SelectNextChunkStream();
+              written = EmitChunk(stream->first, stream->second, sendBuffer);
+            }
+
+            if (written == 0) //send buffer full
+            {
+              if (added == 0 && sendBuffer.IsEmpty())
+                throw std::logic_error("Send buffer is too small to hold a chunk");
+              break;
+            }
+            added += written;
+          }
+          return added > 0;
+        }
+
+        ///<summary>Worst case queueing delay (microseconds) across all messages sent so far on the chunk stream</summary>
+        unsigned long long GetMaxQueueingDelay(unsigned int chunkStreamID)
+        {
+          return GetStatistics(chunkStreamID).MaxQueueingDelayMicroseconds;
+        }
+
+        ChunkStreamQueueStatistics GetStatistics(unsigned int chunkStreamID)
+        {
+          auto itm = _chunkStreams.find(chunkStreamID);
+          return itm == _chunkStreams.end() ? ChunkStreamQueueStatistics() : itm->second.Statistics;
+        }
+
+        void ResetStatistics()
+        {
+          for (auto& itm : _chunkStreams)
+            itm.second.Statistics = ChunkStreamQueueStatistics();
+        }
+
+      private:
+
+        struct PendingMessage
+        {
+          shared_ptr<RTMPMessage> Message;
+          shared_ptr<ChunkStreamHeaderState> HeaderState;
+          unsigned long long Sequence = 0ULL;
+          std::chrono::steady_clock::time_point EnqueuedAt;
+          //state of a message that has started transmission
+          unsigned int Offset = 0U;
+          unsigned int ChunkSize = 0U;
+          unsigned int TimestampField = 0U;
+          //writer for the next chunk of the message
+          ChunkHeaderWriterFunc HeaderWriter = nullptr;
+        };
+
+        struct ChunkStream
+        {
+          unsigned int Priority = DEFAULTPRIORITY;
+          unsigned int Weight = DEFAULTWEIGHT;
+          unsigned int Credits = DEFAULTWEIGHT;
+          std::deque<PendingMessage> Messages;
+          ChunkStreamQueueStatistics Statistics;
+        };
+
+        typedef std::map<unsigned int, ChunkStream>::iterator ChunkStreamIterator;
+
+        ChunkStream& GetChunkStream(unsigned int chunkStreamID)
+        {
+          return _chunkStreams[chunkStreamID];
+        }
+
+        ChunkStreamIterator SelectNextChunkStream()
+        {
+          //a pending chunk size change only lets messages already on the wire continue
+          if (IsChunkSizeChangePending())
+          {
+            for (auto itm = _chunkStreams.begin(); itm != _chunkStreams.end(); itm++)
+            {
+              if (!itm->second.Messages.empty() && itm->second.Messages.front().Offset > 0)
+                return itm;
+            }
+          }
+
+          //a message already on the wire keeps going until done when interleaving is off, otherwise the oldest message goes next
+          if (!_enableInterleaving)
+          {
+            auto selected = _chunkStreams.end();
+            for (auto itm = _chunkStreams.begin(); itm != _chunkStreams.end(); itm++)
+            {
+              if (itm->second.Messages.empty())
+                continue;
+              if (itm->second.Messages.front().Offset > 0)
+                return itm;
+              if (selected == _chunkStreams.end() || itm->second.Messages.front().Sequence < selected->second.Messages.front().Sequence)
+                selected = itm;
+            }
+            return selected;
+          }
+
+          unsigned int topPriority = UINT_MAX;
+          for (auto& itm : _chunkStreams)
+          {
+            if (!itm.second.Messages.empty())
+              topPriority = min(topPriority, itm.second.Priority);
+          }
+
+          //round robin among the chunk streams at the top priority, starting after the last one served
+          for (int pass = 0; pass < 2; pass++)
+          {
+            auto start = _chunkStreams.upper_bound(_lastServedChunkStreamID);
+            for (size_t i = 0; i < _chunkStreams.size(); i++, start++)
+            {
+              if (start == _chunkStreams.end())
+                start = _chunkStreams.begin();
+              auto& stream = start->second;
+              if (stream.Priority == topPriority && !stream.Messages.empty() && stream.Credits > 0)
+                return start;
+            }
+
+            //every eligible chunk stream used up its turn - start a new round
+            for (auto& itm : _chunkStreams)
+            {
+              if (itm.second.Priority == topPriority)
+                itm.second.Credits = itm.second.Weight;
+            }
+          }
+
+          return _chunkStreams.end(); //unreachable while messages are pending
+        }
+
+        unsigned int EmitSetChunkSize(SendRingBuffer& sendBuffer)
+        {
+          BYTE* dst = sendBuffer.Reserve(ChunkMessage::MAXHEADERSIZE + 4);
+          if (dst == nullptr)
+            return 0;
+
+          unsigned int len = ChunkMessage::WriteHeader(dst,
+            RTMPChunkType::Type0,
+            ChunkStreamIDValue::PROTOCOLCONTROL,
+            0,
+            4,
+            RTMPMessageType::PROTOSETCHUNKSIZE,
+            0);
+          ByteWriter(dst + len, 4).put_u32be(_requestedChunkSize);
+          len += 4;
+          sendBuffer.Commit(len);
+
+          _chunkSize = _requestedChunkSize;
+          _requestedChunkSize = 0;
+          return len;
+        }
+
+        ///<returns>Number of bytes written, 0 if the send buffer cannot take the chunk (no state is changed in that case)</returns>
+        unsigned int EmitChunk(unsigned int chunkStreamID, ChunkStream& stream, SendRingBuffer& sendBuffer)
+        {
+          auto& pending = stream.Messages.front();
+          auto& msg = pending.Message;
+          unsigned int messagelen = msg->GetMessageLength();
+          unsigned int payloadlen = min(messagelen - pending.Offset, pending.Offset == 0 ? _chunkSize : pending.ChunkSize);
+
+          BYTE* dst = sendBuffer.Reserve(ChunkMessage::MAXHEADERSIZE + payloadlen);
+          if (dst == nullptr)
+            return 0;
+
+          if (pending.Offset == 0)
+          {
+            //header selection happens at first transmission so that it follows wire order on the chunk stream
+            pending.ChunkSize = _chunkSize;
+            pending.TimestampField = msg->GetTimestamp();
+            BYTE firstChunkType = msg->IsTimestampDelta() ? RTMPChunkType::Type1 : RTMPChunkType::Type0;
+            if (pending.HeaderState != nullptr)
+              firstChunkType = pending.HeaderState->SelectChunkType(msg, pending.TimestampField);
+            pending.HeaderWriter = SelectChunkHeaderWriter(firstChunkType, chunkStreamID, pending.TimestampField);
+          }
+
+          unsigned int len = pending.HeaderWriter(dst,
+            chunkStreamID,
+            pending.TimestampField,
+            messagelen,
+            msg->GetMessageTypeID(),
+            msg->GetMessageStreamID());
+          if (payloadlen > 0)
+            memcpy_s(dst + len, payloadlen, &(*(msg->GetPayload()->begin())) + pending.Offset, payloadlen);
+          len += payloadlen;
+          sendBuffer.Commit(len);
+
+          //continuation chunks repeat the timestamp field of the first chunk
+          if (pending.Offset == 0)
+            pending.HeaderWriter = SelectChunkHeaderWriter(RTMPChunkType::Type3, chunkStreamID, pending.TimestampField);
+          pending.Offset += payloadlen;
+
+          _lastServedChunkStreamID = chunkStreamID;
+          if (stream.Credits > 0)
+            stream.Credits--;
+
+          if (pending.Offset >= messagelen)
+          {
+            auto delay = (unsigned long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - pending.EnqueuedAt).count();
+            stream.Statistics.MessageCount++;
+            stream.Statistics.TotalQueueingDelayMicroseconds += delay;
+            stream.Statistics.MaxQueueingDelayMicroseconds = max(stream.Statistics.MaxQueueingDelayMicroseconds, delay);
+            stream.Messages.pop_front();
+            _pendingMessageCount--;
+          }
+
+          return len;
+        }
+
+        unsigned int _chunkSize;
+        unsigned int _requestedChunkSize = 0U;
+        bool _enableInterleaving;
+        unsigned long long _nextSequence = 0ULL;
+        size_t _pendingMessageCount = 0;
+        unsigned int _lastServedChunkStreamID = 0U;
+        std::map<unsigned int, ChunkStream> _chunkStreams;
+      };
+
+    }
+  }
+}
@@ -0,0 +1,139 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include <algorithm>
+#include "ProtocolConstants.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+
+      ///<summary>Picks the outbound chunk size from the observed audio/video message sizes. Policies, in order of precedence :
+      ///1. a chunk never exceeds the maximum chunk size, which bounds how long audio can wait behind a video chunk
+      ///2. every audio message fits a single chunk
+      ///3. chunks are just large enough for most video messages to fit one chunk - larger chunks add no savings
+      ///4. chunk sizes are aligned so that a chunk and its 1 byte continuation header fill whole TCP segments of the path MSS
+      ///The size is re-evaluated once per window of messages and only changed when the gain is significant</summary>
+      class ChunkSizeController
+      {
+      public:
+
+        static const unsigned int EVALUATIONWINDOW = 128;
+        static const unsigned int MINCHUNKSIZE = 128;
+        //percentile of video message sizes that should fit a single chunk
+        static const unsigned int VIDEOPERCENTILE = 90;
+
+        ChunkSizeController(unsigned int currentChunkSize, unsigned int maxChunkSize, unsigned int pathMSS) :
+          _currentChunkSize(currentChunkSize),
+          _maxChunkSize(maxChunkSize < MINCHUNKSIZE ? (unsigned int) MINCHUNKSIZE : maxChunkSize),
+          _pathMSS(max(pathMSS, 2U))
+        {
+          _videoMessageSizes.reserve(EVALUATIONWINDOW);
+        }
+
+        unsigned int GetChunkSize()
+        {
+          return _currentChunkSize;
+        }
+
+        void Observe(BYTE messageTypeID, unsigned int messageLength)
+        {
+          if (messageTypeID == RTMPMessageType::AUDIO)
+            _maxAudioMessageSize = max(_maxAudioMessageSize, messageLength);
+          else if (messageTypeID == RTMPMessageType::VIDEO)
+            _videoMessageSizes.push_back(messageLength);
+          _observed++;
+        }
+
+        ///<summary>Evaluates the window once enough messages have been observed</summary>
+        ///<returns>The new chunk size, or 0 if the chunk size should stay as is</returns>
+        unsigned int Evaluate()
+        {
+          if (_observed < EVALUATIONWINDOW)
+            return 0;
+
+          unsigned int target = Align(_maxAudioMessageSize);
+          if (!_videoMessageSizes.empty())
+          {
+            auto nth = _videoMessageSizes.begin() + (_videoMessageSizes.size() - 1) * VIDEOPERCENTILE / 100;
+            std::nth_element(_videoMessageSizes.begin(), nth, _videoMessageSizes.end());
+            target = max(target, Align(*nth));
+          }
+          target = min(target, AlignDown(_maxChunkSize));
+
+          bool audioSplit = _maxAudioMessageSize > _currentChunkSize && target > _currentChunkSize;
+          unsigned int difference = target > _currentChunkSize ? target - _currentChunkSize : _currentChunkSize - target;
+
+          _observed = 0;
+          _maxAudioMessageSize = 0;
+          _videoMessageSizes.clear();
+
+          //hysteresis - every change costs a control message and stalls new messages until the in flight ones finish
+          if (!audioSplit && difference * 4 < _currentChunkSize)
+            return 0;
+
+          _currentChunkSize = target;
+          return target;
+        }
+
+      private:
+
+        ///<summary>Smallest aligned chunk size that holds len bytes</summary>
+        unsigned int Align(unsigned int len)
+        {
+          unsigned int segments = (len + 1 + _pathMSS - 1) / _pathMSS;
+          unsigned int retval = segments * _pathMSS - 1;
+          return retval < MINCHUNKSIZE ? (unsigned int) MINCHUNKSIZE : retval;
+        }
+
+        ///<summary>Largest aligned chunk size not above len</summary>
+        unsigned int AlignDown(unsigned int len)
+        {
+          unsigned int segments = (len + 1) / _pathMSS;
+          unsigned int retval = segments > 0 ? segments * _pathMSS - 1 : len;
+          return retval < MINCHUNKSIZE ? (unsigned int) MINCHUNKSIZE : retval;
+        }
+
+        unsigned int _currentChunkSize;
+        unsigned int _maxChunkSize;
+        unsigned int _pathMSS;
+        unsigned int _observed = 0U;
+        unsigned int _maxAudioMessageSize = 0U;
+        std::vector<unsigned int> _videoMessageSizes;
+      };
+
+    }
+  }
+}
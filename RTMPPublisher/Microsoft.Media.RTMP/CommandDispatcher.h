@@ -0,0 +1,298 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ProtocolConstants.h"
+#include "ControlMessageViews.h"
+#include "AMF0Document.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>What the server said to a command - or why it never said anything</summary>
+      struct CommandReply
+      {
+        //_result, _error or onStatus
+        std::string CommandName;
+        unsigned int TransactionID = 0U;
+        unsigned int MessageStreamID = 0U;
+        //an _error, or a status with level "error" such as NetStream.Publish.BadName
+        bool Error = false;
+        //last top level number among the arguments - the stream ID in a createStream result
+        bool HasNumber = false;
+        double Number = 0;
+        //level and code of a status info object
+        std::string Level;
+        std::string Code;
+        //set instead of the fields above when the deadline passed or the connection went away
+        std::exception_ptr Failure;
+        //the failure is the deadline passing - the connection may still be fine
+        bool TimedOut = false;
+      };
+
+      ///<summary>Pairs inbound command replies with the commands waiting for them. A _result or _error goes to whoever registered its transaction ID,
+      ///an onStatus to whoever waits for a status on its message stream - replies nobody waits for are dropped. Every registration has a deadline,
+      ///a thread of the dispatcher's own fails the ones that pass. Callbacks run on the thread that called Dispatch or on the deadline thread, never under the lock</summary>
+      class CommandDispatcher
+      {
+      public:
+        typedef std::function<void(const CommandReply&)> ReplyCallback;
+
+        CommandDispatcher()
+        {
+          _thread = std::thread([this]() { RunDeadlines(); });
+        }
+
+        ~CommandDispatcher()
+        {
+          {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _stopping = true;
+          }
+          _cvDeadline.notify_all();
+          _thread.join();
+          FailAll(std::make_exception_ptr(std::runtime_error("RTMP : Command dispatcher shut down")));
+        }
+
+        ///<summary>Waits for the _result or _error with the given transaction ID - register before the command goes out</summary>
+        void ExpectResult(unsigned int transactionID, unsigned int timeoutMilliseconds, ReplyCallback callback)
+        {
+          Register(false, transactionID, timeoutMilliseconds, callback);
+        }
+
+        ///<summary>Waits for the next onStatus on a message stream - one sent on a stream nobody waits on goes to the longest waiting status instead,
+        ///since some servers answer publish on stream 0</summary>
+        void ExpectStatus(unsigned int messageStreamID, unsigned int timeoutMilliseconds, ReplyCallback callback)
+        {
+          Register(true, messageStreamID, timeoutMilliseconds, callback);
+        }
+
+        ///<summary>Hands an inbound command to whoever waits for it - called from the receive loop only</summary>
+        ///<returns>false if nobody was waiting</returns>
+        bool Dispatch(const AMF0CommandView& view)
+        {
+          bool status = view.IsCommand("onStatus");
+          if (!status && !view.IsCommand("_result") && !view.IsCommand("_error"))
+            return false;
+
+          CommandReply reply;
+          reply.CommandName = view.GetCommandName();
+          reply.TransactionID = view.GetTransactionID();
+          reply.MessageStreamID = view.GetMessageStreamID();
+          reply.Error = view.IsCommand("_error");
+          reply.HasNumber = view.TryGetLastNumber(reply.Number);
+          if (status)
+            ReadStatusInfo(view, reply);
+
+          ReplyCallback callback;
+          {
+            std::lock_guard<std::mutex> lock(_mtx);
+            for (auto itm = _waiters.begin(); itm != _waiters.end(); ++itm)
+            {
+              if (itm->Status == status && itm->Key == (status ? reply.MessageStreamID : reply.TransactionID))
+              {
+                callback = itm->Callback;
+                _waiters.erase(itm);
+                break;
+              }
+            }
+            if (callback == nullptr && status)
+            {
+              for (auto itm = _waiters.begin(); itm != _waiters.end(); ++itm)
+              {
+                if (itm->Status)
+                {
+                  callback = itm->Callback;
+                  _waiters.erase(itm);
+                  break;
+                }
+              }
+            }
+          }
+
+          if (callback == nullptr)
+            return false;
+          callback(reply);
+          return true;
+        }
+
+        ///<summary>Fails everything still waiting - the connection is gone</summary>
+        void FailAll(std::exception_ptr error)
+        {
+          std::deque<Waiter> waiters;
+          {
+            std::lock_guard<std::mutex> lock(_mtx);
+            waiters.swap(_waiters);
+          }
+          for (auto& waiter : waiters)
+            Fail(waiter, error);
+        }
+
+        size_t GetPendingCount()
+        {
+          std::lock_guard<std::mutex> lock(_mtx);
+          return _waiters.size();
+        }
+
+      private:
+
+        struct Waiter
+        {
+          bool Status;
+          //transaction ID for results, message stream ID for statuses
+          unsigned int Key;
+          std::chrono::steady_clock::time_point Deadline;
+          ReplyCallback Callback;
+        };
+
+        void Register(bool status, unsigned int key, unsigned int timeoutMilliseconds, ReplyCallback callback)
+        {
+          {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _waiters.push_back(Waiter{ status, key, std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds), callback });
+          }
+          _cvDeadline.notify_all();
+        }
+
+        static void Fail(const Waiter& waiter, std::exception_ptr error, bool timedOut = false)
+        {
+          CommandReply reply;
+          if (waiter.Status)
+            reply.MessageStreamID = waiter.Key;
+          else
+            reply.TransactionID = waiter.Key;
+          reply.Failure = error;
+          reply.TimedOut = timedOut;
+          waiter.Callback(reply);
+        }
+
+        void ReadStatusInfo(const AMF0CommandView& view, CommandReply& reply)
+        {
+          if (!_arguments.Load(view.GetArguments()))
+            return;
+
+          for (auto arg = _arguments.GetFirstRoot(); arg.IsValid(); arg = arg.GetNextSibling())
+          {
+            auto level = arg["level"];
+            auto code = arg["code"];
+            if (level.GetType() == AMF0TypeMarker::String)
+              reply.Level = level.GetStringValue();
+            if (code.GetType() == AMF0TypeMarker::String)
+              reply.Code = code.GetStringValue();
+
+            //servers answering in AMF3 send the info object as an AMF3 object
+            if (arg.GetType() == AMF0TypeMarker::AvmPlus)
+            {
+              auto info = arg.GetAMF3Value();
+              if (info != nullptr && info->GetType() == AMF3TypeMarker::Object)
+              {
+                for (auto& prop : *(info->GetProperties()))
+                {
+                  if (std::get<1>(prop)->GetType() != AMF3TypeMarker::String)
+                    continue;
+                  if (std::get<0>(prop) == "level")
+                    reply.Level = std::get<1>(prop)->GetStringValue();
+                  else if (std::get<0>(prop) == "code")
+                    reply.Code = std::get<1>(prop)->GetStringValue();
+                }
+              }
+            }
+          }
+
+          if (reply.Level == "error")
+            reply.Error = true;
+        }
+
+        void RunDeadlines()
+        {
+          std::unique_lock<std::mutex> lock(_mtx);
+          while (!_stopping)
+          {
+            auto now = std::chrono::steady_clock::now();
+            auto next = std::chrono::steady_clock::time_point::max();
+            std::vector<Waiter> expired;
+            for (auto itm = _waiters.begin(); itm != _waiters.end();)
+            {
+              if (itm->Deadline <= now)
+              {
+                expired.push_back(*itm);
+                itm = _waiters.erase(itm);
+              }
+              else
+              {
+                if (itm->Deadline < next)
+                  next = itm->Deadline;
+                ++itm;
+              }
+            }
+
+            if (!expired.empty())
+            {
+              lock.unlock();
+              for (auto& waiter : expired)
+                Fail(waiter, std::make_exception_ptr(std::runtime_error(waiter.Status ? "RTMP : Timed out waiting for a status" : "RTMP : Timed out waiting for a command result")), true);
+              lock.lock();
+              continue;
+            }
+
+            if (next == std::chrono::steady_clock::time_point::max())
+              _cvDeadline.wait(lock);
+            else
+              _cvDeadline.wait_until(lock, next);
+          }
+        }
+
+        std::mutex _mtx;
+        std::condition_variable _cvDeadline;
+        bool _stopping = false;
+        //in registration order
+        std::deque<Waiter> _waiters;
+        //arguments of the status being read - reused so that the arena stops growing after the first few
+        AMF0Document _arguments;
+        std::thread _thread;
+      };
+    }
+  }
+}
@@ -0,0 +1,336 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <memory>
+#include <vector>
+#include <string>
+#include <initializer_list>
+#include "ProtocolConstants.h"
+#include "ByteWriter.h"
+#include "RTMPMessageFormats.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>Value for a command template slot - a number or a UTF-8 string. String values are referenced, not copied, and must outlive the Stamp call</summary>
+      class CommandSlotValue
+      {
+      public:
+        CommandSlotValue(double val) : _type(AMF0TypeMarker::Number), _number(val)
+        {
+        }
+
+        CommandSlotValue(int val) : _type(AMF0TypeMarker::Number), _number((double) val)
+        {
+        }
+
+        CommandSlotValue(unsigned int val) : _type(AMF0TypeMarker::Number), _number((double) val)
+        {
+        }
+
+        CommandSlotValue(const std::string& val) : _type(AMF0TypeMarker::String), _stringData(val.data()), _stringLength((unsigned int) val.size())
+        {
+        }
+
+        CommandSlotValue(const char* val) : _type(AMF0TypeMarker::String), _stringData(val), _stringLength((unsigned int) strlen(val))
+        {
+        }
+
+        BYTE GetType() const
+        {
+          return _type;
+        }
+
+        double GetNumberValue() const
+        {
+          return _number;
+        }
+
+        const char* GetStringData() const
+        {
+          return _stringData;
+        }
+
+        unsigned int GetStringLength() const
+        {
+          return _stringLength;
+        }
+
+        ///<returns>Number of bytes the value takes once AMF0 encoded</returns>
+        unsigned int GetEncodedLength() const
+        {
+          if (_type == AMF0TypeMarker::Number)
+            return 9;
+          return (_stringLength <= 65535 ? 3 : 5) + _stringLength;
+        }
+
+        ///<summary>AMF0 encodes the value - matches AMF0Entity::EncodeNumber and AMF0Entity::EncodeString</summary>
+        void Encode(ByteWriter& bw) const
+        {
+          if (_type == AMF0TypeMarker::Number)
+          {
+            bw.put_u8(AMF0TypeMarker::Number);
+            bw.put_f64be(_number);
+          }
+          else if (_stringLength <= 65535)
+          {
+            bw.put_u8(AMF0TypeMarker::String);
+            bw.put_u16be((unsigned short) _stringLength);
+            bw.put_bytes((const BYTE*) _stringData, _stringLength);
+          }
+          else
+          {
+            bw.put_u8(AMF0TypeMarker::LongString);
+            bw.put_u32be(_stringLength);
+            bw.put_bytes((const BYTE*) _stringData, _stringLength);
+          }
+        }
+
+      private:
+        BYTE _type;
+        double _number = 0;
+        const char* _stringData = nullptr;
+        unsigned int _stringLength = 0U;
+      };
+
+      ///<summary>A command or data message encoded once, with slots left open for the values that change from one connection to the next.
+      ///The fixed parts are kept as a single byte blob and Stamp splices the slot values in at their recorded offsets - no entities are built and nothing is re-encoded</summary>
+      class CommandTemplate
+      {
+      public:
+        CommandTemplate(BYTE messageTypeID = RTMPMessageType::COMMANDAMF0) : _messageTypeID(messageTypeID), _bytes(make_shared<vector<BYTE>>())
+        {
+        }
+
+        CommandTemplate& String(const std::string& val)
+        {
+          AMF0Entity::EncodeString(val, _bytes);
+          return *this;
+        }
+
+        CommandTemplate& Number(double val)
+        {
+          AMF0Entity::EncodeNumber(val, _bytes);
+          return *this;
+        }
+
+        CommandTemplate& Boolean(bool val)
+        {
+          AMF0Entity::EncodeBoolean(val, _bytes);
+          return *this;
+        }
+
+        CommandTemplate& Null()
+        {
+          AMF0Entity::EncodeNull(_bytes);
+          return *this;
+        }
+
+        CommandTemplate& BeginObject()
+        {
+          ByteWriter(*_bytes, 1).put_u8(AMF0TypeMarker::Object);
+          return *this;
+        }
+
+        ///<summary>Property name inside an object - follow it with the property value or a slot</summary>
+        CommandTemplate& Name(const std::string& name)
+        {
+          AMF0Entity::EncodeName(name, _bytes);
+          return *this;
+        }
+
+        CommandTemplate& EndObject()
+        {
+          ByteWriter bw(*_bytes, 3);
+          bw.put_u16be(0);
+          bw.put_u8(AMF0TypeMarker::ObjectEnd);
+          return *this;
+        }
+
+        ///<summary>Opens a slot for a number - transaction IDs, codec flags and the like</summary>
+        CommandTemplate& NumberSlot()
+        {
+          _slots.push_back(Slot{ (unsigned int) _bytes->size(), AMF0TypeMarker::Number });
+          return *this;
+        }
+
+        ///<summary>Opens a slot for a string - stream names, URLs and the like</summary>
+        CommandTemplate& StringSlot()
+        {
+          _slots.push_back(Slot{ (unsigned int) _bytes->size(), AMF0TypeMarker::String });
+          return *this;
+        }
+
+        BYTE GetMessageTypeID() const
+        {
+          return _messageTypeID;
+        }
+
+        unsigned int GetSlotCount() const
+        {
+          return (unsigned int) _slots.size();
+        }
+
+        ///<summary>Builds a message from the template</summary>
+        ///<param name='messageStreamID'>Message stream ID of the new message</param>
+        ///<param name='values'>One value per slot, in the order the slots were opened</param>
+        shared_ptr<RTMPMessage> Stamp(unsigned int messageStreamID, std::initializer_list<CommandSlotValue> values) const
+        {
+          if (values.size() != _slots.size())
+            throw invalid_argument("Command template slot count mismatch");
+
+          unsigned int len = (unsigned int) _bytes->size();
+          auto slot = _slots.begin();
+          for (auto& val : values)
+          {
+            if (val.GetType() != (slot++)->Type)
+              throw invalid_argument("Command template slot type mismatch");
+            len += val.GetEncodedLength();
+          }
+
+          auto payload = make_shared<vector<BYTE>>(len);
+          ByteWriter bw(payload->data(), len);
+          unsigned int pos = 0;
+          slot = _slots.begin();
+          for (auto& val : values)
+          {
+            bw.put_bytes(_bytes->data() + pos, slot->Offset - pos);
+            pos = slot->Offset;
+            val.Encode(bw);
+            slot++;
+          }
+          bw.put_bytes(_bytes->data() + pos, (unsigned int) _bytes->size() - pos);
+
+          return make_shared<RTMPMessage>(0, _messageTypeID, messageStreamID, payload);
+        }
+
+      private:
+        struct Slot
+        {
+          unsigned int Offset;
+          BYTE Type;
+        };
+
+        BYTE _messageTypeID;
+        shared_ptr<vector<BYTE>> _bytes;
+        std::vector<Slot> _slots;
+      };
+
+      ///<summary>The commands the publisher sends, each encoded once per process</summary>
+      class CommandTemplates
+      {
+      public:
+        ///<summary>connect - slots : transaction ID, app, tcUrl, audio codec flags, video codec flags</summary>
+        static const CommandTemplate& Connect()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("connect").NumberSlot()
+            .BeginObject()
+            .Name("app").StringSlot()
+            .Name("tcUrl").StringSlot()
+            .Name("audioCodecs").NumberSlot()
+            .Name("videoCodecs").NumberSlot()
+            .EndObject();
+          return tmpl;
+        }
+
+        ///<summary>connect without video - slots : transaction ID, app, tcUrl, audio codec flags</summary>
+        static const CommandTemplate& ConnectAudioOnly()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("connect").NumberSlot()
+            .BeginObject()
+            .Name("app").StringSlot()
+            .Name("tcUrl").StringSlot()
+            .Name("audioCodecs").NumberSlot()
+            .EndObject();
+          return tmpl;
+        }
+
+        ///<summary>connect without audio - slots : transaction ID, app, tcUrl, video codec flags</summary>
+        static const CommandTemplate& ConnectVideoOnly()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("connect").NumberSlot()
+            .BeginObject()
+            .Name("app").StringSlot()
+            .Name("tcUrl").StringSlot()
+            .Name("videoCodecs").NumberSlot()
+            .EndObject();
+          return tmpl;
+        }
+
+        ///<summary>createStream - slots : transaction ID</summary>
+        static const CommandTemplate& CreateStream()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("createStream").NumberSlot().Null();
+          return tmpl;
+        }
+
+        ///<summary>releaseStream - slots : transaction ID, stream name</summary>
+        static const CommandTemplate& ReleaseStream()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("releaseStream").NumberSlot().Null().StringSlot();
+          return tmpl;
+        }
+
+        ///<summary>FCPublish - slots : transaction ID, stream name</summary>
+        static const CommandTemplate& FCPublish()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("FCPublish").NumberSlot().Null().StringSlot();
+          return tmpl;
+        }
+
+        ///<summary>publish - slots : transaction ID, stream name, publish type</summary>
+        static const CommandTemplate& Publish()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("publish").NumberSlot().Null().StringSlot().StringSlot();
+          return tmpl;
+        }
+
+        ///<summary>publish with a false flag, which stops publishing - slots : transaction ID</summary>
+        static const CommandTemplate& Unpublish()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("publish").NumberSlot().Null().Boolean(false);
+          return tmpl;
+        }
+
+        ///<summary>closeStream - slots : transaction ID</summary>
+        static const CommandTemplate& CloseStream()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("closeStream").NumberSlot().Null();
+          return tmpl;
+        }
+      };
+    }
+  }
+}
@@ -33,6 +33,6 @@ using namespace Microsoft::Media::RTMP;
 
  
 
-const wchar_t *RTMPPublishType::LIVE = L"live";
-const wchar_t *RTMPPublishType::RECORD = L"record";
-const wchar_t *RTMPPublishType::APPEND = L"append";
\ No newline at end of file
+const char *RTMPPublishType::LIVE = "live";
+const char *RTMPPublishType::RECORD = "record";
+const char *RTMPPublishType::APPEND = "append";
\ No newline at end of file
@@ -0,0 +1,385 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <functional>
+#include "ProtocolConstants.h"
+#include "ByteReader.h"
+#include "AMF0Reader.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>A reassembled inbound message payload - the bytes belong to the decoder and are only valid for the duration of a handler call.
+      ///Views decode their fields out of it up front and never hold on to the bytes</summary>
+      struct MessagePayloadView
+      {
+        const BYTE* Data;
+        unsigned int Length;
+        unsigned int Timestamp;
+        unsigned int MessageStreamID;
+        BYTE MessageTypeID;
+      };
+
+      ///<summary>Set Chunk Size (type 1)</summary>
+      class SetChunkSizeView
+      {
+      public:
+        static const BYTE MESSAGETYPEID = RTMPMessageType::PROTOSETCHUNKSIZE;
+        static const unsigned int MINCHUNKSIZE = 1U;
+        static const unsigned int MAXCHUNKSIZE = 0x7FFFFFFF;
+
+        ///<returns>false if the payload is truncated or the chunk size is out of range</returns>
+        static bool TryCreate(const MessagePayloadView& payload, SetChunkSizeView& view)
+        {
+          ByteReader br(payload.Data, payload.Length);
+          view._chunkSize = br.get_u32be();
+          //1 to 0x7FFFFFFF - the most significant bit is reserved and must be zero
+          return !br.IsTruncated() && view._chunkSize >= MINCHUNKSIZE && view._chunkSize <= MAXCHUNKSIZE;
+        }
+
+        unsigned int GetChunkSize() const
+        {
+          return _chunkSize;
+        }
+
+      private:
+        unsigned int _chunkSize = 0U;
+      };
+
+      ///<summary>Abort Message (type 2)</summary>
+      class AbortView
+      {
+      public:
+        static const BYTE MESSAGETYPEID = RTMPMessageType::PROTOABORT;
+
+        static bool TryCreate(const MessagePayloadView& payload, AbortView& view)
+        {
+          ByteReader br(payload.Data, payload.Length);
+          view._chunkStreamID = br.get_u32be();
+          return !br.IsTruncated();
+        }
+
+        unsigned int GetChunkStreamID() const
+        {
+          return _chunkStreamID;
+        }
+
+      private:
+        unsigned int _chunkStreamID = 0U;
+      };
+
+      ///<summary>Acknowledgement (type 3)</summary>
+      class AcknowledgementView
+      {
+      public:
+        static const BYTE MESSAGETYPEID = RTMPMessageType::PROTOACKNOWLEDGEMENT;
+
+        static bool TryCreate(const MessagePayloadView& payload, AcknowledgementView& view)
+        {
+          ByteReader br(payload.Data, payload.Length);
+          view._sequenceNumber = br.get_u32be();
+          return !br.IsTruncated();
+        }
+
+        unsigned int GetSequenceNumber() const
+        {
+          return _sequenceNumber;
+        }
+
+      private:
+        unsigned int _sequenceNumber = 0U;
+      };
+
+      ///<summary>Window Acknowledgement Size (type 5)</summary>
+      class WindowAckSizeView
+      {
+      public:
+        static const BYTE MESSAGETYPEID = RTMPMessageType::PROTOACKWINDOWSIZE;
+
+        static bool TryCreate(const MessagePayloadView& payload, WindowAckSizeView& view)
+        {
+          ByteReader br(payload.Data, payload.Length);
+          view._windowSize = br.get_u32be();
+          return !br.IsTruncated();
+        }
+
+        unsigned int GetWindowSize() const
+        {
+          return _windowSize;
+        }
+
+      private:
+        unsigned int _windowSize = 0U;
+      };
+
+      ///<summary>Set Peer Bandwidth (type 6)</summary>
+      class SetPeerBandwidthView
+      {
+      public:
+        static const BYTE MESSAGETYPEID = RTMPMessageType::PROTOSETPEERBANDWIDTH;
+
+        static bool TryCreate(const MessagePayloadView& payload, SetPeerBandwidthView& view)
+        {
+          ByteReader br(payload.Data, payload.Length);
+          view._bandwidth = br.get_u32be();
+          view._bandwidthLimitType = br.get_u8();
+          return !br.IsTruncated();
+        }
+
+        unsigned int GetBandwidth() const
+        {
+          return _bandwidth;
+        }
+
+        BYTE GetBandwidthLimitType() const
+        {
+          return _bandwidthLimitType;
+        }
+
+      private:
+        unsigned int _bandwidth = 0U;
+        BYTE _bandwidthLimitType = 0;
+      };
+
+      ///<summary>User Control Message (type 4) - a 2 byte event type followed by event data</summary>
+      class UserControlView
+      {
+      public:
+        static const BYTE MESSAGETYPEID = RTMPMessageType::USERCONTROL;
+
+        static bool TryCreate(const MessagePayloadView& payload, UserControlView& view)
+        {
+          ByteReader br(payload.Data, payload.Length);
+          view._eventType = br.get_u16be();
+          view._eventData = br.get_u32be();
+          if (view._eventType == UserControlMessageType::SetBufferLength)
+            view._bufferLength = br.get_u32be();
+          return !br.IsTruncated();
+        }
+
+        unsigned short GetEventType() const
+        {
+          return _eventType;
+        }
+
+        bool IsPingRequest() const
+        {
+          return _eventType == UserControlMessageType::PingRequest;
+        }
+
+        ///<summary>Stream the event applies to - Stream Begin, EOF, Dry, Is Recorded and Set Buffer Length</summary>
+        unsigned int GetStreamID() const
+        {
+          return _eventData;
+        }
+
+        ///<summary>Buffer length in milliseconds - Set Buffer Length only</summary>
+        unsigned int GetBufferLength() const
+        {
+          return _bufferLength;
+        }
+
+        ///<summary>Server timestamp to echo back - Ping Request and Ping Response only</summary>
+        unsigned int GetPingTimestamp() const
+        {
+          return _eventData;
+        }
+
+      private:
+        unsigned short _eventType = 0;
+        unsigned int _eventData = 0U;
+        unsigned int _bufferLength = 0U;
+      };
+
+      ///<summary>Command Message, AMF0 encoded (type 20) - the command name and transaction ID are read up front, the arguments are pulled on demand.
+      ///Unlike the control message views the name and the argument tokens point into the payload, so the view must not outlive the handler call</summary>
+      class AMF0CommandView
+      {
+      public:
+        static const BYTE MESSAGETYPEID = RTMPMessageType::COMMANDAMF0;
+
+        static bool TryCreate(const MessagePayloadView& payload, AMF0CommandView& view)
+        {
+          view._reader = AMF0Reader(payload.Data, payload.Length);
+          view._messageStreamID = payload.MessageStreamID;
+
+          if (!view._reader.Next(view._name) || view._name.Type != AMF0TokenType::String)
+            return false;
+
+          AMF0Token tok;
+          if (!view._reader.Next(tok) || tok.Type != AMF0TokenType::Number)
+            return false;
+          view._transactionID = (unsigned int) tok.NumberValue;
+          return true;
+        }
+
+        bool IsCommand(const char* name) const
+        {
+          return _name.StringEquals(name);
+        }
+
+        ///<returns>UTF-8 command name</returns>
+        std::string GetCommandName() const
+        {
+          return _name.ToString();
+        }
+
+        unsigned int GetTransactionID() const
+        {
+          return _transactionID;
+        }
+
+        unsigned int GetMessageStreamID() const
+        {
+          return _messageStreamID;
+        }
+
+        ///<returns>A reader positioned at the first argument after the transaction ID - each call starts over</returns>
+        AMF0Reader GetArguments() const
+        {
+          return _reader;
+        }
+
+        ///<summary>Finds the last top level number among the arguments - the stream ID in a createStream result</summary>
+        bool TryGetLastNumber(double& val) const
+        {
+          auto reader = GetArguments();
+          AMF0Token tok;
+          bool found = false;
+          while (reader.Next(tok))
+          {
+            if (tok.Type == AMF0TokenType::Number)
+            {
+              val = tok.NumberValue;
+              found = true;
+            }
+            else if (tok.Type == AMF0TokenType::AvmPlus)
+            {
+              auto amf3 = AMF3Reader((const BYTE*) tok.StringData, tok.StringLength).TryRead();
+              if (amf3 == nullptr)
+                continue;
+              if (amf3->GetType() == AMF3TypeMarker::Integer || amf3->GetType() == AMF3TypeMarker::Double)
+              {
+                val = amf3->GetNumberValue();
+                found = true;
+              }
+            }
+            else
+            {
+              reader.Skip(tok);
+            }
+          }
+          return found && !reader.HasError();
+        }
+
+      private:
+        AMF0Reader _reader;
+        AMF0Token _name;
+        unsigned int _transactionID = 0U;
+        unsigned int _messageStreamID = 0U;
+      };
+
+      ///<summary>Command Message, AMF3 flavor (type 17) - a format byte followed by the same layout as an AMF0 command.
+      ///The command name and transaction ID have to be plain AMF0 values, arguments can switch to AMF3</summary>
+      class AMF3CommandView : public AMF0CommandView
+      {
+      public:
+        static const BYTE MESSAGETYPEID = RTMPMessageType::COMMANDAMF3;
+
+        static bool TryCreate(const MessagePayloadView& payload, AMF3CommandView& view)
+        {
+          if (payload.Length < 1)
+            return false;
+
+          MessagePayloadView values = payload;
+          values.Data++;
+          values.Length--;
+          return AMF0CommandView::TryCreate(values, view);
+        }
+      };
+
+      ///<summary>Dispatch table of inbound message handlers keyed by message type ID</summary>
+      class MessageDispatcher
+      {
+      public:
+        typedef std::function<void(const MessagePayloadView&)> MessageHandler;
+
+        static const unsigned int MAXMESSAGETYPEID = 31;
+
+        ///<summary>Registers a handler over the raw payload of a message type - pass nullptr to remove it</summary>
+        void SetHandler(BYTE messageTypeID, MessageHandler handler)
+        {
+          if (messageTypeID > MAXMESSAGETYPEID)
+            throw invalid_argument("Invalid message type ID");
+          _handlers[messageTypeID] = handler;
+        }
+
+        ///<summary>Registers a handler over a typed view - malformed payloads are dropped</summary>
+        template<typename TView>
+        void SetHandler(std::function<void(const TView&)> handler)
+        {
+          if (handler == nullptr)
+          {
+            SetHandler(TView::MESSAGETYPEID, nullptr);
+            return;
+          }
+
+          SetHandler(TView::MESSAGETYPEID, [handler](const MessagePayloadView& payload)
+          {
+            TView view;
+            if (TView::TryCreate(payload, view))
+              handler(view);
+          });
+        }
+
+        bool HasHandler(BYTE messageTypeID) const
+        {
+          return messageTypeID <= MAXMESSAGETYPEID && _handlers[messageTypeID] != nullptr;
+        }
+
+        ///<returns>false if no handler is registered for the message type</returns>
+        bool Dispatch(const MessagePayloadView& payload) const
+        {
+          if (!HasHandler(payload.MessageTypeID))
+            return false;
+          _handlers[payload.MessageTypeID](payload);
+          return true;
+        }
+
+      private:
+        MessageHandler _handlers[MAXMESSAGETYPEID + 1];
+      };
+    }
+  }
+}
@@ -0,0 +1,444 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ProtocolConstants.h"
+#include "RTMPMessageFormats.h"
+#include "RTMPChunking.h"
+#include "ControlMessageViews.h"
+#include "CommandTemplates.h"
+#include "RTMPTransport.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>How a FakeIngestPeer behaves - the defaults answer like a well behaved ingest server</summary>
+      struct FakeIngestScript
+      {
+        //send S2 together with S0 and S1 instead of waiting for C2
+        bool SendS2WithS0S1 = true;
+        //protocol control messages sent once the handshake is done - 0 to leave one out
+        unsigned int SetChunkSize = 0U;
+        unsigned int WindowAckSize = 0U;
+        unsigned int PeerBandwidth = 0U;
+        bool AnswerReleaseStream = true;
+        bool AnswerFCPublish = true;
+        //message stream ID handed out by createStream
+        unsigned int StreamID = 1U;
+        //info object of the publish onStatus - level "error" with NetStream.Publish.BadName to reject the publish
+        std::string PublishStatusLevel = "status";
+        std::string PublishStatusCode = "NetStream.Publish.Start";
+        //send the replies to every command found in one read as a single write instead of one write per reply
+        bool CoalesceReplies = false;
+        //fold media payloads into FakeIngestStats::MediaChecksum instead of just counting them
+        bool ChecksumMedia = false;
+      };
+
+      ///<summary>What a FakeIngestPeer has seen so far</summary>
+      struct FakeIngestStats
+      {
+        unsigned long long BytesReceived = 0ULL;
+        unsigned int CommandsReceived = 0U;
+        unsigned int AudioMessages = 0U;
+        unsigned int VideoMessages = 0U;
+        unsigned int DataMessages = 0U;
+        unsigned long long MediaBytes = 0ULL;
+        //FNV-1a over the media payloads in arrival order - ChecksumMedia only
+        unsigned int MediaChecksum = 2166136261U;
+        //smoothed difference between media arrival spacing and timestamp spacing, the RFC 3550 interarrival jitter estimator
+        double JitterMilliseconds = 0.0;
+        std::string StreamName;
+        bool HandshakeValid = false;
+        bool Publishing = false;
+        bool Closed = false;
+        std::chrono::steady_clock::time_point Started;
+        std::chrono::steady_clock::time_point C0C1Received;
+        std::chrono::steady_clock::time_point C2Received;
+        std::chrono::steady_clock::time_point ConnectReceived;
+        std::chrono::steady_clock::time_point PublishReceived;
+        std::chrono::steady_clock::time_point FirstMediaReceived;
+        std::chrono::steady_clock::time_point LastMediaReceived;
+      };
+
+      ///<summary>Scripted stand-in for an ingest server on the far end of a transport, typically the other half of a LoopbackTransport pair.
+      ///It completes the handshake, answers connect, releaseStream, FCPublish, createStream and publish the way the messenger expects and then counts what is published.
+      ///Built from the same handshake, chunking and AMF0 code the messenger uses. Destroying the peer closes the transport and waits for the read loop to wind down,
+      ///so do not destroy it from a transport callback</summary>
+      class FakeIngestPeer
+      {
+      public:
+
+        FakeIngestPeer(shared_ptr<RTMPTransport> transport, const FakeIngestScript& script = FakeIngestScript()) :
+          _transport(transport),
+          _script(script),
+          _receiveBuffer(RECEIVEBUFFERSIZE),
+          _serverRandomBytes(make_shared<vector<BYTE>>(1528))
+        {
+          for (size_t i = 0; i < _serverRandomBytes->size(); i++)
+            (*_serverRandomBytes)[i] = (BYTE) (i * 131 + 7);
+
+          _decoder.SetMessageHandler<AMF0CommandView>([this](const AMF0CommandView& view)
+          {
+            OnCommand(view);
+          });
+        }
+
+        ~FakeIngestPeer()
+        {
+          _transport->Close();
+          std::unique_lock<std::mutex> lock(_mtxStats);
+          _cvStopped.wait(lock, [this]() { return !_receiving; });
+        }
+
+        ///<summary>Starts reading from the transport</summary>
+        void Start()
+        {
+          {
+            std::lock_guard<std::mutex> lock(_mtxStats);
+            _stats.Started = std::chrono::steady_clock::now();
+            _receiving = true;
+          }
+          ReceiveNext();
+        }
+
+        FakeIngestStats GetStats()
+        {
+          std::lock_guard<std::mutex> lock(_mtxStats);
+          return _stats;
+        }
+
+      private:
+
+        static const unsigned int RECEIVEBUFFERSIZE = 65536;
+        static const unsigned int COMMANDCHUNKSTREAMID = 3;
+        static const unsigned int CONTROLCHUNKSTREAMID = 2;
+
+        enum class Phase
+        {
+          C0C1,
+          C2,
+          Chunks
+        };
+
+        void ReceiveNext()
+        {
+          _transport->Receive(&(*(_receiveBuffer.begin())), (unsigned int) _receiveBuffer.size(), [this](unsigned int len, std::exception_ptr error)
+          {
+            if (error != nullptr || len == 0)
+            {
+              //last time the loop touches the peer - the destructor may be waiting on it
+              std::lock_guard<std::mutex> lock(_mtxStats);
+              _stats.Closed = true;
+              _receiving = false;
+              _cvStopped.notify_all();
+              return;
+            }
+
+            {
+              std::lock_guard<std::mutex> lock(_mtxStats);
+              _stats.BytesReceived += len;
+            }
+            try
+            {
+              OnBytes(&(*(_receiveBuffer.begin())), len);
+              FlushReplies();
+            }
+            catch (...)
+            {
+              //nothing after a malformed chunk can be framed any more - hang up like a real server would
+              auto transport = _transport;
+              {
+                std::lock_guard<std::mutex> lock(_mtxStats);
+                _stats.Closed = true;
+                _receiving = false;
+                _cvStopped.notify_all();
+              }
+              transport->Close();
+              return;
+            }
+            ReceiveNext();
+          });
+        }
+
+        void OnBytes(const BYTE* data, unsigned int len)
+        {
+          if (_phase == Phase::Chunks)
+          {
+            OnChunks(data, len);
+            return;
+          }
+
+          _handshake.insert(_handshake.end(), data, data + len);
+
+          if (_phase == Phase::C0C1 && _handshake.size() >= 1537)
+          {
+            {
+              std::lock_guard<std::mutex> lock(_mtxStats);
+              _stats.C0C1Received = std::chrono::steady_clock::now();
+            }
+            _c1 = HandshakeMessageC1C2S1S2::TryParse(&(*(_handshake.begin())) + 1, 1536);
+
+            HandshakeMessageC0S0 s0{ HandshakeMessageC0S0::RTMP_VERSION };
+            auto bitstream = s0.ToBitstream();
+            HandshakeMessageC1C2S1S2(0, _serverRandomBytes).ToBitstream(bitstream);
+            if (_script.SendS2WithS0S1)
+              HandshakeMessageC1C2S1S2(_c1->GetBaseEpoch(), _c1->GetParseTimestamp(), _c1->GetRandomBytes()).ToBitstream(bitstream);
+            Send(bitstream);
+
+            _handshake.erase(_handshake.begin(), _handshake.begin() + 1537);
+            _phase = Phase::C2;
+          }
+
+          if (_phase == Phase::C2 && _handshake.size() >= 1536)
+          {
+            auto c2 = HandshakeMessageC1C2S1S2::TryParse(&(*(_handshake.begin())), 1536);
+            {
+              std::lock_guard<std::mutex> lock(_mtxStats);
+              _stats.C2Received = std::chrono::steady_clock::now();
+              _stats.HandshakeValid = c2 != nullptr && c2->AreRandomBytesEqual(_serverRandomBytes);
+            }
+
+            auto bitstream = make_shared<vector<BYTE>>();
+            if (!_script.SendS2WithS0S1)
+              HandshakeMessageC1C2S1S2(_c1->GetBaseEpoch(), _c1->GetParseTimestamp(), _c1->GetRandomBytes()).ToBitstream(bitstream);
+            if (_script.WindowAckSize > 0)
+              AppendMessage(*bitstream, CONTROLCHUNKSTREAMID, make_shared<ProtoAckWindowSizeMessage>(_script.WindowAckSize));
+            if (_script.PeerBandwidth > 0)
+              AppendMessage(*bitstream, CONTROLCHUNKSTREAMID, make_shared<ProtoSetPeerBandwidthMessage>(_script.PeerBandwidth, (BYTE) BandwidthLimitType::Dynamic));
+            if (_script.SetChunkSize > 0)
+            {
+              AppendMessage(*bitstream, CONTROLCHUNKSTREAMID, make_shared<ProtoSetChunkSizeMessage>(_script.SetChunkSize));
+              _chunkSize = _script.SetChunkSize;
+            }
+            if (!bitstream->empty())
+              Send(bitstream);
+
+            //whatever followed C2 - a pipelining client sends connect right behind it
+            std::vector<BYTE> rest(_handshake.begin() + 1536, _handshake.end());
+            _handshake.clear();
+            _phase = Phase::Chunks;
+            if (!rest.empty())
+              OnChunks(&(*(rest.begin())), (unsigned int) rest.size());
+          }
+        }
+
+        void OnChunks(const BYTE* data, unsigned int len)
+        {
+          //commands go to OnCommand, media and data messages come back here
+          for (auto& msg : _decoder.Decode(data, len))
+          {
+            std::lock_guard<std::mutex> lock(_mtxStats);
+            auto type = msg->GetMessageTypeID();
+            if (type == RTMPMessageType::AUDIO || type == RTMPMessageType::VIDEO)
+            {
+              auto now = std::chrono::steady_clock::now();
+              if (_stats.AudioMessages + _stats.VideoMessages == 0)
+              {
+                _stats.FirstMediaReceived = now;
+              }
+              else
+              {
+                double arrival = std::chrono::duration<double, std::milli>(now - _stats.LastMediaReceived).count();
+                double transit = arrival - ((double) msg->GetTimestamp() - (double) _lastMediaTimestamp);
+                _stats.JitterMilliseconds += ((transit < 0 ? -transit : transit) - _stats.JitterMilliseconds) / 16.0;
+              }
+              _stats.LastMediaReceived = now;
+              _lastMediaTimestamp = msg->GetTimestamp();
+
+              if (type == RTMPMessageType::AUDIO)
+                _stats.AudioMessages++;
+              else
+                _stats.VideoMessages++;
+              _stats.MediaBytes += msg->GetMessageLength();
+
+              if (_script.ChecksumMedia)
+              {
+                auto payload = msg->GetPayload();
+                for (auto b : *payload)
+                  _stats.MediaChecksum = (_stats.MediaChecksum ^ b) * 16777619U;
+              }
+            }
+            else if (type == RTMPMessageType::DATAAMF0 || type == RTMPMessageType::DATAAMF3)
+            {
+              _stats.DataMessages++;
+            }
+          }
+        }
+
+        void OnCommand(const AMF0CommandView& view)
+        {
+          {
+            std::lock_guard<std::mutex> lock(_mtxStats);
+            _stats.CommandsReceived++;
+          }
+
+          auto tid = view.GetTransactionID();
+          if (view.IsCommand("connect"))
+          {
+            {
+              std::lock_guard<std::mutex> lock(_mtxStats);
+              _stats.ConnectReceived = std::chrono::steady_clock::now();
+            }
+            Reply(ConnectResult().Stamp(0, { tid }));
+          }
+          else if (view.IsCommand("releaseStream"))
+          {
+            if (_script.AnswerReleaseStream)
+              Reply(EmptyResult().Stamp(0, { tid }));
+          }
+          else if (view.IsCommand("FCPublish"))
+          {
+            if (_script.AnswerFCPublish)
+              Reply(EmptyResult().Stamp(0, { tid }));
+          }
+          else if (view.IsCommand("createStream"))
+          {
+            Reply(CreateStreamResult().Stamp(0, { tid, _script.StreamID }));
+          }
+          else if (view.IsCommand("publish"))
+          {
+            //publish, tid, null, name, type - or publish, tid, null, false to stop
+            auto args = view.GetArguments();
+            AMF0Token tok;
+            args.Next(tok);
+            if (args.Next(tok) && tok.Type == AMF0TokenType::String)
+            {
+              {
+                std::lock_guard<std::mutex> lock(_mtxStats);
+                _stats.StreamName = tok.ToString();
+                _stats.PublishReceived = std::chrono::steady_clock::now();
+                _stats.Publishing = _script.PublishStatusLevel != "error";
+              }
+              Reply(PublishStatus().Stamp(_script.StreamID, { _script.PublishStatusLevel, _script.PublishStatusCode }));
+            }
+            else
+            {
+              std::lock_guard<std::mutex> lock(_mtxStats);
+              _stats.Publishing = false;
+            }
+          }
+        }
+
+        void Reply(shared_ptr<RTMPMessage> msg)
+        {
+          AppendMessage(_heldReplies, COMMANDCHUNKSTREAMID, msg);
+          if (!_script.CoalesceReplies)
+            FlushReplies();
+        }
+
+        void FlushReplies()
+        {
+          if (_heldReplies.empty())
+            return;
+          auto bitstream = make_shared<vector<BYTE>>(std::move(_heldReplies));
+          _heldReplies.clear();
+          Send(bitstream);
+        }
+
+        void AppendMessage(std::vector<BYTE>& bitstream, unsigned int chunkStreamID, shared_ptr<RTMPMessage> msg)
+        {
+          auto bs = ChunkProcessor::ToChunkedBitstream(chunkStreamID, _chunkSize, msg);
+          bitstream.insert(bitstream.end(), bs->begin(), bs->end());
+        }
+
+        void Send(shared_ptr<vector<BYTE>> bitstream)
+        {
+          TransportBuffer buffer{ &(*(bitstream->begin())), (unsigned int) bitstream->size() };
+          //the callback keeps the bytes alive until the transport is done with them
+          _transport->Send(&buffer, 1, [bitstream](unsigned int, std::exception_ptr) {});
+        }
+
+        static const CommandTemplate& ConnectResult()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("_result").NumberSlot()
+            .BeginObject()
+            .Name("fmsVer").String("FMS/3,5,7,7009")
+            .Name("capabilities").Number(31)
+            .EndObject()
+            .BeginObject()
+            .Name("level").String("status")
+            .Name("code").String("NetConnection.Connect.Success")
+            .Name("description").String("Connection succeeded.")
+            .Name("objectEncoding").Number(0)
+            .EndObject();
+          return tmpl;
+        }
+
+        static const CommandTemplate& EmptyResult()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("_result").NumberSlot().Null();
+          return tmpl;
+        }
+
+        static const CommandTemplate& CreateStreamResult()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("_result").NumberSlot().Null().NumberSlot();
+          return tmpl;
+        }
+
+        static const CommandTemplate& PublishStatus()
+        {
+          static const CommandTemplate tmpl = CommandTemplate().String("onStatus").Number(0).Null()
+            .BeginObject()
+            .Name("level").StringSlot()
+            .Name("code").StringSlot()
+            .EndObject();
+          return tmpl;
+        }
+
+        shared_ptr<RTMPTransport> _transport;
+        FakeIngestScript _script;
+        std::vector<BYTE> _receiveBuffer;
+        shared_ptr<vector<BYTE>> _serverRandomBytes;
+        Phase _phase = Phase::C0C1;
+        std::vector<BYTE> _handshake;
+        shared_ptr<HandshakeMessageC1C2S1S2> _c1;
+        ChunkDecoder _decoder;
+        unsigned int _chunkSize = 128U;
+        unsigned int _lastMediaTimestamp = 0U;
+        std::vector<BYTE> _heldReplies;
+        std::mutex _mtxStats;
+        std::condition_variable _cvStopped;
+        bool _receiving = false;
+        FakeIngestStats _stats;
+      };
+    }
+  }
+}
@@ -0,0 +1,524 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#if defined(__linux__)
+
+#include "PlatformTypes.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <system_error>
+#include "RTMPTransport.h"
+#include "FakeIngestPeer.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>One publisher session as seen by an IngestServer</summary>
+      struct IngestConnectionReport
+      {
+        unsigned int ConnectionID;
+        std::string RemoteAddress;
+        bool Open;
+        FakeIngestStats Stats;
+        //averaged from accept to now, or to the close for a finished connection
+        double BytesPerSecond;
+        double MessagesPerSecond;
+      };
+
+      ///<summary>Stand-in for an ingest server that many publishers can connect to at once - for end to end load tests on one Linux box.
+      ///A single thread runs an epoll loop over the listening socket and every accepted connection, and each connection is answered by a FakeIngestPeer
+      ///with the same script, so sessions go through the handshake and command sequence the messenger expects. Media is counted and optionally checksummed, never kept</summary>
+      class IngestServer
+      {
+      public:
+
+        IngestServer(const FakeIngestScript& script = FakeIngestScript()) : _script(script)
+        {
+
+        }
+
+        ~IngestServer()
+        {
+          Stop();
+        }
+
+        ///<summary>Binds, listens and starts the server thread</summary>
+        ///<param name='address'>IPv4 address to bind to</param>
+        ///<param name='port'>Port to bind to - 0 picks a free one</param>
+        ///<returns>The port the server listens on</returns>
+        unsigned short Listen(const std::string& address = "127.0.0.1", unsigned short port = 0)
+        {
+          if (_thread.joinable())
+            throw std::logic_error("Ingest server : already listening");
+
+          sockaddr_in addr = {};
+          addr.sin_family = AF_INET;
+          addr.sin_port = htons(port);
+          if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+            throw std::invalid_argument("Ingest server : invalid address");
+
+          _listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+          if (_listener < 0)
+            throw std::system_error(errno, std::generic_category(), "Ingest server : socket");
+          int reuse = 1;
+          setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+          socklen_t addrlen = sizeof(addr);
+          if (bind(_listener, (sockaddr*) &addr, sizeof(addr)) != 0 || listen(_listener, SOMAXCONN) != 0 || getsockname(_listener, (sockaddr*) &addr, &addrlen) != 0)
+          {
+            auto err = errno;
+            CloseDescriptors();
+            throw std::system_error(err, std::generic_category(), "Ingest server : listen");
+          }
+
+          _epoll = epoll_create1(EPOLL_CLOEXEC);
+          _wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+          if (_epoll < 0 || _wake < 0)
+          {
+            auto err = errno;
+            CloseDescriptors();
+            throw std::system_error(err, std::generic_category(), "Ingest server : epoll");
+          }
+
+          epoll_event ev = {};
+          ev.events = EPOLLIN;
+          ev.data.u64 = LISTENERKEY;
+          epoll_ctl(_epoll, EPOLL_CTL_ADD, _listener, &ev);
+          ev.data.u64 = WAKEKEY;
+          epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake, &ev);
+
+          _stopping = false;
+          _thread = std::thread([this]() { Run(); });
+          return ntohs(addr.sin_port);
+        }
+
+        ///<summary>Stops the server thread and closes every connection - reports stay available</summary>
+        void Stop()
+        {
+          if (!_thread.joinable())
+            return;
+
+          _stopping = true;
+          uint64_t one = 1;
+          auto written = write(_wake, &one, sizeof(one));
+          (void) written;
+          _thread.join();
+
+          std::lock_guard<std::mutex> lock(_mtxConnections);
+          while (!_connections.empty())
+            Retire(_connections.begin());
+          CloseDescriptors();
+        }
+
+        ///<returns>Every connection accepted so far, open ones first, in accept order</returns>
+        std::vector<IngestConnectionReport> GetReport()
+        {
+          std::lock_guard<std::mutex> lock(_mtxConnections);
+          std::vector<IngestConnectionReport> retval;
+          auto now = std::chrono::steady_clock::now();
+          for (auto& itm : _connections)
+            retval.push_back(MakeReport(*itm.second, itm.second->Peer->GetStats(), true, now));
+          retval.insert(retval.end(), _finished.begin(), _finished.end());
+          return retval;
+        }
+
+      private:
+
+        static const uint64_t LISTENERKEY = 0;
+        static const uint64_t WAKEKEY = 1;
+        static const unsigned int MAXEVENTS = 256;
+
+        ///<summary>Transport over an accepted socket, driven by the server's epoll loop - every call is made on the server thread</summary>
+        class Connection : public RTMPTransport
+        {
+        public:
+
+          Connection(int fd, int epoll, uint64_t key) : _fd(fd), _epoll(epoll), _key(key)
+          {
+            int nodelay = 1;
+            setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+            epoll_event ev = {};
+            ev.events = 0;
+            ev.data.u64 = _key;
+            epoll_ctl(_epoll, EPOLL_CTL_ADD, _fd, &ev);
+          }
+
+          virtual ~Connection()
+          {
+            Close();
+          }
+
+          ///<summary>Accepted connections are already connected</summary>
+          virtual void Connect(const std::string&, const std::string&, ConnectCallback callback) override
+          {
+            callback(std::make_exception_ptr(std::logic_error("Ingest server : accepted connections cannot connect")));
+          }
+
+          virtual void Send(const TransportBuffer* buffers, unsigned int count, IOCallback callback) override
+          {
+            if (_fd < 0)
+            {
+              callback(0, std::make_exception_ptr(std::runtime_error("Ingest server : connection closed")));
+              return;
+            }
+
+            PendingSend pending;
+            for (unsigned int i = 0; i < count; i++)
+            {
+              pending.Total += buffers[i].Length;
+              //what goes out right away does not have to be copied
+              if (_sends.empty() && pending.Bytes.empty())
+              {
+                unsigned int sent = 0;
+                while (sent < buffers[i].Length)
+                {
+                  auto ret = send(_fd, buffers[i].Data + sent, buffers[i].Length - sent, MSG_NOSIGNAL);
+                  if (ret < 0 && errno == EINTR)
+                    continue;
+                  if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                  {
+                    callback(0, std::make_exception_ptr(std::system_error(errno, std::generic_category(), "Ingest server : send")));
+                    return;
+                  }
+                  if (ret <= 0)
+                    break;
+                  sent += (unsigned int) ret;
+                }
+                pending.Bytes.insert(pending.Bytes.end(), buffers[i].Data + sent, buffers[i].Data + buffers[i].Length);
+              }
+              else
+              {
+                pending.Bytes.insert(pending.Bytes.end(), buffers[i].Data, buffers[i].Data + buffers[i].Length);
+              }
+            }
+
+            if (pending.Bytes.empty() && _sends.empty())
+            {
+              callback(pending.Total, nullptr);
+              return;
+            }
+
+            pending.Callback = callback;
+            _sends.push_back(std::move(pending));
+            UpdateInterest();
+          }
+
+          virtual void Receive(BYTE* data, unsigned int len, IOCallback callback) override
+          {
+            if (_fd < 0)
+            {
+              callback(0, std::make_exception_ptr(std::runtime_error("Ingest server : connection closed")));
+              return;
+            }
+            if (_receiveCallback != nullptr)
+            {
+              callback(0, std::make_exception_ptr(std::logic_error("Ingest server : a receive is already pending")));
+              return;
+            }
+
+            _receiveData = data;
+            _receiveLength = len;
+            _receiveCallback = callback;
+            UpdateInterest();
+          }
+
+          ///<summary>Fails what is pending and closes the socket</summary>
+          virtual void Close() override
+          {
+            if (_fd < 0)
+              return;
+
+            epoll_ctl(_epoll, EPOLL_CTL_DEL, _fd, nullptr);
+            ::close(_fd);
+            _fd = -1;
+
+            auto error = std::make_exception_ptr(std::runtime_error("Ingest server : connection closed"));
+            auto sends = std::move(_sends);
+            _sends.clear();
+            for (auto& pending : sends)
+              pending.Callback(0, error);
+            if (_receiveCallback != nullptr)
+            {
+              auto callback = _receiveCallback;
+              _receiveCallback = nullptr;
+              callback(0, error);
+            }
+          }
+
+          ///<summary>Handles the events epoll reported for the socket</summary>
+          void OnEvents(uint32_t events)
+          {
+            if ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0)
+              FlushSends();
+
+            if (_fd >= 0 && _receiveCallback != nullptr && (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0)
+            {
+              ssize_t read;
+              do
+              {
+                read = recv(_fd, _receiveData, _receiveLength, 0);
+              } while (read < 0 && errno == EINTR);
+
+              if (read >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+              {
+                std::exception_ptr error = read < 0 ? std::make_exception_ptr(std::system_error(errno, std::generic_category(), "Ingest server : receive")) : nullptr;
+                if (read <= 0)
+                  _finished = true;
+                auto callback = _receiveCallback;
+                _receiveCallback = nullptr;
+                callback(read > 0 ? (unsigned int) read : 0U, error);
+              }
+            }
+
+            if (_fd >= 0)
+              UpdateInterest();
+          }
+
+          uint64_t Key() const
+          {
+            return _key;
+          }
+
+          ///<summary>The peer hung up or the connection failed - the session is over</summary>
+          bool IsFinished() const
+          {
+            return _finished || _fd < 0;
+          }
+
+          std::string RemoteAddress;
+          shared_ptr<FakeIngestPeer> Peer;
+          std::chrono::steady_clock::time_point Accepted;
+
+        private:
+
+          struct PendingSend
+          {
+            std::vector<BYTE> Bytes;
+            size_t Offset = 0;
+            unsigned int Total = 0U;
+            IOCallback Callback;
+          };
+
+          void FlushSends()
+          {
+            while (_fd >= 0 && !_sends.empty())
+            {
+              auto& front = _sends.front();
+              if (front.Offset < front.Bytes.size())
+              {
+                auto ret = send(_fd, &front.Bytes[front.Offset], front.Bytes.size() - front.Offset, MSG_NOSIGNAL);
+                if (ret < 0 && errno == EINTR)
+                  continue;
+                if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                  return;
+                if (ret < 0)
+                {
+                  _finished = true;
+                  auto pending = std::move(front);
+                  _sends.pop_front();
+                  pending.Callback(0, std::make_exception_ptr(std::system_error(errno, std::generic_category(), "Ingest server : send")));
+                  continue;
+                }
+                front.Offset += (size_t) ret;
+                if (front.Offset < front.Bytes.size())
+                  continue;
+              }
+
+              auto pending = std::move(front);
+              _sends.pop_front();
+              pending.Callback(pending.Total, nullptr);
+            }
+          }
+
+          ///<summary>Waits for readability only while a receive is pending and for writability only while sends are queued</summary>
+          void UpdateInterest()
+          {
+            uint32_t events = (_receiveCallback != nullptr ? (uint32_t) EPOLLIN : 0U) | (!_sends.empty() ? (uint32_t) EPOLLOUT : 0U);
+            if (events == _events || _fd < 0)
+              return;
+            _events = events;
+            epoll_event ev = {};
+            ev.events = events;
+            ev.data.u64 = _key;
+            epoll_ctl(_epoll, EPOLL_CTL_MOD, _fd, &ev);
+          }
+
+          int _fd;
+          int _epoll;
+          uint64_t _key;
+          uint32_t _events = 0;
+          bool _finished = false;
+          std::deque<PendingSend> _sends;
+          BYTE* _receiveData = nullptr;
+          unsigned int _receiveLength = 0U;
+          IOCallback _receiveCallback;
+        };
+
+        void Run()
+        {
+          epoll_event events[MAXEVENTS];
+          while (!_stopping)
+          {
+            auto count = epoll_wait(_epoll, events, MAXEVENTS, -1);
+            if (count < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              break;
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+              auto key = events[i].data.u64;
+              if (key == WAKEKEY)
+                continue;
+              if (key == LISTENERKEY)
+              {
+                Accept();
+                continue;
+              }
+
+              std::lock_guard<std::mutex> lock(_mtxConnections);
+              auto itm = _connections.find(key);
+              //retired earlier in this batch
+              if (itm == _connections.end())
+                continue;
+              itm->second->OnEvents(events[i].events);
+              if (itm->second->IsFinished())
+                Retire(itm);
+            }
+          }
+        }
+
+        void Accept()
+        {
+          while (true)
+          {
+            sockaddr_in addr = {};
+            socklen_t addrlen = sizeof(addr);
+            auto fd = accept4(_listener, (sockaddr*) &addr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+              if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+              //EAGAIN once the backlog is drained - anything else (out of descriptors) is retried on the next wakeup
+              return;
+            }
+
+            char name[INET_ADDRSTRLEN] = {};
+            inet_ntop(AF_INET, &addr.sin_addr, name, sizeof(name));
+
+            std::lock_guard<std::mutex> lock(_mtxConnections);
+            auto key = _nextKey++;
+            auto connection = make_shared<Connection>(fd, _epoll, key);
+            connection->RemoteAddress = std::string(name) + ":" + std::to_string(ntohs(addr.sin_port));
+            connection->Accepted = std::chrono::steady_clock::now();
+            connection->Peer = make_shared<FakeIngestPeer>(connection, _script);
+            _connections[key] = connection;
+            connection->Peer->Start();
+          }
+        }
+
+        ///<summary>Moves a connection to the finished reports and tears it down - called with the connection lock held</summary>
+        void Retire(std::map<uint64_t, shared_ptr<Connection>>::iterator itm)
+        {
+          auto connection = itm->second;
+          _connections.erase(itm);
+          connection->Close();
+          _finished.push_back(MakeReport(*connection, connection->Peer->GetStats(), false, std::chrono::steady_clock::now()));
+          //the peer holds the transport, let go of both
+          connection->Peer.reset();
+        }
+
+        IngestConnectionReport MakeReport(const Connection& connection, const FakeIngestStats& stats, bool open, std::chrono::steady_clock::time_point now)
+        {
+          IngestConnectionReport report;
+          report.ConnectionID = (unsigned int) (connection.Key() - FIRSTCONNECTIONKEY);
+          report.RemoteAddress = connection.RemoteAddress;
+          report.Open = open;
+          report.Stats = stats;
+          double seconds = std::chrono::duration<double>(now - connection.Accepted).count();
+          auto messages = stats.CommandsReceived + stats.AudioMessages + stats.VideoMessages + stats.DataMessages;
+          report.BytesPerSecond = seconds > 0 ? stats.BytesReceived / seconds : 0.0;
+          report.MessagesPerSecond = seconds > 0 ? messages / seconds : 0.0;
+          return report;
+        }
+
+        void CloseDescriptors()
+        {
+          if (_listener >= 0)
+            ::close(_listener);
+          if (_epoll >= 0)
+            ::close(_epoll);
+          if (_wake >= 0)
+            ::close(_wake);
+          _listener = _epoll = _wake = -1;
+        }
+
+        static const uint64_t FIRSTCONNECTIONKEY = 2;
+
+        FakeIngestScript _script;
+        int _listener = -1;
+        int _epoll = -1;
+        int _wake = -1;
+        std::thread _thread;
+        std::atomic<bool> _stopping{ false };
+        std::mutex _mtxConnections;
+        uint64_t _nextKey = FIRSTCONNECTIONKEY;
+        std::map<uint64_t, shared_ptr<Connection>> _connections;
+        std::vector<IngestConnectionReport> _finished;
+      };
+    }
+  }
+}
+
+#endif
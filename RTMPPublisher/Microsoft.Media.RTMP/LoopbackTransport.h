@@ -0,0 +1,335 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "RTMPTransport.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>Pause in delivery once the receiving side has been handed Offset bytes</summary>
+      struct LoopbackStall
+      {
+        unsigned long long Offset;
+        unsigned int Milliseconds;
+      };
+
+      ///<summary>Faults applied to the bytes an endpoint receives - none by default</summary>
+      struct LoopbackFaults
+      {
+        //largest read handed out, 0 for no limit - 1 splits every read down to single bytes
+        unsigned int MaxReadSize = 0U;
+        //delay before each read completes
+        unsigned int ReadDelayMilliseconds = 0U;
+        //delivery stops short of each offset and resumes after the stall - offsets in ascending order
+        std::vector<LoopbackStall> Stalls;
+      };
+
+      ///<summary>One end of an in-memory byte stream. Sends complete right away, receives complete on the pair's delivery thread in the order they were issued -
+      ///split reads, slow reads and stalls can be injected on either side. Do not drop the last reference to a pair from one of its callbacks</summary>
+      class LoopbackTransport : public RTMPTransport
+      {
+      public:
+
+        ///<returns>Two connected endpoints - what one sends the other receives</returns>
+        static std::pair<shared_ptr<LoopbackTransport>, shared_ptr<LoopbackTransport>> CreatePair()
+        {
+          auto pair = make_shared<Pair>();
+          return std::make_pair(shared_ptr<LoopbackTransport>(new LoopbackTransport(pair, 0)), shared_ptr<LoopbackTransport>(new LoopbackTransport(pair, 1)));
+        }
+
+        ///<summary>Faults applied to what this endpoint receives from now on - stall offsets count from the first byte ever received</summary>
+        void SetReceiveFaults(const LoopbackFaults& faults)
+        {
+          std::lock_guard<std::mutex> lock(_pair->Mutex);
+          Self().Faults = faults;
+          Self().NextStall = 0;
+        }
+
+        unsigned long long GetBytesReceived()
+        {
+          std::lock_guard<std::mutex> lock(_pair->Mutex);
+          return Self().Received;
+        }
+
+        unsigned long long GetBytesSent()
+        {
+          std::lock_guard<std::mutex> lock(_pair->Mutex);
+          return Peer().Received + (Peer().Inbound.size() - Peer().Head);
+        }
+
+        ///<summary>Host and port are ignored - the endpoint is connected to its peer from the start</summary>
+        virtual void Connect(const std::string&, const std::string&, ConnectCallback callback) override
+        {
+          std::unique_lock<std::mutex> lock(_pair->Mutex);
+          bool closed = Self().Closed || Peer().Closed;
+          lock.unlock();
+          callback(closed ? std::make_exception_ptr(std::runtime_error("RTMP transport : loopback peer closed")) : nullptr);
+        }
+
+        virtual void Send(const TransportBuffer* buffers, unsigned int count, IOCallback callback) override
+        {
+          unsigned int total = 0;
+          std::unique_lock<std::mutex> lock(_pair->Mutex);
+          if (Self().Closed || Peer().Closed)
+          {
+            lock.unlock();
+            callback(0, std::make_exception_ptr(std::runtime_error("RTMP transport : loopback peer closed")));
+            return;
+          }
+
+          auto& inbound = Peer().Inbound;
+          for (unsigned int i = 0; i < count; i++)
+          {
+            inbound.insert(inbound.end(), buffers[i].Data, buffers[i].Data + buffers[i].Length);
+            total += buffers[i].Length;
+          }
+          Schedule(1 - _side);
+          lock.unlock();
+
+          callback(total, nullptr);
+        }
+
+        virtual void Receive(BYTE* data, unsigned int len, IOCallback callback) override
+        {
+          std::unique_lock<std::mutex> lock(_pair->Mutex);
+          if (Self().Closed)
+          {
+            lock.unlock();
+            callback(0, std::make_exception_ptr(std::runtime_error("RTMP transport : connection closed")));
+            return;
+          }
+          if (Self().Callback != nullptr)
+          {
+            lock.unlock();
+            callback(0, std::make_exception_ptr(std::logic_error("RTMP transport : a receive is already pending")));
+            return;
+          }
+
+          Self().Data = data;
+          Self().Length = len;
+          Self().Callback = callback;
+          Schedule(_side);
+        }
+
+        ///<summary>The peer reads what is already in flight, then sees the connection close</summary>
+        virtual void Close() override
+        {
+          IOCallback callback;
+          {
+            std::lock_guard<std::mutex> lock(_pair->Mutex);
+            if (Self().Closed)
+              return;
+            Self().Closed = true;
+            callback = Self().Callback;
+            Self().Callback = nullptr;
+            Schedule(1 - _side);
+          }
+          if (callback != nullptr)
+            callback(0, std::make_exception_ptr(std::runtime_error("RTMP transport : connection closed")));
+        }
+
+      private:
+
+        struct Side
+        {
+          //bytes sent to this side and not read yet start at Head
+          std::vector<BYTE> Inbound;
+          size_t Head = 0;
+          unsigned long long Received = 0ULL;
+          bool Closed = false;
+          //pending receive
+          BYTE* Data = nullptr;
+          unsigned int Length = 0U;
+          IOCallback Callback;
+          //a delivery is scheduled
+          bool Scheduled = false;
+          LoopbackFaults Faults;
+          size_t NextStall = 0;
+        };
+
+        //state shared by the two endpoints and the thread that completes their receives
+        struct Pair
+        {
+          std::mutex Mutex;
+          std::condition_variable Wake;
+          Side Sides[2];
+          std::multimap<std::chrono::steady_clock::time_point, int> Deliveries;
+          bool Stopping = false;
+          std::thread Thread;
+
+          Pair()
+          {
+            Thread = std::thread([this]() { Run(); });
+          }
+
+          ~Pair()
+          {
+            {
+              std::lock_guard<std::mutex> lock(Mutex);
+              Stopping = true;
+            }
+            Wake.notify_all();
+            Thread.join();
+          }
+
+          void Run()
+          {
+            std::unique_lock<std::mutex> lock(Mutex);
+            while (!Stopping)
+            {
+              if (Deliveries.empty())
+              {
+                Wake.wait(lock);
+                continue;
+              }
+
+              auto next = Deliveries.begin();
+              if (next->first > std::chrono::steady_clock::now())
+              {
+                Wake.wait_until(lock, next->first);
+                continue;
+              }
+
+              auto side = next->second;
+              Deliveries.erase(next);
+              Sides[side].Scheduled = false;
+              Deliver(side, lock);
+            }
+          }
+
+          ///<summary>Completes the side's pending receive with what it may be handed now - called with the lock held, releases it around the callback</summary>
+          void Deliver(int side, std::unique_lock<std::mutex>& lock)
+          {
+            auto& s = Sides[side];
+            if (s.Callback == nullptr)
+              return;
+
+            size_t available = s.Inbound.size() - s.Head;
+            if (available == 0)
+            {
+              //EOF once the sender has closed and everything it sent has been read
+              if (Sides[1 - side].Closed)
+              {
+                auto callback = s.Callback;
+                s.Callback = nullptr;
+                lock.unlock();
+                callback(0, nullptr);
+                lock.lock();
+              }
+              return;
+            }
+
+            size_t len = available < s.Length ? available : s.Length;
+            if (s.Faults.MaxReadSize > 0 && len > s.Faults.MaxReadSize)
+              len = s.Faults.MaxReadSize;
+
+            if (s.NextStall < s.Faults.Stalls.size())
+            {
+              auto& stall = s.Faults.Stalls[s.NextStall];
+              if (s.Received >= stall.Offset)
+              {
+                //reached the stall - resume delivery once it is over
+                s.NextStall++;
+                s.Scheduled = true;
+                Deliveries.insert(std::make_pair(std::chrono::steady_clock::now() + std::chrono::milliseconds(stall.Milliseconds), side));
+                return;
+              }
+              if (s.Received + len > stall.Offset)
+                len = (size_t) (stall.Offset - s.Received);
+            }
+
+            memcpy(s.Data, &s.Inbound[s.Head], len);
+            s.Head += len;
+            s.Received += len;
+            if (s.Head == s.Inbound.size())
+            {
+              s.Inbound.clear();
+              s.Head = 0;
+            }
+            else if (s.Head > s.Inbound.size() / 2)
+            {
+              s.Inbound.erase(s.Inbound.begin(), s.Inbound.begin() + s.Head);
+              s.Head = 0;
+            }
+
+            auto callback = s.Callback;
+            s.Callback = nullptr;
+            lock.unlock();
+            callback((unsigned int) len, nullptr);
+            lock.lock();
+          }
+        };
+
+        LoopbackTransport(shared_ptr<Pair> pair, int side) : _pair(pair), _side(side)
+        {
+
+        }
+
+        Side& Self()
+        {
+          return _pair->Sides[_side];
+        }
+
+        Side& Peer()
+        {
+          return _pair->Sides[1 - _side];
+        }
+
+        ///<summary>Queues a delivery attempt for a side with a pending receive - callers hold the lock</summary>
+        void Schedule(int side)
+        {
+          auto& s = _pair->Sides[side];
+          if (s.Scheduled || s.Callback == nullptr)
+            return;
+          s.Scheduled = true;
+          _pair->Deliveries.insert(std::make_pair(std::chrono::steady_clock::now() + std::chrono::milliseconds(s.Faults.ReadDelayMilliseconds), side));
+          _pair->Wake.notify_all();
+        }
+
+        shared_ptr<Pair> _pair;
+        int _side;
+      };
+    }
+  }
+}
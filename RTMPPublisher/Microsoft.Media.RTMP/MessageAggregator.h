@@ -0,0 +1,128 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include <memory>
+#include <chrono>
+#include "RTMPMessageFormats.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+
+      ///<summary>Batches consecutive small messages of one chunk stream into aggregate messages. A batch is closed when the next message would take it past
+      ///the byte window or span the time window, messages that do not fit the byte window on their own pass through unbatched. A batch that no message
+      ///of its own stream closes is flushed by the send pump once it has been open for the time window (GetFlushDeadline). The pump runs whenever
+      ///either stream hands over a message, so batching holds a message back by at most the time window for as long as one of the streams is flowing -
+      ///if both stop, what is left goes out with the final Flush() on close</summary>
+      class MessageAggregator
+      {
+      public:
+
+        ///<param name='windowMilliseconds'>Maximum timestamp span of a batch - 0 disables batching</param>
+        ///<param name='windowBytes'>Maximum aggregate payload size - 0 disables batching</param>
+        MessageAggregator(unsigned int windowMilliseconds, unsigned int windowBytes) :
+          _windowMilliseconds(windowMilliseconds), _windowBytes(windowBytes)
+        {
+
+        }
+
+        bool IsEnabled()
+        {
+          return _windowMilliseconds > 0 && _windowBytes > 0;
+        }
+
+        ///<summary>Adds a message to the current batch</summary>
+        ///<param name='now'>Time the message was handed over - a batch opened by it is due to be flushed a time window later</param>
+        ///<returns>Messages that are ready to be sent, in order</returns>
+        std::vector<shared_ptr<RTMPMessage>> Add(shared_ptr<RTMPMessage> msg, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+        {
+          std::vector<shared_ptr<RTMPMessage>> retval;
+          unsigned int tagSize = AggregateMessage::GetTagSize(msg->GetMessageLength());
+
+          //delta timestamps cannot be rebased into tag timestamps
+          if (!IsEnabled() || msg->IsTimestampDelta() || tagSize > _windowBytes)
+          {
+            retval = Flush();
+            retval.push_back(msg);
+            return retval;
+          }
+
+          if (!_pending.empty() &&
+            (_pendingBytes + tagSize > _windowBytes ||
+              msg->GetTimestamp() < _pending.front()->GetTimestamp() ||
+              msg->GetTimestamp() - _pending.front()->GetTimestamp() >= _windowMilliseconds))
+            retval = Flush();
+
+          if (_pending.empty())
+            _openedAt = now;
+          _pending.push_back(msg);
+          _pendingBytes += tagSize;
+          return retval;
+        }
+
+        ///<summary>Closes the current batch</summary>
+        ///<returns>The batch - a single message is returned as is rather than wrapped in an aggregate</returns>
+        std::vector<shared_ptr<RTMPMessage>> Flush()
+        {
+          std::vector<shared_ptr<RTMPMessage>> retval;
+          if (_pending.size() == 1)
+            retval.push_back(_pending.front());
+          else if (_pending.size() > 1)
+            retval.push_back(make_shared<AggregateMessage>(_pending.front()->GetMessageStreamID(), _pending));
+
+          _pending.clear();
+          _pendingBytes = 0;
+          return retval;
+        }
+
+        ///<returns>When the current batch has to be flushed even if no further message closes it - time_point::max() if there is no batch</returns>
+        std::chrono::steady_clock::time_point GetFlushDeadline() const
+        {
+          if (_pending.empty())
+            return std::chrono::steady_clock::time_point::max();
+          return _openedAt + std::chrono::milliseconds(_windowMilliseconds);
+        }
+
+      private:
+        unsigned int _windowMilliseconds;
+        unsigned int _windowBytes;
+        unsigned int _pendingBytes = 0U;
+        std::vector<shared_ptr<RTMPMessage>> _pending;
+        std::chrono::steady_clock::time_point _openedAt;
+      };
+
+    }
+  }
+}
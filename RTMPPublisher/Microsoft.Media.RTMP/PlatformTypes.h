@@ -0,0 +1,56 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#pragma once
+
+#if defined(_WIN32)
+
+#include <wtypes.h>
+
+#else
+
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+//the handful of Windows types and CRT calls the protocol headers use - everything else in them is standard C++
+typedef unsigned char BYTE;
+
+inline int memcpy_s(void* dest, size_t destsz, const void* src, size_t count)
+{
+  if (count == 0)
+    return 0;
+  if (dest == nullptr || src == nullptr || destsz < count)
+  {
+    if (dest != nullptr && destsz > 0)
+      memset(dest, 0, destsz);
+    return EINVAL;
+  }
+  memcpy(dest, src, count);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,486 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#if !defined(_WIN32)
+
+#include "PlatformTypes.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <climits>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <system_error>
+#include "RTMPTransport.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>RTMPTransport over a non-blocking POSIX socket. Sends are tried on the caller's thread first and only what the socket does not take right away
+      ///is queued - one I/O thread per transport polls for the rest, for receives and for the connect</summary>
+      class PosixTransport : public RTMPTransport
+      {
+      public:
+
+        PosixTransport() : _destroyed(std::make_shared<bool>(false))
+        {
+          if (pipe(_wakeup) != 0)
+            throw std::system_error(errno, std::generic_category(), "RTMP transport : pipe");
+          fcntl(_wakeup[0], F_SETFL, fcntl(_wakeup[0], F_GETFL) | O_NONBLOCK);
+          fcntl(_wakeup[1], F_SETFL, fcntl(_wakeup[1], F_GETFL) | O_NONBLOCK);
+          auto destroyed = _destroyed;
+          _thrdIO = std::thread([this, destroyed]() { Run(destroyed); });
+        }
+
+        virtual ~PosixTransport()
+        {
+          Close();
+          {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _stopping = true;
+          }
+          if (std::this_thread::get_id() == _thrdIO.get_id())
+          {
+            //the last reference went away in one of the transport's own callbacks - the I/O thread cannot join itself, it leaves once the callback returns
+            *_destroyed = true;
+            _thrdIO.detach();
+          }
+          else
+          {
+            Wake();
+            _thrdIO.join();
+          }
+          close(_wakeup[0]);
+          close(_wakeup[1]);
+        }
+
+        ///<summary>Resolves the host on the caller's thread, then connects without blocking - addresses are tried in the order the resolver returns them</summary>
+        virtual void Connect(const std::string& host, const std::string& port, ConnectCallback callback) override
+        {
+          addrinfo hints = {};
+          hints.ai_family = AF_UNSPEC;
+          hints.ai_socktype = SOCK_STREAM;
+          hints.ai_flags = AI_ADDRCONFIG;
+          addrinfo* result = nullptr;
+          auto err = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+          if (err != 0)
+          {
+            callback(std::make_exception_ptr(std::runtime_error(std::string("RTMP transport : cannot resolve host - ") + gai_strerror(err))));
+            return;
+          }
+
+          std::unique_lock<std::mutex> lock(_mtx);
+          _addresses.clear();
+          for (auto ai = result; ai != nullptr; ai = ai->ai_next)
+          {
+            Address addr;
+            memcpy(&addr.Storage, ai->ai_addr, ai->ai_addrlen);
+            addr.Length = (socklen_t) ai->ai_addrlen;
+            _addresses.push_back(addr);
+          }
+          freeaddrinfo(result);
+
+          _connectCallback = callback;
+          _nextAddress = 0;
+          auto error = StartConnect();
+          if (error != nullptr)
+          {
+            _connectCallback = nullptr;
+            lock.unlock();
+            callback(error);
+            return;
+          }
+          lock.unlock();
+          Wake();
+        }
+
+        virtual void Send(const TransportBuffer* buffers, unsigned int count, IOCallback callback) override
+        {
+          PendingSend op;
+          op.Callback = callback;
+          for (unsigned int i = 0; i < count; i++)
+          {
+            if (buffers[i].Length == 0)
+              continue;
+            iovec iov;
+            iov.iov_base = const_cast<BYTE*>(buffers[i].Data);
+            iov.iov_len = buffers[i].Length;
+            op.Buffers.push_back(iov);
+            op.Total += buffers[i].Length;
+          }
+
+          std::unique_lock<std::mutex> lock(_mtx);
+          if (_fd < 0 || _connectCallback != nullptr)
+          {
+            lock.unlock();
+            callback(0, std::make_exception_ptr(std::runtime_error("RTMP transport : not connected")));
+            return;
+          }
+
+          //nothing ahead of it - try to hand it all to the socket right here
+          if (_sends.empty())
+          {
+            auto error = TrySend(op);
+            if (error != nullptr || op.Sent == op.Total)
+            {
+              lock.unlock();
+              callback(error != nullptr ? 0 : op.Total, error);
+              return;
+            }
+          }
+
+          _sends.push_back(std::move(op));
+          lock.unlock();
+          Wake();
+        }
+
+        virtual void Receive(BYTE* data, unsigned int len, IOCallback callback) override
+        {
+          std::unique_lock<std::mutex> lock(_mtx);
+          if (_fd < 0 || _connectCallback != nullptr)
+          {
+            lock.unlock();
+            callback(0, std::make_exception_ptr(std::runtime_error("RTMP transport : not connected")));
+            return;
+          }
+          if (_receive.Callback != nullptr)
+          {
+            lock.unlock();
+            callback(0, std::make_exception_ptr(std::logic_error("RTMP transport : a receive is already pending")));
+            return;
+          }
+
+          _receive.Data = data;
+          _receive.Length = len;
+          _receive.Callback = callback;
+          lock.unlock();
+          Wake();
+        }
+
+        virtual void Close() override
+        {
+          std::vector<std::function<void()>> completions;
+          {
+            std::lock_guard<std::mutex> lock(_mtx);
+            if (_fd < 0)
+              return;
+            close(_fd);
+            _fd = -1;
+            FailPending(std::make_exception_ptr(std::runtime_error("RTMP transport : connection closed")), completions);
+          }
+          Wake();
+          for (auto& completion : completions)
+            completion();
+        }
+
+        virtual unsigned int GetPathMSS() override
+        {
+          std::lock_guard<std::mutex> lock(_mtx);
+          if (_fd < 0 || _connectCallback != nullptr)
+            return 0;
+          int mss = 0;
+          socklen_t len = sizeof(mss);
+          if (getsockopt(_fd, IPPROTO_TCP, TCP_MAXSEG, &mss, &len) != 0 || mss <= 0)
+            return 0;
+          return (unsigned int) mss;
+        }
+
+      private:
+
+        struct Address
+        {
+          sockaddr_storage Storage;
+          socklen_t Length;
+        };
+
+        struct PendingSend
+        {
+          std::vector<iovec> Buffers;
+          unsigned int Total = 0U;
+          unsigned int Sent = 0U;
+          IOCallback Callback;
+        };
+
+        struct PendingReceive
+        {
+          BYTE* Data = nullptr;
+          unsigned int Length = 0U;
+          IOCallback Callback;
+        };
+
+        ///<summary>Starts a connect to the next address - callers hold _mtx</summary>
+        ///<param name='lasterr'>Why the previous address failed</param>
+        ///<returns>The error once every address has failed</returns>
+        std::exception_ptr StartConnect(int lasterr = 0)
+        {
+          while (_nextAddress < _addresses.size())
+          {
+            auto& addr = _addresses[_nextAddress++];
+            if (_fd >= 0)
+              close(_fd);
+            _fd = socket(addr.Storage.ss_family, SOCK_STREAM, 0);
+            if (_fd < 0)
+            {
+              lasterr = errno;
+              continue;
+            }
+
+            fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) | O_NONBLOCK);
+            int on = 1;
+            setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            setsockopt(_fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+#if defined(SO_NOSIGPIPE)
+            setsockopt(_fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+            if (connect(_fd, (const sockaddr*) &addr.Storage, addr.Length) == 0 || errno == EINPROGRESS)
+              return nullptr;
+            lasterr = errno;
+          }
+
+          if (_fd >= 0)
+          {
+            close(_fd);
+            _fd = -1;
+          }
+          return std::make_exception_ptr(std::system_error(lasterr, std::generic_category(), "RTMP transport : connect"));
+        }
+
+        ///<summary>Writes as much of the send as the socket takes without blocking - callers hold _mtx</summary>
+        ///<returns>The error if the connection failed</returns>
+        std::exception_ptr TrySend(PendingSend& op)
+        {
+          while (op.Sent < op.Total)
+          {
+            //skip what earlier writes already took
+            unsigned int skip = op.Sent;
+            size_t first = 0;
+            while (skip >= op.Buffers[first].iov_len)
+              skip -= (unsigned int) op.Buffers[(first++)].iov_len;
+
+            iovec* iov = &op.Buffers[first];
+            size_t iovcnt = op.Buffers.size() - first;
+            if (iovcnt > IOV_MAX)
+              iovcnt = IOV_MAX;
+            auto base = iov->iov_base;
+            auto len = iov->iov_len;
+            iov->iov_base = (BYTE*) base + skip;
+            iov->iov_len = len - skip;
+
+            msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+#if defined(MSG_NOSIGNAL)
+            auto written = sendmsg(_fd, &msg, MSG_NOSIGNAL);
+#else
+            auto written = sendmsg(_fd, &msg, 0);
+#endif
+            iov->iov_base = base;
+            iov->iov_len = len;
+
+            if (written < 0)
+            {
+              if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return nullptr;
+              if (errno == EINTR)
+                continue;
+              return std::make_exception_ptr(std::system_error(errno, std::generic_category(), "RTMP transport : send"));
+            }
+            op.Sent += (unsigned int) written;
+          }
+          return nullptr;
+        }
+
+        ///<summary>Completes every pending operation with the error - callers hold _mtx and run the completions after releasing it</summary>
+        void FailPending(std::exception_ptr error, std::vector<std::function<void()>>& completions)
+        {
+          if (_connectCallback != nullptr)
+          {
+            auto callback = _connectCallback;
+            _connectCallback = nullptr;
+            completions.push_back([callback, error]() { callback(error); });
+          }
+          for (auto& op : _sends)
+          {
+            auto callback = op.Callback;
+            completions.push_back([callback, error]() { callback(0, error); });
+          }
+          _sends.clear();
+          if (_receive.Callback != nullptr)
+          {
+            auto callback = _receive.Callback;
+            _receive = PendingReceive();
+            completions.push_back([callback, error]() { callback(0, error); });
+          }
+        }
+
+        void Wake()
+        {
+          BYTE b = 0;
+          auto ret = write(_wakeup[1], &b, 1);
+          (void) ret;
+        }
+
+        ///<param name='destroyed'>Set when the transport was destroyed on this thread - checked after every callback, before touching a member</param>
+        void Run(std::shared_ptr<bool> destroyed)
+        {
+          while (true)
+          {
+            pollfd fds[2] = {};
+            fds[0].fd = _wakeup[0];
+            fds[0].events = POLLIN;
+            nfds_t nfds = 1;
+            {
+              std::lock_guard<std::mutex> lock(_mtx);
+              if (_stopping)
+                return;
+              if (_fd >= 0)
+              {
+                fds[1].fd = _fd;
+                fds[1].events = (short) ((_connectCallback != nullptr || !_sends.empty() ? POLLOUT : 0) | (_receive.Callback != nullptr ? POLLIN : 0));
+                if (fds[1].events != 0)
+                  nfds = 2;
+              }
+            }
+
+            if (poll(fds, nfds, -1) < 0 && errno != EINTR)
+              return;
+
+            if (fds[0].revents & POLLIN)
+            {
+              BYTE drain[64];
+              while (read(_wakeup[0], drain, sizeof(drain)) > 0);
+            }
+
+            if (nfds == 2 && fds[1].revents != 0)
+            {
+              OnReady(fds[1].fd, fds[1].revents);
+              if (*destroyed)
+                return;
+            }
+          }
+        }
+
+        void OnReady(int fd, short revents)
+        {
+          std::vector<std::function<void()>> completions;
+          {
+            std::lock_guard<std::mutex> lock(_mtx);
+            //closed or reconnected while polling
+            if (fd != _fd)
+              return;
+
+            if (_connectCallback != nullptr)
+            {
+              if ((revents & (POLLOUT | POLLERR | POLLHUP)) == 0)
+                return;
+              int err = 0;
+              socklen_t errlen = sizeof(err);
+              getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+              std::exception_ptr error = err != 0 ? StartConnect(err) : nullptr;
+              //another address is being tried
+              if (err != 0 && error == nullptr)
+                return;
+              auto callback = _connectCallback;
+              _connectCallback = nullptr;
+              completions.push_back([callback, error]() { callback(error); });
+            }
+            else
+            {
+              if (!_sends.empty() && (revents & (POLLOUT | POLLERR | POLLHUP)) != 0)
+              {
+                while (!_sends.empty())
+                {
+                  auto& op = _sends.front();
+                  auto error = TrySend(op);
+                  if (error != nullptr)
+                  {
+                    FailPending(error, completions);
+                    break;
+                  }
+                  if (op.Sent < op.Total)
+                    break;
+                  auto callback = op.Callback;
+                  auto total = op.Total;
+                  completions.push_back([callback, total]() { callback(total, nullptr); });
+                  _sends.pop_front();
+                }
+              }
+
+              if (_receive.Callback != nullptr && (revents & (POLLIN | POLLERR | POLLHUP)) != 0)
+              {
+                auto read = recv(_fd, _receive.Data, _receive.Length, 0);
+                if (read >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                {
+                  auto callback = _receive.Callback;
+                  _receive = PendingReceive();
+                  std::exception_ptr error = read < 0 ? std::make_exception_ptr(std::system_error(errno, std::generic_category(), "RTMP transport : receive")) : nullptr;
+                  unsigned int len = read > 0 ? (unsigned int) read : 0U;
+                  completions.push_back([callback, len, error]() { callback(len, error); });
+                }
+              }
+            }
+          }
+
+          for (auto& completion : completions)
+            completion();
+        }
+
+        std::mutex _mtx;
+        std::shared_ptr<bool> _destroyed;
+        std::thread _thrdIO;
+        int _wakeup[2];
+        bool _stopping = false;
+        int _fd = -1;
+        std::vector<Address> _addresses;
+        size_t _nextAddress = 0;
+        ConnectCallback _connectCallback;
+        std::deque<PendingSend> _sends;
+        PendingReceive _receive;
+      };
+    }
+  }
+}
+
+#endif
@@ -235,6 +235,151 @@ namespace Microsoft
 
 
 
+        ///<summary>Interleave audio, video and control chunks on the wire so audio does not wait behind long video messages. Enabled by default</summary>
+        property bool EnableChunkInterleaving
+        {
+          bool get()
+          {
+            return _enableChunkInterleaving;
+          }
+          void set(bool val)
+          {
+            _enableChunkInterleaving = val;
+          }
+        }
+
+        ///<summary>Scheduling priority of the audio chunk stream when interleaving - lower values go first, control and command chunks are at 0. 1 by default</summary>
+        property unsigned int AudioChunkStreamPriority
+        {
+          unsigned int get()
+          {
+            return _audioChunkStreamPriority;
+          }
+          void set(unsigned int val)
+          {
+            _audioChunkStreamPriority = val;
+          }
+        }
+
+        ///<summary>Consecutive audio chunks sent before yielding to a chunk stream of the same priority. 1 by default</summary>
+        property unsigned int AudioChunkStreamWeight
+        {
+          unsigned int get()
+          {
+            return _audioChunkStreamWeight;
+          }
+          void set(unsigned int val)
+          {
+            _audioChunkStreamWeight = val < 1 ? 1 : val;
+          }
+        }
+
+        ///<summary>Scheduling priority of the video chunk stream when interleaving. 2 by default, so audio preempts video at chunk boundaries</summary>
+        property unsigned int VideoChunkStreamPriority
+        {
+          unsigned int get()
+          {
+            return _videoChunkStreamPriority;
+          }
+          void set(unsigned int val)
+          {
+            _videoChunkStreamPriority = val;
+          }
+        }
+
+        ///<summary>Consecutive video chunks sent before yielding to a chunk stream of the same priority. 1 by default</summary>
+        property unsigned int VideoChunkStreamWeight
+        {
+          unsigned int get()
+          {
+            return _videoChunkStreamWeight;
+          }
+          void set(unsigned int val)
+          {
+            _videoChunkStreamWeight = val < 1 ? 1 : val;
+          }
+        }
+
+        ///<summary>Maximum timestamp span of a batch of audio or video messages sent as one aggregate message. 0 (default) disables batching</summary>
+        property unsigned int AggregationWindowMilliseconds
+        {
+          unsigned int get()
+          {
+            return _aggregationWindowMilliseconds;
+          }
+          void set(unsigned int val)
+          {
+            _aggregationWindowMilliseconds = val;
+          }
+        }
+
+        ///<summary>Maximum payload size of an aggregate message. Messages that do not fit on their own are sent unbatched</summary>
+        property unsigned int AggregationWindowBytes
+        {
+          unsigned int get()
+          {
+            return _aggregationWindowBytes;
+          }
+          void set(unsigned int val)
+          {
+            _aggregationWindowBytes = val;
+          }
+        }
+
+        ///<summary>Adjust the outbound chunk size mid stream based on the observed audio/video message sizes. ClientChunkSize is the starting size</summary>
+        property bool EnableAdaptiveChunkSize
+        {
+          bool get()
+          {
+            return _enableAdaptiveChunkSize;
+          }
+          void set(bool val)
+          {
+            _enableAdaptiveChunkSize = val;
+          }
+        }
+
+        ///<summary>Send every handshake step that does not depend on a server reply without waiting for one - three round trips instead of nine, two with EnableStreamIDPrediction.
+        ///releaseStream, FCPublish and createStream go out in the same write as connect, before the server has accepted it. Disabled by default</summary>
+        property bool EnablePipelinedHandshake
+        {
+          bool get()
+          {
+            return _enablePipelinedHandshake;
+          }
+          void set(bool val)
+          {
+            _enablePipelinedHandshake = val;
+          }
+        }
+
+        ///<summary>With the pipelined handshake, send publish right behind createStream on the message stream ID the server type is assumed to hand out (1 for Wowza)
+        ///instead of waiting for the createStream result - one round trip less. Publish and @setDataFrame are sent again if the server picks another ID. Disabled by default</summary>
+        property bool EnableStreamIDPrediction
+        {
+          bool get()
+          {
+            return _enableStreamIDPrediction;
+          }
+          void set(bool val)
+          {
+            _enableStreamIDPrediction = val;
+          }
+        }
+
+        ///<summary>How long connect, releaseStream, createStream and publish each wait for the server to answer before the handshake fails. 10 seconds by default</summary>
+        property unsigned int CommandTimeoutMilliseconds
+        {
+          unsigned int get()
+          {
+            return _commandTimeoutMilliseconds;
+          }
+          void set(unsigned int val)
+          {
+            _commandTimeoutMilliseconds = val;
+          }
+        }
+
         property MediaEncodingProfile^ TargetEncodingProfile
         {
           MediaEncodingProfile^ get()
@@ -300,6 +445,28 @@ namespace Microsoft
         bool _enableLowLatency = false;
 
         bool _disableThrottling = false;
+
+        bool _enableChunkInterleaving = true;
+
+        unsigned int _audioChunkStreamPriority = 1U;
+
+        unsigned int _audioChunkStreamWeight = 1U;
+
+        unsigned int _videoChunkStreamPriority = 2U;
+
+        unsigned int _videoChunkStreamWeight = 1U;
+
+        unsigned int _aggregationWindowMilliseconds = 0U;
+
+        unsigned int _aggregationWindowBytes = 4096U;
+
+        bool _enableAdaptiveChunkSize = false;
+
+        bool _enablePipelinedHandshake = false;
+
+        bool _enableStreamIDPrediction = false;
+
+        unsigned int _commandTimeoutMilliseconds = 10000U;
       };
 
     }
@@ -34,6 +34,7 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "RTMPPublisherSink.h"
 #include "RTMPAudioStreamSink.h"
 #include "ProfileState.h"
+#include "ByteWriter.h"
 
 using namespace Microsoft::Media::RTMP;
 using namespace Windows::Foundation;
@@ -312,27 +313,26 @@ std::vector<BYTE> RTMPAudioStreamSink::PreparePayload(MediaSampleInfo* pSampleIn
 
 
 
-  BitOp::AddToBitstream(audiodata, retval, false);
-
   if (firstPacket)
   {
     //we add AACPacketType == 0, AudioSpecificConfig
     auto audioconfigrecord = MakeAudioSpecificConfig(pSampleInfo);
-    retval.push_back((BYTE)0);
-    auto oldsize = retval.size();
-    retval.resize(oldsize + audioconfigrecord.size());
-    memcpy_s(&(*(retval.begin() + oldsize)), (unsigned int)audioconfigrecord.size(), &(*(audioconfigrecord.begin())), (unsigned int)audioconfigrecord.size());
+
+    ByteWriter bw(retval, 2 + (unsigned int)audioconfigrecord.size());
+    bw.put_u8(audiodata);
+    bw.put_u8(0);
+    bw.put_bytes(&(*(audioconfigrecord.begin())), (unsigned int)audioconfigrecord.size());
   }
   else
   {
     //we add AACPacketType == 1,and AAC Frame Data
-    retval.push_back((BYTE)1);
-
     auto frames = pSampleInfo->GetSampleData();//we get raw aac frames per our output media type setting
 
-    auto oldsize = retval.size();
-    retval.resize(oldsize + frames.size());
-    memcpy_s(&(*(retval.begin() + oldsize)), (unsigned int)frames.size(), &(*(frames.begin())), (unsigned int)frames.size());
+    ByteWriter bw(retval, 2 + (unsigned int)frames.size());
+    bw.put_u8(audiodata);
+    bw.put_u8(1);
+    if (frames.size() > 0)
+      bw.put_bytes(&(*(frames.begin())), (unsigned int)frames.size());
   }
   return retval;
 }
@@ -457,14 +457,14 @@ HRESULT RTMPAudioStreamSink::CompleteProcessNextWorkitem(IMFAsyncResult *pAsyncR
       _mediasinkparent->GetMessenger()->QueueAudioVideoMessage(
         RTMPMessageType::AUDIO,
         uiPTS,
-        audioconfigpayload);
+        std::move(audioconfigpayload));
 
       auto framepayload = PreparePayload(sampleInfo, false);
 
       _mediasinkparent->GetMessenger()->QueueAudioVideoMessage(
         RTMPMessageType::AUDIO,
         uiPTS,
-        framepayload);
+        std::move(framepayload));
 
     }
     else
@@ -476,7 +476,7 @@ HRESULT RTMPAudioStreamSink::CompleteProcessNextWorkitem(IMFAsyncResult *pAsyncR
       _mediasinkparent->GetMessenger()->QueueAudioVideoMessage(
         RTMPMessageType::AUDIO,
         uiPTS,
-        framepayload);
+        std::move(framepayload));
     }
 
 #if defined(_DEBUG)
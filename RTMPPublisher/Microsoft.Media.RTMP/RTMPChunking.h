@@ -25,16 +25,19 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once 
 
-#include <pch.h>
 #include <cmath>
-#include <windef.h>
+#include "PlatformTypes.h"
 #include <vector>
 #include <algorithm>
 #include <chrono> 
 #include <limits>
 #include <memory>
+#include <unordered_map>
 #include "BitOp.h" 
+#include "ByteReader.h"
+#include "ByteWriter.h"
 #include "RTMPMessageFormats.h"
+#include "ControlMessageViews.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -46,10 +49,108 @@ namespace Microsoft
     namespace RTMP
     {
 
+      ///<summary>Chunk header writer specialized on chunk type, basic header size (1, 2 or 3 bytes) and presence of an extended timestamp.
+      ///Every condition is a compile time constant, so each instantiation reduces to a fixed sequence of stores</summary>
+      template<BYTE ChunkType, unsigned int BasicHeaderSize, bool ExtendedTimestamp>
+      struct ChunkHeaderWriter
+      {
+        static const unsigned int MessageHeaderSize =
+          ChunkType == RTMPChunkType::Type0 ? 11 : (ChunkType == RTMPChunkType::Type1 ? 7 : (ChunkType == RTMPChunkType::Type2 ? 3 : 0));
+
+        static const unsigned int Size = BasicHeaderSize + MessageHeaderSize + (ExtendedTimestamp ? 4 : 0);
+
+        static unsigned int Write(BYTE* dst,
+          unsigned int chunkStreamID,
+          unsigned int timestamp,
+          unsigned int messageLength,
+          BYTE messageTypeID,
+          unsigned int messageStreamID)
+        {
+          ByteWriter bw(dst, Size);
+
+          //basic header
+          if (BasicHeaderSize == 1)
+          {
+            bw.put_u8((BYTE) ((ChunkType << 6) | chunkStreamID));
+          }
+          else if (BasicHeaderSize == 2)
+          {
+            bw.put_u8((BYTE) (ChunkType << 6));
+            bw.put_u8((BYTE) (chunkStreamID - 64));
+          }
+          else //ID - 64 in little endian
+          {
+            bw.put_u8((BYTE) ((ChunkType << 6) | 1));
+            bw.put_u8((BYTE) (chunkStreamID - 64));
+            bw.put_u8((BYTE) ((chunkStreamID - 64) >> 8));
+          }
+
+          //message header - timestamp(3 bytes NBO)+messagelength(3 bytes NBO)+messagetypeid(1 byte)+messagestreamid(4 bytes LE)
+          if (ChunkType != RTMPChunkType::Type3)
+            bw.put_u24be(ExtendedTimestamp ? 0xFFFFFF : timestamp);
+
+          if (ChunkType == RTMPChunkType::Type0 || ChunkType == RTMPChunkType::Type1)
+          {
+            bw.put_u24be(messageLength);
+            bw.put_u8(messageTypeID);
+          }
+
+          if (ChunkType == RTMPChunkType::Type0)
+            bw.put_u32le(messageStreamID);
+
+          if (ExtendedTimestamp)
+            bw.put_u32be(timestamp);
+
+          return Size;
+        }
+      };
+
+      typedef unsigned int(*ChunkHeaderWriterFunc)(BYTE* dst,
+        unsigned int chunkStreamID,
+        unsigned int timestamp,
+        unsigned int messageLength,
+        BYTE messageTypeID,
+        unsigned int messageStreamID);
+
+      ///<summary>Picks the specialized header writer for a header - meant to be called once per message, not once per chunk</summary>
+      ///<param name='timestamp'>Timestamp field of the header (absolute or delta) - decides whether an extended timestamp is written</param>
+      inline ChunkHeaderWriterFunc SelectChunkHeaderWriter(BYTE chunkType, unsigned int chunkStreamID, unsigned int timestamp)
+      {
+        static const ChunkHeaderWriterFunc writers[4][3][2] = {
+          {
+            { &ChunkHeaderWriter<RTMPChunkType::Type0, 1, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type0, 1, true>::Write },
+            { &ChunkHeaderWriter<RTMPChunkType::Type0, 2, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type0, 2, true>::Write },
+            { &ChunkHeaderWriter<RTMPChunkType::Type0, 3, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type0, 3, true>::Write }
+          },
+          {
+            { &ChunkHeaderWriter<RTMPChunkType::Type1, 1, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type1, 1, true>::Write },
+            { &ChunkHeaderWriter<RTMPChunkType::Type1, 2, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type1, 2, true>::Write },
+            { &ChunkHeaderWriter<RTMPChunkType::Type1, 3, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type1, 3, true>::Write }
+          },
+          {
+            { &ChunkHeaderWriter<RTMPChunkType::Type2, 1, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type2, 1, true>::Write },
+            { &ChunkHeaderWriter<RTMPChunkType::Type2, 2, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type2, 2, true>::Write },
+            { &ChunkHeaderWriter<RTMPChunkType::Type2, 3, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type2, 3, true>::Write }
+          },
+          {
+            { &ChunkHeaderWriter<RTMPChunkType::Type3, 1, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type3, 1, true>::Write },
+            { &ChunkHeaderWriter<RTMPChunkType::Type3, 2, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type3, 2, true>::Write },
+            { &ChunkHeaderWriter<RTMPChunkType::Type3, 3, false>::Write, &ChunkHeaderWriter<RTMPChunkType::Type3, 3, true>::Write }
+          }
+        };
+
+        unsigned int basicHeaderForm = chunkStreamID <= 63 ? 0 : (chunkStreamID <= 319 ? 1 : 2);
+        return writers[chunkType & 0x03][basicHeaderForm][timestamp >= 0xFFFFFF ? 1 : 0];
+      }
+
       class ChunkMessage
       {
 
       public:
+
+        //3 bytes basic header + 11 bytes message header + 4 bytes extended timestamp
+        static const unsigned int MAXHEADERSIZE = 18;
+
         ChunkMessage() {
           _payload = make_shared<vector<BYTE>>();
 
@@ -153,17 +254,19 @@ namespace Microsoft
             basicheadersize = 3;
           }
 
+          unsigned int extendedtimestampsize = _extendedTimestamp ? 4 : 0;
+
           if (_chunkType == RTMPChunkType::Type0)
           {
-            return 11 + basicheadersize;
+            return 11 + basicheadersize + extendedtimestampsize;
           }
           else if (_chunkType == RTMPChunkType::Type1)
           {
-            return 7 + basicheadersize;
+            return 7 + basicheadersize + extendedtimestampsize;
           }
           else if (_chunkType == RTMPChunkType::Type2)
           {
-            return 3 + basicheadersize;
+            return 3 + basicheadersize + extendedtimestampsize;
           }
           else
             return basicheadersize;
@@ -180,151 +283,86 @@ namespace Microsoft
 
         static shared_ptr<ChunkMessage> TryParse(const BYTE *data, unsigned int len, unsigned int currentChunkSize, unsigned int startAt = 0)
         {
-          auto ctr = startAt;
-          auto retval = make_shared<ChunkMessage>();
+          if (startAt >= len)
+            return nullptr;
 
+          ByteReader br(data + startAt, len - startAt);
+          auto retval = make_shared<ChunkMessage>();
 
-          retval.get()->_chunkType = BitOp::ExtractBits<BYTE>(data[ctr], 0, 2);
+          BYTE basicheader = br.get_u8();
+          retval.get()->_chunkType = BitOp::ExtractBits<BYTE>(basicheader, 0, 2);
           if (retval.get()->_chunkType < RTMPChunkType::Type0 || retval.get()->_chunkType > RTMPChunkType::Type3)
             return nullptr; //Chunk type has to be within bounds
 
-          auto csidhdrind = BitOp::ExtractBits<BYTE>(data[ctr], 2, 6);
+          auto csidhdrind = BitOp::ExtractBits<BYTE>(basicheader, 2, 6);
 
           if (csidhdrind == 1)
-          {
-            retval.get()->_chunkStreamID = data[ctr + 2] * 256 + data[ctr + 1] + 64;
-            ctr += 3;
-          }
+            retval.get()->_chunkStreamID = br.get_u16le() + 64;
           else if (csidhdrind == 0)
-          {
-            retval.get()->_chunkStreamID = data[ctr + 1] + 64;
-            ctr += 2;
-          }
+            retval.get()->_chunkStreamID = br.get_u8() + 64;
           else
-          {
             retval.get()->_chunkStreamID = csidhdrind;
-            ctr += 1;
+
+          if (retval.get()->_chunkType != RTMPChunkType::Type3)
+            retval.get()->_timestamp = br.get_u24be();
+
+          if (retval.get()->_chunkType == RTMPChunkType::Type0 || retval.get()->_chunkType == RTMPChunkType::Type1)
+          {
+            retval.get()->_messageLength = br.get_u24be();
+            retval.get()->_messageTypeID = br.get_u8();
           }
 
           if (retval.get()->_chunkType == RTMPChunkType::Type0)
-          {
-            retval.get()->_timestamp = BitOp::ToInteger<unsigned int>(data + ctr, 3);
-            ctr += 3;
-            retval.get()->_messageLength = BitOp::ToInteger<unsigned int>(data + ctr, 3);
-            ctr += 3;
-            retval.get()->_messageTypeID = data[ctr];
-            ctr += 1;
-            retval.get()->_messageStreamID = BitOp::ToInteger<unsigned int>(data + ctr, 4);
-            ctr += 4;
+            retval.get()->_messageStreamID = br.get_u32le(); //little endian
 
-          }
-          else if (retval.get()->_chunkType == RTMPChunkType::Type1)
+          if (retval.get()->_chunkType != RTMPChunkType::Type3 && retval.get()->_timestamp == 0xFFFFFF)
           {
-            retval.get()->_timestamp = BitOp::ToInteger<unsigned int>(data + ctr, 3);
-            ctr += 3;
-            retval.get()->_messageLength = BitOp::ToInteger<unsigned int>(data + ctr, 3);
-            ctr += 3;
-            retval.get()->_messageTypeID = data[ctr];
-            ctr += 1;
-
+            retval.get()->_timestamp = br.get_u32be();
+            retval.get()->_extendedTimestamp = true;
           }
-          else if (retval.get()->_chunkType == RTMPChunkType::Type2)
-          {
-            retval.get()->_timestamp = BitOp::ToInteger<unsigned int>(data + ctr, 3);
-            ctr += 3;
 
-          }
+          if (br.IsTruncated())
+            return nullptr; //header is incomplete
 
-          auto payloadlen = min(len - ctr, currentChunkSize);
+          //timestamp field for types 1 & 2 is a delta - InheritHeader() turns it into an absolute timestamp
+          retval.get()->_timestampDelta = retval.get()->_timestamp;
+
+          auto payloadlen = min(br.GetRemaining(), currentChunkSize);
+          auto payload = br.get_bytes(payloadlen);
           retval.get()->GetPayload()->resize(payloadlen);
-          memcpy_s(&(*(retval.get()->GetPayload()->begin())), payloadlen, data + ctr, payloadlen);
+          if (payloadlen > 0)
+            memcpy_s(&(*(retval.get()->GetPayload()->begin())), payloadlen, payload, payloadlen);
           return retval;
 
         }
 
 
-        virtual shared_ptr<vector<BYTE>> ToBitstream()
+        ///<summary>Serializes a chunk header (basic header, message header and extended timestamp if needed) into the supplied buffer</summary>
+        ///<param name='dst'>Buffer to write to - must be at least MAXHEADERSIZE bytes long</param>
+        ///<returns>Number of header bytes written</returns>
+        static unsigned int WriteHeader(BYTE* dst,
+          BYTE chunkType,
+          unsigned int chunkStreamID,
+          unsigned int timestamp,
+          unsigned int messageLength = 0U,
+          BYTE messageTypeID = 0,
+          unsigned int messageStreamID = 0U)
         {
-          auto retval = make_shared<vector<BYTE>>();
-
-          //basic header
-
-          if (_chunkStreamID <= 63) //1 byte format
-          {
-            BYTE ret = 0;
-            ret |= _chunkType;
-            ret <<= 6;
-            ret |= _chunkStreamID;
-            retval->push_back(ret);
-          }
-          else if (_chunkStreamID <= 319) //2 byte format
-          {
-            BYTE ret = 0;
-            ret |= _chunkType;
-            ret <<= 6;
-            retval->push_back(ret);
-            retval->push_back(_chunkStreamID - 64);
-
-          }
-          else if (_chunkStreamID <= ChunkStreamIDValue::MAX) //3 byte format
-          {
-            BitOp::AddToBitstream(_chunkStreamID - 64, retval, false);
-            if (retval->size() > 2)
-              retval->resize(2);
-
-            BYTE ret = 0;
-            ret |= _chunkType;
-            ret <<= 6;
-            ret |= 1;
-            retval->insert(begin(*retval), ret);
-          }
-
-          //message header
+          return SelectChunkHeaderWriter(chunkType, chunkStreamID, timestamp)(dst, chunkStreamID, timestamp, messageLength, messageTypeID, messageStreamID);
+        }
 
-          if (_chunkType == RTMPChunkType::Type0) //format : timestamp(3 bytes NBO)+messagelength(3 bytes NBO)+messagetypeid(1 byte)+messagestreamid(4 bytes)
-          {
-            BitOp::AddToBitstream<unsigned int>(_timestamp > 0xFFFFFF ? 0xFFFFFF : _timestamp, retval, true, 3);
-            BitOp::AddToBitstream(_messageLength, retval, true, 3);
-            BitOp::AddToBitstream(_messageTypeID, retval);
-            BitOp::AddToBitstream(_messageStreamID, retval, false);
-            if (_timestamp > 0xFFFFFF)
-            {
-              BitOp::AddToBitstream(_timestamp, retval);
-            }
-          }
-          else if (_chunkType == RTMPChunkType::Type1)
-          {
-            BitOp::AddToBitstream<unsigned int>(_timestamp > 0xFFFFFF ? 0xFFFFFF : _timestamp, retval, true, 3);
-            BitOp::AddToBitstream(_messageLength, retval, true, 3);
-            BitOp::AddToBitstream(_messageTypeID, retval);
-            if (_timestamp > 0xFFFFFF)
-            {
-              BitOp::AddToBitstream(_timestamp, retval);
-            }
-          }
-          else if (_chunkType == RTMPChunkType::Type2)
-          {
-            BitOp::AddToBitstream<unsigned int>(_timestamp > 0xFFFFFF ? 0xFFFFFF : _timestamp, retval, true, 3);
-            if (_timestamp > 0xFFFFFF)
-            {
-              BitOp::AddToBitstream(_timestamp, retval);
-            }
-          }
-          else if (_chunkType == RTMPChunkType::Type3)
-          {
-            if (_timestamp > 0xFFFFFF)
-            {
-              BitOp::AddToBitstream(_timestamp, retval);
-            }
-          }
+        virtual shared_ptr<vector<BYTE>> ToBitstream()
+        {
+          BYTE header[MAXHEADERSIZE];
+          auto headerlen = WriteHeader(header, _chunkType, _chunkStreamID, _timestamp, _messageLength, _messageTypeID, _messageStreamID);
 
-          if (_payload != nullptr)
-          {
-            auto oldsize = retval->size();
-            retval->resize(oldsize + _payload->size());
-            memcpy_s(&(*(retval->begin() + oldsize)), _payload->size(), &(*(_payload->begin())), _payload->size());
-          }
+          auto payloadlen = _payload != nullptr ? _payload->size() : 0;
+          auto retval = make_shared<vector<BYTE>>();
+          retval->reserve(headerlen + payloadlen);
+          retval->insert(retval->end(), header, header + headerlen);
 
+          if (payloadlen > 0)
+            retval->insert(retval->end(), _payload->begin(), _payload->end());
 
           return retval;
         }
@@ -362,6 +400,31 @@ namespace Microsoft
 
 
 
+        unsigned int GetTimestampDelta() {
+          return _timestampDelta;
+        }
+
+        ///<summary>Fills in the header fields a Type1, Type2 or Type3 chunk that starts a new message omits, from the previous message on the same chunk stream</summary>
+        ///<param name='prev'>Previous message on the same chunk stream</param>
+        void InheritHeader(ChunkMessage& prev)
+        {
+          if (_chunkType == RTMPChunkType::Type0)
+            return;
+
+          _messageStreamID = prev._messageStreamID;
+
+          if (_chunkType == RTMPChunkType::Type2 || _chunkType == RTMPChunkType::Type3)
+          {
+            _messageLength = prev._messageLength;
+            _messageTypeID = prev._messageTypeID;
+          }
+
+          if (_chunkType == RTMPChunkType::Type3)
+            _timestampDelta = prev._timestampDelta; //a Type3 chunk starting a new message reuses the previous delta
+
+          _timestamp = prev._timestamp + _timestampDelta;
+        }
+
         void TrimPayload(unsigned int len)
         {
           _payload->resize(len);
@@ -388,196 +451,535 @@ namespace Microsoft
         unsigned int _messageLength = 0U;
         BYTE _messageTypeID = 0;
         unsigned int _messageStreamID = 0U;
-        //bool _extendedTimestamp = false;
+        unsigned int _timestampDelta = 0U;
+        bool _extendedTimestamp = false;
         shared_ptr<vector<BYTE>> _payload;
       };
 
 
 
-      class ChunkProcessor
+      ///<summary>Header fields of the last message sent on a chunk stream - used to pick the smallest legal chunk header for the next message on that chunk stream</summary>
+      class ChunkStreamHeaderState
       {
       public:
 
-        static std::vector<shared_ptr<RTMPMessage>> TryParse(const BYTE* data, unsigned int len, unsigned int curChunkSize, unsigned int startAt = 0)
+        ///<summary>Picks the chunk type for the first chunk of a message and records the message as the last one sent on this chunk stream</summary>
+        ///<param name='rtmpmsg'>Message about to be sent</param>
+        ///<param name='timestampField'>Receives the value to write in the timestamp field of the chunk headers (absolute for Type0, delta otherwise)</param>
+        ///<returns>The chunk type to use for the first chunk of the message</returns>
+        BYTE SelectChunkType(shared_ptr<RTMPMessage> rtmpmsg, unsigned int& timestampField)
         {
-          auto ctr = startAt;
-          std::vector<shared_ptr<ChunkMessage>> chunkmessages;
-          auto retval = std::vector<shared_ptr<RTMPMessage>>();
-          shared_ptr<RTMPMessage> curMessage;
+          BYTE retval = RTMPChunkType::Type0;
 
-          unsigned int chunkSize = curChunkSize;
-
-          //let's dechunk
-          while (len > ctr)
+          if (!_initialized)
           {
-            auto chunkMessage = ChunkMessage::TryParse(data + ctr, len - ctr, chunkSize);
-
-            if (chunkMessage == nullptr)
-              break;
-
-            if (chunkMessage->GetChunkType() < RTMPChunkType::Type0 || chunkMessage->GetChunkType() > RTMPChunkType::Type3)
-              break;
+            //nothing to compress against - honor what the caller asked for
+            retval = rtmpmsg->IsTimestampDelta() ? RTMPChunkType::Type1 : RTMPChunkType::Type0;
+            timestampField = rtmpmsg->GetTimestamp();
+            _timestamp = rtmpmsg->GetTimestamp();
+          }
+          else
+          {
+            unsigned int timestamp = rtmpmsg->IsTimestampDelta() ? _timestamp + rtmpmsg->GetTimestamp() : rtmpmsg->GetTimestamp();
+            unsigned int delta = timestamp - _timestamp;
 
-            if (chunkMessage->GetChunkType() == RTMPChunkType::Type3)
+            if (rtmpmsg->GetMessageStreamID() != _messageStreamID || timestamp < _timestamp || delta >= 0xFFFFFF)
             {
-              if (chunkmessages.size() == 0)
-                break;
-              else
-              {
-                //find the last chunk message of types 0, 1, or 2 that has the same stream ID as this
-                auto cmStart = std::find_if(chunkmessages.rbegin(), chunkmessages.rend(), [&chunkMessage](std::shared_ptr<ChunkMessage> cm)
-                {
-                  return (cm->GetChunkType() == RTMPChunkType::Type0 || cm->GetChunkType() == RTMPChunkType::Type1 || cm->GetChunkType() == RTMPChunkType::Type2) && chunkMessage->GetChunkStreamID() == cm->GetChunkStreamID();
-                });
-                if (cmStart == chunkmessages.rend())
-                  break;
-
-                chunkMessage->TrimPayload(min(chunkSize, (*cmStart)->GetMessageLength() - (unsigned int) ((*cmStart)->GetPayload()->size())));
-                (*cmStart)->AppendPayload(chunkMessage->GetPayload());
-              }
-
+              retval = RTMPChunkType::Type0;
+              timestampField = timestamp;
+            }
+            else if (rtmpmsg->GetMessageLength() != _messageLength || rtmpmsg->GetMessageTypeID() != _messageTypeID)
+            {
+              retval = RTMPChunkType::Type1;
+              timestampField = delta;
             }
-            else if (chunkMessage->GetChunkType() == RTMPChunkType::Type0 || chunkMessage->GetChunkType() == RTMPChunkType::Type1 || chunkMessage->GetChunkType() == RTMPChunkType::Type2)
+            //receivers disagree on the implied delta of a Type3 that follows a Type0 - so only reuse an explicitly sent delta
+            else if (!_deltaValid || delta != _timestampDelta)
             {
-              chunkMessage->TrimPayload(min(chunkSize, chunkMessage->GetMessageLength()));
-              chunkmessages.push_back(chunkMessage);
+              retval = RTMPChunkType::Type2;
+              timestampField = delta;
+            }
+            else
+            {
+              retval = RTMPChunkType::Type3;
+              timestampField = delta;
             }
 
-            ctr += chunkMessage->GetSize();
+            _timestamp = timestamp;
+          }
 
-            if (chunkMessage->GetPayload()->size() == chunkMessage->GetMessageLength())
-            {
+          _initialized = true;
+          _deltaValid = (retval != RTMPChunkType::Type0);
+          _timestampDelta = _deltaValid ? timestampField : 0U;
+          _messageLength = rtmpmsg->GetMessageLength();
+          _messageTypeID = rtmpmsg->GetMessageTypeID();
+          _messageStreamID = rtmpmsg->GetMessageStreamID();
 
-              if (chunkMessage->GetMessageTypeID() == RTMPMessageType::COMMANDAMF0)
-              {
-                auto props = AMF0Entity::TryParse(chunkMessage->GetPayload());
-                if (props.size() > 0 && props.front()->GetType() == AMF0TypeMarker::String)
-                {
-
-                  if (props.front()->GetStringValue() == L"_result")
-                  {
-                    retval.push_back(make_shared<Command_Result>(props, (unsigned int) chunkMessage->GetPayload()->size(), chunkMessage->GetMessageStreamID()));
-                  }
-                  else if (props.front()->GetStringValue() == L"_error")
-                  {
-                    retval.push_back(make_shared<Command_Error>(props, (unsigned int) chunkMessage->GetPayload()->size(), chunkMessage->GetMessageStreamID()));
-                  }
-                  else if (props.front()->GetStringValue() == L"onStatus")
-                  {
-                    retval.push_back(make_shared<Command_Status>(props, (unsigned int) chunkMessage->GetPayload()->size(), chunkMessage->GetMessageStreamID()));
-                  }
-                  else
-                  {
-                    retval.push_back(make_shared<AMF0EncodedCommandOrData>(props, (unsigned int) chunkMessage->GetPayload()->size(), chunkMessage->GetMessageStreamID()));
-                  }
-
-                }
-              }
-              else if (chunkMessage->GetMessageTypeID() == RTMPMessageType::PROTOABORT)
-              {
+          return retval;
+        }
 
-                retval.push_back(make_shared<ProtoAbortMessage>(
-                  ProtoAbortMessage::GetChunkStreamID(&(*(chunkMessage->GetPayload()->begin())))
-                  ));
+        ///<summary>Forgets the previous message - the next message is sent with a Type0 header</summary>
+        void Reset()
+        {
+          _initialized = false;
+          _deltaValid = false;
+        }
 
-              }
-              else if (chunkMessage->GetMessageTypeID() == RTMPMessageType::PROTOACKNOWLEDGEMENT)
-              {
-                retval.push_back(make_shared<ProtoAcknowledgementMessage>(
-                  ProtoAcknowledgementMessage::GetSequenceNumber(&(*(chunkMessage->GetPayload()->begin())))
-                  ));
+      private:
+        bool _initialized = false;
+        bool _deltaValid = false;
+        unsigned int _timestamp = 0U;
+        unsigned int _timestampDelta = 0U;
+        unsigned int _messageLength = 0U;
+        BYTE _messageTypeID = 0;
+        unsigned int _messageStreamID = 0U;
+      };
 
-              }
-              else if (chunkMessage->GetMessageTypeID() == RTMPMessageType::PROTOACKWINDOWSIZE)
-              {
-                retval.push_back(make_shared<ProtoAckWindowSizeMessage>(
-                  ProtoAckWindowSizeMessage::GetWindowSize(&(*(chunkMessage->GetPayload()->begin())))
-                  ));
+      ///<summary>A single chunk on the wire - the serialized chunk header and the slice of the message payload the chunk carries</summary>
+      struct ChunkSegment
+      {
+        BYTE Header[ChunkMessage::MAXHEADERSIZE];
+        unsigned int HeaderLength = 0U;
+        const BYTE* Payload = nullptr;
+        unsigned int PayloadLength = 0U;
+      };
 
-              }
-              else if (chunkMessage->GetMessageTypeID() == RTMPMessageType::PROTOSETCHUNKSIZE)
-              {
-                chunkSize = ProtoSetChunkSizeMessage::GetChunkSize(&(*(chunkMessage->GetPayload()->begin())));
-                retval.push_back(make_shared<ProtoSetChunkSizeMessage>(
-                  chunkSize
-                  ));
+      ///<summary>A chunked message as a list of segments pointing into the original message payload</summary>
+      class ChunkSegmentList
+      {
+      public:
 
-              }
-              else if (chunkMessage->GetMessageTypeID() == RTMPMessageType::PROTOSETPEERBANDWIDTH)
-              {
-                retval.push_back(make_shared<ProtoSetPeerBandwidthMessage>(
-                  ProtoSetPeerBandwidthMessage::GetBandwidth(&(*(chunkMessage->GetPayload()->begin()))),
-                  ProtoSetPeerBandwidthMessage::GetBandwidthLimitType(&(*(chunkMessage->GetPayload()->begin())))
-                  ));
+        ChunkSegmentList()
+        {
 
-              }
-              else if (chunkMessage->GetMessageTypeID() == RTMPMessageType::USERCONTROL)
-              {
-                unsigned short usercontrolmessagetype = BitOp::ToInteger<unsigned short>(&(*(chunkMessage->GetPayload()->begin())), 2);
-                unsigned short payloadlength = 6;
-                if (usercontrolmessagetype == UserControlMessageType::SetBufferLength)
-                  payloadlength = 10;
-                retval.push_back(make_shared<UserControlMessage>(&(*(chunkMessage->GetPayload()->begin())), payloadlength));
-              }
-            }
+        }
+
+        ChunkSegmentList(shared_ptr<vector<BYTE>> payload)
+        {
+          AddPayloadReference(payload);
+        }
+
+        ///<summary>Keeps a payload alive for as long as segments may point into it</summary>
+        void AddPayloadReference(shared_ptr<vector<BYTE>> payload)
+        {
+          if (payload != nullptr)
+            _payloads.push_back(payload);
+        }
+
+        void Reserve(size_t count)
+        {
+          _segments.reserve(count);
+        }
 
+        void Add(const ChunkSegment& segment)
+        {
+          _segments.push_back(segment);
+          _size += segment.HeaderLength + segment.PayloadLength;
+        }
+
+        const std::vector<ChunkSegment>& GetSegments()
+        {
+          return _segments;
+        }
 
+        ///<summary>Total number of bytes on the wire</summary>
+        unsigned int GetSize()
+        {
+          return _size;
+        }
+
+        ///<summary>Flattens the segments into a single contiguous bitstream</summary>
+        shared_ptr<vector<BYTE>> ToBitstream()
+        {
+          auto retval = make_shared<vector<BYTE>>();
+          retval->reserve(_size);
+          for (auto& segment : _segments)
+          {
+            retval->insert(retval->end(), segment.Header, segment.Header + segment.HeaderLength);
+            if (segment.PayloadLength > 0)
+              retval->insert(retval->end(), segment.Payload, segment.Payload + segment.PayloadLength);
           }
+          return retval;
+        }
+
+      private:
+        //keeps the payloads the segments point into alive
+        std::vector<shared_ptr<vector<BYTE>>> _payloads;
+        std::vector<ChunkSegment> _segments;
+        unsigned int _size = 0U;
+      };
+
+
+
+      ///<summary>Incremental inbound chunk decoder. Accepts arbitrary slices of the inbound byte stream and emits complete messages - partial chunks,
+      ///per chunk stream reassembly state and the negotiated inbound chunk size are kept across calls</summary>
+      class ChunkDecoder
+      {
+      public:
+
+        ChunkDecoder(unsigned int chunkSize = 128U) : _chunkSize(chunkSize)
+        {
+
+        }
+
+        unsigned int GetChunkSize()
+        {
+          return _chunkSize;
+        }
+
+        void SetChunkSize(unsigned int val)
+        {
+          _chunkSize = val;
+        }
+
+        ///<summary>Routes a message type to a handler over a typed view of its payload instead of creating a message for it</summary>
+        ///<remarks>The view is only valid for the duration of the call. Set Chunk Size and Abort are applied by the decoder before the handler runs.</remarks>
+        template<typename TView>
+        void SetMessageHandler(std::function<void(const TView&)> handler)
+        {
+          _dispatcher.SetHandler<TView>(handler);
+        }
 
+        ///<summary>Decodes the next slice of the inbound byte stream</summary>
+        ///<param name='data'>Bytes received</param>
+        ///<param name='len'>Number of bytes received</param>
+        ///<returns>Messages completed by this slice - a trailing partial chunk is buffered until the rest of it arrives</returns>
+        ///<remarks>Throws logic_error on a protocol error - the rest of the stream can not be framed and the connection should be closed</remarks>
+        std::vector<shared_ptr<RTMPMessage>> Decode(const BYTE* data, unsigned int len)
+        {
+          std::vector<shared_ptr<RTMPMessage>> retval;
+
+          if (_pending.empty())
+          {
+            auto consumed = DecodeChunks(data, len, retval);
+            if (consumed < len)
+              _pending.assign(data + consumed, data + len);
+          }
+          else
+          {
+            //finish the chunk that was split across reads
+            _pending.insert(_pending.end(), data, data + len);
+            auto consumed = DecodeChunks(&(*(_pending.begin())), (unsigned int) _pending.size(), retval);
+            _pending.erase(_pending.begin(), _pending.begin() + consumed);
+          }
 
           return retval;
         }
 
-        static shared_ptr<vector<BYTE>> ToChunkedBitstream(unsigned int chunkStreamID, unsigned int chunkSize, shared_ptr<RTMPMessage> rtmpmsg)
+        ///<summary>Creates a typed message from a reassembled payload</summary>
+        ///<returns>The message, or nullptr if the message type is not one we process or its payload is truncated</returns>
+        static shared_ptr<RTMPMessage> CreateMessage(BYTE messageTypeID, unsigned int messageStreamID, shared_ptr<vector<BYTE>> payload, unsigned int timestamp = 0U)
         {
-          auto retval = make_shared<vector<BYTE>>();
-          unsigned int messagelen = rtmpmsg->GetMessageLength();
-          int numchunks = (int) std::ceil((double) messagelen / (double) chunkSize);
-          for (int i = 0; i < numchunks; i++)
+          if (messageTypeID == RTMPMessageType::AUDIO || messageTypeID == RTMPMessageType::VIDEO || messageTypeID == RTMPMessageType::DATAAMF0 || messageTypeID == RTMPMessageType::DATAAMF3)
           {
-            shared_ptr<vector<BYTE>> bs;
-            if (i == 0)
-            {
+            return make_shared<RTMPMessage>(timestamp, (unsigned int) payload->size(), messageTypeID, messageStreamID,
+              payload->size() > 0 ? &(*(payload->begin())) : nullptr);
+          }
 
-              if (rtmpmsg->IsTimestampDelta() == false)
-              {
-                bs = ChunkMessage(chunkStreamID,
-                  rtmpmsg->GetTimestamp(),
-                  rtmpmsg->GetMessageLength(),
-                  rtmpmsg->GetMessageTypeID(),
-                  rtmpmsg->GetMessageStreamID(),
-                  &(*(rtmpmsg->GetPayload()->begin() + (i * chunkSize))),
-                  min(messagelen - (i * chunkSize), chunkSize)).ToBitstream();
-              }
+          if (messageTypeID == RTMPMessageType::COMMANDAMF0)
+          {
+            auto props = AMF0Entity::TryParse(payload);
+            if (props.size() > 0 && props.front()->GetType() == AMF0TypeMarker::String)
+            {
+              if (props.front()->GetStringValue() == "_result")
+                return make_shared<Command_Result>(props, (unsigned int) payload->size(), messageStreamID);
+              else if (props.front()->GetStringValue() == "_error")
+                return make_shared<Command_Error>(props, (unsigned int) payload->size(), messageStreamID);
+              else if (props.front()->GetStringValue() == "onStatus")
+                return make_shared<Command_Status>(props, (unsigned int) payload->size(), messageStreamID);
               else
+                return make_shared<AMF0EncodedCommandOrData>(props, (unsigned int) payload->size(), messageStreamID);
+            }
+            return nullptr;
+          }
+
+          if (messageTypeID == RTMPMessageType::COMMANDAMF3)
+          {
+            //skip the format byte
+            if (payload->size() < 1)
+              return nullptr;
+            auto props = AMF0Entity::TryParse(&(*(payload->begin())) + 1, (unsigned int) payload->size() - 1);
+            if (props.size() > 0 && props.front()->GetType() == AMF0TypeMarker::String)
+              return make_shared<AMF3EncodedCommandOrData>(props, (unsigned int) payload->size(), messageStreamID, messageTypeID);
+            return nullptr;
+          }
+
+          const BYTE* bs = payload->data();
+          unsigned int len = (unsigned int) payload->size();
+
+          if (messageTypeID == RTMPMessageType::PROTOABORT)
+          {
+            unsigned int chunkStreamID = 0U;
+            if (ProtoAbortMessage::TryGetChunkStreamID(bs, len, chunkStreamID))
+              return make_shared<ProtoAbortMessage>(chunkStreamID);
+          }
+          else if (messageTypeID == RTMPMessageType::PROTOACKNOWLEDGEMENT)
+          {
+            unsigned int sequenceNumber = 0U;
+            if (ProtoAcknowledgementMessage::TryGetSequenceNumber(bs, len, sequenceNumber))
+              return make_shared<ProtoAcknowledgementMessage>(sequenceNumber);
+          }
+          else if (messageTypeID == RTMPMessageType::PROTOACKWINDOWSIZE)
+          {
+            unsigned int windowSize = 0U;
+            if (ProtoAckWindowSizeMessage::TryGetWindowSize(bs, len, windowSize))
+              return make_shared<ProtoAckWindowSizeMessage>(windowSize);
+          }
+          else if (messageTypeID == RTMPMessageType::PROTOSETCHUNKSIZE)
+          {
+            unsigned int chunkSize = 0U;
+            if (ProtoSetChunkSizeMessage::TryGetChunkSize(bs, len, chunkSize))
+              return make_shared<ProtoSetChunkSizeMessage>(chunkSize);
+          }
+          else if (messageTypeID == RTMPMessageType::PROTOSETPEERBANDWIDTH)
+          {
+            unsigned int bandwidth = 0U;
+            BYTE bandwidthLimitType = 0;
+            if (ProtoSetPeerBandwidthMessage::TryGetBandwidth(bs, len, bandwidth, bandwidthLimitType))
+              return make_shared<ProtoSetPeerBandwidthMessage>(bandwidth, bandwidthLimitType);
+          }
+          else if (messageTypeID == RTMPMessageType::USERCONTROL)
+          {
+            //event type + 4 bytes of event data, Set Buffer Length carries 4 more
+            ByteReader br(bs, len);
+            auto usercontrolmessagetype = br.get_u16be();
+            br.skip(4);
+            if (usercontrolmessagetype == UserControlMessageType::SetBufferLength)
+              br.skip(4);
+            if (!br.IsTruncated())
+              return make_shared<UserControlMessage>(const_cast<BYTE*>(bs), br.GetPosition());
+          }
+
+          return nullptr;
+        }
+
+      private:
+
+        struct ChunkStreamState
+        {
+          bool HasHeader = false;
+          bool ExtendedTimestamp = false;
+          unsigned int Timestamp = 0U;
+          unsigned int TimestampDelta = 0U;
+          unsigned int MessageLength = 0U;
+          BYTE MessageTypeID = 0;
+          unsigned int MessageStreamID = 0U;
+          //payload of the message being reassembled - capacity is reused across messages
+          shared_ptr<vector<BYTE>> Payload = make_shared<vector<BYTE>>();
+        };
+
+        ///<summary>Decodes as many whole chunks as are available</summary>
+        ///<returns>Number of bytes consumed</returns>
+        unsigned int DecodeChunks(const BYTE* data, unsigned int len, std::vector<shared_ptr<RTMPMessage>>& messages)
+        {
+          unsigned int ctr = 0;
+          unsigned int chunklen = 0;
+          while (ctr < len && DecodeChunk(data + ctr, len - ctr, chunklen, messages))
+            ctr += chunklen;
+          return ctr;
+        }
+
+        ///<summary>Decodes a single chunk - state is only touched once the whole chunk is available</summary>
+        ///<returns>false if more bytes are needed to decode the chunk</returns>
+        bool DecodeChunk(const BYTE* data, unsigned int len, unsigned int& chunklen, std::vector<shared_ptr<RTMPMessage>>& messages)
+        {
+          //a truncated read means the rest of the chunk has not arrived yet
+          ByteReader br(data, len);
+
+          //basic header
+          BYTE basicheader = br.get_u8();
+          BYTE chunkType = basicheader >> 6;
+          unsigned int chunkStreamID = basicheader & 0x3F;
+          if (chunkStreamID == 0)
+            chunkStreamID = br.get_u8() + 64;
+          else if (chunkStreamID == 1)
+            chunkStreamID = br.get_u16le() + 64;
+          if (br.IsTruncated()) return false;
+
+          auto& state = _chunkStreams[chunkStreamID];
+
+          //message header
+          unsigned int timestampField = 0;
+          unsigned int messageLength = state.MessageLength;
+          BYTE messageTypeID = state.MessageTypeID;
+          unsigned int messageStreamID = state.MessageStreamID;
+
+          if (chunkType != RTMPChunkType::Type3)
+            timestampField = br.get_u24be();
+          if (chunkType == RTMPChunkType::Type0 || chunkType == RTMPChunkType::Type1)
+          {
+            messageLength = br.get_u24be();
+            messageTypeID = br.get_u8();
+          }
+          if (chunkType == RTMPChunkType::Type0)
+            messageStreamID = br.get_u32le(); //little endian
+          if (br.IsTruncated()) return false;
+
+          if (chunkType != RTMPChunkType::Type0 && !state.HasHeader)
+            throw std::logic_error("Parse Error : Chunk header refers to an unknown chunk stream");
+
+          //extended timestamp - a Type3 chunk carries one if the last header on the chunk stream did
+          bool extendedTimestamp = chunkType == RTMPChunkType::Type3 ? state.ExtendedTimestamp : timestampField == 0xFFFFFF;
+          if (extendedTimestamp)
+            timestampField = br.get_u32be();
+
+          bool continuation = chunkType == RTMPChunkType::Type3 && state.Payload->size() > 0 && state.Payload->size() < state.MessageLength;
+          unsigned int received = continuation ? (unsigned int) state.Payload->size() : 0U;
+          unsigned int payloadlen = min(_chunkSize, messageLength - received);
+
+          const BYTE* payload = br.get_bytes(payloadlen);
+          if (br.IsTruncated()) return false;
+
+          //whole chunk is available - update chunk stream state
+          if (!continuation)
+          {
+            if (chunkType == RTMPChunkType::Type0)
+            {
+              state.Timestamp = timestampField;
+              state.TimestampDelta = timestampField;
+            }
+            else
+            {
+              if (chunkType != RTMPChunkType::Type3)
+                state.TimestampDelta = timestampField;
+              state.Timestamp += state.TimestampDelta;
+            }
+
+            if (chunkType != RTMPChunkType::Type3)
+              state.ExtendedTimestamp = extendedTimestamp;
+
+            state.HasHeader = true;
+            state.MessageLength = messageLength;
+            state.MessageTypeID = messageTypeID;
+            state.MessageStreamID = messageStreamID;
+            state.Payload->clear();
+            state.Payload->reserve(messageLength);
+          }
+
+          state.Payload->insert(state.Payload->end(), payload, payload + payloadlen);
+          chunklen = br.GetPosition();
+
+          if (state.Payload->size() == state.MessageLength)
+          {
+            if (state.MessageTypeID == RTMPMessageType::AGGREGATE)
+            {
+              if (state.MessageLength > 0)
               {
-                bs = ChunkMessage(chunkStreamID,
-                  rtmpmsg->GetTimestamp(),
-                  rtmpmsg->GetMessageLength(),
-                  rtmpmsg->GetMessageTypeID(),
-                  &(*(rtmpmsg->GetPayload()->begin() + (i * chunkSize))),
-                  min(messagelen - (i * chunkSize), chunkSize)).ToBitstream();
+                auto parts = AggregateMessage::Split(state.Timestamp, state.MessageStreamID, &(*(state.Payload->begin())), state.MessageLength);
+                messages.insert(messages.end(), parts.begin(), parts.end());
               }
+              state.Payload->clear();
+              return true;
             }
-            else
+
+            MessagePayloadView payload = { state.MessageLength > 0 ? &(*(state.Payload->begin())) : nullptr,
+              state.MessageLength, state.Timestamp, state.MessageStreamID, state.MessageTypeID };
+
+            //protocol control that the decoder itself depends on
+            if (state.MessageTypeID == RTMPMessageType::PROTOSETCHUNKSIZE)
+            {
+              SetChunkSizeView view;
+              //a zero chunk size would never make progress - nothing after it can be framed
+              if (!SetChunkSizeView::TryCreate(payload, view))
+                throw std::logic_error("Parse Error : Set Chunk Size is malformed or out of range");
+              _chunkSize = view.GetChunkSize();
+            }
+            else if (state.MessageTypeID == RTMPMessageType::PROTOABORT)
             {
-              bs = ChunkMessage(
-                RTMPChunkType::Type3,
-                chunkStreamID,
-                rtmpmsg->GetTimestamp(),
-                &(*(rtmpmsg->GetPayload()->begin() + ((i * chunkSize)))),
-                min(messagelen - (i * chunkSize), chunkSize)).ToBitstream();
+              AbortView view;
+              if (AbortView::TryCreate(payload, view))
+              {
+                auto aborted = _chunkStreams.find(view.GetChunkStreamID());
+                if (aborted != _chunkStreams.end() && aborted->first != chunkStreamID)
+                  aborted->second.Payload->clear();
+              }
             }
 
-            auto oldsize = retval->size();
-            retval->resize(oldsize + bs->size());
-            memcpy_s(&(*(retval->begin() + oldsize)), bs->size(), &(*(bs->begin())), bs->size());
+            shared_ptr<RTMPMessage> msg = nullptr;
+            if (!_dispatcher.Dispatch(payload))
+              msg = CreateMessage(state.MessageTypeID, state.MessageStreamID, state.Payload, state.Timestamp);
 
+            //clear the reassembly buffer so that a Type3 chunk that follows starts a new message
+            state.Payload->clear();
+
+            if (msg != nullptr)
+              messages.push_back(msg);
           }
+
+          return true;
+        }
+
+        unsigned int _chunkSize = 128U;
+        //bytes of an incomplete chunk carried over to the next call
+        std::vector<BYTE> _pending;
+        std::unordered_map<unsigned int, ChunkStreamState> _chunkStreams;
+        MessageDispatcher _dispatcher;
+      };
+
+
+
+      class ChunkProcessor
+      {
+      public:
+
+        static std::vector<shared_ptr<RTMPMessage>> TryParse(const BYTE* data, unsigned int len, unsigned int curChunkSize, unsigned int startAt = 0)
+        {
+          ChunkDecoder decoder(curChunkSize);
+          return decoder.Decode(data + startAt, len - startAt);
+        }
+
+        ///<summary>Chunks a message without copying its payload</summary>
+        ///<param name='chunkStreamID'>Chunk stream to send the message on</param>
+        ///<param name='chunkSize'>Current outbound chunk size</param>
+        ///<param name='rtmpmsg'>Message to chunk</param>
+        ///<param name='headerState'>Optional header state of the chunk stream - when supplied the smallest legal header is picked for the first chunk</param>
+        ///<returns>A list of (chunk header, payload slice) segments that reference the payload of the supplied message</returns>
+        static shared_ptr<ChunkSegmentList> ToChunkSegments(unsigned int chunkStreamID,
+          unsigned int chunkSize,
+          shared_ptr<RTMPMessage> rtmpmsg,
+          shared_ptr<ChunkStreamHeaderState> headerState = nullptr)
+        {
+          auto retval = make_shared<ChunkSegmentList>(rtmpmsg->GetPayload());
+          unsigned int messagelen = rtmpmsg->GetMessageLength();
+          const BYTE* payload = messagelen > 0 ? &(*(rtmpmsg->GetPayload()->begin())) : nullptr;
+          unsigned int offset = 0;
+
+          retval->Reserve(messagelen > 0 ? (messagelen + chunkSize - 1) / chunkSize : 1);
+
+          unsigned int timestampField = rtmpmsg->GetTimestamp();
+          BYTE firstChunkType = rtmpmsg->IsTimestampDelta() ? RTMPChunkType::Type1 : RTMPChunkType::Type0;
+          if (headerState != nullptr)
+            firstChunkType = headerState->SelectChunkType(rtmpmsg, timestampField);
+
+          //continuation chunks repeat the timestamp field of the first chunk (it decides whether an extended timestamp follows)
+          auto firstChunkWriter = SelectChunkHeaderWriter(firstChunkType, chunkStreamID, timestampField);
+          auto continuationChunkWriter = SelectChunkHeaderWriter(RTMPChunkType::Type3, chunkStreamID, timestampField);
+
+          do
+          {
+            ChunkSegment segment;
+
+            segment.HeaderLength = (offset == 0 ? firstChunkWriter : continuationChunkWriter)(segment.Header,
+              chunkStreamID,
+              timestampField,
+              messagelen,
+              rtmpmsg->GetMessageTypeID(),
+              rtmpmsg->GetMessageStreamID());
+
+            segment.Payload = payload + offset;
+            segment.PayloadLength = min(messagelen - offset, chunkSize);
+            offset += segment.PayloadLength;
+
+            retval->Add(segment);
+          } while (offset < messagelen);
+
           return retval;
         }
 
-   
+        static shared_ptr<vector<BYTE>> ToChunkedBitstream(unsigned int chunkStreamID, unsigned int chunkSize, shared_ptr<RTMPMessage> rtmpmsg)
+        {
+          return ToChunkSegments(chunkStreamID, chunkSize, rtmpmsg)->ToBitstream();
+        }   
 
       };
 
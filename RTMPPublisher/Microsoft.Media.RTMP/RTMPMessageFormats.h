@@ -25,15 +25,19 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once 
 
-#include <pch.h>
 #include <cmath>
-#include <windef.h>
+#include "PlatformTypes.h"
 #include <vector>
 #include <algorithm>
 #include <chrono>
 #include <limits>
+#include <string>
 #include "BitOp.h" 
-#include "Constants.h"
+#include "ByteReader.h"
+#include "ByteWriter.h"
+#include "AMF0Reader.h"
+#include "AMF0PropertyIndex.h"
+#include "ProtocolConstants.h"
 
 
 using namespace std;
@@ -59,7 +63,7 @@ namespace Microsoft
         std::shared_ptr<vector<BYTE>> ToBitstream()
         {
           shared_ptr<vector<BYTE>> retval = std::make_shared<std::vector<BYTE>>();
-          BitOp::AddToBitstream<unsigned short>(_version, retval, true, 1U);
+          ToBitstream(retval);
           return retval;
         }
 
@@ -67,7 +71,7 @@ namespace Microsoft
         {
           if (retval == nullptr)
             retval = std::make_shared<std::vector<BYTE>>();
-          BitOp::AddToBitstream<unsigned short>(_version, retval, true, 1U);
+          ByteWriter(*retval, 1).put_u8((BYTE) _version);
           return;
         }
 
@@ -126,14 +130,21 @@ namespace Microsoft
         {
           if (size != 1536) return nullptr; //we are expecting exactly 1536 bytes
 
+          //time (4 bytes NBO) + time2 (4 bytes, echoed back in C2/S2 - not needed here) + random bytes
+          ByteReader br(data, size);
+          auto baseEpoch = br.get_u32be();
+          br.skip(4);
+          auto randomBytes = br.get_bytes(1528);
+          if (br.IsTruncated())
+            return nullptr;
+
           auto retval = make_shared<HandshakeMessageC1C2S1S2>();
-          retval->_baseEpoch = BitOp::ToInteger<unsigned int>(data, 4, true);
-          retval->_randomBytes->resize(1528);
-          memcpy_s(&(*(retval->_randomBytes->begin())), 1528, data + 8, 1528);
+          retval->_baseEpoch = baseEpoch;
+          retval->_randomBytes->assign(randomBytes, randomBytes + 1528);
 
 
           //timestamp when we parsed this packet - only useful when parsing S1 - since we will need this to pack into C2
-          retval->_parseTimestamp = (unsigned int) (chrono::system_clock::now().time_since_epoch().count() * TICKSTOMILLIS);
+          retval->_parseTimestamp = (unsigned int) chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
 
           return retval;
         }
@@ -141,14 +152,7 @@ namespace Microsoft
         std::shared_ptr<vector<BYTE>> ToBitstream()
         {
           shared_ptr<vector<BYTE>> retval = std::make_shared<std::vector<BYTE>>();
-
-          BitOp::AddToBitstream(_baseEpoch, retval);
-          BitOp::AddToBitstream(_parseTimestamp, retval);
-
-          auto oldsize = retval->size();
-          retval->resize(oldsize + _randomBytes->size());
-          copy(_randomBytes->begin(), _randomBytes->end(), retval->begin() + oldsize);
-
+          ToBitstream(retval);
           return retval;
         }
 
@@ -157,12 +161,11 @@ namespace Microsoft
           if (retval == nullptr)
             retval = std::make_shared<std::vector<BYTE>>();
 
-          BitOp::AddToBitstream(_baseEpoch, retval);
-          BitOp::AddToBitstream(_parseTimestamp, retval);
-
-          auto oldsize = retval->size();
-          retval->resize(oldsize + _randomBytes->size());
-          copy(_randomBytes->begin(), _randomBytes->end(), retval->begin() + oldsize);
+          ByteWriter bw(*retval, 8 + (unsigned int) _randomBytes->size());
+          bw.put_u32be(_baseEpoch);
+          bw.put_u32be(_parseTimestamp);
+          if (_randomBytes->size() > 0)
+            bw.put_bytes(&(*(_randomBytes->begin())), (unsigned int) _randomBytes->size());
 
           return;
         }
@@ -193,9 +196,9 @@ namespace Microsoft
 
       private:
 
-        shared_ptr<vector<BYTE>> _randomBytes;
         unsigned int _baseEpoch = 0U;
         unsigned int _parseTimestamp = 0U;
+        shared_ptr<vector<BYTE>> _randomBytes;
       };
 
 
@@ -230,6 +233,23 @@ namespace Microsoft
 
         }
 
+        //takes ownership of an already assembled payload without copying it
+        RTMPMessage(
+          unsigned int timestamp,
+          BYTE messageTypeID,
+          unsigned int messageStreamID,
+          shared_ptr<vector<BYTE>> payload,
+          bool isTimestampDelta = false) :
+          _timestamp(timestamp),
+          _messageLength(payload != nullptr ? (unsigned int) payload->size() : 0U),
+          _messageTypeID(messageTypeID),
+          _messageStreamID(messageStreamID),
+          _payload(payload != nullptr ? payload : make_shared<vector<BYTE>>()),
+          _isTimetampDelta(isTimestampDelta)
+        {
+
+        }
+
         unsigned int GetTimestamp() {
           return _timestamp;
         }
@@ -274,23 +294,28 @@ namespace Microsoft
         ProtoSetChunkSizeMessage(unsigned int chunkSize) :
           RTMPMessage(0, sizeof(unsigned int), RTMPMessageType::PROTOSETCHUNKSIZE, 0)
         {
-          if (chunkSize > 0x7FFFFFFF)
-            throw invalid_argument("Chunk size cannot be greater than 2147483647 bytes");
+          if (chunkSize < 1 || chunkSize > 0x7FFFFFFF)
+            throw invalid_argument("Chunk size must be between 1 and 2147483647 bytes");
 
 
-          BitOp::AddToBitstream(chunkSize, this->_payload);
+          ByteWriter(*_payload, 4).put_u32be(chunkSize);
         }
 
 
 
         unsigned int GetChunkSize()
         {
-          return BitOp::ToInteger<unsigned int>(&(*(_payload->begin())), 4);
+          unsigned int chunkSize = 0U;
+          TryGetChunkSize(_payload->data(), (unsigned int) _payload->size(), chunkSize);
+          return chunkSize;
         }
 
-        static unsigned int GetChunkSize(const BYTE* bs)
+        ///<returns>false if the payload is truncated</returns>
+        static bool TryGetChunkSize(const BYTE* bs, unsigned int len, unsigned int& chunkSize)
         {
-          return BitOp::ToInteger<unsigned int>(bs, 4);
+          ByteReader br(bs, len);
+          chunkSize = br.get_u32be();
+          return !br.IsTruncated();
         }
 
       };
@@ -307,17 +332,22 @@ namespace Microsoft
         ProtoAbortMessage(unsigned int chunkStreamID) :
           RTMPMessage(0, sizeof(unsigned int), RTMPMessageType::PROTOABORT, 0)
         {
-          BitOp::AddToBitstream(chunkStreamID, this->_payload);
+          ByteWriter(*_payload, 4).put_u32be(chunkStreamID);
         }
 
         unsigned int GetChunkStreamID()
         {
-          return BitOp::ToInteger<unsigned int>(&(*(_payload->begin())), 4);
+          unsigned int chunkStreamID = 0U;
+          TryGetChunkStreamID(_payload->data(), (unsigned int) _payload->size(), chunkStreamID);
+          return chunkStreamID;
         }
 
-        static unsigned int GetChunkStreamID(const BYTE* bs)
+        ///<returns>false if the payload is truncated</returns>
+        static bool TryGetChunkStreamID(const BYTE* bs, unsigned int len, unsigned int& chunkStreamID)
         {
-          return BitOp::ToInteger<unsigned int>(bs, 4);
+          ByteReader br(bs, len);
+          chunkStreamID = br.get_u32be();
+          return !br.IsTruncated();
         }
       };
 
@@ -333,17 +363,22 @@ namespace Microsoft
         ProtoAcknowledgementMessage(unsigned int sequenceNumber) :
           RTMPMessage(0, sizeof(unsigned int), RTMPMessageType::PROTOACKNOWLEDGEMENT, 0)
         {
-          BitOp::AddToBitstream(sequenceNumber, this->_payload);
+          ByteWriter(*_payload, 4).put_u32be(sequenceNumber);
         }
 
         unsigned int GetSequenceNumber()
         {
-          return BitOp::ToInteger<unsigned int>(&(*(_payload->begin())), 4);
+          unsigned int sequenceNumber = 0U;
+          TryGetSequenceNumber(_payload->data(), (unsigned int) _payload->size(), sequenceNumber);
+          return sequenceNumber;
         }
 
-        static unsigned int GetSequenceNumber(const BYTE* bs)
+        ///<returns>false if the payload is truncated</returns>
+        static bool TryGetSequenceNumber(const BYTE* bs, unsigned int len, unsigned int& sequenceNumber)
         {
-          return BitOp::ToInteger<unsigned int>(bs, 4);
+          ByteReader br(bs, len);
+          sequenceNumber = br.get_u32be();
+          return !br.IsTruncated();
         }
       };
 
@@ -358,18 +393,23 @@ namespace Microsoft
         ProtoAckWindowSizeMessage(unsigned int windowSize) :
           RTMPMessage(0, sizeof(unsigned int), RTMPMessageType::PROTOACKWINDOWSIZE, 0)
         {
-          BitOp::AddToBitstream(windowSize, this->_payload);
+          ByteWriter(*_payload, 4).put_u32be(windowSize);
         }
 
 
         unsigned int GetWindowSize()
         {
-          return BitOp::ToInteger<unsigned int>(&(*(_payload->begin())), 4);
+          unsigned int windowSize = 0U;
+          TryGetWindowSize(_payload->data(), (unsigned int) _payload->size(), windowSize);
+          return windowSize;
         }
 
-        static unsigned int GetWindowSize(const BYTE* bs)
+        ///<returns>false if the payload is truncated</returns>
+        static bool TryGetWindowSize(const BYTE* bs, unsigned int len, unsigned int& windowSize)
         {
-          return BitOp::ToInteger<unsigned int>(bs, 4);
+          ByteReader br(bs, len);
+          windowSize = br.get_u32be();
+          return !br.IsTruncated();
         }
 
       };
@@ -391,30 +431,36 @@ namespace Microsoft
             throw invalid_argument("Invalid Bandwidth limit type");
 
 
-          BitOp::AddToBitstream(bandwidth, this->_payload);
-          BitOp::AddToBitstream(bandwidthLimitType, this->_payload);
+          ByteWriter bw(*_payload, 5);
+          bw.put_u32be(bandwidth);
+          bw.put_u8(bandwidthLimitType);
 
         }
 
 
         unsigned int GetBandwidth()
         {
-          return BitOp::ToInteger<unsigned int>(&(*(_payload->begin())), 4);
+          unsigned int bandwidth = 0U;
+          BYTE bandwidthLimitType = 0;
+          TryGetBandwidth(_payload->data(), (unsigned int) _payload->size(), bandwidth, bandwidthLimitType);
+          return bandwidth;
         }
 
         BYTE GetBandwidthLimitType()
         {
-          return (*_payload)[4];
+          unsigned int bandwidth = 0U;
+          BYTE bandwidthLimitType = 0;
+          TryGetBandwidth(_payload->data(), (unsigned int) _payload->size(), bandwidth, bandwidthLimitType);
+          return bandwidthLimitType;
         }
 
-        static unsigned int GetBandwidth(const BYTE* bs)
+        ///<returns>false if the payload is truncated</returns>
+        static bool TryGetBandwidth(const BYTE* bs, unsigned int len, unsigned int& bandwidth, BYTE& bandwidthLimitType)
         {
-          return BitOp::ToInteger<unsigned int>(bs, 4);
-        }
-
-        static BYTE GetBandwidthLimitType(const BYTE* bs)
-        {
-          return bs[4];
+          ByteReader br(bs, len);
+          bandwidth = br.get_u32be();
+          bandwidthLimitType = br.get_u8();
+          return !br.IsTruncated();
         }
 
       };
@@ -430,7 +476,7 @@ namespace Microsoft
 
         unsigned short GetType()
         {
-          return BitOp::ToInteger<unsigned short>(&(*(_payload->begin())), 2);
+          return ByteReader(_payload->data(), (unsigned int) _payload->size()).get_u16be();
         }
 
         const BYTE* GetData()
@@ -441,6 +487,88 @@ namespace Microsoft
 
 
 
+      ///<summary>Aggregate message (type 22) - a run of FLV tags (11 byte tag header, payload, 4 byte back pointer) sent as a single message.
+      ///Tag timestamps are relative to the first tag, the aggregate message itself carries the absolute timestamp of the first tag</summary>
+      class AggregateMessage : public RTMPMessage
+      {
+      public:
+
+        static const unsigned int TAGHEADERSIZE = 11;
+        static const unsigned int BACKPOINTERSIZE = 4;
+
+        AggregateMessage(unsigned int messageStreamID, const std::vector<shared_ptr<RTMPMessage>>& messages) :
+          RTMPMessage(messages.empty() ? 0U : messages.front()->GetTimestamp(), 0U, RTMPMessageType::AGGREGATE, messageStreamID)
+        {
+          unsigned int size = 0;
+          for (auto& msg : messages)
+            size += GetTagSize(msg->GetMessageLength());
+          ByteWriter bw(*_payload, size);
+
+          for (auto& msg : messages)
+          {
+            unsigned int relativeTimestamp = msg->GetTimestamp() - _timestamp;
+
+            bw.put_u8(msg->GetMessageTypeID());
+            bw.put_u24be(msg->GetMessageLength());
+            bw.put_u24be(relativeTimestamp);
+            bw.put_u8((BYTE) (relativeTimestamp >> 24)); //timestamp extension
+            bw.put_u24be(0U); //stream ID - always 0, the aggregate message stream ID applies
+            if (msg->GetMessageLength() > 0)
+              bw.put_bytes(&(*(msg->GetPayload()->begin())), msg->GetMessageLength());
+            bw.put_u32be(TAGHEADERSIZE + msg->GetMessageLength()); //back pointer
+          }
+
+          _messageLength = (unsigned int) _payload->size();
+        }
+
+        ///<summary>Size a message adds to an aggregate payload</summary>
+        static unsigned int GetTagSize(unsigned int messageLength)
+        {
+          return TAGHEADERSIZE + messageLength + BACKPOINTERSIZE;
+        }
+
+        ///<summary>Splits an aggregate payload back into the individual messages</summary>
+        ///<param name='timestamp'>Absolute timestamp of the aggregate message - tag timestamps are renormalized so that the first tag lands on it</param>
+        static std::vector<shared_ptr<RTMPMessage>> Split(unsigned int timestamp, unsigned int messageStreamID, const BYTE* data, unsigned int len)
+        {
+          std::vector<shared_ptr<RTMPMessage>> retval;
+          ByteReader br(data, len);
+          unsigned int firstTagTimestamp = 0;
+
+          while (br.GetRemaining() > 0)
+          {
+            BYTE messageTypeID = br.get_u8();
+            unsigned int messageLength = br.get_u24be();
+            unsigned int tagTimestamp = br.get_u24be();
+            tagTimestamp |= (unsigned int) br.get_u8() << 24; //timestamp extension
+            br.skip(3); //stream ID
+            if (br.IsTruncated())
+              throw std::logic_error("Parse Error : Truncated aggregate message tag header");
+
+            const BYTE* payload = br.get_bytes(messageLength);
+            unsigned int backPointer = br.get_u32be();
+            if (br.IsTruncated())
+              throw std::logic_error("Parse Error : Truncated aggregate message tag");
+            if (backPointer != TAGHEADERSIZE + messageLength)
+              throw std::logic_error("Parse Error : Aggregate message back pointer does not match tag size");
+
+            if (retval.empty())
+              firstTagTimestamp = tagTimestamp;
+
+            retval.push_back(make_shared<RTMPMessage>(
+              timestamp + (tagTimestamp - firstTagTimestamp),
+              messageLength,
+              messageTypeID,
+              messageStreamID,
+              const_cast<BYTE*>(payload)));
+          }
+
+          return retval;
+        }
+      };
+
+
+
       class AMF0Entity
       {
       public:
@@ -455,7 +583,8 @@ namespace Microsoft
 
         }
 
-        AMF0Entity(wstring stringValue) : _stringValue(stringValue)
+        ///<param name='stringValue'>UTF-8 string</param>
+        AMF0Entity(string stringValue) : _stringValue(stringValue)
         {
           if (stringValue.size() <= 65535)
             _type = AMF0TypeMarker::String;
@@ -468,93 +597,241 @@ namespace Microsoft
 
         }
 
-        AMF0Entity(shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>>  propmap) : _type(AMF0TypeMarker::Object), _propertyMap(propmap)
+        AMF0Entity(shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>>  propmap) : _type(AMF0TypeMarker::Object), _propertyMap(propmap)
         {
 
         }
 
+        ///<param name='type'>AMF0TypeMarker::Object, AMF0TypeMarker::EcmaArray or AMF0TypeMarker::TypedObject</param>
+        AMF0Entity(BYTE type, shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>>  propmap) : _type(type), _propertyMap(propmap)
+        {
 
+        }
 
-        static void EncodeString(std::wstring str, shared_ptr<vector<BYTE>> bs)
+        AMF0Entity(shared_ptr<std::vector<shared_ptr<AMF0Entity>>> elements) : _type(AMF0TypeMarker::StrictArray), _elements(elements)
         {
-          BitOp::AddToBitstream<BYTE>(AMF0TypeMarker::String, bs, false);
 
-          if (str.size() <= 65535)
-            BitOp::AddToBitstream<unsigned short>((unsigned short) str.size(), bs, true);
-          else
-            BitOp::AddToBitstream<unsigned int>((unsigned int) str.size(), bs, true);
+        }
+
+        ///<summary>An AMF3 value - written after an AvmPlus marker</summary>
+        AMF0Entity(shared_ptr<AMF3Entity> amf3Value) : _type(AMF0TypeMarker::AvmPlus), _amf3Value(amf3Value)
+        {
+
+        }
 
-          if (str.size() > 0)
-            BitOp::AddToBitstream(str, bs);
+        ///<param name='dateValue'>Milliseconds since the epoch (UTC)</param>
+        ///<param name='timeZone'>Reserved by the spec - senders should write 0</param>
+        static shared_ptr<AMF0Entity> CreateDate(double dateValue, short timeZone = 0)
+        {
+          auto retval = make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::Date);
+          retval->_numberValue = dateValue;
+          retval->_timeZone = timeZone;
+          return retval;
         }
 
-        static void EncodeName(std::wstring str, shared_ptr<vector<BYTE>> bs)
+        ///<param name='className'>UTF-8 class name the receiver should deserialize the object as</param>
+        static shared_ptr<AMF0Entity> CreateTypedObject(string className, shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>> propmap)
         {
+          auto retval = make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::TypedObject, propmap);
+          retval->_stringValue = className;
+          return retval;
+        }
 
+        ///<param name='xml'>UTF-8 XML text</param>
+        static shared_ptr<AMF0Entity> CreateXmlDocument(string xml)
+        {
+          auto retval = make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::XmlDocument);
+          retval->_stringValue = xml;
+          return retval;
+        }
+
+        ///<param name='index'>Index of an earlier object, typed object or array in the same payload</param>
+        static shared_ptr<AMF0Entity> CreateReference(unsigned short index)
+        {
+          auto retval = make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::Reference);
+          retval->_referenceIndex = index;
+          return retval;
+        }
+
+
+
+        ///<summary>Encodes a UTF-8 string value - strings longer than 65535 bytes are written as long strings</summary>
+        static void EncodeString(const std::string& str, shared_ptr<vector<BYTE>> bs)
+        {
           if (str.size() <= 65535)
-            BitOp::AddToBitstream<unsigned short>((unsigned short) str.size(), bs, true);
+          {
+            ByteWriter bw(*bs, 3 + (unsigned int) str.size());
+            bw.put_u8(AMF0TypeMarker::String);
+            bw.put_u16be((unsigned short) str.size());
+            bw.put_bytes((const BYTE*) str.data(), (unsigned int) str.size());
+          }
           else
-            BitOp::AddToBitstream<unsigned int>((unsigned int) str.size(), bs, true);
+          {
+            ByteWriter bw(*bs, 5 + (unsigned int) str.size());
+            bw.put_u8(AMF0TypeMarker::LongString);
+            bw.put_u32be((unsigned int) str.size());
+            bw.put_bytes((const BYTE*) str.data(), (unsigned int) str.size());
+          }
+        }
+
+        ///<summary>Encodes a UTF-8 object property name</summary>
+        static void EncodeName(const std::string& str, shared_ptr<vector<BYTE>> bs)
+        {
+          if (str.size() > 65535)
+            throw invalid_argument("AMF0 property names cannot be longer than 65535 bytes");
 
-          if (str.size() > 0)
-            BitOp::AddToBitstream(str, bs);
+          ByteWriter bw(*bs, 2 + (unsigned int) str.size());
+          bw.put_u16be((unsigned short) str.size());
+          bw.put_bytes((const BYTE*) str.data(), (unsigned int) str.size());
         }
 
 
         static void EncodeNumber(double num, shared_ptr<vector<BYTE>> bs)
         {
-          BitOp::AddToBitstream<BYTE>(AMF0TypeMarker::Number, bs, false);
-          BitOp::AddToBitstream<unsigned long long>(BitOp::FromDoubleToFPRep(num), bs, true);
+          ByteWriter bw(*bs, 9);
+          bw.put_u8(AMF0TypeMarker::Number);
+          bw.put_f64be(num);
         }
 
         static void EncodeBoolean(bool val, shared_ptr<vector<BYTE>> bs)
         {
-          BitOp::AddToBitstream<BYTE>(AMF0TypeMarker::Boolean, bs, false);
-          BitOp::AddToBitstream<BYTE>(val ? 1 : 0, bs, false);
+          ByteWriter bw(*bs, 2);
+          bw.put_u8(AMF0TypeMarker::Boolean);
+          bw.put_u8(val ? 1 : 0);
         }
 
         static void EncodeNull(shared_ptr<vector<BYTE>> bs)
         {
-          BitOp::AddToBitstream<BYTE>(AMF0TypeMarker::Null, bs, false);
+          ByteWriter(*bs, 1).put_u8(AMF0TypeMarker::Null);
+        }
+
+        static void EncodeUndefined(shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter(*bs, 1).put_u8(AMF0TypeMarker::Undefined);
         }
 
+        static void EncodeUnsupported(shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter(*bs, 1).put_u8(AMF0TypeMarker::Unsupported);
+        }
 
-        static void EncodeObject(shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>> propmap, shared_ptr<vector<BYTE>> bs)
+        static void EncodeDate(double dateValue, short timeZone, shared_ptr<vector<BYTE>> bs)
         {
-          BitOp::AddToBitstream(AMF0TypeMarker::Object, bs);
+          ByteWriter bw(*bs, 11);
+          bw.put_u8(AMF0TypeMarker::Date);
+          bw.put_f64be(dateValue);
+          bw.put_u16be((unsigned short) timeZone);
+        }
 
-          for (auto& t : *propmap)
-          {
-            auto name = std::get<0>(t);
+        static void EncodeReference(unsigned short index, shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter bw(*bs, 3);
+          bw.put_u8(AMF0TypeMarker::Reference);
+          bw.put_u16be(index);
+        }
 
-            AMF0Entity::EncodeName(name, bs);
+        static void EncodeXmlDocument(const std::string& xml, shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter bw(*bs, 5 + (unsigned int) xml.size());
+          bw.put_u8(AMF0TypeMarker::XmlDocument);
+          bw.put_u32be((unsigned int) xml.size());
+          bw.put_bytes((const BYTE*) xml.data(), (unsigned int) xml.size());
+        }
 
+        ///<summary>Encodes an anonymous object - property values can be of any type, objects included</summary>
+        static void EncodeObject(shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>> propmap, shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter(*bs, 1).put_u8(AMF0TypeMarker::Object);
+          EncodeProperties(propmap, bs);
+        }
 
-            auto entity = std::get<1>(t);
+        ///<summary>Encodes an associative array - the count written is the number of properties</summary>
+        static void EncodeEcmaArray(shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>> propmap, shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter bw(*bs, 5);
+          bw.put_u8(AMF0TypeMarker::EcmaArray);
+          bw.put_u32be(propmap != nullptr ? (unsigned int) propmap->size() : 0U);
+          EncodeProperties(propmap, bs);
+        }
 
-            if (entity->GetType() == AMF0TypeMarker::String || entity->GetType() == AMF0TypeMarker::LongString)
-            {
-              AMF0Entity::EncodeString(entity->GetStringValue(), bs);
-            }
-            else if (entity->GetType() == AMF0TypeMarker::Number)
-            {
-              AMF0Entity::EncodeNumber(entity->GetNumberValue(), bs);
-            }
-            else if (entity->GetType() == AMF0TypeMarker::Boolean)
-            {
-              AMF0Entity::EncodeBoolean(entity->GetBooleanValue(), bs);
-            }
-            else if (entity->GetType() == AMF0TypeMarker::Object)
-            {
-              AMF0Entity::EncodeObject(entity->GetPropertyMap(), bs); //does AMF0 allow object nesting ???
-            }
-            else if (entity->GetType() == AMF0TypeMarker::Null)
-            {
-              AMF0Entity::EncodeNull(bs);
-            }
+        static void EncodeTypedObject(const std::string& className, shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>> propmap, shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter(*bs, 1).put_u8(AMF0TypeMarker::TypedObject);
+          EncodeName(className, bs);
+          EncodeProperties(propmap, bs);
+        }
+
+        static void EncodeStrictArray(shared_ptr<std::vector<shared_ptr<AMF0Entity>>> elements, shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter bw(*bs, 5);
+          bw.put_u8(AMF0TypeMarker::StrictArray);
+          bw.put_u32be(elements != nullptr ? (unsigned int) elements->size() : 0U);
+          if (elements != nullptr)
+          {
+            for (auto& entity : *elements)
+              Encode(entity, bs);
+          }
+        }
+
+        ///<summary>Switches to AMF3 for a single value - the value gets reference tables of its own</summary>
+        static void EncodeAMF3(shared_ptr<AMF3Entity> value, shared_ptr<vector<BYTE>> bs)
+        {
+          ByteWriter(*bs, 1).put_u8(AMF0TypeMarker::AvmPlus);
+          AMF3Writer(bs).Write(value);
+        }
+
+        ///<summary>Encodes an entity of any type</summary>
+        static void Encode(shared_ptr<AMF0Entity> entity, shared_ptr<vector<BYTE>> bs)
+        {
+          switch (entity->GetType())
+          {
+          case AMF0TypeMarker::Number:
+            EncodeNumber(entity->_numberValue, bs);
+            break;
+          case AMF0TypeMarker::Boolean:
+            EncodeBoolean(entity->_booleanValue, bs);
+            break;
+          case AMF0TypeMarker::String:
+          case AMF0TypeMarker::LongString:
+            EncodeString(entity->_stringValue, bs);
+            break;
+          case AMF0TypeMarker::Object:
+            EncodeObject(entity->_propertyMap, bs);
+            break;
+          case AMF0TypeMarker::Null:
+            EncodeNull(bs);
+            break;
+          case AMF0TypeMarker::Undefined:
+            EncodeUndefined(bs);
+            break;
+          case AMF0TypeMarker::Reference:
+            EncodeReference(entity->_referenceIndex, bs);
+            break;
+          case AMF0TypeMarker::EcmaArray:
+            EncodeEcmaArray(entity->_propertyMap, bs);
+            break;
+          case AMF0TypeMarker::StrictArray:
+            EncodeStrictArray(entity->_elements, bs);
+            break;
+          case AMF0TypeMarker::Date:
+            EncodeDate(entity->_numberValue, entity->_timeZone, bs);
+            break;
+          case AMF0TypeMarker::Unsupported:
+            EncodeUnsupported(bs);
+            break;
+          case AMF0TypeMarker::XmlDocument:
+            EncodeXmlDocument(entity->_stringValue, bs);
+            break;
+          case AMF0TypeMarker::TypedObject:
+            EncodeTypedObject(entity->_stringValue, entity->_propertyMap, bs);
+            break;
+          case AMF0TypeMarker::AvmPlus:
+            EncodeAMF3(entity->_amf3Value, bs);
+            break;
+          default:
+            //MovieClip and Recordset are reserved
+            throw invalid_argument("Unsupported AMF0 type");
           }
-          AMF0Entity::EncodeName(L"", bs);
-          BitOp::AddToBitstream(AMF0TypeMarker::ObjectEnd, bs);
         }
 
         BYTE GetType() {
@@ -562,159 +839,237 @@ namespace Microsoft
         }
 
         double GetNumberValue() {
-          if (_type != AMF0TypeMarker::Number) throw exception("Not a number");
+          if (_type != AMF0TypeMarker::Number) throw std::logic_error("Not a number");
           return _numberValue;
         }
 
-        wstring GetStringValue() {
-          if (_type != AMF0TypeMarker::String) throw exception("Not a string");
+        ///<returns>The UTF-8 string value</returns>
+        string GetStringValue() {
+          if (_type != AMF0TypeMarker::String && _type != AMF0TypeMarker::LongString) throw std::logic_error("Not a string");
           return _stringValue;
         }
 
         bool GetBooleanValue() {
-          if (_type != AMF0TypeMarker::Boolean) throw exception("Not a boolean");
+          if (_type != AMF0TypeMarker::Boolean) throw std::logic_error("Not a boolean");
           return _booleanValue;
         }
 
-        shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>> GetPropertyMap()
+        ///<returns>Milliseconds since the epoch (UTC)</returns>
+        double GetDateValue() {
+          if (_type != AMF0TypeMarker::Date) throw std::logic_error("Not a date");
+          return _numberValue;
+        }
+
+        short GetTimeZone() {
+          if (_type != AMF0TypeMarker::Date) throw std::logic_error("Not a date");
+          return _timeZone;
+        }
+
+        ///<returns>The UTF-8 class name of a typed object</returns>
+        string GetClassName() {
+          if (_type != AMF0TypeMarker::TypedObject) throw std::logic_error("Not a typed object");
+          return _stringValue;
+        }
+
+        ///<returns>The UTF-8 XML text</returns>
+        string GetXmlValue() {
+          if (_type != AMF0TypeMarker::XmlDocument) throw std::logic_error("Not an XML document");
+          return _stringValue;
+        }
+
+        unsigned short GetReferenceIndex() {
+          if (_type != AMF0TypeMarker::Reference) throw std::logic_error("Not a reference");
+          return _referenceIndex;
+        }
+
+        ///<summary>Properties of an object, a typed object or an ECMA array - the caller may change them, so the name index is dropped</summary>
+        shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>> GetPropertyMap()
         {
-          if (_type != AMF0TypeMarker::Object) throw exception("Not an object");
-          if (_propertyMap == nullptr)
-            _propertyMap = make_shared<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>>();
-          return _propertyMap;
+          _propertyIndex.clear();
+          return GetProperties();
         }
 
+        ///<summary>Looks up a property of an object, a typed object or an ECMA array by name.
+        ///The name index is built on the first lookup and rebuilt on the first lookup after GetPropertyMap</summary>
+        ///<returns>nullptr if there is no such property</returns>
+        shared_ptr<AMF0Entity> GetPropertyValue(const std::string& name)
+        {
+          auto propmap = GetProperties();
+          if (_propertyIndex.size() != propmap->size())
+          {
+            _propertyIndex.resize(propmap->size());
+            for (unsigned int i = 0; i < propmap->size(); i++)
+            {
+              auto& key = std::get<0>((*propmap)[i]);
+              _propertyIndex[i].Hash = AMF0PropertyIndex::Hash(key.data(), (unsigned int) key.size());
+              _propertyIndex[i].Position = i;
+            }
+            AMF0PropertyIndex::Sort(_propertyIndex.data(), _propertyIndex.data() + _propertyIndex.size());
+          }
 
+          auto pos = AMF0PropertyIndex::Find(_propertyIndex.data(), _propertyIndex.data() + _propertyIndex.size(),
+            AMF0PropertyIndex::Hash(name.data(), (unsigned int) name.size()),
+            [&propmap, &name](unsigned int position)
+          {
+            return std::get<0>((*propmap)[position]) == name;
+          });
 
+          return pos != AMF0PropertyIndex::NONE ? std::get<1>((*propmap)[pos]) : nullptr;
+        }
 
+        shared_ptr<AMF3Entity> GetAMF3Value()
+        {
+          if (_type != AMF0TypeMarker::AvmPlus) throw std::logic_error("Not an AMF3 value");
+          return _amf3Value;
+        }
 
+        shared_ptr<std::vector<shared_ptr<AMF0Entity>>> GetElements()
+        {
+          if (_type != AMF0TypeMarker::StrictArray) throw std::logic_error("Not a strict array");
+          if (_elements == nullptr)
+            _elements = make_shared<std::vector<shared_ptr<AMF0Entity>>>();
+          return _elements;
+        }
+
+
+
+        ///<summary>Builds entities for the top level values of an AMF0 payload</summary>
         static std::vector<shared_ptr<AMF0Entity>> TryParse(shared_ptr<vector<BYTE>> payload)
+        {
+          return TryParse(payload->size() > 0 ? &(*(payload->begin())) : nullptr, (unsigned int) payload->size());
+        }
+
+        static std::vector<shared_ptr<AMF0Entity>> TryParse(const BYTE* data, unsigned int len)
         {
           std::vector<shared_ptr<AMF0Entity>> retval;
-          bool inObject = false;
-          shared_ptr<AMF0Entity> curObject = nullptr;
-          wstring curPropKey;
-          for (auto itr = payload->begin(); itr != payload->end();)
+          AMF0Reader reader(data, len);
+          AMF0Token tok;
+
+          while (reader.Next(tok))
           {
+            auto entity = ReadEntity(reader, tok);
+            if (entity == nullptr)
+              break;
+            retval.push_back(entity);
+          }
 
-            if (inObject && curPropKey == L"")
-            {
-              auto strlen = BitOp::ToInteger<unsigned short>(&(*(itr)), 2);
-              if (*itr == AMF0TypeMarker::ObjectEnd || strlen == 0)
-              {
-                inObject = false;
-                retval.push_back(curObject);
-                if (*itr == AMF0TypeMarker::ObjectEnd)
-                  ++itr;
-                else
-                  itr += 3;
-                continue;
-              }
-              //read string length 
-              itr += 2;
-              curPropKey = BitOp::ToWideString((char*) &(*(itr)), strlen);
-              itr += strlen;
-            }
+          if (reader.HasError())
+            throw std::logic_error(reader.GetError());
 
-            auto type = *itr;
-            ++itr;
+          return retval;
+        }
 
-            if (type == AMF0TypeMarker::Boolean)
-            {
 
+      private:
 
-              if (inObject)
-              {
-                if (curPropKey == L"")
-                  throw std::logic_error("Parse Error : Missing object property name"); //gotta have a property name
-                curObject->GetPropertyMap()->push_back(std::tuple<wstring, shared_ptr<AMF0Entity>>(curPropKey, make_shared<AMF0Entity>((*itr) == 1 ? true : false)));
-                curPropKey = L"";
-              }
-              else
-              {
-                retval.push_back(make_shared<AMF0Entity>((*itr) == 1 ? true : false));
-              }
-              ++itr;
-            }
-            else if (type == AMF0TypeMarker::Number)
-            {
+        shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>> GetProperties()
+        {
+          if (_type != AMF0TypeMarker::Object && _type != AMF0TypeMarker::EcmaArray && _type != AMF0TypeMarker::TypedObject) throw std::logic_error("Not an object");
+          if (_propertyMap == nullptr)
+            _propertyMap = make_shared<std::vector<tuple<string, shared_ptr<AMF0Entity>>>>();
+          return _propertyMap;
+        }
 
-              if (inObject)
-              {
-                if (curPropKey == L"")
-                  throw std::logic_error("Parse Error : Missing object property name"); //gotta have a property name
-                auto fprep = BitOp::ToInteger<unsigned long long>(&(*(itr)), sizeof(unsigned long long));
-                double val = BitOp::FromFPRepToDouble(fprep);
-                curObject->GetPropertyMap()->push_back(std::tuple<wstring, shared_ptr<AMF0Entity>>(curPropKey, make_shared<AMF0Entity>(val)));
-                curPropKey = L"";
-              }
-              else
-              {
-                auto fprep = BitOp::ToInteger<unsigned long long>(&(*(itr)), sizeof(unsigned long long));
-                double val = BitOp::FromFPRepToDouble(fprep);
-                retval.push_back(make_shared<AMF0Entity>(val));
-              }
-              itr += sizeof(unsigned long long);
-            }
-            else if (type == AMF0TypeMarker::String)
+        static void EncodeProperties(shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>> propmap, shared_ptr<vector<BYTE>> bs)
+        {
+          if (propmap != nullptr)
+          {
+            for (auto& t : *propmap)
             {
-
-              //read string length
-              auto strlen = BitOp::ToInteger<unsigned short>(&(*(itr)), 2);
-              itr += 2;
-
-              if (inObject)
-              {
-                if (curPropKey == L"")
-                  throw std::logic_error("Parse Error : Missing object property name"); //gotta have a property name
-                else
-                {
-                  curObject->GetPropertyMap()->push_back(std::tuple<wstring, shared_ptr<AMF0Entity>>(curPropKey, make_shared<AMF0Entity>(BitOp::ToWideString((char*) &(*(itr)), strlen))));
-                  curPropKey = L"";
-                }
-              }
-              else
-              {
-                retval.push_back(make_shared<AMF0Entity>(BitOp::ToWideString((char*) &(*(itr)), strlen)));
-              }
-              itr += strlen;
+              AMF0Entity::EncodeName(std::get<0>(t), bs);
+              AMF0Entity::Encode(std::get<1>(t), bs);
             }
+          }
+          //empty name + object end marker
+          ByteWriter bw(*bs, 3);
+          bw.put_u16be(0);
+          bw.put_u8(AMF0TypeMarker::ObjectEnd);
+        }
 
-            else if (type == AMF0TypeMarker::Null)
+        ///<summary>Builds the entity for the value that starts with tok - objects and arrays are read up to their end token</summary>
+        ///<returns>nullptr if the reader failed part way through</returns>
+        static shared_ptr<AMF0Entity> ReadEntity(AMF0Reader& reader, const AMF0Token& tok)
+        {
+          switch (tok.Type)
+          {
+          case AMF0TokenType::Number:
+            return make_shared<AMF0Entity>(tok.NumberValue);
+          case AMF0TokenType::Boolean:
+            return make_shared<AMF0Entity>(tok.BooleanValue);
+          case AMF0TokenType::String:
+            return make_shared<AMF0Entity>(tok.ToString());
+          case AMF0TokenType::Null:
+          case AMF0TokenType::Undefined:
+          case AMF0TokenType::Unsupported:
+            return make_shared<AMF0Entity>(tok.Marker);
+          case AMF0TokenType::Date:
+            return CreateDate(tok.NumberValue, tok.TimeZone);
+          case AMF0TokenType::Reference:
+            return CreateReference(tok.ReferenceIndex);
+          case AMF0TokenType::XmlDocument:
+            return CreateXmlDocument(tok.ToString());
+          case AMF0TokenType::AvmPlus:
+          {
+            //a malformed AMF3 value reads as undefined so the values after it keep their positions
+            auto amf3 = AMF3Reader((const BYTE*) tok.StringData, tok.StringLength).TryRead();
+            return amf3 != nullptr ? make_shared<AMF0Entity>(amf3) : make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::Undefined);
+          }
+          case AMF0TokenType::ObjectBegin:
+          {
+            auto retval = make_shared<AMF0Entity>(tok.Marker);
+            if (tok.Marker == AMF0TypeMarker::TypedObject)
+              retval->_stringValue = tok.ToString();
+            auto propmap = retval->GetPropertyMap();
+            AMF0Token name;
+            AMF0Token val;
+
+            while (reader.Next(name) && name.Type == AMF0TokenType::PropertyName)
             {
-              retval.push_back(make_shared<AMF0Entity>(type));
-
+              if (!reader.Next(val))
+                return nullptr;
+              auto entity = ReadEntity(reader, val);
+              if (entity == nullptr)
+                return nullptr;
+              propmap->push_back(std::tuple<string, shared_ptr<AMF0Entity>>(name.ToString(), entity));
             }
-            else if (type == AMF0TypeMarker::EcmaArray)
-            {
-              //we do not process arrays -no scenarios need it yet
-              while (*itr != AMF0TypeMarker::ObjectEnd)
-                ++itr;
 
-              ++itr;//go past the object end marker
+            return reader.HasError() ? nullptr : retval;
+          }
+          case AMF0TokenType::ArrayBegin:
+          {
+            auto retval = make_shared<AMF0Entity>((BYTE) AMF0TypeMarker::StrictArray);
+            auto elements = retval->GetElements();
+            //the count comes off the wire - do not trust it for a reservation
+            AMF0Token val;
 
-              if (inObject)
-                curPropKey = L"";
-            }
-            else if (type == AMF0TypeMarker::Object)
+            while (reader.Next(val) && val.Type != AMF0TokenType::ArrayEnd)
             {
-
-              inObject = true;
-              curObject = make_shared<AMF0Entity>(type);
-
+              auto entity = ReadEntity(reader, val);
+              if (entity == nullptr)
+                return nullptr;
+              elements->push_back(entity);
             }
 
+            return reader.HasError() ? nullptr : retval;
+          }
+          default:
+            return nullptr;
           }
-          return retval;
         }
 
 
-      private:
         BYTE _type = AMF0TypeMarker::Unsupported;
         double  _numberValue = 0;
-        wstring _stringValue = L"";
+        //string and XML document values, class name of a typed object
+        string _stringValue = "";
         bool _booleanValue = false;
-        shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>> _propertyMap = nullptr;
+        short _timeZone = 0;
+        unsigned short _referenceIndex = 0;
+        shared_ptr<std::vector<tuple<string, shared_ptr<AMF0Entity>>>> _propertyMap = nullptr;
+        shared_ptr<std::vector<shared_ptr<AMF0Entity>>> _elements = nullptr;
+        shared_ptr<AMF3Entity> _amf3Value = nullptr;
+        //built lazily by GetPropertyValue
+        std::vector<AMF0PropertyIndex::Entry> _propertyIndex;
       };
 
 
@@ -722,7 +1077,7 @@ namespace Microsoft
       class AMF0EncodedCommandOrData : public RTMPMessage
       {
       public:
-        AMF0EncodedCommandOrData(wstring commandName, unsigned int messageStreamID, unsigned int transactionID) :
+        AMF0EncodedCommandOrData(string commandName, unsigned int messageStreamID, unsigned int transactionID) :
           RTMPMessage(0, 0, RTMPMessageType::COMMANDAMF0, messageStreamID)
         {
           _entities.push_back(make_shared<AMF0Entity>(commandName));
@@ -735,7 +1090,7 @@ namespace Microsoft
 
         }
 
-        AMF0EncodedCommandOrData(wstring commandName, unsigned int messageStreamID) :
+        AMF0EncodedCommandOrData(string commandName, unsigned int messageStreamID) :
           RTMPMessage(0, 0, RTMPMessageType::DATAAMF0, messageStreamID)
         {
           _entities.push_back(make_shared<AMF0Entity>(commandName));
@@ -743,7 +1098,7 @@ namespace Microsoft
 
 
 
-        wstring GetCommandName()
+        string GetCommandName()
         {
           return _entities.begin()->get()->GetStringValue();
         }
@@ -758,27 +1113,19 @@ namespace Microsoft
         }
 
 
-        shared_ptr<AMF0Entity> GetObjectPropertyValue(wstring PropertyName)
+        ///<summary>Looks up a property of the first top level object that has it - the info object of a status or result</summary>
+        ///<returns>nullptr if no object has the property</returns>
+        shared_ptr<AMF0Entity> GetObjectPropertyValue(string PropertyName)
         {
           shared_ptr<AMF0Entity> retval = nullptr;
           for (auto& ent : _entities)
           {
-            if (ent->GetType() == AMF0TypeMarker::Object)
+            auto type = ent->GetType();
+            if (type == AMF0TypeMarker::Object || type == AMF0TypeMarker::TypedObject || type == AMF0TypeMarker::EcmaArray)
             {
-              auto propmap = ent->GetPropertyMap();
-              auto match = std::find_if(propmap->begin(), propmap->end(), [&PropertyName](tuple<wstring, shared_ptr<AMF0Entity>> tpl)
-              {
-                wstring name = std::get<0>(tpl);
-                return true;
-              });
-
-              if (match != propmap->end())
-              {
-                retval = std::get<1>(*match);
+              retval = ent->GetPropertyValue(PropertyName);
+              if (retval != nullptr)
                 break;
-              }
-
-
             }
           }
 
@@ -791,28 +1138,7 @@ namespace Microsoft
             _payload = make_shared<vector<BYTE>>();
 
           for (auto& entity : _entities)
-          {
-            if (entity->GetType() == AMF0TypeMarker::String || entity->GetType() == AMF0TypeMarker::LongString)
-            {
-              AMF0Entity::EncodeString(entity->GetStringValue(), _payload);
-            }
-            else if (entity->GetType() == AMF0TypeMarker::Number)
-            {
-              AMF0Entity::EncodeNumber(entity->GetNumberValue(), _payload);
-            }
-            else if (entity->GetType() == AMF0TypeMarker::Boolean)
-            {
-              AMF0Entity::EncodeBoolean(entity->GetBooleanValue(), _payload);
-            }
-            else if (entity->GetType() == AMF0TypeMarker::Null)
-            {
-              AMF0Entity::EncodeNull(_payload);
-            }
-            else if (entity->GetType() == AMF0TypeMarker::Object)
-            {
-              AMF0Entity::EncodeObject(entity->GetPropertyMap(), _payload);
-            }
-          }
+            AMF0Entity::Encode(entity, _payload);
         }
       protected:
 
@@ -821,163 +1147,34 @@ namespace Microsoft
 
 
 
-
-
-
-      class  Command_Connect : public AMF0EncodedCommandOrData
-      {
-      public:
-        Command_Connect(unsigned int transactionID, wstring serverapp, wstring tcUrl, unsigned short audioCodecs, unsigned short videoCodecs) :
-          AMF0EncodedCommandOrData(L"connect", 0, transactionID)
-        {
-          shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>> props
-            = make_shared<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>>();
-
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"app", make_shared<AMF0Entity>(serverapp)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"tcUrl", make_shared<AMF0Entity>(tcUrl)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audioCodecs", make_shared<AMF0Entity>((double) audioCodecs)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"videoCodecs", make_shared<AMF0Entity>((double) videoCodecs)));
-          /*  props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"type", make_shared<AMF0Entity>(wstring(L"nonprivate"))));
-            props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"flashVer", make_shared<AMF0Entity>(wstring(L"wirecast/FM 1.0 (compatible; MSS/1.0)"))));*/
-
-
-          _entities.push_back(make_shared<AMF0Entity>(props));
-
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
-        }
-
-        Command_Connect(unsigned int transactionID, wstring serverapp, wstring tcUrl, unsigned short codec, bool AudioOnly) :
-          AMF0EncodedCommandOrData(L"connect", 0, transactionID)
-        {
-          shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>> props
-            = make_shared<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>>();
-
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"app", make_shared<AMF0Entity>(serverapp)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"tcUrl", make_shared<AMF0Entity>(tcUrl)));
-          if (AudioOnly)
-            props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audioCodecs", make_shared<AMF0Entity>((double) codec)));
-          else
-            props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"videoCodecs", make_shared<AMF0Entity>((double) codec)));
-          /*  props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"type", make_shared<AMF0Entity>(wstring(L"nonprivate"))));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"flashVer", make_shared<AMF0Entity>(wstring(L"wirecast/FM 1.0 (compatible; MSS/1.0)"))));*/
-
-
-          _entities.push_back(make_shared<AMF0Entity>(props));
-
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
-        }
-
-      };
-
-
-
-
-
-      class  Command_CreateStream : public AMF0EncodedCommandOrData
-      {
-      public:
-        Command_CreateStream(unsigned int transactionID) :
-          AMF0EncodedCommandOrData(L"createStream", 0, transactionID)
-        {
-
-          _entities.push_back(make_shared<AMF0Entity>(AMF0TypeMarker::Null));
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
-        }
-      };
-
-
-
-
-
-      class  Command_ReleaseStream : public AMF0EncodedCommandOrData
+      ///<summary>Command or data message in its AMF3 flavor (type 17 or 15) - a format byte of 0 followed by AMF0 values, any of which can switch to AMF3</summary>
+      class AMF3EncodedCommandOrData : public AMF0EncodedCommandOrData
       {
       public:
-        Command_ReleaseStream(unsigned int transactionID, wstring streamName) :
-          AMF0EncodedCommandOrData(L"releaseStream", 0, transactionID)
+        ///<summary>Outbound data message (type 15) - add values with AddValue, then call Encode</summary>
+        AMF3EncodedCommandOrData(string name, unsigned int messageStreamID) :
+          AMF0EncodedCommandOrData(name, messageStreamID)
         {
-          _entities.push_back(make_shared<AMF0Entity>(AMF0TypeMarker::Null));
-          _entities.push_back(make_shared<AMF0Entity>(streamName));
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
+          _messageTypeID = RTMPMessageType::DATAAMF3;
         }
-      };
-
-      class  Command_FCPublish : public AMF0EncodedCommandOrData
-      {
-      public:
-        Command_FCPublish(unsigned int transactionID, wstring streamName) :
-          AMF0EncodedCommandOrData(L"FCPublish", 0, transactionID)
-        {
-          _entities.push_back(make_shared<AMF0Entity>(AMF0TypeMarker::Null));
-          _entities.push_back(make_shared<AMF0Entity>(streamName));
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
-        }
-      };
-
-
-
-
 
-      class  Command_PublishStream : public AMF0EncodedCommandOrData
-      {
-      public:
-        Command_PublishStream(unsigned int transactionID, unsigned int messageStreamID, wstring streamName, wstring publishType) :
-          AMF0EncodedCommandOrData(L"publish", messageStreamID, transactionID)
+        ///<param name='entities'>Values that follow the format byte</param>
+        AMF3EncodedCommandOrData(std::vector<shared_ptr<AMF0Entity>> entities, unsigned int messageLength, unsigned int messageStreamID, BYTE messageTypeID) :
+          AMF0EncodedCommandOrData(entities, messageLength, messageStreamID)
         {
-          _entities.push_back(make_shared<AMF0Entity>(AMF0TypeMarker::Null));
-          _entities.push_back(make_shared<AMF0Entity>(streamName));
-          _entities.push_back(make_shared<AMF0Entity>(publishType));
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
+          _messageTypeID = messageTypeID;
         }
-      };
 
-      class  Command_UnpublishStream : public AMF0EncodedCommandOrData
-      {
-      public:
-        Command_UnpublishStream(unsigned int transactionID, unsigned int messageStreamID) :
-          AMF0EncodedCommandOrData(L"publish", messageStreamID, transactionID)
+        void AddValue(shared_ptr<AMF3Entity> value)
         {
-          _entities.push_back(make_shared<AMF0Entity>(AMF0TypeMarker::Null));
-          _entities.push_back(make_shared<AMF0Entity>(false));
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
+          _entities.push_back(make_shared<AMF0Entity>(value));
         }
-      };
 
-      class  Command_CloseStream : public AMF0EncodedCommandOrData
-      {
-      public:
-        Command_CloseStream(unsigned int transactionID, unsigned int messageStreamID) :
-          AMF0EncodedCommandOrData(L"closeStream", messageStreamID, transactionID)
+        virtual void Encode()
         {
-          _entities.push_back(make_shared<AMF0Entity>(AMF0TypeMarker::Null));
-          Encode();
+          _payload->clear();
+          ByteWriter(*_payload, 1).put_u8(0);
+          AMF0EncodedCommandOrData::Encode();
           _messageLength = (unsigned int) _payload->size();
         }
       };
@@ -986,111 +1183,6 @@ namespace Microsoft
 
 
 
-      class Command_SetDataFrame : public AMF0EncodedCommandOrData
-      {
-      public:
-        Command_SetDataFrame(unsigned int transactionID, unsigned int messageStreamID,
-          double videoFrameRate,
-          unsigned int videoFrameWidth,
-          unsigned int videoFrameHeight,
-          wstring videoCodec,
-          unsigned int videoBitrate,
-          unsigned int videoKeyFrameFrequency,
-          wstring audioCodec,
-          unsigned int audioSampleRate,
-          unsigned int audioChannels,
-          unsigned int audioBitrate) :
-          AMF0EncodedCommandOrData(L"@setDataFrame", messageStreamID)
-        {
-
-          _entities.push_back(make_shared<AMF0Entity>(wstring(L"onMetaData")));
-
-          shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>> props
-            = make_shared<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>>();
-
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"framerate", make_shared<AMF0Entity>(videoFrameRate)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"width", make_shared<AMF0Entity>((double) videoFrameWidth)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"height", make_shared<AMF0Entity>((double) videoFrameHeight)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"videocodecid", make_shared<AMF0Entity>(videoCodec)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"videodatarate", make_shared<AMF0Entity>((double) videoBitrate)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"videokeyframe_frequency", make_shared<AMF0Entity>((double) videoKeyFrameFrequency)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audiocodecid", make_shared<AMF0Entity>(audioCodec)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audiosamplerate", make_shared<AMF0Entity>((double) audioSampleRate)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audiochannels", make_shared<AMF0Entity>((double) audioChannels)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audiodatarate", make_shared<AMF0Entity>((double) audioBitrate)));
-
-          _entities.push_back(make_shared<AMF0Entity>(props));
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
-        }
-
-        Command_SetDataFrame(unsigned int transactionID, unsigned int messageStreamID,
-
-          wstring audioCodec,
-          unsigned int audioSampleRate,
-          unsigned int audioChannels,
-          unsigned int audioBitrate) :
-          AMF0EncodedCommandOrData(L"@setDataFrame", messageStreamID)
-        {
-
-          _entities.push_back(make_shared<AMF0Entity>(wstring(L"onMetaData")));
-
-          shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>> props
-            = make_shared<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>>();
-
-
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audiocodecid", make_shared<AMF0Entity>(audioCodec)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audiosamplerate", make_shared<AMF0Entity>((double) audioSampleRate)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audiochannels", make_shared<AMF0Entity>((double) audioChannels)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"audiodatarate", make_shared<AMF0Entity>((double) audioBitrate)));
-
-          _entities.push_back(make_shared<AMF0Entity>(props));
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
-        }
-
-
-        Command_SetDataFrame(unsigned int transactionID, unsigned int messageStreamID,
-          double videoFrameRate,
-          unsigned int videoFrameWidth,
-          unsigned int videoFrameHeight,
-          wstring videoCodec,
-          unsigned int videoBitrate,
-          unsigned int videoKeyFrameFrequency) :
-          AMF0EncodedCommandOrData(L"@setDataFrame", messageStreamID)
-        {
-
-          _entities.push_back(make_shared<AMF0Entity>(wstring(L"onMetaData")));
-
-          shared_ptr<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>> props
-            = make_shared<std::vector<tuple<wstring, shared_ptr<AMF0Entity>>>>();
-
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"framerate", make_shared<AMF0Entity>(videoFrameRate)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"width", make_shared<AMF0Entity>((double) videoFrameWidth)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"height", make_shared<AMF0Entity>((double) videoFrameHeight)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"videocodecid", make_shared<AMF0Entity>(videoCodec)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"videodatarate", make_shared<AMF0Entity>((double) videoBitrate)));
-          props->push_back(tuple<wstring, shared_ptr<AMF0Entity>>(L"videokeyframe_frequency", make_shared<AMF0Entity>((double) videoKeyFrameFrequency)));
-
-          _entities.push_back(make_shared<AMF0Entity>(props));
-
-          Encode();
-
-
-          _messageLength = (unsigned int) _payload->size();
-        }
-
-      };
-
-
-
-
 
       class  Command_Result : public AMF0EncodedCommandOrData
       {
@@ -29,6 +29,7 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "RTMPMessageFormats.h"
 #include "RTMPMessenger.h"
 #include "RTMPChunking.h"
+#include "CommandTemplates.h"
 #include <agents.h>
 #include <cmath>
 
@@ -42,54 +43,95 @@ using namespace Windows::Foundation;
 using namespace Microsoft::Media::RTMP;
 
 RTMPMessenger::RTMPMessenger(PublishProfile^ params) :
-  _streamSocket(nullptr)
+  RTMPMessenger(params, make_shared<WinRTTransport>())
+{
+
+}
+
+RTMPMessenger::RTMPMessenger(PublishProfile^ params, std::shared_ptr<RTMPTransport> transport) :
+  _transport(transport)
 {
   _sessionManager = make_shared<RTMPSessionManager>(params);
+  _chunkDecoder = make_shared<ChunkDecoder>(_sessionManager->GetServerChunkSize());
+  _commandDispatcher = make_shared<CommandDispatcher>();
+  RegisterMessageHandlers();
+  _receiveBuffer = make_shared<std::vector<BYTE>>(RECEIVEBUFFERSIZE);
+  _chunkInterleaver = make_shared<ChunkInterleaver>(_sessionManager->GetClientChunkSize(), _sessionManager->IsChunkInterleavingEnabled());
+  _audioAggregator = make_shared<MessageAggregator>(_sessionManager->GetAggregationWindowMilliseconds(), _sessionManager->GetAggregationWindowBytes());
+  _videoAggregator = make_shared<MessageAggregator>(_sessionManager->GetAggregationWindowMilliseconds(), _sessionManager->GetAggregationWindowBytes());
+  _sendBuffer = make_shared<SendRingBuffer>(GetSendBufferSize(_sessionManager->GetClientChunkSize()));
 }
 
 RTMPMessenger::~RTMPMessenger()
 {
-
+  //nothing to wait for - the receive loop only holds the messenger weakly, and a read completing after this finds it gone
+  _transport->Close();
 }
 
 
 task<void> RTMPMessenger::ConnectAsync()
 {
-  _streamSocket = ref new StreamSocket();
-
-
-  _streamSocket->Control->KeepAlive = true;
-  _streamSocket->Control->NoDelay = true;
-
-
-  return create_task(
-    _streamSocket->ConnectAsync(
-      ref new HostName(
-        ref new String(_sessionManager->GetHostName().data())),
-      ref new String(_sessionManager->GetPortNumber().data())
-      ));
+  _connectStarted = std::chrono::steady_clock::now();
+  _publishTimings = PublishTimings();
 
+  task_completion_event<void> tce;
+  _transport->Connect(Utf8::FromWide(_sessionManager->GetHostName()), Utf8::FromWide(_sessionManager->GetPortNumber()), [tce](std::exception_ptr error)
+  {
+    if (error != nullptr)
+      tce.set_exception(error);
+    else
+      tce.set();
+  });
+  return create_task(tce)
+    .then([this]()
+  {
+    //the chunk size controller aligns chunks to the segment size - keep the default if the transport cannot tell
+    auto pathMSS = _transport->GetPathMSS();
+    if (pathMSS > 0)
+      _sessionManager->SetPathMSS(pathMSS);
+    MarkPublishTiming(&PublishTimings::Connected);
+  });
 }
 
 void RTMPMessenger::Disconnect()
 {
-  delete _streamSocket;
+  _transport->Close();
 }
 
 task<void> RTMPMessenger::CloseAsync()
 {
-  return SendUnpublishAndCloseStreamAsync().then([](unsigned int i) { return; });
+  LOG("RTMPMessenger::CloseAsync() : Max audio queueing delay (us) = " << GetMaxAudioQueueingDelay()
+    << (_chunkInterleaver->IsInterleavingEnabled() ? L"" : L" (interleaving disabled)"));
+  return create_task([this]()
+  {
+    FlushAggregatedMessages();
+  })
+    .then([this]()
+  {
+    return SendUnpublishAndCloseStreamAsync();
+  })
+    .then([](unsigned int i) { return; });
 }
 
 task<void> RTMPMessenger::HandshakeAsync()
 {
-  if (_sessionManager->GetServerType() == RTMPServerType::Azure)
-    return HandshakeAsyncAzure();
+  task<void> handshake;
+  if (_sessionManager->IsPipelinedHandshakeEnabled())
+    handshake = HandshakeAsyncPipelined();
+  else if (_sessionManager->GetServerType() == RTMPServerType::Azure)
+    handshake = HandshakeAsyncAzure();
   else if (_sessionManager->GetServerType() == RTMPServerType::Wowza)
-    return HandshakeAsyncWowza();
+    handshake = HandshakeAsyncWowza();
   else
     throw std::invalid_argument("Unknown RTMP server type");
 
+  return handshake.then([this]()
+  {
+    LOG("RTMPMessenger::HandshakeAsync() : Time to publish (ms) = " << _publishTimings.Published
+      << " (TCP " << _publishTimings.Connected << ", handshake " << _publishTimings.Handshaken
+      << ", connect " << _publishTimings.ConnectResult << ", createStream " << _publishTimings.StreamCreated << ")"
+      << (_sessionManager->IsPipelinedHandshakeEnabled() ? L" pipelined" : L""));
+  });
 }
 
 task<void> RTMPMessenger::HandshakeAsyncAzure()
@@ -118,27 +160,14 @@ task<void> RTMPMessenger::HandshakeAsyncAzure()
   {
 
     antecedent.get();
-    return SendConnectAsync();
-  })
-    .then([this](task<unsigned int> antecedent)
-  {
-
-    antecedent.get();
-
-    return ReceiveConnectResponseAsync();
+    return RequestConnectAsync();
   })
     .then([this](task<void> antecedent)
   {
 
     antecedent.get(); 
    
-    return SendReleaseStreamAsync();
-  })
-    .then([this](task<unsigned int> antecedent)
-  {
-
-    antecedent.get();
-    return ReceiveReleaseStreamResponseAsync();
+    return RequestReleaseStreamAsync();
   })
 
     /* Send FCPublish and CreateStream in a batch - for some reason in case of MBR 
@@ -148,82 +177,19 @@ task<void> RTMPMessenger::HandshakeAsyncAzure()
     .then([this](task<void> antecedent)
   {
     antecedent.get();
-    //return SendFCPublishAsync();
-    return SendFCPublishAsync().then([this](task<unsigned int> antecedent)
-    {
-      antecedent.get();
-      return SendCreateStreamAsync();
-    });
-  })
-    .then([this](task<unsigned int> antecedent)
-  {
-
-    antecedent.get();
-    //return ReceiveFCPublishResponseAsync();
-    return ReceiveFCPublishResponseAsync().then([this](task<void> antecedent)
-    {
-      antecedent.get();
-      return  ReceiveCreateStreamResponseAsync();
-    });
-  })
-  /*  .then([this](task<void> antecedent)
-  {
-    antecedent.get(); 
-
-    return SendCreateStreamAsync();
+    return RequestCreateStreamAsync({ CreateFCPublishBitstream() });
   })
-    .then([this](task<unsigned int> antecedent)
-  {
-    antecedent.get();
-    return  ReceiveCreateStreamResponseAsync();
-  })*/
     .then([this](task<void> antecedent)
   {
     antecedent.get();
-    return SendPublishStreamAsync();
-  })
-    .then([this](task<unsigned int> antecedent)
-  {
-
-    antecedent.get();
-    return ReceivePublishStreamResponseAsync();
+    return RequestPublishAsync();
   })
     .then([this](task<void> antecedent)
   {
 
     antecedent.get();
 
-    if (_sessionManager->GetEncodingProfile()->Video == nullptr)
-    {
-      return SendSetDataFrameAsync(
-
-        L"mp4a",
-        _sessionManager->GetEncodingProfile()->Audio->SampleRate,
-        _sessionManager->GetEncodingProfile()->Audio->ChannelCount,
-        _sessionManager->GetEncodingProfile()->Audio->Bitrate / 1000);
-    }
-    else if (_sessionManager->GetEncodingProfile()->Audio == nullptr)
-    {
-      return SendSetDataFrameAsync(
-        (double)_sessionManager->GetEncodingProfile()->Video->FrameRate->Numerator / (double)_sessionManager->GetEncodingProfile()->Video->FrameRate->Denominator,
-        _sessionManager->GetEncodingProfile()->Video->Width,
-        _sessionManager->GetEncodingProfile()->Video->Height,
-        L"avc1",
-        _sessionManager->GetEncodingProfile()->Video->Bitrate / 1000,
-        _sessionManager->GetKeyframeInterval());
-    }
-    else
-      return SendSetDataFrameAsync(
-        (double)_sessionManager->GetEncodingProfile()->Video->FrameRate->Numerator / (double)_sessionManager->GetEncodingProfile()->Video->FrameRate->Denominator,
-        _sessionManager->GetEncodingProfile()->Video->Width,
-        _sessionManager->GetEncodingProfile()->Video->Height,
-        L"avc1",
-        _sessionManager->GetEncodingProfile()->Video->Bitrate / 1000,
-        _sessionManager->GetKeyframeInterval(),
-        L"mp4a",
-        _sessionManager->GetEncodingProfile()->Audio->SampleRate,
-        _sessionManager->GetEncodingProfile()->Audio->ChannelCount,
-        _sessionManager->GetEncodingProfile()->Audio->Bitrate / 1000);
+    return SendSetDataFrameAsync(GetStreamMetadata());
   })
     .then([this](task<unsigned int> antecedent)
   {
@@ -234,12 +200,7 @@ task<void> RTMPMessenger::HandshakeAsyncAzure()
     .then([this](task<unsigned int> antecedent)
   {
     antecedent.get();
-
-    _sessionManager->SetVideoChunkStreamID(_sessionManager->GetNextChunkStreamID());
-    _sessionManager->SetAudioChunkStreamID(_sessionManager->GetNextChunkStreamID());
-    _sessionManager->SetState(RTMPSessionState::RTMP_RUNNING);
-
-
+    StartRunning();
   });
 }
 
@@ -269,224 +230,428 @@ task<void> RTMPMessenger::HandshakeAsyncWowza()
   {
 
     antecedent.get();
-    return SendConnectAsync();
+    return RequestConnectAsync();
   })
-    .then([this](task<unsigned int> antecedent)
+    .then([this](task<void> antecedent)
   {
 
     antecedent.get();
-    return ReceiveConnectResponseAsync();
+    //releaseStream and FCPublish answers are not waited for - createStream's is told apart from them by transaction ID
+    return RequestCreateStreamAsync({ CreateReleaseStreamBitstream(), CreateFCPublishBitstream() });
   })
     .then([this](task<void> antecedent)
   {
-
     antecedent.get();
-    return SendReleaseStreamAsync();
+    return RequestPublishAsync();
   })
-    .then([this](task<unsigned int> antecedent)
+    .then([this](task<void> antecedent)
   {
+
     antecedent.get();
-    return SendFCPublishAsync();
+    return SendSetDataFrameAsync(GetStreamMetadata());
   })
     .then([this](task<unsigned int> antecedent)
   {
 
     antecedent.get();
-    return ReceiveFCPublishResponseAsync();
-  })
-    .then([this](task<void> antecedent)
-  {
-    antecedent.get(); 
-    return SendCreateStreamAsync();
+    return SendSetChunkSizeAsync(_sessionManager->GetClientChunkSize());
   })
     .then([this](task<unsigned int> antecedent)
   {
     antecedent.get();
-    return  ReceiveCreateStreamResponseAsync();
-  })
-    .then([this](task<void> antecedent)
+    StartRunning();
+  });
+}
+
+task<void> RTMPMessenger::HandshakeAsyncPipelined()
+{
+  //everything that does not depend on an answer goes out as soon as the protocol allows - C0C1, then C2 with connect, releaseStream, FCPublish and
+  //createStream in one write, then publish with @setDataFrame and the chunk size. Every answer is waited for before the write that asks for it
+  auto policy = ServerPolicy::ForServer(_sessionManager->GetServerType(), _sessionManager->IsStreamIDPredictionEnabled());
+  auto replies = make_shared<std::tuple<task<CommandReply>, task<CommandReply>, task<CommandReply>>>(); //connect, createStream, publish
+
+  return SendC0C1Async()
+    .then([this](unsigned int)
   {
-    antecedent.get();
-    return SendPublishStreamAsync();
+    return ReceiveS0S1Async();
   })
-    .then([this](task<unsigned int> antecedent)
+    .then([this, policy]()
   {
-
-    antecedent.get();
-    return ReceivePublishStreamResponseAsync();
+    if (policy.SendConnectWithC2)
+      return task_from_result();
+    return SendC2Async().then([this](unsigned int)
+    {
+      return ReceiveS2Async();
+    });
   })
-    .then([this](task<void> antecedent)
+    .then([this, policy, replies]()
   {
+    std::vector<std::shared_ptr<std::vector<BYTE>>> bitstreams;
+    if (policy.SendConnectWithC2)
+      bitstreams.push_back(CreateC2Bitstream());
 
-    antecedent.get();
-    if (_sessionManager->GetEncodingProfile()->Video == nullptr)
+    bitstreams.push_back(CreateConnectBitstream());
+    std::get<0>(*replies) = ExpectResultAsync(_sessionManager->GetLastTransactionID())
+      .then([this](CommandReply reply)
     {
-      return SendSetDataFrameAsync(
+      if (reply.Failure == nullptr && !reply.Error)
+        MarkPublishTiming(&PublishTimings::ConnectResult);
+      return reply;
+    });
+    bitstreams.push_back(CreateReleaseStreamBitstream());
+    //FCPublish and createStream back to back - see ServerPolicy::ForServer
+    bitstreams.push_back(CreateFCPublishBitstream());
+    bitstreams.push_back(CreateCreateStreamBitstream());
+    std::get<1>(*replies) = ExpectResultAsync(_sessionManager->GetLastTransactionID());
 
-        L"mp4a",
-        _sessionManager->GetEncodingProfile()->Audio->SampleRate,
-        _sessionManager->GetEncodingProfile()->Audio->ChannelCount,
-        _sessionManager->GetEncodingProfile()->Audio->Bitrate / 1000);
-    }
-    else if (_sessionManager->GetEncodingProfile()->Audio == nullptr)
+    if (policy.PredictedStreamID > 0)
     {
-      return SendSetDataFrameAsync(
-        (double)_sessionManager->GetEncodingProfile()->Video->FrameRate->Numerator / (double)_sessionManager->GetEncodingProfile()->Video->FrameRate->Denominator,
-        _sessionManager->GetEncodingProfile()->Video->Width,
-        _sessionManager->GetEncodingProfile()->Video->Height,
-        L"avc1",
-        _sessionManager->GetEncodingProfile()->Video->Bitrate / 1000,
-        _sessionManager->GetKeyframeInterval());
+      _sessionManager->SetMessageStreamID(policy.PredictedStreamID);
+      bitstreams.push_back(CreatePublishStreamBitstream());
+      std::get<2>(*replies) = ExpectStatusAsync(policy.PredictedStreamID);
+      bitstreams.push_back(CreateSetDataFrameBitstream(GetStreamMetadata()));
+      bitstreams.push_back(CreateSetChunkSizeBitstream(_sessionManager->GetClientChunkSize()));
     }
-    else
-      return SendSetDataFrameAsync(
-        (double)_sessionManager->GetEncodingProfile()->Video->FrameRate->Numerator / (double)_sessionManager->GetEncodingProfile()->Video->FrameRate->Denominator,
-        _sessionManager->GetEncodingProfile()->Video->Width,
-        _sessionManager->GetEncodingProfile()->Video->Height,
-        L"avc1",
-        _sessionManager->GetEncodingProfile()->Video->Bitrate / 1000,
-        _sessionManager->GetKeyframeInterval(),
-        L"mp4a",
-        _sessionManager->GetEncodingProfile()->Audio->SampleRate,
-        _sessionManager->GetEncodingProfile()->Audio->ChannelCount,
-        _sessionManager->GetEncodingProfile()->Audio->Bitrate / 1000);
+
+    return SendBitstreamsAsync(bitstreams);
   })
-    .then([this](task<unsigned int> antecedent)
+    .then([this, policy](unsigned int)
+  {
+    if (policy.SendConnectWithC2)
+      return ReceiveS2Async();
+    return task_from_result();
+  })
+    .then([replies]()
+  {
+    return std::get<0>(*replies);
+  })
+    .then([replies](CommandReply reply)
   {
+    CheckReply(reply, "RTMP Connect failed");
+    return std::get<1>(*replies);
+  })
+    .then([this, policy, replies](CommandReply reply)
+  {
+    OnStreamCreated(reply);
+    if (policy.PredictedStreamID > 0 && _sessionManager->GetMessageStreamID() == policy.PredictedStreamID)
+      return std::get<2>(*replies);
 
-    antecedent.get();
-    return SendSetChunkSizeAsync(_sessionManager->GetClientChunkSize());
+    std::vector<std::shared_ptr<std::vector<BYTE>>> bitstreams;
+    auto status = ExpectStatusAsync(_sessionManager->GetMessageStreamID());
+    if (policy.PredictedStreamID > 0)
+    {
+      //the guess was wrong - publish again on the stream the server handed out. Whatever it answers to the first publish goes to the wait
+      //registered for it, which is older than this one and is dropped. The chunk size has already been changed by then
+      bitstreams.push_back(CreatePublishStreamBitstream(_sessionManager->GetClientChunkSize()));
+      bitstreams.push_back(CreateSetDataFrameBitstream(GetStreamMetadata(), _sessionManager->GetClientChunkSize()));
+    }
+    else
+    {
+      bitstreams.push_back(CreatePublishStreamBitstream());
+      bitstreams.push_back(CreateSetDataFrameBitstream(GetStreamMetadata()));
+      bitstreams.push_back(CreateSetChunkSizeBitstream(_sessionManager->GetClientChunkSize()));
+    }
+    return SendBitstreamsAsync(bitstreams)
+      .then([status](unsigned int)
+    {
+      return status;
+    });
   })
-    .then([this](task<unsigned int> antecedent)
+    .then([this](CommandReply reply)
   {
-    antecedent.get();
+    CheckReply(reply, "ERROR : RTMP Publish failed");
+    MarkPublishTiming(&PublishTimings::Published);
+    StartRunning();
+  });
+}
 
-    _sessionManager->SetVideoChunkStreamID(_sessionManager->GetNextChunkStreamID());
-    _sessionManager->SetAudioChunkStreamID(_sessionManager->GetNextChunkStreamID());
-    _sessionManager->SetState(RTMPSessionState::RTMP_RUNNING);
+void RTMPMessenger::StartRunning()
+{
+  _sessionManager->SetVideoChunkStreamID(_sessionManager->GetNextChunkStreamID());
+  _sessionManager->SetAudioChunkStreamID(_sessionManager->GetNextChunkStreamID());
+  ConfigureChunkInterleaver();
+  _sessionManager->SetState(RTMPSessionState::RTMP_RUNNING);
+}
 
+RTMPMessenger::PublishTimings RTMPMessenger::GetPublishTimings()
+{
+  return _publishTimings;
+}
 
-  });
+void RTMPMessenger::MarkPublishTiming(double PublishTimings::* step)
+{
+  _publishTimings.*step = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _connectStarted).count();
 }
 
 
 void RTMPMessenger::QueueAudioVideoMessage(BYTE type,
   unsigned int timestamp,
-  std::vector<BYTE>& payload,
+  std::vector<BYTE>&& payload,
   bool useTimestampAsDelta)
 {
   
 
   auto msg = make_shared<RTMPMessage>(
     timestamp,
-    (unsigned int)payload.size(),
     type,
     _sessionManager->GetMessageStreamID(),
-    (&(*(payload.begin())))
-    , useTimestampAsDelta);
+    make_shared<vector<BYTE>>(std::move(payload)),
+    useTimestampAsDelta);
 
-  auto chunkedbs = ChunkProcessor::ToChunkedBitstream(
-    type == RTMPMessageType::VIDEO ? _sessionManager->GetVideoChunkStreamID() : _sessionManager->GetAudioChunkStreamID(),
-    _sessionManager->GetClientChunkSize(),
-    msg
-    );
+  {
+    std::lock_guard<std::mutex> lock(_mtxChunkInterleaver);
+    EnqueueAudioVideoMessage(msg);
+  }
 
-  dw->WriteBytes(ref new Array<BYTE>(&(*(chunkedbs.get()->begin())), (unsigned int)chunkedbs->size()));
+  SendQueuedChunks();
+}
 
-  try {
-    create_task(dw->StoreAsync()).wait();
-  }
-  catch (COMException^ ex)
+
+task<unsigned int> RTMPMessenger::SendBitstreamsAsync(std::vector<std::shared_ptr<std::vector<BYTE>>> bitstreams)
+{
+  std::vector<TransportBuffer> buffers;
+  for (auto& bs : bitstreams)
+    buffers.push_back(TransportBuffer{ bs->empty() ? nullptr : &(*(bs->begin())), (unsigned int) bs->size() });
+
+  task_completion_event<unsigned int> tce;
+  //the callback holds on to the bitstreams until the transport is done with them
+  _transport->Send(buffers.data(), (unsigned int) buffers.size(), [tce, bitstreams](unsigned int sent, std::exception_ptr error)
   {
-    throw;
-  }
-  catch (...)
+    if (error != nullptr)
+      tce.set_exception(error);
+    else
+      tce.set(sent);
+  });
+  return create_task(tce);
+}
+
+void RTMPMessenger::StartReceiveLoop()
+{
+  ReceiveNext();
+}
+
+void RTMPMessenger::ReceiveNext()
+{
+  //the pending read keeps the buffer alive but not the messenger - the messenger is only kept alive while a completed read is handled,
+  //so it may be destroyed from any thread, including the transport's own
+  std::weak_ptr<RTMPMessenger> weakThis = shared_from_this();
+  auto buffer = _receiveBuffer;
+  _transport->Receive(&(*(buffer->begin())), (unsigned int) buffer->size(), [weakThis, buffer](unsigned int len, std::exception_ptr error)
   {
-    throw;
-  }
+    auto messenger = weakThis.lock();
+    if (messenger == nullptr)
+      return;
+
+    if (error != nullptr || len == 0)
+    {
+      messenger->StopReceiveLoop(error != nullptr ? error : std::make_exception_ptr(std::exception("RTMP : Connection closed by server")));
+      return;
+    }
 
+    try
+    {
+      //commands go to the command dispatcher and control messages to the session manager - media and data messages are not expected from an ingest server
+      messenger->_chunkDecoder->Decode(&(*(buffer->begin())), len);
+    }
+    catch (...)
+    {
+      //nothing after a malformed chunk can be framed any more
+      messenger->_transport->Close();
+      messenger->StopReceiveLoop(std::current_exception());
+      return;
+    }
 
+    messenger->ReceiveNext();
+  });
 }
 
+void RTMPMessenger::StopReceiveLoop(std::exception_ptr error)
+{
+  //no answer is coming for anything still waiting
+  _commandDispatcher->FailAll(error);
+}
+
+task<void> RTMPMessenger::ReceiveExactlyAsync(unsigned int len, unsigned int received)
+{
+  if (received == len)
+    return task_from_result();
+  if (_receiveBuffer->size() < len)
+    _receiveBuffer->resize(len);
+
+  task_completion_event<unsigned int> tce;
+  auto buffer = _receiveBuffer;
+  _transport->Receive(&(*(buffer->begin())) + received, len - received, [tce, buffer](unsigned int count, std::exception_ptr error)
+  {
+    if (error != nullptr)
+      tce.set_exception(error);
+    else if (count == 0)
+      tce.set_exception(std::make_exception_ptr(std::exception("RTMP : Connection closed by server")));
+    else
+      tce.set(count);
+  });
+  return create_task(tce)
+    .then([this, len, received](unsigned int count)
+  {
+    return ReceiveExactlyAsync(len, received + count);
+  });
+}
 
-void RTMPMessenger::ProcessQueue()
+void RTMPMessenger::EnqueueAudioVideoMessage(shared_ptr<RTMPMessage> msg)
 {
-  while (_sessionManager->GetState() == RTMPSessionState::RTMP_RUNNING)
+  BYTE type = msg->GetMessageTypeID();
+  auto chunkStreamID = type == RTMPMessageType::VIDEO ? _sessionManager->GetVideoChunkStreamID() : _sessionManager->GetAudioChunkStreamID();
+  auto aggregator = type == RTMPMessageType::VIDEO ? _videoAggregator : _audioAggregator;
+  auto now = std::chrono::steady_clock::now();
+
+  //a batch that has been open for the time window goes out now - a stalled stream would otherwise hold its last messages back indefinitely
+  FlushDueAggregates(now);
+
+  for (auto& readymsg : aggregator->Add(msg, now))
+  {
+    if (_chunkSizeController != nullptr)
+      _chunkSizeController->Observe(type, readymsg->GetMessageLength());
+    _chunkInterleaver->Enqueue(chunkStreamID, readymsg, _sessionManager->GetChunkStreamHeaderState(chunkStreamID));
+  }
+
+  if (_chunkSizeController != nullptr)
   {
-    std::unique_lock<std::mutex> lock(_mtxQueueNotifier);
-    _cvQueueNotifier.wait(lock, [this]() {return !_messageQueue.empty(); });
+    auto chunkSize = _chunkSizeController->Evaluate();
+    if (chunkSize > 0)
+      _chunkInterleaver->RequestChunkSize(chunkSize);
+  }
+}
 
-    vector<shared_ptr<RTMPMessage>> items;
+void RTMPMessenger::ConfigureChunkInterleaver()
+{
+  //same order as SendQueuedChunks - the send lock before the interleaver lock
+  std::lock_guard<std::mutex> sendlock(_mtxSend);
+  std::lock_guard<std::mutex> lock(_mtxChunkInterleaver);
+  _chunkInterleaver->SetChunkSize(_sessionManager->GetClientChunkSize());
+  _chunkInterleaver->SetChunkStreamPriority(_sessionManager->GetAudioChunkStreamID(),
+    _sessionManager->GetAudioChunkStreamPriority(),
+    _sessionManager->GetAudioChunkStreamWeight());
+  _chunkInterleaver->SetChunkStreamPriority(_sessionManager->GetVideoChunkStreamID(),
+    _sessionManager->GetVideoChunkStreamPriority(),
+    _sessionManager->GetVideoChunkStreamWeight());
+
+  _sendBuffer->Resize(GetSendBufferSize(_sessionManager->GetClientChunkSize()));
+
+  if (_sessionManager->IsAdaptiveChunkSizeEnabled())
+    _chunkSizeController = make_shared<ChunkSizeController>(_sessionManager->GetClientChunkSize(), SENDQUANTUM, _sessionManager->GetPathMSS());
+}
 
+void RTMPMessenger::SendQueuedChunks()
+{
+  while (true)
+  {
     {
-      std::lock_guard<std::recursive_mutex> lock(_rmtxMessageQueue);
-      while (_messageQueue.empty() == false)
+      //only one thread writes to the socket - a caller that finds it busy leaves its message to the thread already sending
+      std::unique_lock<std::mutex> sendlock(_mtxSend, std::try_to_lock);
+      if (!sendlock.owns_lock())
+        return;
+
+      while (true)
       {
-        items.push_back(_messageQueue.front());
-        _messageQueue.pop_front();
+        {
+          std::lock_guard<std::mutex> lock(_mtxChunkInterleaver);
+          if (!_chunkInterleaver->Dequeue(*_sendBuffer, SENDQUANTUM))
+            break;
+          //commands written outside the interleaver have to use the chunk size the server was last told about
+          _sessionManager->SetClientChunkSize(_chunkInterleaver->GetChunkSize());
+        }
+
+        WriteSendBuffer();
       }
     }
 
+    //a message queued after the last dequeue but before the send lock was released would otherwise wait for the next caller
+    std::lock_guard<std::mutex> lock(_mtxChunkInterleaver);
+    if (_chunkInterleaver->IsEmpty())
+      return;
+  }
+}
 
+void RTMPMessenger::FlushAggregatedMessages()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mtxChunkInterleaver);
+    FlushDueAggregates(std::chrono::steady_clock::time_point::max());
+  }
 
-    for (auto& itemptr : items)
-    {
+  SendQueuedChunks();
+}
 
-      auto bs = ChunkProcessor::ToChunkedBitstream(
-        itemptr->GetMessageTypeID() == RTMPMessageType::VIDEO ? _sessionManager->GetVideoChunkStreamID() : _sessionManager->GetAudioChunkStreamID(),
-        _sessionManager->GetClientChunkSize(),
-        itemptr);
+void RTMPMessenger::FlushDueAggregates(std::chrono::steady_clock::time_point now)
+{
+  if (_audioAggregator->GetFlushDeadline() <= now)
+  {
+    for (auto& readymsg : _audioAggregator->Flush())
+      _chunkInterleaver->Enqueue(_sessionManager->GetAudioChunkStreamID(), readymsg, _sessionManager->GetChunkStreamHeaderState(_sessionManager->GetAudioChunkStreamID()));
+  }
+  if (_videoAggregator->GetFlushDeadline() <= now)
+  {
+    for (auto& readymsg : _videoAggregator->Flush())
+      _chunkInterleaver->Enqueue(_sessionManager->GetVideoChunkStreamID(), readymsg, _sessionManager->GetChunkStreamHeaderState(_sessionManager->GetVideoChunkStreamID()));
+  }
+}
 
+unsigned long long RTMPMessenger::GetMaxAudioQueueingDelay()
+{
+  std::lock_guard<std::mutex> lock(_mtxChunkInterleaver);
+  return _chunkInterleaver->GetMaxQueueingDelay(_sessionManager->GetAudioChunkStreamID());
+}
 
-      dw->WriteBytes(ref new Array<BYTE>(&(*(bs.get()->begin())), (unsigned int)bs->size()));
-    }
 
-    try {
-      create_task(dw->StoreAsync())
-        .then([this](task<unsigned int> antecedent) { antecedent.get(); return dw->FlushAsync(); })
-        .then([this](task<bool> antecedent) { antecedent.get(); }).wait();
-    }
-    catch (Exception^ ex)
-    {
-      throw ex;
-    }
-    catch (...)
-    {
-      throw;
-    }
+unsigned int RTMPMessenger::GetSendBufferSize(unsigned int chunkSize)
+{
+  //a quantum may overshoot by one chunk - adaptive chunk sizes never exceed a quantum
+  unsigned int maxChunkSize = chunkSize > SENDQUANTUM ? chunkSize : SENDQUANTUM;
+  return SENDQUANTUM + maxChunkSize + ChunkMessage::MAXHEADERSIZE;
+}
 
+void RTMPMessenger::WriteSendBuffer()
+{
+  //the transport reads straight from the send buffer memory
+  BYTE* data = nullptr;
+  unsigned int len = 0;
+  while (_sendBuffer->GetReadRegion(data, len))
+  {
+    TransportBuffer buffer{ data, len };
+    task_completion_event<unsigned int> tce;
+    _transport->Send(&buffer, 1, [tce](unsigned int sent, std::exception_ptr error)
+    {
+      if (error != nullptr)
+        tce.set_exception(error);
+      else
+        tce.set(sent);
+    });
+    auto written = create_task(tce).get();
+    if (written == 0)
+      throw std::exception("RTMP : Connection closed while sending");
+    _sendBuffer->Consume(written);
   }
 }
 
 
 task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendC0C1Async()
 {
-  dw = ref new DataWriter(_streamSocket->OutputStream);
   HandshakeMessageC0S0 c0{ HandshakeMessageC0S0::RTMP_VERSION };
   auto bitstreamc0 = c0.ToBitstream();
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bitstreamc0.get()->begin())), (unsigned int)bitstreamc0->size()));
-
 
   auto c1 = make_shared<HandshakeMessageC1C2S1S2>(_sessionManager->GetBaseEpoch(), _sessionManager->GetC1RandomBytes());
   auto bitstreamc1 = c1->ToBitstream();
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bitstreamc1.get()->begin())), (unsigned int)bitstreamc1->size()));
 
-  return create_task(dw->StoreAsync());
+  return SendBitstreamsAsync({ bitstreamc0, bitstreamc1 });
 }
 
 task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveS0S1Async()
 {
-  dr = ref new DataReader(_streamSocket->InputStream);
-  return create_task(dr->LoadAsync(1537))
-    .then([this](task<unsigned int> antecedent)
+  return ReceiveExactlyAsync(1537)
+    .then([this](task<void> antecedent)
   {
     antecedent.get();
     //receive S0 & S1
-    auto Buff = dr->ReadBuffer(1537);
-    auto vec = BitOp::BufferToVector(Buff);
-
-    if (vec.size() == 0)
-      throw std::exception("RTMP S0S1 not received");
+    auto& vec = *_receiveBuffer;
 
     auto s0 = HandshakeMessageC0S0::TryParse(&(*(vec.begin())), 1);
 
@@ -504,331 +669,287 @@ task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveS0S1Async()
   });
 }
 
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendC2Async()
+std::shared_ptr<std::vector<BYTE>> Microsoft::Media::RTMP::RTMPMessenger::CreateC2Bitstream()
 {
-  //send C2 - timestamp will be that sent in S1
+  //C2 - timestamp will be that sent in S1
   auto c2 = make_shared<HandshakeMessageC1C2S1S2>(_sessionManager->GetServerBaseEpoch(), _sessionManager->GetS1ParseTimestamp(), _sessionManager->GetS1RandomBytes());
-  auto bitstream = c2->ToBitstream();
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bitstream.get()->begin())), (unsigned int)bitstream->size()));
-  return create_task(dw->StoreAsync());
+  return c2->ToBitstream();
 }
 
-task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveS2Async()
+task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendC2Async()
 {
-  dr->InputStreamOptions = InputStreamOptions::Partial;
+  return SendBitstreamsAsync({ CreateC2Bitstream() });
+}
 
-  return create_task(dr->LoadAsync(1537))
-    .then([this](task<unsigned int> antecedent)
+task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveS2Async()
+{
+  return ReceiveExactlyAsync(1536)
+    .then([this](task<void> antecedent)
   {
-    unsigned int ret = antecedent.get();
+    antecedent.get();
 
     //receive S2
-    auto Buff = dr->ReadBuffer(1536);
-    auto vec = BitOp::BufferToVector(Buff);
-
-    if (vec.size() == 0)
-      throw std::exception("RTMP S2 not received");
+    auto& vec = *_receiveBuffer;
 
     auto s2 = HandshakeMessageC1C2S1S2::TryParse(&(*(vec.begin())), 1536);
 
     if (s2 == nullptr || s2->GetBaseEpoch() != _sessionManager->GetBaseEpoch() || !s2->AreRandomBytesEqual(_sessionManager->GetC1RandomBytes()))
       throw std::exception("RTMP Handshake Failed : Message S2");
+    MarkPublishTiming(&PublishTimings::Handshaken);
+
+    //everything after S2 is chunked - from here on the receive loop reads it
+    StartReceiveLoop();
   });
 
 }
 
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendConnectAsync()
+std::shared_ptr<std::vector<BYTE>> Microsoft::Media::RTMP::RTMPMessenger::CreateConnectBitstream()
 {
-  //send connect
   std::shared_ptr<std::vector<BYTE>> bs_commandconnect = nullptr;
   if (_sessionManager->GetEncodingProfile()->Audio == nullptr)
   {
     bs_commandconnect = ChunkProcessor::ToChunkedBitstream(
       _sessionManager->GetNextChunkStreamID(),
       _sessionManager->GetDefaultChunkSize(),
-      make_shared<Command_Connect>(_sessionManager->GetNextTransactionID(),
+      CommandTemplates::ConnectVideoOnly().Stamp(0, {
+        _sessionManager->GetNextTransactionID(),
         _sessionManager->GetServerAppName(),
-        _sessionManager->GetRTMPUri(), 
-        _sessionManager->GetSupportedRTMPVideoCodecFlags(),false));
+        _sessionManager->GetRTMPUri(),
+        _sessionManager->GetSupportedRTMPVideoCodecFlags() }));
   }
   else if (_sessionManager->GetEncodingProfile()->Video == nullptr)
   {
     bs_commandconnect = ChunkProcessor::ToChunkedBitstream(
       _sessionManager->GetNextChunkStreamID(),
       _sessionManager->GetDefaultChunkSize(),
-      make_shared<Command_Connect>(_sessionManager->GetNextTransactionID(),
+      CommandTemplates::ConnectAudioOnly().Stamp(0, {
+        _sessionManager->GetNextTransactionID(),
         _sessionManager->GetServerAppName(),
         _sessionManager->GetRTMPUri(),
-        _sessionManager->GetSupportedRTMPAudioCodecFlags(),
-        true));
+        _sessionManager->GetSupportedRTMPAudioCodecFlags() }));
   }
   else
   {
     bs_commandconnect = ChunkProcessor::ToChunkedBitstream(
       _sessionManager->GetNextChunkStreamID(),
       _sessionManager->GetDefaultChunkSize(),
-      make_shared<Command_Connect>(_sessionManager->GetNextTransactionID(),
+      CommandTemplates::Connect().Stamp(0, {
+        _sessionManager->GetNextTransactionID(),
         _sessionManager->GetServerAppName(),
         _sessionManager->GetRTMPUri(),
         _sessionManager->GetSupportedRTMPAudioCodecFlags(),
-        _sessionManager->GetSupportedRTMPVideoCodecFlags()));
+        _sessionManager->GetSupportedRTMPVideoCodecFlags() }));
   }
- 
 
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandconnect.get()->begin())), (unsigned int)bs_commandconnect->size()));
-  return create_task(dw->StoreAsync());
+  return bs_commandconnect;
 }
 
-task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveConnectResponseAsync()
+task<void> Microsoft::Media::RTMP::RTMPMessenger::RequestConnectAsync()
 {
+  auto bitstream = CreateConnectBitstream();
+  auto reply = ExpectResultAsync(_sessionManager->GetLastTransactionID());
+  return SendBitstreamsAsync({ bitstream })
+    .then([reply](unsigned int)
+  {
+    return reply;
+  })
+    .then([this](CommandReply reply)
+  {
+    CheckReply(reply, "RTMP Connect failed");
+    MarkPublishTiming(&PublishTimings::ConnectResult);
+  });
+}
 
-
-  return create_task(dr->LoadAsync(3300))
-    .then([this](task<unsigned int> antecedent)
+void Microsoft::Media::RTMP::RTMPMessenger::RegisterMessageHandlers()
+{
+  //acks and pings keep arriving for the life of the connection - read them in place instead of allocating a message for each
+  _chunkDecoder->SetMessageHandler<WindowAckSizeView>([this](const WindowAckSizeView& view)
   {
-    unsigned int ret = antecedent.get();
+    _sessionManager->SetAcknowledgementWindowSize(view.GetWindowSize());
+  });
 
+  _chunkDecoder->SetMessageHandler<SetChunkSizeView>([this](const SetChunkSizeView& view)
+  {
+    _sessionManager->SetServerChunkSize(view.GetChunkSize());
+  });
 
-    auto Buff = dr->ReadBuffer(dr->UnconsumedBufferLength);
-    auto vec = BitOp::BufferToVector(Buff);
+  _chunkDecoder->SetMessageHandler<SetPeerBandwidthView>([this](const SetPeerBandwidthView& view)
+  {
+    _sessionManager->SetPeerBandwidthLimit(view.GetBandwidth());
+    _sessionManager->SetBandwidthLimitType(view.GetBandwidthLimitType());
+  });
 
-    if (vec.size() == 0)
-      throw std::exception("RTMP Connect : Response not received");
+  _chunkDecoder->SetMessageHandler<AbortView>([](const AbortView&)
+  {
+    //applied by the decoder
+  });
 
-    auto messages = ChunkProcessor::TryParse(&(*(vec.begin())), (unsigned int)vec.size(), (unsigned int)_sessionManager->GetServerChunkSize());
+  _chunkDecoder->SetMessageHandler<AcknowledgementView>([](const AcknowledgementView&)
+  {
+    //do nothing
+  });
 
-    //read response
-    for (auto& msg : messages)
-    {
-      if (msg->GetMessageTypeID() == RTMPMessageType::PROTOACKWINDOWSIZE)
-      {
-        _sessionManager->SetAcknowledgementWindowSize((static_cast<ProtoAckWindowSizeMessage*>(msg.get()))->GetWindowSize());
-      }
-      else if (msg->GetMessageTypeID() == RTMPMessageType::PROTOSETCHUNKSIZE)
-      {
-        _sessionManager->SetServerChunkSize((static_cast<ProtoSetChunkSizeMessage*>(msg.get()))->GetChunkSize());
-      }
-      else if (msg->GetMessageTypeID() == RTMPMessageType::PROTOSETPEERBANDWIDTH)
-      {
-        _sessionManager->SetPeerBandwidthLimit((static_cast<ProtoSetPeerBandwidthMessage*>(msg.get()))->GetBandwidth());
-        _sessionManager->SetBandwidthLimitType((static_cast<ProtoSetPeerBandwidthMessage*>(msg.get()))->GetBandwidthLimitType());
-      }
-      else if (msg->GetMessageTypeID() == RTMPMessageType::COMMANDAMF0)
-      {
-        auto cmd = (static_cast<AMF0EncodedCommandOrData*>(msg.get()));
-        if (cmd->GetCommandName() == L"_error")
-        {
-          throw std::exception("RTMP Connect failed");
-        }
+  _chunkDecoder->SetMessageHandler<UserControlView>([](const UserControlView&)
+  {
+    //do nothing
+  });
 
-      }
-      else if (msg->GetMessageTypeID() == RTMPMessageType::USERCONTROL)
-      {
-        //do nothing
-      }
-    }
+  //command replies are read in place and handed to whoever waits for them - the payload is never copied into a message
+  _chunkDecoder->SetMessageHandler<AMF0CommandView>([this](const AMF0CommandView& view)
+  {
+    OnCommand(view);
   });
 
+  _chunkDecoder->SetMessageHandler<AMF3CommandView>([this](const AMF3CommandView& view)
+  {
+    OnCommand(view);
+  });
 }
 
-
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendReleaseStreamAsync()
+void Microsoft::Media::RTMP::RTMPMessenger::OnCommand(const AMF0CommandView& view)
 {
-
-  _sessionManager->SetStreamCreateReleaseChunkStreamID(_sessionManager->GetNextChunkStreamID());
-
-  auto bs_commandrelease = ChunkProcessor::ToChunkedBitstream(
-    _sessionManager->GetStreamCreateReleaseChunkStreamID(),
-    _sessionManager->GetDefaultChunkSize(),
-    make_shared<Command_ReleaseStream>(
-      _sessionManager->GetNextTransactionID(),
-      _sessionManager->GetStreamName()));
-
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandrelease.get()->begin())), (unsigned int)bs_commandrelease->size()));
-  return create_task(dw->StoreAsync());
+  //answers nobody waits for - onBWDone, onFCPublish, the releaseStream result on Wowza - are dropped
+  _commandDispatcher->Dispatch(view);
 }
 
-task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveReleaseStreamResponseAsync()
+task<CommandReply> Microsoft::Media::RTMP::RTMPMessenger::ExpectResultAsync(unsigned int transactionID)
 {
-
-
-  return create_task(dr->LoadAsync(500))
-    .then([this](task<unsigned int> antecedent)
+  task_completion_event<CommandReply> tce;
+  //failures travel inside the reply rather than as a task exception, so a wait that is given up on is never reported as unobserved
+  _commandDispatcher->ExpectResult(transactionID, _sessionManager->GetCommandTimeoutMilliseconds(), [tce](const CommandReply& reply)
   {
-    antecedent.get();
-
-    auto Buff = dr->ReadBuffer(dr->UnconsumedBufferLength);
-    auto vec = BitOp::BufferToVector(Buff);
-
-    if (vec.size() > 0) {
-
-      auto messages = ChunkProcessor::TryParse(&(*(vec.begin())), (unsigned int)vec.size(), (unsigned int)_sessionManager->GetServerChunkSize());
-
-      for (auto& msg : messages)
-      {
-        if (msg->GetMessageTypeID() == RTMPMessageType::COMMANDAMF0)
-        {
-          auto cmd = (static_cast<AMF0EncodedCommandOrData*>(msg.get()));
-          if (cmd->GetCommandName() == L"_error")
-          {
-            throw std::exception("RTMP Release Stream response");
-          }
-
-        }
-      }
+    tce.set(reply);
+  });
+  return create_task(tce);
+}
 
-    }
+task<CommandReply> Microsoft::Media::RTMP::RTMPMessenger::ExpectStatusAsync(unsigned int messageStreamID)
+{
+  task_completion_event<CommandReply> tce;
+  _commandDispatcher->ExpectStatus(messageStreamID, _sessionManager->GetCommandTimeoutMilliseconds(), [tce](const CommandReply& reply)
+  {
+    tce.set(reply);
   });
+  return create_task(tce);
+}
 
+void Microsoft::Media::RTMP::RTMPMessenger::CheckReply(const CommandReply& reply, const char* error)
+{
+  if (reply.Failure != nullptr)
+    std::rethrow_exception(reply.Failure);
+  if (reply.Error)
+    throw std::exception(error);
 }
 
 
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendFCPublishAsync()
+std::shared_ptr<std::vector<BYTE>> Microsoft::Media::RTMP::RTMPMessenger::CreateReleaseStreamBitstream()
 {
+  _sessionManager->SetStreamCreateReleaseChunkStreamID(_sessionManager->GetNextChunkStreamID());
+
   auto bs_commandrelease = ChunkProcessor::ToChunkedBitstream(
     _sessionManager->GetStreamCreateReleaseChunkStreamID(),
     _sessionManager->GetDefaultChunkSize(),
-    make_shared<Command_FCPublish>(
+    CommandTemplates::ReleaseStream().Stamp(0, {
       _sessionManager->GetNextTransactionID(),
-      _sessionManager->GetStreamName()));
+      _sessionManager->GetStreamName() }));
 
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandrelease.get()->begin())), (unsigned int)bs_commandrelease->size()));
-  return create_task(dw->StoreAsync());
+  return bs_commandrelease;
 }
 
-task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveFCPublishResponseAsync()
+task<void> Microsoft::Media::RTMP::RTMPMessenger::RequestReleaseStreamAsync()
 {
-  return create_task(dr->LoadAsync(500))
-    .then([this](task<unsigned int> antecedent)
+  auto bitstream = CreateReleaseStreamBitstream();
+  auto reply = ExpectResultAsync(_sessionManager->GetLastTransactionID());
+  return SendBitstreamsAsync({ bitstream })
+    .then([reply](unsigned int)
   {
-    antecedent.get();
-
-    auto Buff = dr->ReadBuffer(dr->UnconsumedBufferLength);
-    auto vec = BitOp::BufferToVector(Buff);
-
-    if (vec.size() > 0)
-    {
-      auto messages = ChunkProcessor::TryParse(&(*(vec.begin())), (unsigned int)vec.size(), (unsigned int)_sessionManager->GetServerChunkSize());
+    return reply;
+  })
+    .then([](CommandReply reply)
+  {
+    //only an _error fails it, as before replies were correlated - not every server answers releaseStream
+    if (reply.TimedOut)
+      return;
+    CheckReply(reply, "RTMP Release Stream response");
+  });
+}
 
-      for (auto& msg : messages)
-      {
-        if (msg->GetMessageTypeID() == RTMPMessageType::COMMANDAMF0)
-        {
-          auto cmd = (static_cast<AMF0EncodedCommandOrData*>(msg.get()));
-          if (cmd->GetCommandName() == L"_error")
-          {
-            throw std::exception("RTMP FCPublish response");
-          }
 
-        }
-      }
-    }
-  });
+std::shared_ptr<std::vector<BYTE>> Microsoft::Media::RTMP::RTMPMessenger::CreateFCPublishBitstream()
+{
+  auto bs_commandfcpublish = ChunkProcessor::ToChunkedBitstream(
+    _sessionManager->GetStreamCreateReleaseChunkStreamID(),
+    _sessionManager->GetDefaultChunkSize(),
+    CommandTemplates::FCPublish().Stamp(0, {
+      _sessionManager->GetNextTransactionID(),
+      _sessionManager->GetStreamName() }));
 
+  return bs_commandfcpublish;
 }
 
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendCreateStreamAsync()
+std::shared_ptr<std::vector<BYTE>> Microsoft::Media::RTMP::RTMPMessenger::CreateCreateStreamBitstream()
 {
   auto bs_commandcreate = ChunkProcessor::ToChunkedBitstream(
     _sessionManager->GetStreamCreateReleaseChunkStreamID(),
     _sessionManager->GetDefaultChunkSize(),
-    make_shared<Command_CreateStream>(_sessionManager->GetNextTransactionID()));
-
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandcreate.get()->begin())), (unsigned int)bs_commandcreate->size()));
-  return create_task(dw->StoreAsync());
+    CommandTemplates::CreateStream().Stamp(0, { _sessionManager->GetNextTransactionID() }));
 
+  return bs_commandcreate;
 }
 
-
-task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveCreateStreamResponseAsync()
+task<void> Microsoft::Media::RTMP::RTMPMessenger::RequestCreateStreamAsync(std::vector<std::shared_ptr<std::vector<BYTE>>> bitstreams)
 {
-  return create_task(dr->LoadAsync(500))
-    .then([this](task<unsigned int> antecedent)
+  bitstreams.push_back(CreateCreateStreamBitstream());
+  auto reply = ExpectResultAsync(_sessionManager->GetLastTransactionID());
+  return SendBitstreamsAsync(bitstreams)
+    .then([reply](unsigned int)
   {
-    antecedent.get();
-
-    auto Buff = dr->ReadBuffer(dr->UnconsumedBufferLength);
-    auto vec = BitOp::BufferToVector(Buff);
-    if (vec.size() == 0)
-      throw std::exception("RTMP Create : Response not received");
-
-    auto messages = ChunkProcessor::TryParse(&(*(vec.begin())), (unsigned int)vec.size(), (unsigned int)_sessionManager->GetServerChunkSize());
-
-    for (auto& msg : messages)
-    {
-      if (msg->GetMessageTypeID() == RTMPMessageType::COMMANDAMF0)
-      {
-        auto cmd = (static_cast<AMF0EncodedCommandOrData*>(msg.get()));
-        if (cmd->GetCommandName() == L"_error")
-        {
-          throw std::exception("RTMP Create failed");
-        }
-        else if (cmd->GetCommandName() == L"_result")
-        {
-          _sessionManager->SetMessageStreamID((unsigned int)cmd->GetAllEntities().back()->GetNumberValue());
-        }
-
-      }
-    }
+    return reply;
+  })
+    .then([this](CommandReply reply)
+  {
+    OnStreamCreated(reply);
   });
+}
 
+void Microsoft::Media::RTMP::RTMPMessenger::OnStreamCreated(const CommandReply& reply)
+{
+  CheckReply(reply, "RTMP Create failed");
+  if (reply.HasNumber)
+    _sessionManager->SetMessageStreamID((unsigned int) reply.Number);
+  MarkPublishTiming(&PublishTimings::StreamCreated);
 }
 
 
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendPublishStreamAsync()
+std::shared_ptr<std::vector<BYTE>> Microsoft::Media::RTMP::RTMPMessenger::CreatePublishStreamBitstream(unsigned int chunkSize)
 {
   _sessionManager->SetPublishChunkStreamID(_sessionManager->GetNextChunkStreamID());
   auto bs_commandpublish = ChunkProcessor::ToChunkedBitstream(
     _sessionManager->GetPublishChunkStreamID(),
-    _sessionManager->GetDefaultChunkSize(),
-    make_shared<Command_PublishStream>(
+    chunkSize > 0 ? chunkSize : _sessionManager->GetDefaultChunkSize(),
+    CommandTemplates::Publish().Stamp(_sessionManager->GetMessageStreamID(), {
       0,
-      _sessionManager->GetMessageStreamID(),
       _sessionManager->GetStreamName(),
-      RTMPPublishType::LIVE));
+      RTMPPublishType::LIVE }));
 
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandpublish.get()->begin())), (unsigned int)bs_commandpublish->size()));
-  return create_task(dw->StoreAsync());
+  return bs_commandpublish;
 }
 
-
-
-task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceivePublishStreamResponseAsync()
+task<void> Microsoft::Media::RTMP::RTMPMessenger::RequestPublishAsync()
 {
-  return create_task(dr->LoadAsync(500))
-    .then([this](task<unsigned int> antecedent)
+  auto bitstream = CreatePublishStreamBitstream();
+  //publish is answered with an onStatus rather than a _result
+  auto reply = ExpectStatusAsync(_sessionManager->GetMessageStreamID());
+  return SendBitstreamsAsync({ bitstream })
+    .then([reply](unsigned int)
   {
-    antecedent.get();
-
-    auto Buff = dr->ReadBuffer(dr->UnconsumedBufferLength);
-    auto vec = BitOp::BufferToVector(Buff);
-    if (vec.size() == 0)
-      throw std::exception("ERROR : RTMP Publish : Response not received");
-
-    auto messages = ChunkProcessor::TryParse(&(*(vec.begin())), (unsigned int)vec.size(), (unsigned int)_sessionManager->GetServerChunkSize());
-
-    for (auto& msg : messages)
-    {
-      if (msg->GetMessageTypeID() == RTMPMessageType::COMMANDAMF0)
-      {
-        auto cmd = (static_cast<AMF0EncodedCommandOrData*>(msg.get()));
-        if (cmd->GetCommandName() == L"_error")
-        {
-          throw std::exception("ERROR : RTMP Publish failed");
-        }
-        else if (cmd->GetCommandName() == L"onStatus")
-        {
-
-        }
-
-      }
-      else if (msg->GetMessageTypeID() == RTMPMessageType::USERCONTROL)
-      {
-        //do nothing
-      }
-    }
+    return reply;
+  })
+    .then([this](CommandReply reply)
+  {
+    CheckReply(reply, "ERROR : RTMP Publish failed");
+    MarkPublishTiming(&PublishTimings::Published);
   });
-
 }
 
 
@@ -837,143 +958,70 @@ task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendUnpublishAndCloseS
   auto bs_commandunpublish = ChunkProcessor::ToChunkedBitstream(
     _sessionManager->GetPublishChunkStreamID(),
     _sessionManager->GetClientChunkSize(),
-    make_shared<Command_UnpublishStream>(
-      0,
-      _sessionManager->GetMessageStreamID()));
-
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandunpublish.get()->begin())), (unsigned int)bs_commandunpublish->size()));
+    CommandTemplates::Unpublish().Stamp(_sessionManager->GetMessageStreamID(), { 0 }));
 
   auto bs_commandclose = ChunkProcessor::ToChunkedBitstream(
     _sessionManager->GetPublishChunkStreamID(),
     _sessionManager->GetClientChunkSize(),
-    make_shared<Command_CloseStream>(
-      0,
-      _sessionManager->GetMessageStreamID()));
+    CommandTemplates::CloseStream().Stamp(_sessionManager->GetMessageStreamID(), { 0 }));
 
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandclose.get()->begin())), (unsigned int)bs_commandclose->size()));
-  return create_task(dw->StoreAsync());
+  return SendBitstreamsAsync({ bs_commandunpublish, bs_commandclose });
 }
 
-task<void> Microsoft::Media::RTMP::RTMPMessenger::ReceiveUnpublishStreamResponseAsync()
+StreamMetadata Microsoft::Media::RTMP::RTMPMessenger::GetStreamMetadata()
 {
-  return create_task(dr->LoadAsync(500))
-    .then([this](task<unsigned int> antecedent)
-  {
-    antecedent.get();
-
-    auto Buff = dr->ReadBuffer(dr->UnconsumedBufferLength);
-    auto vec = BitOp::BufferToVector(Buff);
-
-    auto messages = ChunkProcessor::TryParse(&(*(vec.begin())), (unsigned int)vec.size(), (unsigned int)_sessionManager->GetServerChunkSize());
+  StreamMetadata metadata;
+  auto profile = _sessionManager->GetEncodingProfile();
 
-    for (auto& msg : messages)
-    {
-      if (msg->GetMessageTypeID() == RTMPMessageType::COMMANDAMF0)
-      {
-        auto cmd = (static_cast<AMF0EncodedCommandOrData*>(msg.get()));
-        if (cmd->GetCommandName() == L"onStatus")
-        {
-
-        }
-
-      }
+  if (profile->Video != nullptr)
+  {
+    metadata.HasVideo = true;
+    metadata.FrameRate = (double)profile->Video->FrameRate->Numerator / (double)profile->Video->FrameRate->Denominator;
+    metadata.Width = profile->Video->Width;
+    metadata.Height = profile->Video->Height;
+    metadata.VideoCodec = "avc1";
+    metadata.VideoBitrate = profile->Video->Bitrate / 1000;
+    metadata.VideoKeyFrameFrequency = _sessionManager->GetKeyframeInterval();
+  }
 
-    }
-  });
+  if (profile->Audio != nullptr)
+  {
+    metadata.HasAudio = true;
+    metadata.AudioCodec = "mp4a";
+    metadata.AudioSampleRate = profile->Audio->SampleRate;
+    metadata.AudioChannels = profile->Audio->ChannelCount;
+    metadata.AudioBitrate = profile->Audio->Bitrate / 1000;
+  }
 
+  return metadata;
 }
 
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendSetDataFrameAsync(double frameRate,
-  unsigned int width,
-  unsigned int height,
-  wstring videoCodec,
-  unsigned int videoBitrate,
-  unsigned int videoKeyFrameIntervalTime,
-  wstring audioCodec,
-  unsigned int audioSampleRate,
-  unsigned int audioChannelCount,
-  unsigned int audioBitrate)
+std::shared_ptr<std::vector<BYTE>> Microsoft::Media::RTMP::RTMPMessenger::CreateSetDataFrameBitstream(const StreamMetadata& metadata, unsigned int chunkSize)
 {
-  auto bs_commandDataFrame = ChunkProcessor::ToChunkedBitstream(
+  return ChunkProcessor::ToChunkedBitstream(
     _sessionManager->GetNextChunkStreamID(),
-    _sessionManager->GetDefaultChunkSize(),
-    make_shared<Command_SetDataFrame>(
-      _sessionManager->GetNextTransactionID(),
-      _sessionManager->GetMessageStreamID(), frameRate,
-      width,
-      height,
-      videoCodec,
-      videoBitrate,
-      videoKeyFrameIntervalTime,
-      audioCodec,
-      audioSampleRate,
-      audioChannelCount,
-      audioBitrate
-
-      ));
-
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandDataFrame.get()->begin())), (unsigned int)bs_commandDataFrame->size()));
-  return create_task(dw->StoreAsync());
+    chunkSize > 0 ? chunkSize : _sessionManager->GetDefaultChunkSize(),
+    metadata.CreateSetDataFrameMessage(_sessionManager->GetMessageStreamID()));
 }
 
-
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendSetDataFrameAsync(double frameRate,
-  unsigned int width,
-  unsigned int height,
-  wstring videoCodec,
-  unsigned int videoBitrate,
-  unsigned int videoKeyFrameIntervalTime)
+task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendSetDataFrameAsync(const StreamMetadata& metadata)
 {
-  auto bs_commandDataFrame = ChunkProcessor::ToChunkedBitstream(
-    _sessionManager->GetNextChunkStreamID(),
-    _sessionManager->GetDefaultChunkSize(),
-    make_shared<Command_SetDataFrame>(
-      _sessionManager->GetNextTransactionID(),
-      _sessionManager->GetMessageStreamID(), frameRate,
-      width,
-      height,
-      videoCodec,
-      videoBitrate,
-      videoKeyFrameIntervalTime 
-      ));
-
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandDataFrame.get()->begin())), (unsigned int)bs_commandDataFrame->size()));
-  return create_task(dw->StoreAsync());
+  return SendBitstreamsAsync({ CreateSetDataFrameBitstream(metadata) });
 }
 
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendSetDataFrameAsync( 
-  wstring audioCodec,
-  unsigned int audioSampleRate,
-  unsigned int audioChannelCount,
-  unsigned int audioBitrate)
+std::shared_ptr<std::vector<BYTE>> Microsoft::Media::RTMP::RTMPMessenger::CreateSetChunkSizeBitstream(unsigned int ChunkSize)
 {
-  auto bs_commandDataFrame = ChunkProcessor::ToChunkedBitstream(
-    _sessionManager->GetNextChunkStreamID(),
-    _sessionManager->GetDefaultChunkSize(),
-    make_shared<Command_SetDataFrame>(
-      _sessionManager->GetNextTransactionID(),
-      _sessionManager->GetMessageStreamID(),  
-      audioCodec,
-      audioSampleRate,
-      audioChannelCount,
-      audioBitrate
-
-      ));
-
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_commandDataFrame.get()->begin())), (unsigned int)bs_commandDataFrame->size()));
-  return create_task(dw->StoreAsync());
-}
-task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendSetChunkSizeAsync(unsigned int ChunkSize)
-{
-  auto bs_SetChunkSize = ChunkProcessor::ToChunkedBitstream(
+  return ChunkProcessor::ToChunkedBitstream(
     _sessionManager->GetNextChunkStreamID(),
     _sessionManager->GetDefaultChunkSize(),
     make_shared<ProtoSetChunkSizeMessage>(
       ChunkSize
       ));
+}
 
-  dw->WriteBytes(ref new Array<BYTE>(&(*(bs_SetChunkSize.get()->begin())), (unsigned int)bs_SetChunkSize->size()));
-  return create_task(dw->StoreAsync());
+task<unsigned int> Microsoft::Media::RTMP::RTMPMessenger::SendSetChunkSizeAsync(unsigned int ChunkSize)
+{
+  return SendBitstreamsAsync({ CreateSetChunkSizeBitstream(ChunkSize) });
 }
 
 
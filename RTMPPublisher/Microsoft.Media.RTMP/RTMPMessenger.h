@@ -38,10 +38,23 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <chrono>
+#include <functional>
 #include "PublishProfile.h"
 #include "RTMPMessageFormats.h" 
 #include "RTMPSessionManager.h"
 #include "RTMPChunking.h"
+#include "AMF0Document.h"
+#include "CommandDispatcher.h"
+#include "StreamMetadata.h"
+#include "RTMPTransport.h"
+#include "WinRTTransport.h"
+#include "ServerPolicy.h"
+#include "ChunkInterleaver.h"
+#include "MessageAggregator.h"
+#include "ChunkSizeController.h"
+#include "SendRingBuffer.h"
+#include "BufferOp.h"
 #include "Uri.h"
 
 
@@ -59,13 +72,17 @@ namespace Microsoft
     namespace RTMP
     {
 
-      class RTMPMessenger
+      ///<summary>Always owned by a shared_ptr - the receive loop refers back to the messenger through a weak_ptr</summary>
+      class RTMPMessenger : public std::enable_shared_from_this<RTMPMessenger>
       {
 
       public:
 
         RTMPMessenger(PublishProfile^ params);
 
+        ///<param name='transport'>Byte stream to run the protocol over - a WinRTTransport unless one is supplied</param>
+        RTMPMessenger(PublishProfile^ params, std::shared_ptr<RTMPTransport> transport);
+
         virtual ~RTMPMessenger();
 
 
@@ -80,7 +97,7 @@ namespace Microsoft
 
         void QueueAudioVideoMessage(BYTE type, 
           unsigned int timestamp, 
-          std::vector<BYTE>& payload, 
+          std::vector<BYTE>&& payload, 
           bool useTimestampAsDelta = false);
 
         shared_ptr<RTMPSessionManager> GetSessionManager()
@@ -88,31 +105,93 @@ namespace Microsoft
           return _sessionManager;
         }
 
+        ///<summary>Worst case time (microseconds) an audio message spent queued before its last chunk was handed to the socket</summary>
+        unsigned long long GetMaxAudioQueueingDelay();
+
+        ///<summary>Milliseconds from the start of ConnectAsync to each step of getting the stream published - 0 for steps not reached yet</summary>
+        struct PublishTimings
+        {
+          double Connected = 0;
+          double Handshaken = 0;
+          double ConnectResult = 0;
+          double StreamCreated = 0;
+          double Published = 0;
+        };
+
+        PublishTimings GetPublishTimings();
+
       private:
 
+        static const unsigned int RECEIVEBUFFERSIZE = 4096;
+
+        //bytes written per store - audio and control can preempt video at most this far apart
+        static const unsigned int SENDQUANTUM = 8192;
+
         std::shared_ptr<RTMPSessionManager> _sessionManager;
 
-        StreamSocket^ _streamSocket;
+        std::shared_ptr<ChunkDecoder> _chunkDecoder;
+
+        std::shared_ptr<ChunkInterleaver> _chunkInterleaver;
+
+        std::mutex _mtxChunkInterleaver;
+
+        //batching stages ahead of the interleaver, guarded by _mtxChunkInterleaver
+        std::shared_ptr<MessageAggregator> _audioAggregator;
+
+        std::shared_ptr<MessageAggregator> _videoAggregator;
+
+        //null unless adaptive chunk sizing is enabled, guarded by _mtxChunkInterleaver
+        std::shared_ptr<ChunkSizeController> _chunkSizeController;
+
+        //taken before _mtxChunkInterleaver whenever both are held
+        std::mutex _mtxSend;
+
+        //chunks are serialized into the send buffer and written to the socket from it in place, guarded by _mtxSend
+        std::shared_ptr<SendRingBuffer> _sendBuffer;
+
+        std::shared_ptr<RTMPTransport> _transport;
+
+        //inbound bytes are read into this buffer and decoded in place - shared with the pending read, which may outlive the messenger
+        std::shared_ptr<std::vector<BYTE>> _receiveBuffer;
 
-        DataReader^ dr = nullptr;
+        //commands waiting for an answer, resolved by the receive loop
+        std::shared_ptr<CommandDispatcher> _commandDispatcher;
 
-        DataWriter^ dw = nullptr;
+        std::chrono::steady_clock::time_point _connectStarted;
+
+        PublishTimings _publishTimings;
 
         std::vector<std::tuple<unsigned int, unsigned int>> _mstocs;
 
-        std::deque<std::shared_ptr<RTMPMessage>> _messageQueue;
+        ///<summary>Sends the bitstreams back to back in one vectored send</summary>
+        task<unsigned int> SendBitstreamsAsync(std::vector<std::shared_ptr<std::vector<BYTE>>> bitstreams);
+
+        ///<summary>Starts reading and decoding everything the server sends after S2 - runs until the connection or the messenger goes away</summary>
+        void StartReceiveLoop();
+
+        void ReceiveNext();
+
+        void StopReceiveLoop(std::exception_ptr error);
 
-        std::recursive_mutex _rmtxMessageQueue;
+        ///<summary>Fills the first len bytes of the receive buffer</summary>
+        task<void> ReceiveExactlyAsync(unsigned int len, unsigned int received = 0U);
 
-        std::mutex _mtxQueueNotifier;
+        static unsigned int GetSendBufferSize(unsigned int chunkSize);
 
-        std::condition_variable _cvQueueNotifier;
+        void WriteSendBuffer();
 
-        shared_ptr<std::thread> _thrdProcessQueue;
+        //callers hold _mtxChunkInterleaver
+        void EnqueueAudioVideoMessage(shared_ptr<RTMPMessage> msg);
 
+        void ConfigureChunkInterleaver();
 
+        void SendQueuedChunks();
 
-        void ProcessQueue();
+        void FlushAggregatedMessages();
+
+        ///<summary>Sends the aggregate batches whose flush deadline is at or before now - time_point::max() sends every batch</summary>
+        //callers hold _mtxChunkInterleaver
+        void FlushDueAggregates(std::chrono::steady_clock::time_point now);
 
         task<void> HandshakeAsyncWowza();
 
@@ -122,65 +201,69 @@ namespace Microsoft
 
         task<void> CloseAsyncAzure();
 
+        task<void> HandshakeAsyncPipelined();
+
+        void StartRunning();
+
+        void MarkPublishTiming(double PublishTimings::* step);
+
         task<unsigned int> SendC0C1Async();
 
         task<void> ReceiveS0S1Async();
 
+        std::shared_ptr<std::vector<BYTE>> CreateC2Bitstream();
+
         task<unsigned int> SendC2Async();
 
         task<void> ReceiveS2Async();
 
-        task<unsigned int> SendConnectAsync();
+        void RegisterMessageHandlers();
+
+        void OnCommand(const AMF0CommandView& view);
+
+        ///<summary>Waits for the _result or _error to a transaction - call before the command goes out</summary>
+        ///<returns>The reply, which carries a timeout or a lost connection as its Failure</returns>
+        task<CommandReply> ExpectResultAsync(unsigned int transactionID);
+
+        ///<summary>Waits for the next onStatus on a message stream - call before the command goes out</summary>
+        task<CommandReply> ExpectStatusAsync(unsigned int messageStreamID);
 
-        task<void> ReceiveConnectResponseAsync();
+        ///<summary>Throws if the reply is a failure or an error</summary>
+        static void CheckReply(const CommandReply& reply, const char* error);
 
-        task<unsigned int> SendReleaseStreamAsync();
+        std::shared_ptr<std::vector<BYTE>> CreateConnectBitstream();
 
-        task<void> ReceiveReleaseStreamResponseAsync();
+        task<void> RequestConnectAsync();
 
-        task<unsigned int> SendFCPublishAsync();
+        std::shared_ptr<std::vector<BYTE>> CreateReleaseStreamBitstream();
 
-        task<void> ReceiveFCPublishResponseAsync();
+        task<void> RequestReleaseStreamAsync();
 
-        task<unsigned int> SendCreateStreamAsync();
+        std::shared_ptr<std::vector<BYTE>> CreateFCPublishBitstream();
 
-        task<void> ReceiveCreateStreamResponseAsync();
+        std::shared_ptr<std::vector<BYTE>> CreateCreateStreamBitstream();
 
-        task<unsigned int> SendPublishStreamAsync();
+        ///<param name='bitstreams'>Commands to send ahead of createStream in the same write - their answers are not waited for</param>
+        task<void> RequestCreateStreamAsync(std::vector<std::shared_ptr<std::vector<BYTE>>> bitstreams = {});
 
-        task<void> ReceivePublishStreamResponseAsync();
+        void OnStreamCreated(const CommandReply& reply);
 
-        task<unsigned int> SendSetDataFrameAsync(
-          double frameRate,
-          unsigned int width,
-          unsigned int height,
-          wstring videoCodec,
-          unsigned int videoBitrate,
-          unsigned int videoKeyFrameIntervalTime,
-          wstring audioCodec,
-          unsigned int audioSampleRate,
-          unsigned int audioChannelCount,
-          unsigned int audioBitrate);
+        ///<param name='chunkSize'>Chunk size to chunk the command with - 0 for the default chunk size</param>
+        std::shared_ptr<std::vector<BYTE>> CreatePublishStreamBitstream(unsigned int chunkSize = 0U);
 
-        task<unsigned int> SendSetDataFrameAsync(
-          wstring audioCodec,
-          unsigned int audioSampleRate,
-          unsigned int audioChannelCount,
-          unsigned int audioBitrate);
+        task<void> RequestPublishAsync();
 
-        task<unsigned int> SendSetDataFrameAsync(
-          double frameRate,
-          unsigned int width,
-          unsigned int height,
-          wstring videoCodec,
-          unsigned int videoBitrate,
-          unsigned int videoKeyFrameIntervalTime);
+        StreamMetadata GetStreamMetadata();
+
+        std::shared_ptr<std::vector<BYTE>> CreateSetDataFrameBitstream(const StreamMetadata& metadata, unsigned int chunkSize = 0U);
+
+        task<unsigned int> SendSetDataFrameAsync(const StreamMetadata& metadata);
+
+        std::shared_ptr<std::vector<BYTE>> CreateSetChunkSizeBitstream(unsigned int ChunkSize);
 
         task<unsigned int> SendSetChunkSizeAsync(unsigned int ChunkSize);
 
         task<unsigned int> SendUnpublishAndCloseStreamAsync();
-
-        task<void> ReceiveUnpublishStreamResponseAsync();
         
       };
     }
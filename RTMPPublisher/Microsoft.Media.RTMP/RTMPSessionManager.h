@@ -30,11 +30,15 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <vector>
 #include <atomic>
 #include <memory> 
+#include <map>
+#include <mutex>
 #include <windows.media.mediaproperties.h>
 #include "Constants.h"
 #include "PublishProfile.h"
 #include "Uri.h"
+#include "Utf8.h"
 #include "Constants.h"
+#include "RTMPChunking.h"
 
 using namespace std;
 using namespace Windows::Media::MediaProperties;
@@ -69,20 +73,34 @@ namespace Microsoft
         RTMPSessionManager(PublishProfile^ params) :
           _encodingProfile(params->TargetEncodingProfile),
           _baseEpoch(params->BaseEpoch),
-          _rtmpUri(params->EndpointUri->Data()),
-          _streamName(params->StreamName->Data()),
           _clientChunkSize(params->ClientChunkSize),
           _serverType(params->ServerType),
-          _keyframeinterval(params->KeyFrameInterval)
-        {
-          auto uri = Microsoft::Media::RTMP::Uri::Parse(_rtmpUri);
+          _keyframeinterval(params->KeyFrameInterval),
+          _enableChunkInterleaving(params->EnableChunkInterleaving),
+          _audioChunkStreamPriority(params->AudioChunkStreamPriority),
+          _audioChunkStreamWeight(params->AudioChunkStreamWeight),
+          _videoChunkStreamPriority(params->VideoChunkStreamPriority),
+          _videoChunkStreamWeight(params->VideoChunkStreamWeight),
+          _aggregationWindowMilliseconds(params->AggregationWindowMilliseconds),
+          _aggregationWindowBytes(params->AggregationWindowBytes),
+          _enableAdaptiveChunkSize(params->EnableAdaptiveChunkSize),
+          _enablePipelinedHandshake(params->EnablePipelinedHandshake),
+          _enableStreamIDPrediction(params->EnableStreamIDPrediction),
+          _commandTimeoutMilliseconds(params->CommandTimeoutMilliseconds)
+        {
+          std::wstring rtmpUri(params->EndpointUri->Data());
+          auto uri = Microsoft::Media::RTMP::Uri::Parse(rtmpUri);
 
           if (uri.Host().empty() || uri.Port().empty())
             throw std::invalid_argument("Malformed URI");
 
           _hostName = uri.Host();
           _portNumber = uri.Port();
-          _serverappname = uri.Path(); 
+
+          //names that go out in AMF0 commands are converted to UTF-8 once, here
+          _rtmpUri = Utf8::FromWide(rtmpUri);
+          _serverappname = Utf8::FromWide(uri.Path());
+          _streamName = Utf8::FromWide(params->StreamName->Data(), params->StreamName->Length());
 
           auto seed = GetNewGUIDAsString();
           wstring sranddata = GetNewGUIDAsString() + wstring(1528 - seed.size(), '\0');
@@ -103,17 +121,20 @@ namespace Microsoft
           return _portNumber;
         }
 
-        wstring GetServerAppName()
+        ///<returns>UTF-8 application name</returns>
+        string GetServerAppName()
         {
           return _serverappname;
         }
 
-        wstring GetStreamName()
+        ///<returns>UTF-8 stream name</returns>
+        string GetStreamName()
         {
           return _streamName;
         }
 
-        wstring GetRTMPUri()
+        ///<returns>UTF-8 endpoint URI</returns>
+        string GetRTMPUri()
         {
           return _rtmpUri;
         }
@@ -153,6 +174,42 @@ namespace Microsoft
           return _clientChunkSize;
         }
 
+        void SetClientChunkSize(unsigned int val)
+        {
+          _clientChunkSize = val;
+        }
+
+        bool IsAdaptiveChunkSizeEnabled()
+        {
+          return _enableAdaptiveChunkSize;
+        }
+
+        bool IsPipelinedHandshakeEnabled()
+        {
+          return _enablePipelinedHandshake;
+        }
+
+        bool IsStreamIDPredictionEnabled()
+        {
+          return _enableStreamIDPrediction;
+        }
+
+        unsigned int GetCommandTimeoutMilliseconds()
+        {
+          return _commandTimeoutMilliseconds;
+        }
+
+        ///<summary>TCP maximum segment size assumed for the path to the server</summary>
+        unsigned int GetPathMSS()
+        {
+          return _pathMSS;
+        }
+
+        void SetPathMSS(unsigned int val)
+        {
+          _pathMSS = val;
+        }
+
         unsigned int GetServerChunkSize()
         {
           return _serverChunkSize;
@@ -203,6 +260,12 @@ namespace Microsoft
           return _transactionID++;
         }
 
+        ///<summary>Transaction ID handed out by the last GetNextTransactionID</summary>
+        unsigned int GetLastTransactionID()
+        {
+          return _transactionID - 1;
+        }
+
         unsigned int GetVideoChunkStreamID()
         {
           return _videoChunkStreamID;
@@ -223,6 +286,16 @@ namespace Microsoft
           _audioChunkStreamID = val;
         }
 
+        ///<summary>Header compression state for a chunk stream - created on first use</summary>
+        shared_ptr<ChunkStreamHeaderState> GetChunkStreamHeaderState(unsigned int chunkStreamID)
+        {
+          std::lock_guard<std::mutex> lock(_mtxChunkStreamHeaderStates);
+          auto& state = _chunkStreamHeaderStates[chunkStreamID];
+          if (state == nullptr)
+            state = make_shared<ChunkStreamHeaderState>();
+          return state;
+        }
+
         unsigned int GetMessageStreamID()
         {
           return _messageStreamID;
@@ -348,14 +421,50 @@ namespace Microsoft
           return _encodingProfile;
         }
 
+        bool IsChunkInterleavingEnabled()
+        {
+          return _enableChunkInterleaving;
+        }
+
+        unsigned int GetAggregationWindowMilliseconds()
+        {
+          return _aggregationWindowMilliseconds;
+        }
+
+        unsigned int GetAggregationWindowBytes()
+        {
+          return _aggregationWindowBytes;
+        }
+
+        ///<summary>Chunk streams without an explicit priority (control, commands) are scheduled at priority 0</summary>
+        unsigned int GetAudioChunkStreamPriority()
+        {
+          return _audioChunkStreamPriority;
+        }
+
+        unsigned int GetAudioChunkStreamWeight()
+        {
+          return _audioChunkStreamWeight;
+        }
+
+        unsigned int GetVideoChunkStreamPriority()
+        {
+          return _videoChunkStreamPriority;
+        }
+
+        unsigned int GetVideoChunkStreamWeight()
+        {
+          return _videoChunkStreamWeight;
+        }
+
 
 
       private:
         std::wstring _hostName = L"";
         std::wstring _portNumber = L"";
-        std::wstring _serverappname = L"";
-        std::wstring _streamName = L"";
-        std::wstring _rtmpUri = L"";
+        std::string _serverappname = "";
+        std::string _streamName = "";
+        std::string _rtmpUri = "";
         unsigned int _baseEpoch = 0U;
         unsigned int _serverBaseEpoch = 0U;
         unsigned int _clientChunkSize = 128U;
@@ -377,6 +486,22 @@ namespace Microsoft
         unsigned int _transactionID = 1;
         unsigned int _messageStreamID = 0;
 
+        std::map<unsigned int, shared_ptr<ChunkStreamHeaderState>> _chunkStreamHeaderStates;
+        std::mutex _mtxChunkStreamHeaderStates;
+
+        bool _enableChunkInterleaving = true;
+        unsigned int _audioChunkStreamPriority = 1;
+        unsigned int _audioChunkStreamWeight = 1;
+        unsigned int _videoChunkStreamPriority = 2;
+        unsigned int _videoChunkStreamWeight = 1;
+        unsigned int _aggregationWindowMilliseconds = 0U;
+        unsigned int _aggregationWindowBytes = 4096U;
+        bool _enableAdaptiveChunkSize = false;
+        bool _enablePipelinedHandshake = false;
+        bool _enableStreamIDPrediction = false;
+        unsigned int _commandTimeoutMilliseconds = 10000U;
+        unsigned int _pathMSS = 1460U;
+
         unsigned int _bytesSentSinceLastAck = 0;
 
         std::shared_ptr<unsigned int> _lastVideoTimestamp = nullptr;
@@ -0,0 +1,88 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <functional>
+#include <exception>
+#include <string>
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>A run of bytes handed to a vectored send - the bytes belong to the caller</summary>
+      struct TransportBuffer
+      {
+        const BYTE* Data;
+        unsigned int Length;
+      };
+
+      ///<summary>Byte stream the messenger runs the protocol over. Every operation completes through a callback, which may run on a transport thread
+      ///or, if the operation finishes right away, before the call returns. Failures are reported as an exception to rethrow, never thrown from the call itself</summary>
+      class RTMPTransport
+      {
+      public:
+        typedef std::function<void(std::exception_ptr error)> ConnectCallback;
+
+        ///<param name='bytesTransferred'>0 on a receive with no error means the peer closed the connection</param>
+        typedef std::function<void(unsigned int bytesTransferred, std::exception_ptr error)> IOCallback;
+
+        virtual ~RTMPTransport()
+        {
+
+        }
+
+        ///<param name='host'>UTF-8 host name or address</param>
+        ///<param name='port'>UTF-8 port number or service name</param>
+        virtual void Connect(const std::string& host, const std::string& port, ConnectCallback callback) = 0;
+
+        ///<summary>Sends every byte of the buffers in order - the callback runs once all of them have been handed to the network.
+        ///The buffer array is copied, the bytes it points to have to stay valid until the callback. Sends complete in the order they were issued</summary>
+        virtual void Send(const TransportBuffer* buffers, unsigned int count, IOCallback callback) = 0;
+
+        ///<summary>Receives whatever has arrived, at least one byte and at most len - the callback says how many. One receive at a time</summary>
+        virtual void Receive(BYTE* data, unsigned int len, IOCallback callback) = 0;
+
+        ///<summary>Closes the connection - pending operations fail</summary>
+        virtual void Close() = 0;
+
+        ///<summary>TCP maximum segment size of the connection</summary>
+        ///<returns>0 if it is not known - not connected, or the transport cannot tell</returns>
+        virtual unsigned int GetPathMSS()
+        {
+          return 0;
+        }
+      };
+    }
+  }
+}
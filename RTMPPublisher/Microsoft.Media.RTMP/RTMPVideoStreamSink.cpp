@@ -38,6 +38,7 @@ OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "RTMPVideoStreamSink.h"
 #include "RTMPPublishSession.h"
 #include "AVCParser.h"
+#include "ByteWriter.h"
 #include "ProfileState.h"
 
 using namespace Windows::Foundation;
@@ -333,29 +334,29 @@ std::vector<BYTE> RTMPVideoStreamSink::PreparePayload(MediaSampleInfo* pSampleIn
   BYTE videodata = pSampleInfo->IsKeyFrame() ? 0x07 /*H.264*/ | (0x01 /* Key Frame */ << 4) //first 4 bits - frame type, last 4 bits - encoding type 
     : 0x07 /*H.264*/ | (0x02 /* Inter Frame */ << 4); //first 4 bits - frame type, last 4 bits - encoding type 
 
-  BitOp::AddToBitstream(videodata, retval, false);
-
   if (firstPacket)
   {
     //we add AVCPacketType == 0, composition time offset = 0, and decoder config record
     auto decoderconfigrecord = MakeDecoderConfigRecord(pSampleInfo);
-    BitOp::AddToBitstream((BYTE)0, retval, false);
-    BitOp::AddToBitstream<unsigned int>((unsigned int)0, retval, true, 3);
 
-    auto oldsize = retval.size();
-    retval.resize(oldsize + decoderconfigrecord.size());
-    memcpy_s(&(*(retval.begin() + oldsize)), (unsigned int)decoderconfigrecord.size(), &(*(decoderconfigrecord.begin())), (unsigned int)decoderconfigrecord.size());
+    ByteWriter bw(retval, 5 + (unsigned int)decoderconfigrecord.size());
+    bw.put_u8(videodata);
+    bw.put_u8(0);
+    bw.put_u24be(0);
+    bw.put_bytes(&(*(decoderconfigrecord.begin())), (unsigned int)decoderconfigrecord.size());
   }
   else
   {
     //we add AVCPacketType == 1, composition time offset (3 bytes), and NALU's
-    BitOp::AddToBitstream((BYTE)1, retval, false);
-    BitOp::AddToBitstream<unsigned int>(compositionTimeOffset, retval, true, 3);
-
-    auto sample = MakeAVCSample(pSampleInfo);
-    auto oldsize = retval.size();
-    retval.resize(oldsize + sample.size());
-    memcpy_s(&(*(retval.begin() + oldsize)), (unsigned int)sample.size(), &(*(sample.begin())), (unsigned int)sample.size());
+    auto sampledata = pSampleInfo->GetSampleData();
+    auto nalus = AVCParser::Parse(sampledata);
+
+    //size the payload up front so that the NALU's are copied straight into it
+    ByteWriter bw(retval, 5 + AVCParser::GetAVCCLength(nalus));
+    bw.put_u8(videodata);
+    bw.put_u8(1);
+    bw.put_u24be(compositionTimeOffset);
+    AVCParser::WriteAVCC(nalus, bw);
   }
   return retval;
 }
@@ -452,19 +453,17 @@ std::vector<BYTE> RTMPVideoStreamSink::MakeDecoderConfigRecord(MediaSampleInfo*
     {
       ++ppscount;
 
-      BitOp::AddToBitstream((unsigned short)nalu->GetLength(), ppsbs);
-      auto oldsize = ppsbs.size();
-      ppsbs.resize(nalu->GetLength() + oldsize);
-      memcpy_s(&(*(ppsbs.begin() + oldsize)), nalu->GetLength(), nalu->GetData(), nalu->GetLength());
+      ByteWriter bw(ppsbs, 2 + nalu->GetLength());
+      bw.put_u16be((unsigned short)nalu->GetLength());
+      bw.put_bytes(nalu->GetData(), nalu->GetLength());
     }
     else if (nalu->GetType() == NALUType::NALUTYPE_SPS)
     {
       ++spscount;
 
-      BitOp::AddToBitstream((unsigned short)nalu->GetLength(), spsbs);
-      auto oldsize = spsbs.size();
-      spsbs.resize(nalu->GetLength() + oldsize);
-      memcpy_s(&(*(spsbs.begin() + oldsize)), nalu->GetLength(), nalu->GetData(), nalu->GetLength());
+      ByteWriter bw(spsbs, 2 + nalu->GetLength());
+      bw.put_u16be((unsigned short)nalu->GetLength());
+      bw.put_bytes(nalu->GetData(), nalu->GetLength());
 
       if (spscount == 1)
       {
@@ -493,34 +492,6 @@ std::vector<BYTE> RTMPVideoStreamSink::MakeDecoderConfigRecord(MediaSampleInfo*
   return retval;
 }
 
-std::vector<BYTE> RTMPVideoStreamSink::MakeAVCSample(MediaSampleInfo* pSampleInfo)
-{
-
-  std::vector<BYTE> retval;
-
-
-  auto sampledata = pSampleInfo->GetSampleData();
-  auto nalus = AVCParser::Parse(sampledata);
-
-  for (auto& nalu : nalus)
-  {
-
-
-    unsigned int nalusize = nalu->GetLength();
-    BitOp::AddToBitstream(nalusize, retval); //add the length field as 4 bytes
-
-    auto oldsize = retval.size();
-    auto newsize = nalusize + oldsize;
-
-    retval.resize(newsize);
-    memcpy_s(&(*(retval.begin() + oldsize)), nalusize, nalu->GetData(), nalusize);
-  }
-
-  return retval;
-}
-
-
-
 HRESULT RTMPVideoStreamSink::CompleteProcessNextWorkitem(IMFAsyncResult *pAsyncResult)
 {
   std::lock_guard<std::recursive_mutex> lock(_lockSink);
@@ -567,14 +538,14 @@ HRESULT RTMPVideoStreamSink::CompleteProcessNextWorkitem(IMFAsyncResult *pAsyncR
       _mediasinkparent->GetMessenger()->QueueAudioVideoMessage(
         RTMPMessageType::VIDEO,
         uiDTS,
-        decoderconfigpayload);
+        std::move(decoderconfigpayload));
 
       auto framepayload = PreparePayload(sampleInfo, compositiontimeoffset, false);
 
       _mediasinkparent->GetMessenger()->QueueAudioVideoMessage(
         RTMPMessageType::VIDEO,
         uiDTS,
-        framepayload);
+        std::move(framepayload));
 
     }
     else
@@ -588,7 +559,7 @@ HRESULT RTMPVideoStreamSink::CompleteProcessNextWorkitem(IMFAsyncResult *pAsyncR
       _mediasinkparent->GetMessenger()->QueueAudioVideoMessage(
         RTMPMessageType::VIDEO,
         uiDTS,
-        framepayload);
+        std::move(framepayload));
 
     }
 
@@ -74,8 +74,6 @@ namespace Microsoft
 
         HRESULT CompleteProcessNextWorkitem(IMFAsyncResult *pAsyncResult) override;
 
-        std::vector<BYTE> MakeAVCSample(MediaSampleInfo* pSampleInfo);
-
        
       };
     }
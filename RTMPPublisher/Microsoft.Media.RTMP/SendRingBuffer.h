@@ -0,0 +1,167 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+
+      ///<summary>Preallocated send buffer with reserve/commit semantics. Writers reserve contiguous space, serialize into it in place and commit what they
+      ///wrote, the transport drains committed bytes in place. When the space at the end of the buffer is too small for a reservation writing wraps around to
+      ///the start (if the reader has moved far enough), so every reservation and every readable region is contiguous. Not thread safe</summary>
+      class SendRingBuffer
+      {
+      public:
+
+        SendRingBuffer(unsigned int capacity) : _buffer(capacity)
+        {
+
+        }
+
+        unsigned int GetCapacity()
+        {
+          return (unsigned int) _buffer.size();
+        }
+
+        ///<summary>Changes the capacity - only possible while the buffer is empty</summary>
+        bool Resize(unsigned int capacity)
+        {
+          if (!IsEmpty())
+            return false;
+          _buffer.resize(capacity);
+          _buffer.shrink_to_fit();
+          return true;
+        }
+
+        bool IsEmpty()
+        {
+          return _readStart == _readEnd && _wrapEnd == 0;
+        }
+
+        ///<summary>Number of committed bytes not yet consumed</summary>
+        unsigned int GetSize()
+        {
+          return (_readEnd - _readStart) + _wrapEnd;
+        }
+
+        ///<summary>Reserves contiguous space for a writer</summary>
+        ///<returns>Pointer to the reserved space or nullptr if the buffer cannot fit len contiguous bytes until the reader consumes more</returns>
+        BYTE* Reserve(unsigned int len)
+        {
+          if (_wrapped)
+          {
+            //writing at the start of the buffer, behind the reader
+            if (_readStart - _wrapEnd < len)
+              return nullptr;
+            _reserved = len;
+            return _buffer.data() + _wrapEnd;
+          }
+
+          if ((unsigned int) _buffer.size() - _readEnd >= len)
+          {
+            _reserved = len;
+            return _buffer.data() + _readEnd;
+          }
+
+          //not enough room at the end - wrap if there is enough room ahead of the reader (an empty buffer always starts at 0)
+          if (_readStart >= len)
+          {
+            _wrapped = true;
+            _reserved = len;
+            return _buffer.data();
+          }
+
+          return nullptr;
+        }
+
+        ///<summary>Makes len bytes of the last reservation readable</summary>
+        void Commit(unsigned int len)
+        {
+          if (len > _reserved)
+            len = _reserved;
+          if (_wrapped)
+            _wrapEnd += len;
+          else
+            _readEnd += len;
+          _reserved = 0;
+        }
+
+        ///<summary>Oldest contiguous run of committed bytes</summary>
+        ///<returns>false if there is nothing to read</returns>
+        bool GetReadRegion(BYTE*& data, unsigned int& len)
+        {
+          if (_readStart == _readEnd && _wrapped)
+            Unwrap();
+
+          len = _readEnd - _readStart;
+          data = _buffer.data() + _readStart;
+          return len > 0;
+        }
+
+        ///<summary>Releases len bytes from the front of the read region</summary>
+        void Consume(unsigned int len)
+        {
+          _readStart += min(len, _readEnd - _readStart);
+          if (_readStart == _readEnd)
+          {
+            if (_wrapped)
+              Unwrap();
+            else
+              _readStart = _readEnd = 0;
+          }
+        }
+
+      private:
+
+        void Unwrap()
+        {
+          _readStart = 0;
+          _readEnd = _wrapEnd;
+          _wrapEnd = 0;
+          _wrapped = false;
+        }
+
+        std::vector<BYTE> _buffer;
+        //committed, unconsumed bytes are [_readStart, _readEnd) followed by [0, _wrapEnd) once the writer has wrapped
+        unsigned int _readStart = 0U;
+        unsigned int _readEnd = 0U;
+        unsigned int _wrapEnd = 0U;
+        bool _wrapped = false;
+        unsigned int _reserved = 0U;
+      };
+
+    }
+  }
+}
@@ -0,0 +1,70 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include <wtypes.h>
+#include "Constants.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>What the pipelined handshake may assume about an ingest server</summary>
+      struct ServerPolicy
+      {
+        //send connect in the same write as C2 instead of waiting for S2 first
+        bool SendConnectWithC2 = true;
+        //message stream ID the first createStream on a connection is assumed to be answered with - publish goes out right behind createStream when set,
+        //0 to wait for the answer. Only a guess : the messenger publishes again on the ID the server actually hands out
+        unsigned int PredictedStreamID = 0U;
+
+        ///<param name='predictStreamID'>Whether to guess the stream ID where the server type allows it - opt in, see PublishProfile::EnableStreamIDPrediction</param>
+        static ServerPolicy ForServer(RTMPServerType serverType, bool predictStreamID)
+        {
+          ServerPolicy policy;
+          if (serverType == RTMPServerType::Wowza)
+          {
+            //Wowza numbers the streams of a connection from 1, but nothing in the protocol promises that
+            policy.PredictedStreamID = predictStreamID ? 1U : 0U;
+          }
+          else
+          {
+            //with MBR, AMS does not hand out stream IDs per connection the way other servers do - FCPublish and createStream have to go out
+            //back to back before either answer is read, and the stream ID cannot be guessed
+            policy.PredictedStreamID = 0U;
+          }
+          return policy;
+        }
+      };
+    }
+  }
+}
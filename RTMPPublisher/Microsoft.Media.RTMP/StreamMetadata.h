@@ -0,0 +1,104 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include "ProtocolConstants.h"
+#include "ByteWriter.h"
+#include "AMF0Schema.h"
+#include "RTMPMessageFormats.h"
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>Stream metadata sent in the onMetaData object of @setDataFrame. To send a new property add a member and list it in GetSchema</summary>
+      struct StreamMetadata
+      {
+        static const unsigned int VIDEO = 1;
+        static const unsigned int AUDIO = 2;
+
+        bool HasVideo = false;
+        double FrameRate = 0;
+        unsigned int Width = 0U;
+        unsigned int Height = 0U;
+        std::string VideoCodec;
+        //kbps
+        unsigned int VideoBitrate = 0U;
+        unsigned int VideoKeyFrameFrequency = 0U;
+
+        bool HasAudio = false;
+        std::string AudioCodec;
+        unsigned int AudioSampleRate = 0U;
+        unsigned int AudioChannels = 0U;
+        //kbps
+        unsigned int AudioBitrate = 0U;
+
+        static auto GetSchema()
+        {
+          return std::make_tuple(
+            AMF0Schema::Field("framerate", &StreamMetadata::FrameRate, VIDEO),
+            AMF0Schema::Field("width", &StreamMetadata::Width, VIDEO),
+            AMF0Schema::Field("height", &StreamMetadata::Height, VIDEO),
+            AMF0Schema::Field("videocodecid", &StreamMetadata::VideoCodec, VIDEO),
+            AMF0Schema::Field("videodatarate", &StreamMetadata::VideoBitrate, VIDEO),
+            AMF0Schema::Field("videokeyframe_frequency", &StreamMetadata::VideoKeyFrameFrequency, VIDEO),
+            AMF0Schema::Field("audiocodecid", &StreamMetadata::AudioCodec, AUDIO),
+            AMF0Schema::Field("audiosamplerate", &StreamMetadata::AudioSampleRate, AUDIO),
+            AMF0Schema::Field("audiochannels", &StreamMetadata::AudioChannels, AUDIO),
+            AMF0Schema::Field("audiodatarate", &StreamMetadata::AudioBitrate, AUDIO));
+        }
+
+        ///<summary>Builds the @setDataFrame data message - the properties of a missing track are left out</summary>
+        shared_ptr<RTMPMessage> CreateSetDataFrameMessage(unsigned int messageStreamID) const
+        {
+          static const auto setDataFrame = AMF0Schema::StringValue("@setDataFrame");
+          static const auto onMetaData = AMF0Schema::StringValue("onMetaData");
+
+          unsigned int groups = (HasVideo ? VIDEO : 0U) | (HasAudio ? AUDIO : 0U);
+          unsigned int len = (unsigned int) (sizeof(setDataFrame.Bytes) + sizeof(onMetaData.Bytes)) + AMF0Schema::GetEncodedLength(*this, groups);
+
+          auto payload = make_shared<vector<BYTE>>(len);
+          ByteWriter bw(payload->data(), len);
+          bw.put_bytes(setDataFrame.Bytes, (unsigned int) sizeof(setDataFrame.Bytes));
+          bw.put_bytes(onMetaData.Bytes, (unsigned int) sizeof(onMetaData.Bytes));
+          AMF0Schema::Encode(*this, bw, groups);
+
+          return make_shared<RTMPMessage>(0, (BYTE) RTMPMessageType::DATAAMF0, messageStreamID, payload);
+        }
+      };
+    }
+  }
+}
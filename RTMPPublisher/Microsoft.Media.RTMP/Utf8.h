@@ -0,0 +1,123 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include <wtypes.h>
+#include <string>
+#include <string.h>
+
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>UTF-8 helpers - AMF0 strings are kept as UTF-8 bytes and only converted where they cross the WinRT boundary</summary>
+      class Utf8
+      {
+      public:
+
+        ///<summary>Checks whether a run of bytes is 7-bit ASCII, 8 bytes at a time</summary>
+        static bool IsAscii(const char* data, size_t len)
+        {
+          const unsigned long long highbits = 0x8080808080808080ULL;
+          size_t ctr = 0;
+          for (; ctr + 8 <= len; ctr += 8)
+          {
+            unsigned long long word = 0;
+            memcpy(&word, data + ctr, sizeof(word));
+            if (word & highbits)
+              return false;
+          }
+          for (; ctr < len; ctr++)
+          {
+            if (data[ctr] & 0x80)
+              return false;
+          }
+          return true;
+        }
+
+        ///<summary>Converts a UTF-16 string to UTF-8 - ASCII strings are narrowed directly without calling into the OS</summary>
+        static std::string FromWide(const wchar_t* data, size_t len)
+        {
+          wchar_t bits = 0;
+          for (size_t ctr = 0; ctr < len; ctr++)
+            bits |= data[ctr];
+
+          std::string retval;
+          if (bits < 0x80)
+          {
+            retval.resize(len);
+            for (size_t ctr = 0; ctr < len; ctr++)
+              retval[ctr] = (char) data[ctr];
+            return retval;
+          }
+
+          auto buffsize = ::WideCharToMultiByte(CP_UTF8, 0, data, (int) len, nullptr, 0, nullptr, nullptr);
+          if (buffsize <= 0)
+            return retval;
+          retval.resize(buffsize);
+          ::WideCharToMultiByte(CP_UTF8, 0, data, (int) len, &retval[0], buffsize, nullptr, nullptr);
+          return retval;
+        }
+
+        static std::string FromWide(const std::wstring& in)
+        {
+          return FromWide(in.data(), in.size());
+        }
+
+        ///<summary>Converts UTF-8 bytes to a UTF-16 string - ASCII is widened directly without calling into the OS</summary>
+        static std::wstring ToWide(const char* data, size_t len)
+        {
+          std::wstring retval;
+          if (IsAscii(data, len))
+          {
+            retval.resize(len);
+            for (size_t ctr = 0; ctr < len; ctr++)
+              retval[ctr] = (wchar_t) data[ctr];
+            return retval;
+          }
+
+          auto buffsize = ::MultiByteToWideChar(CP_UTF8, 0, data, (int) len, nullptr, 0);
+          if (buffsize <= 0)
+            return retval;
+          retval.resize(buffsize);
+          ::MultiByteToWideChar(CP_UTF8, 0, data, (int) len, &retval[0], buffsize);
+          return retval;
+        }
+
+        static std::wstring ToWide(const std::string& in)
+        {
+          return ToWide(in.data(), in.size());
+        }
+      };
+    }
+  }
+}
@@ -0,0 +1,184 @@
+/****************************************************************************************************************************
+
+RTMP Live Publishing Library
+
+Copyright (c) Microsoft Corporation
+
+All rights reserved.
+
+MIT License
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation
+files (the ""Software""), to deal in the Software without restriction, including without limitation the rights to use, copy,
+modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED *AS IS*, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+*****************************************************************************************************************************/
+
+
+
+#pragma once
+
+#include <wtypes.h>
+#include <windows.networking.h>
+#include <windows.networking.sockets.h>
+#include <windows.storage.streams.h>
+#include <ppltasks.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "RTMPTransport.h"
+#include "BufferOp.h"
+#include "Utf8.h"
+
+using namespace Windows::Networking;
+using namespace Windows::Networking::Sockets;
+using namespace Windows::Storage::Streams;
+using namespace Concurrency;
+using namespace Platform;
+using namespace std;
+
+namespace Microsoft
+{
+  namespace Media
+  {
+    namespace RTMP
+    {
+      ///<summary>RTMPTransport over a WinRT StreamSocket. Sends write straight out of the caller's memory, receives go through a DataReader in partial mode</summary>
+      class WinRTTransport : public RTMPTransport
+      {
+      public:
+
+        WinRTTransport() : _lastSend(task_from_result())
+        {
+
+        }
+
+        virtual void Connect(const std::string& host, const std::string& port, ConnectCallback callback) override
+        {
+          _streamSocket = ref new StreamSocket();
+          _streamSocket->Control->KeepAlive = true;
+          _streamSocket->Control->NoDelay = true;
+
+          create_task(_streamSocket->ConnectAsync(
+            ref new HostName(ref new String(Utf8::ToWide(host).data())),
+            ref new String(Utf8::ToWide(port).data())))
+            .then([this, callback](task<void> antecedent)
+          {
+            try
+            {
+              antecedent.get();
+              _reader = ref new DataReader(_streamSocket->InputStream);
+              _reader->InputStreamOptions = InputStreamOptions::Partial;
+            }
+            catch (...)
+            {
+              callback(std::current_exception());
+              return;
+            }
+            callback(nullptr);
+          });
+        }
+
+        virtual void Send(const TransportBuffer* buffers, unsigned int count, IOCallback callback) override
+        {
+          auto pending = make_shared<std::vector<TransportBuffer>>(buffers, buffers + count);
+
+          //each send starts when the one before it is done so that the bytes go out in order
+          std::lock_guard<std::mutex> lock(_mtxSend);
+          _lastSend = _lastSend.then([this, pending, callback]()
+          {
+            return WriteAsync(pending, 0, 0, 0)
+              .then([callback](task<unsigned int> antecedent)
+            {
+              unsigned int written = 0;
+              try
+              {
+                written = antecedent.get();
+              }
+              catch (...)
+              {
+                callback(0, std::current_exception());
+                return;
+              }
+              callback(written, nullptr);
+            });
+          });
+        }
+
+        virtual void Receive(BYTE* data, unsigned int len, IOCallback callback) override
+        {
+          create_task(_reader->LoadAsync(len))
+            .then([this, data, len, callback](task<unsigned int> antecedent)
+          {
+            unsigned int read = 0;
+            try
+            {
+              antecedent.get();
+              read = _reader->UnconsumedBufferLength < len ? _reader->UnconsumedBufferLength : len;
+              if (read > 0)
+                _reader->ReadBytes(ArrayReference<BYTE>(data, read));
+            }
+            catch (...)
+            {
+              callback(0, std::current_exception());
+              return;
+            }
+            callback(read, nullptr);
+          });
+        }
+
+        virtual void Close() override
+        {
+          if (_streamSocket != nullptr)
+          {
+            delete _streamSocket;
+            _streamSocket = nullptr;
+          }
+        }
+
+      private:
+
+        ///<summary>Writes the buffers from the given position on - the views wrap the caller's memory, nothing is copied</summary>
+        task<unsigned int> WriteAsync(shared_ptr<std::vector<TransportBuffer>> buffers, unsigned int index, unsigned int offset, unsigned int total)
+        {
+          while (index < buffers->size() && offset == (*buffers)[index].Length)
+          {
+            index++;
+            offset = 0;
+          }
+          if (index == buffers->size())
+            return task_from_result(total);
+
+          auto& buf = (*buffers)[index];
+          auto view = Make<BufferView>();
+          view->SetView(const_cast<BYTE*>(buf.Data) + offset, buf.Length - offset);
+
+          return create_task(_streamSocket->OutputStream->WriteAsync(view->AsBuffer()))
+            .then([this, buffers, index, offset, total, view](unsigned int written)
+          {
+            if (written == 0)
+              throw std::exception("RTMP : Connection closed while sending");
+            return WriteAsync(buffers, index, offset + written, total + written);
+          });
+        }
+
+        StreamSocket^ _streamSocket = nullptr;
+
+        DataReader^ _reader = nullptr;
+
+        std::mutex _mtxSend;
+
+        task<void> _lastSend;
+      };
+    }
+  }
+}